@@ -911,6 +911,11 @@ const char *OBSApp::GetRenderModule() const
 	const char *renderer = config_get_string(globalConfig, "Video",
 			"Renderer");
 
+	/* the null renderer is only available when it has been built, and
+	 * is not offered in the settings */
+	if (astrcmpi(renderer, "Null") == 0 && *DL_NULL)
+		return DL_NULL;
+
 	return (astrcmpi(renderer, "Direct3D 11") == 0) ?
 		DL_D3D11 : DL_OPENGL;
 }
@@ -1839,12 +1844,33 @@ static void upgrade_settings(void)
 	os_closedir(dir);
 }
 
+static void log_leaked_memory(void)
+{
+	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+
+	for (int tag = 0; tag < bmem_num_tags(); tag++) {
+		struct bmem_stats stats;
+		if (!bmem_get_tag_stats(tag, &stats) || !stats.allocs)
+			continue;
+
+		blog(LOG_INFO, "    %s: %llu allocations, %llu bytes "
+				"(peak %llu bytes)",
+				bmem_get_tag_name(tag),
+				(unsigned long long)stats.allocs,
+				(unsigned long long)stats.bytes,
+				(unsigned long long)stats.peak_bytes);
+	}
+}
+
 int main(int argc, char *argv[])
 {
 #ifndef _WIN32
 	signal(SIGPIPE, SIG_IGN);
 #endif
 
+	bmem_enable_thread_cache(true);
+	bmem_set_thread_tag(bmem_register_tag("UI"));
+
 #ifdef _WIN32
 	SetErrorMode(SEM_FAILCRITICALERRORS);
 	load_debug_privilege();
@@ -1873,6 +1899,9 @@ int main(int argc, char *argv[])
 		} else if (arg_is(argv[i], "--unfiltered_log", nullptr)) {
 			unfiltered_log = true;
 
+		} else if (arg_is(argv[i], "--memory-stats", nullptr)) {
+			bmem_enable_stats(true);
+
 		} else if (arg_is(argv[i], "--startstreaming", nullptr)) {
 			opt_start_streaming = true;
 
@@ -1916,7 +1945,9 @@ int main(int argc, char *argv[])
 			"--multi, -m: Don't warn when launching multiple instances.\n\n" <<
 			"--verbose: Make log more verbose.\n" <<
 			"--always-on-top: Start in 'always on top' mode.\n\n" <<
-			"--unfiltered_log: Make log unfiltered.\n\n" <<
+			"--unfiltered_log: Make log unfiltered.\n" <<
+			"--memory-stats: Log memory leaks by thread on exit."
+				<< "\n\n" <<
 			"--allow-opengl: Allow OpenGL on Windows.\n\n" <<
 			"--version, -V: Get current version.\n";
 
@@ -1946,7 +1977,7 @@ int main(int argc, char *argv[])
 	curl_global_init(CURL_GLOBAL_ALL);
 	int ret = run_program(logFile, argc, argv);
 
-	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+	log_leaked_memory();
 	base_set_log_handler(nullptr, nullptr);
 	return ret;
 }
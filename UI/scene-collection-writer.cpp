@@ -0,0 +1,92 @@
+/******************************************************************************
+    Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/base.h>
+#include "scene-collection-writer.hpp"
+
+using namespace std;
+
+SceneCollectionWriter::SceneCollectionWriter()
+{
+	thread = std::thread([this] () {WriteThread();});
+}
+
+SceneCollectionWriter::~SceneCollectionWriter()
+{
+	{
+		unique_lock<mutex> lock(m);
+		stopping = true;
+	}
+
+	cv.notify_all();
+	thread.join();
+}
+
+void SceneCollectionWriter::WriteThread()
+{
+	os_set_thread_name("scene collection writer");
+
+	unique_lock<mutex> lock(m);
+
+	for (;;) {
+		cv.wait(lock, [this] () {return pending || stopping;});
+
+		/* pending data is always written before stopping */
+		if (!pending)
+			break;
+
+		string path = move(pendingPath);
+		string data = move(pendingData);
+		pending = false;
+		writing = true;
+
+		lock.unlock();
+
+		if (!os_quick_write_utf8_file_safe(path.c_str(), data.c_str(),
+					data.size(), false, "tmp", "bak"))
+			blog(LOG_ERROR, "Could not save scene data to %s",
+					path.c_str());
+
+		lock.lock();
+
+		writing = false;
+		cv.notify_all();
+	}
+}
+
+void SceneCollectionWriter::Write(const string &path, string &&data)
+{
+	unique_lock<mutex> lock(m);
+
+	/* data waiting for another file can't be replaced, only data that
+	 * was queued for the same file */
+	cv.wait(lock, [&] () {return !pending || pendingPath == path;});
+
+	pendingPath = path;
+	pendingData = move(data);
+	pending = true;
+
+	cv.notify_all();
+}
+
+void SceneCollectionWriter::Flush()
+{
+	unique_lock<mutex> lock(m);
+	cv.wait(lock, [this] () {return !pending && !writing;});
+}
@@ -0,0 +1,47 @@
+/******************************************************************************
+    Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <mutex>
+
+/* Writes scene collection files on a background thread.  Data queued for a
+ * file while the previous data for that file is still waiting to be written
+ * replaces it, so bursts of saves only write the most recent data once. */
+class SceneCollectionWriter {
+	std::thread thread;
+	std::condition_variable cv;
+	std::mutex m;
+
+	std::string pendingPath;
+	std::string pendingData;
+	bool pending = false;
+	bool writing = false;
+	bool stopping = false;
+
+	void WriteThread();
+
+public:
+	SceneCollectionWriter();
+	~SceneCollectionWriter();
+
+	void Write(const std::string &path, std::string &&data);
+	void Flush();
+};
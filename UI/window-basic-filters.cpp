@@ -237,7 +237,7 @@ void OBSBasicFilters::RemoveFilter(OBSSource filter)
 	blog(LOG_INFO, "User removed filter '%s' (%s) from source '%s'",
 			filterName, filterId, sourceName);
 
-	main->SaveProject();
+	main->SaveProjectChanged(source);
 }
 
 struct FilterOrderInfo {
@@ -322,7 +322,7 @@ void OBSBasicFilters::UpdateFilters()
 				window->AddFilter(filter);
 			}, this);
 
-	main->SaveProject();
+	main->SaveProjectChanged(source);
 }
 
 static bool filter_compatible(bool async, uint32_t sourceFlags,
@@ -462,7 +462,7 @@ void OBSBasicFilters::closeEvent(QCloseEvent *event)
 	obs_display_remove_draw_callback (ui->preview->GetDisplay(),
 		OBSBasicFilters::DrawPreview, this);
 
-	main->SaveProject();
+	main->SaveProjectChanged(source);
 }
 
 /* OBS Signals */
@@ -322,11 +322,11 @@ static obs_data_t *GenerateSaveData(obs_data_array_t *sceneOrder,
 		obs_data_array_t *savedProjectorList,
 		obs_data_array_t *savedPreviewProjectorList,
 		obs_data_array_t *savedStudioProgramProjectorList,
-		obs_data_array_t *savedMultiviewProjectorList)
+		obs_data_array_t *savedMultiviewProjectorList,
+		vector<OBSSource> &audioSources)
 {
 	obs_data_t *saveData = obs_data_create();
 
-	vector<OBSSource> audioSources;
 	audioSources.reserve(5);
 
 	SaveAudioDevice(DESKTOP_AUDIO_1, 1, saveData, audioSources);
@@ -335,19 +335,6 @@ static obs_data_t *GenerateSaveData(obs_data_array_t *sceneOrder,
 	SaveAudioDevice(AUX_AUDIO_2,     4, saveData, audioSources);
 	SaveAudioDevice(AUX_AUDIO_3,     5, saveData, audioSources);
 
-	auto FilterAudioSources = [&](obs_source_t *source)
-	{
-		return find(begin(audioSources), end(audioSources), source) ==
-				end(audioSources);
-	};
-	using FilterAudioSources_t = decltype(FilterAudioSources);
-
-	obs_data_array_t *sourcesArray = obs_save_sources_filtered(
-			[](void *data, obs_source_t *source)
-	{
-		return (*static_cast<FilterAudioSources_t*>(data))(source);
-	}, static_cast<void*>(&FilterAudioSources));
-
 	obs_source_t *transition = obs_get_output_source(0);
 	obs_source_t *currentScene = obs_scene_get_source(scene);
 	const char   *sceneName   = obs_source_get_name(currentScene);
@@ -360,7 +347,6 @@ static obs_data_t *GenerateSaveData(obs_data_array_t *sceneOrder,
 	obs_data_set_string(saveData, "current_program_scene", programName);
 	obs_data_set_array(saveData, "scene_order", sceneOrder);
 	obs_data_set_string(saveData, "name", sceneCollection);
-	obs_data_set_array(saveData, "sources", sourcesArray);
 	obs_data_set_array(saveData, "quick_transitions", quickTransitionData);
 	obs_data_set_array(saveData, "transitions", transitions);
 	obs_data_set_array(saveData, "saved_projectors", savedProjectorList);
@@ -370,7 +356,6 @@ static obs_data_t *GenerateSaveData(obs_data_array_t *sceneOrder,
 			savedStudioProgramProjectorList);
 	obs_data_set_array(saveData, "saved_multiview_projectors",
 			savedMultiviewProjectorList);
-	obs_data_array_release(sourcesArray);
 
 	obs_data_set_string(saveData, "current_transition",
 			obs_source_get_name(transition));
@@ -487,6 +472,151 @@ obs_data_array_t *OBSBasic::SaveMultiviewProjectors()
 	return saveProjector;
 }
 
+void OBSBasic::MarkSourceDirty(obs_source_t *source)
+{
+	lock_guard<mutex> lock(dirtySourcesMutex);
+
+	if (source)
+		dirtySources.insert(source);
+	else
+		allSourcesDirty = true;
+}
+
+/* source signals for changes to anything the source saves, filters are saved
+ * by their parent, so changes to filters mark the parent dirty */
+static const char *sourceSaveSignals[] = {
+	"update",
+	"rename",
+	"enable",
+	"volume",
+	"mute",
+	"push_to_mute_changed",
+	"push_to_mute_delay",
+	"push_to_talk_changed",
+	"push_to_talk_delay",
+	"audio_sync",
+	"audio_mixers",
+	"audio_monitoring",
+	"update_flags",
+	"reorder_filters"
+};
+
+void OBSBasic::ConnectSourceSignals(obs_source_t *source)
+{
+	signal_handler_t *sh = obs_source_get_signal_handler(source);
+
+	for (const char *signal : sourceSaveSignals)
+		signal_handler_connect(sh, signal, OBSBasic::SourceChanged,
+				this);
+
+	signal_handler_connect(sh, "filter_add",
+			OBSBasic::SourceFilterAdded, this);
+	signal_handler_connect(sh, "filter_remove",
+			OBSBasic::SourceFilterRemoved, this);
+}
+
+void OBSBasic::DisconnectSourceSignals(obs_source_t *source)
+{
+	signal_handler_t *sh = obs_source_get_signal_handler(source);
+
+	for (const char *signal : sourceSaveSignals)
+		signal_handler_disconnect(sh, signal, OBSBasic::SourceChanged,
+				this);
+
+	signal_handler_disconnect(sh, "filter_add",
+			OBSBasic::SourceFilterAdded, this);
+	signal_handler_disconnect(sh, "filter_remove",
+			OBSBasic::SourceFilterRemoved, this);
+
+	obs_source_enum_filters(source, [] (obs_source_t*,
+				obs_source_t *filter, void *data)
+	{
+		OBSBasic *window = static_cast<OBSBasic*>(data);
+		window->DisconnectSourceSignals(filter);
+	}, this);
+}
+
+/* Returns the "sources" array.  Only sources that were marked dirty or that
+ * weren't saved before are saved again, the rest reuse the data from the
+ * last save. */
+obs_data_array_t *OBSBasic::SaveSources(const vector<OBSSource> &skip)
+{
+	unordered_set<obs_source_t*> dirty;
+	bool allDirty;
+
+	{
+		lock_guard<mutex> lock(dirtySourcesMutex);
+		dirty.swap(dirtySources);
+		allDirty = allSourcesDirty;
+		allSourcesDirty = false;
+	}
+
+	if (allDirty)
+		savedSources.clear();
+	for (obs_source_t *source : dirty)
+		savedSources.erase(source);
+
+	struct SaveEntry {
+		obs_source_t *source;
+		bool cached;
+	};
+
+	struct SaveContext {
+		OBSBasic *window;
+		const vector<OBSSource> &skip;
+		vector<SaveEntry> entries;
+	} context = {this, skip, {}};
+
+	/* the filter is called in source order, and only the sources it
+	 * accepts are saved, so the returned array holds the saved data of
+	 * the entries that aren't cached, in the same order */
+	obs_data_array_t *array = obs_save_sources_filtered(
+			[] (void *data, obs_source_t *source)
+	{
+		SaveContext *context = static_cast<SaveContext*>(data);
+		auto &saved = context->window->savedSources;
+
+		if (find(begin(context->skip), end(context->skip), source) !=
+				end(context->skip))
+			return false;
+
+		auto it = saved.find(source);
+		bool cached = it != saved.end() &&
+			obs_weak_source_references_source(it->second.weak,
+					source);
+
+		context->entries.push_back({source, cached});
+		return !cached;
+	}, &context);
+
+	unordered_map<obs_source_t*, SavedSource> newSavedSources;
+	newSavedSources.reserve(context.entries.size());
+
+	obs_data_array_t *sources = obs_data_array_create();
+	size_t idx = 0;
+
+	for (SaveEntry &entry : context.entries) {
+		SavedSource &saved = newSavedSources[entry.source];
+
+		if (entry.cached) {
+			saved = move(savedSources[entry.source]);
+		} else {
+			obs_data_t *data = obs_data_array_item(array, idx++);
+
+			saved.weak = OBSGetWeakRef(entry.source);
+			saved.data = data;
+			obs_data_release(data);
+		}
+
+		obs_data_array_push_back(sources, saved.data);
+	}
+
+	savedSources.swap(newSavedSources);
+	obs_data_array_release(array);
+
+	return sources;
+}
+
 void OBSBasic::Save(const char *file)
 {
 	OBSScene scene = GetCurrentScene();
@@ -503,12 +633,13 @@ void OBSBasic::Save(const char *file)
 			SaveStudioProgramProjectors();
 	obs_data_array_t *savedMultiviewProjectorList =
 			SaveMultiviewProjectors();
+	vector<OBSSource> audioSources;
 	obs_data_t *saveData = GenerateSaveData(sceneOrder, quickTrData,
 			ui->transitionDuration->value(), transitions,
 			scene, curProgramScene, savedProjectorList,
 			savedPreviewProjectorList,
 			savedStudioProgramProjectorList,
-			savedMultiviewProjectorList);
+			savedMultiviewProjectorList, audioSources);
 
 	obs_data_set_bool(saveData, "preview_locked", ui->preview->Locked());
 	obs_data_set_bool(saveData, "scaling_enabled",
@@ -527,8 +658,14 @@ void OBSBasic::Save(const char *file)
 		obs_data_release(moduleObj);
 	}
 
-	if (!obs_data_save_json_safe(saveData, file, "tmp", "bak"))
-		blog(LOG_ERROR, "Could not save scene data to %s", file);
+	obs_data_array_t *sourcesArray = SaveSources(audioSources);
+	obs_data_set_array(saveData, "sources", sourcesArray);
+	obs_data_array_release(sourcesArray);
+
+	/* write the file on the writer thread; the JSON text doesn't share
+	 * any data with the sources */
+	const char *saveJson = obs_data_get_json(saveData);
+	saveWriter.Write(file, saveJson ? saveJson : "{}");
 
 	obs_data_release(saveData);
 	obs_data_array_release(sceneOrder);
@@ -804,7 +941,11 @@ void OBSBasic::Load(const char *file)
 	LoadAudioDevice(AUX_AUDIO_2,     4, data);
 	LoadAudioDevice(AUX_AUDIO_3,     5, data);
 
-	obs_load_sources(sources, OBSBasic::SourceLoaded, this);
+	/* only create the inputs of the scenes that are shown on startup, the
+	 * rest are created when they are first used */
+	const char *startScenes[] = {sceneName, programSceneName};
+	obs_load_sources_deferred(sources, startScenes, 2,
+			OBSBasic::SourceLoaded, this);
 
 	if (transitions)
 		LoadTransitions(transitions);
@@ -1278,7 +1419,9 @@ void OBSBasic::InitOBSCallbacks()
 {
 	ProfileScope("OBSBasic::InitOBSCallbacks");
 
-	signalHandlers.reserve(signalHandlers.size() + 6);
+	signalHandlers.reserve(signalHandlers.size() + 7);
+	signalHandlers.emplace_back(obs_get_signal_handler(), "source_create",
+			OBSBasic::SourceCreated, this);
 	signalHandlers.emplace_back(obs_get_signal_handler(), "source_remove",
 			OBSBasic::SourceRemoved, this);
 	signalHandlers.emplace_back(obs_get_signal_handler(), "source_activate",
@@ -1950,8 +2093,10 @@ void OBSBasic::SaveProjectNow()
 	if (disableSaving)
 		return;
 
+	MarkSourceDirty(nullptr);
 	projectChanged = true;
 	SaveProjectDeferred();
+	saveWriter.Flush();
 }
 
 void OBSBasic::SaveProject()
@@ -1959,6 +2104,23 @@ void OBSBasic::SaveProject()
 	if (disableSaving)
 		return;
 
+	MarkSourceDirty(nullptr);
+	projectChanged = true;
+	QMetaObject::invokeMethod(this, "SaveProjectDeferred",
+			Qt::QueuedConnection);
+}
+
+/* Saves the project when only the given source has changed since the last
+ * save, or when no source has changed if the source is null.  Changes to
+ * scene items are tracked through scene signals, other changes to sources
+ * through source signals. */
+void OBSBasic::SaveProjectChanged(obs_source_t *source)
+{
+	if (disableSaving)
+		return;
+
+	if (source)
+		MarkSourceDirty(source);
 	projectChanged = true;
 	QMetaObject::invokeMethod(this, "SaveProjectDeferred",
 			Qt::QueuedConnection);
@@ -2133,6 +2295,10 @@ void OBSBasic::AddScene(OBSSource source)
 					OBSBasic::SceneItemDeselected, this),
 		std::make_shared<OBSSignal>(handler, "reorder",
 					OBSBasic::SceneReordered, this),
+		std::make_shared<OBSSignal>(handler, "item_visible",
+					OBSBasic::SceneItemChanged, this),
+		std::make_shared<OBSSignal>(handler, "item_transform",
+					OBSBasic::SceneItemChanged, this),
 	});
 
 	item->setData(static_cast<int>(QtDataRole::OBSSignals),
@@ -2155,7 +2321,7 @@ void OBSBasic::AddScene(OBSSource source)
 				return true;
 			}, &addSceneItem);
 
-	SaveProject();
+	SaveProjectChanged(obs_scene_get_source(scene));
 
 	if (!disableSaving) {
 		obs_source_t *source = obs_scene_get_source(scene);
@@ -2192,7 +2358,7 @@ void OBSBasic::RemoveScene(OBSSource source)
 		delete sel;
 	}
 
-	SaveProject();
+	SaveProjectChanged(source);
 
 	if (!disableSaving) {
 		blog(LOG_INFO, "User Removed scene '%s'",
@@ -2212,7 +2378,7 @@ void OBSBasic::AddSceneItem(OBSSceneItem item)
 	if (GetCurrentScene() == scene)
 		InsertSceneItem(item);
 
-	SaveProject();
+	SaveProjectChanged(obs_scene_get_source(scene));
 
 	if (!disableSaving) {
 		obs_source_t *sceneSource = obs_scene_get_source(scene);
@@ -2235,7 +2401,8 @@ void OBSBasic::RemoveSceneItem(OBSSceneItem item)
 		}
 	}
 
-	SaveProject();
+	SaveProjectChanged(obs_scene_get_source(
+				obs_sceneitem_get_scene(item)));
 
 	if (!disableSaving) {
 		obs_scene_t *scene = obs_sceneitem_get_scene(item);
@@ -2298,7 +2465,14 @@ void OBSBasic::RenameSources(OBSSource source, QString newName,
 			projectorArray.at(j) = newText;
 	}
 
-	SaveProject();
+	/* scenes save the names of their items' sources */
+	for (int i = 0; i < ui->scenes->count(); i++) {
+		OBSScene scene = GetOBSRef<OBSScene>(ui->scenes->item(i));
+		MarkSourceDirty(obs_scene_get_source(scene));
+	}
+
+	obs_source_t *parent = obs_filter_get_parent(source);
+	SaveProjectChanged(parent ? parent : source.Get());
 
 	obs_scene_t *scene = obs_scene_from_source(source);
 	if (scene)
@@ -2791,7 +2965,7 @@ void OBSBasic::ReorderSources(OBSScene scene)
 				return true;
 			}, &info);
 
-	SaveProject();
+	SaveProjectChanged(obs_scene_get_source(scene));
 }
 
 /* OBS Callbacks */
@@ -2802,6 +2976,8 @@ void OBSBasic::SceneReordered(void *data, calldata_t *params)
 
 	obs_scene_t *scene = (obs_scene_t*)calldata_ptr(params, "scene");
 
+	window->MarkSourceDirty(obs_scene_get_source(scene));
+
 	QMetaObject::invokeMethod(window, "ReorderSources",
 			Q_ARG(OBSScene, OBSScene(scene)));
 }
@@ -2810,8 +2986,11 @@ void OBSBasic::SceneItemAdded(void *data, calldata_t *params)
 {
 	OBSBasic *window = static_cast<OBSBasic*>(data);
 
+	obs_scene_t     *scene = (obs_scene_t*)calldata_ptr(params, "scene");
 	obs_sceneitem_t *item = (obs_sceneitem_t*)calldata_ptr(params, "item");
 
+	window->MarkSourceDirty(obs_scene_get_source(scene));
+
 	QMetaObject::invokeMethod(window, "AddSceneItem",
 			Q_ARG(OBSSceneItem, OBSSceneItem(item)));
 }
@@ -2820,12 +2999,26 @@ void OBSBasic::SceneItemRemoved(void *data, calldata_t *params)
 {
 	OBSBasic *window = static_cast<OBSBasic*>(data);
 
+	obs_scene_t     *scene = (obs_scene_t*)calldata_ptr(params, "scene");
 	obs_sceneitem_t *item = (obs_sceneitem_t*)calldata_ptr(params, "item");
 
+	window->MarkSourceDirty(obs_scene_get_source(scene));
+
 	QMetaObject::invokeMethod(window, "RemoveSceneItem",
 			Q_ARG(OBSSceneItem, OBSSceneItem(item)));
 }
 
+/* item changes that don't need the UI updated, but do need the scene to be
+ * saved again */
+void OBSBasic::SceneItemChanged(void *data, calldata_t *params)
+{
+	OBSBasic *window = static_cast<OBSBasic*>(data);
+
+	obs_scene_t *scene = (obs_scene_t*)calldata_ptr(params, "scene");
+
+	window->MarkSourceDirty(obs_scene_get_source(scene));
+}
+
 void OBSBasic::SceneItemSelected(void *data, calldata_t *params)
 {
 	OBSBasic *window = static_cast<OBSBasic*>(data);
@@ -2864,16 +3057,53 @@ void OBSBasic::SourceLoaded(void *data, obs_source_t *source)
 				Q_ARG(OBSSource, OBSSource(source)));
 }
 
+void OBSBasic::SourceCreated(void *data, calldata_t *params)
+{
+	obs_source_t *source = (obs_source_t*)calldata_ptr(params, "source");
+
+	static_cast<OBSBasic*>(data)->ConnectSourceSignals(source);
+}
+
 void OBSBasic::SourceRemoved(void *data, calldata_t *params)
 {
 	obs_source_t *source = (obs_source_t*)calldata_ptr(params, "source");
 
+	static_cast<OBSBasic*>(data)->DisconnectSourceSignals(source);
+
 	if (obs_scene_from_source(source) != NULL)
 		QMetaObject::invokeMethod(static_cast<OBSBasic*>(data),
 				"RemoveScene",
 				Q_ARG(OBSSource, OBSSource(source)));
 }
 
+void OBSBasic::SourceChanged(void *data, calldata_t *params)
+{
+	obs_source_t *source = (obs_source_t*)calldata_ptr(params, "source");
+	obs_source_t *parent = obs_filter_get_parent(source);
+
+	static_cast<OBSBasic*>(data)->MarkSourceDirty(parent ? parent : source);
+}
+
+void OBSBasic::SourceFilterAdded(void *data, calldata_t *params)
+{
+	OBSBasic *window = static_cast<OBSBasic*>(data);
+	obs_source_t *source = (obs_source_t*)calldata_ptr(params, "source");
+	obs_source_t *filter = (obs_source_t*)calldata_ptr(params, "filter");
+
+	window->ConnectSourceSignals(filter);
+	window->MarkSourceDirty(source);
+}
+
+void OBSBasic::SourceFilterRemoved(void *data, calldata_t *params)
+{
+	OBSBasic *window = static_cast<OBSBasic*>(data);
+	obs_source_t *source = (obs_source_t*)calldata_ptr(params, "source");
+	obs_source_t *filter = (obs_source_t*)calldata_ptr(params, "filter");
+
+	window->DisconnectSourceSignals(filter);
+	window->MarkSourceDirty(source);
+}
+
 void OBSBasic::SourceActivated(void *data, calldata_t *params)
 {
 	obs_source_t *source = (obs_source_t*)calldata_ptr(params, "source");
@@ -3329,14 +3559,14 @@ void OBSBasic::ClearSceneData()
 	swapScene = nullptr;
 	programScene = nullptr;
 
-	auto cb = [](void *unused, obs_source_t *source)
+	auto cb = [](void *data, obs_source_t *source)
 	{
+		static_cast<OBSBasic*>(data)->DisconnectSourceSignals(source);
 		obs_source_remove(source);
-		UNUSED_PARAMETER(unused);
 		return true;
 	};
 
-	obs_enum_sources(cb, nullptr);
+	obs_enum_sources(cb, this);
 
 	disableSaving--;
 
@@ -3739,6 +3969,7 @@ void OBSBasic::SetDeinterlacingMode()
 	obs_source_t *source = obs_sceneitem_get_source(sceneItem);
 
 	obs_source_set_deinterlace_mode(source, mode);
+	MarkSourceDirty(source);
 }
 
 void OBSBasic::SetDeinterlacingOrder()
@@ -3750,6 +3981,7 @@ void OBSBasic::SetDeinterlacingOrder()
 	obs_source_t *source = obs_sceneitem_get_source(sceneItem);
 
 	obs_source_set_deinterlace_field_order(source, order);
+	MarkSourceDirty(source);
 }
 
 QMenu *OBSBasic::AddDeinterlacingMenu(obs_source_t *source)
@@ -3802,6 +4034,8 @@ void OBSBasic::SetScaleFilter()
 	OBSSceneItem sceneItem = GetCurrentSceneItem();
 
 	obs_sceneitem_set_scale_filter(sceneItem, mode);
+	MarkSourceDirty(obs_scene_get_source(
+				obs_sceneitem_get_scene(sceneItem)));
 }
 
 QMenu *OBSBasic::AddScaleFilteringMenu(obs_sceneitem_t *item)
@@ -4431,7 +4665,7 @@ void OBSBasic::StartStreaming()
 	if (api)
 		api->on_event(OBS_FRONTEND_EVENT_STREAMING_STARTING);
 
-	SaveProject();
+	SaveProjectChanged(nullptr);
 
 	ui->streamButton->setEnabled(false);
 	ui->streamButton->setText(QTStr("Basic.Main.Connecting"));
@@ -4517,7 +4751,7 @@ inline void OBSBasic::OnDeactivate()
 
 void OBSBasic::StopStreaming()
 {
-	SaveProject();
+	SaveProjectChanged(nullptr);
 
 	if (outputHandler->StreamingActive())
 		outputHandler->StopStreaming(streamingStopping);
@@ -4541,7 +4775,7 @@ void OBSBasic::StopStreaming()
 
 void OBSBasic::ForceStopStreaming()
 {
-	SaveProject();
+	SaveProjectChanged(nullptr);
 
 	if (outputHandler->StreamingActive())
 		outputHandler->StopStreaming(true);
@@ -4728,7 +4962,7 @@ void OBSBasic::StartRecording()
 	if (api)
 		api->on_event(OBS_FRONTEND_EVENT_RECORDING_STARTING);
 
-	SaveProject();
+	SaveProjectChanged(nullptr);
 	outputHandler->StartRecording();
 }
 
@@ -4746,7 +4980,7 @@ void OBSBasic::RecordStopping()
 
 void OBSBasic::StopRecording()
 {
-	SaveProject();
+	SaveProjectChanged(nullptr);
 
 	if (outputHandler->RecordingActive())
 		outputHandler->StopRecording(recordingStopping);
@@ -4847,7 +5081,7 @@ void OBSBasic::StartReplayBuffer()
 	if (api)
 		api->on_event(OBS_FRONTEND_EVENT_REPLAY_BUFFER_STARTING);
 
-	SaveProject();
+	SaveProjectChanged(nullptr);
 	outputHandler->StartReplayBuffer();
 }
 
@@ -4871,7 +5105,7 @@ void OBSBasic::StopReplayBuffer()
 	if (!outputHandler || !outputHandler->replayBuffer)
 		return;
 
-	SaveProject();
+	SaveProjectChanged(nullptr);
 
 	if (outputHandler->ReplayBufferActive())
 		outputHandler->StopReplayBuffer(replayBufferStopping);
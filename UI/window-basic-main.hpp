@@ -23,12 +23,16 @@
 #include <obs.hpp>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 #include "window-main.hpp"
 #include "window-basic-interaction.hpp"
 #include "window-basic-properties.hpp"
 #include "window-basic-transform.hpp"
 #include "window-basic-adv-audio.hpp"
 #include "window-basic-filters.hpp"
+#include "scene-collection-writer.hpp"
 
 #include <obs-frontend-internal.hpp>
 
@@ -128,6 +132,20 @@ private:
 	bool loaded = false;
 	long disableSaving = 1;
 	bool projectChanged = false;
+
+	/* saved data of each source as of the last save, reused for sources
+	 * that haven't been marked dirty since (only used by the UI thread) */
+	struct SavedSource {
+		OBSWeakSource weak;
+		OBSData data;
+	};
+	std::unordered_map<obs_source_t*, SavedSource> savedSources;
+
+	std::mutex dirtySourcesMutex;
+	std::unordered_set<obs_source_t*> dirtySources;
+	bool allSourcesDirty = true;
+
+	SceneCollectionWriter saveWriter;
 	bool previewEnabled = true;
 	bool fullscreenInterface = false;
 
@@ -200,6 +218,11 @@ private:
 	void          Save(const char *file);
 	void          Load(const char *file);
 
+	void          MarkSourceDirty(obs_source_t *source);
+	void          ConnectSourceSignals(obs_source_t *source);
+	void          DisconnectSourceSignals(obs_source_t *source);
+	obs_data_array_t *SaveSources(const std::vector<OBSSource> &skip);
+
 	void          InitHotkeys();
 	void          CreateHotkeys();
 	void          ClearHotkeys();
@@ -403,6 +426,7 @@ public slots:
 
 	void SaveProjectDeferred();
 	void SaveProject();
+	void SaveProjectChanged(obs_source_t *source);
 
 	void SetTransition(OBSSource transition);
 	void TransitionToScene(OBSScene scene, bool force = false,
@@ -471,10 +495,15 @@ private:
 	static void SceneReordered(void *data, calldata_t *params);
 	static void SceneItemAdded(void *data, calldata_t *params);
 	static void SceneItemRemoved(void *data, calldata_t *params);
+	static void SceneItemChanged(void *data, calldata_t *params);
 	static void SceneItemSelected(void *data, calldata_t *params);
 	static void SceneItemDeselected(void *data, calldata_t *params);
 	static void SourceLoaded(void *data, obs_source_t *source);
+	static void SourceCreated(void *data, calldata_t *params);
 	static void SourceRemoved(void *data, calldata_t *params);
+	static void SourceChanged(void *data, calldata_t *params);
+	static void SourceFilterAdded(void *data, calldata_t *params);
+	static void SourceFilterRemoved(void *data, calldata_t *params);
 	static void SourceActivated(void *data, calldata_t *params);
 	static void SourceDeactivated(void *data, calldata_t *params);
 	static void SourceRenamed(void *data, calldata_t *params);
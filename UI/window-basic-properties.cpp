@@ -128,7 +128,7 @@ OBSBasicProperties::OBSBasicProperties(QWidget *parent, OBSSource source_)
 OBSBasicProperties::~OBSBasicProperties()
 {
 	obs_source_dec_showing(source);
-	main->SaveProject();
+	main->SaveProjectChanged(source);
 }
 
 void OBSBasicProperties::SourceRemoved(void *data, calldata_t *params)
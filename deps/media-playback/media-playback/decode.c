@@ -16,6 +16,7 @@
 
 #include "decode.h"
 #include "media.h"
+#include "shared.h"
 
 static AVCodec *find_hardware_decoder(enum AVCodecID id)
 {
@@ -144,27 +145,71 @@ bool mp_decode_init(mp_media_t *m, enum AVMediaType type, bool hw)
 
 	if (d->codec->capabilities & CODEC_CAP_TRUNC)
 		d->decoder->flags |= CODEC_FLAG_TRUNC;
+
+	size_t depth = (size_t)m->decode_ahead;
+	if (d->audio && depth < MP_MIN_AUDIO_FRAMES)
+		depth = MP_MIN_AUDIO_FRAMES;
+
+	/* audio frames are not converted, so they go straight to the frames
+	 * queue */
+	if (!mp_queue_init(&d->packets, sizeof(AVPacket), 0) ||
+	    (!d->audio && !mp_queue_init(&d->decoded,
+			    sizeof(struct mp_frame), depth)) ||
+	    !mp_queue_init(&d->frames, sizeof(struct mp_frame), depth)) {
+		blog(LOG_WARNING, "MP: Failed to create %s queues",
+				av_get_media_type_string(type));
+		return false;
+	}
+
 	return true;
 }
 
-void mp_decode_clear_packets(struct mp_decode *d)
+void mp_decode_release_frame(struct mp_decode *d, struct mp_frame *frame)
 {
+	if (frame->shared) {
+		mp_shared_frame_release(frame->shared);
+	} else {
+		if (frame->frame)
+			av_frame_free(&frame->frame);
+		if (frame->pic.data[0])
+			mp_queue_push(&d->m->pics, &frame->pic);
+	}
+
+	memset(frame, 0, sizeof(*frame));
+}
+
+static void mp_decode_clear(struct mp_decode *d)
+{
+	struct mp_frame frame;
+	AVPacket pkt;
+
 	if (d->packet_pending) {
 		av_packet_unref(&d->orig_pkt);
 		d->packet_pending = false;
 	}
 
-	while (d->packets.size) {
-		AVPacket pkt;
-		circlebuf_pop_front(&d->packets, &pkt, sizeof(pkt));
+	while (mp_queue_try_pop(&d->packets, &pkt))
 		av_packet_unref(&pkt);
-	}
+	os_atomic_set_long(&d->packet_bytes, 0);
+	while (!d->audio && mp_queue_try_pop(&d->decoded, &frame))
+		mp_decode_release_frame(d, &frame);
+	while (mp_queue_try_pop(&d->frames, &frame))
+		mp_decode_release_frame(d, &frame);
+
+	mp_decode_release_frame(d, &d->cur);
+	d->frame_ready = false;
 }
 
 void mp_decode_free(struct mp_decode *d)
 {
-	mp_decode_clear_packets(d);
-	circlebuf_free(&d->packets);
+	if (d->packets.item_size)
+		mp_decode_clear(d);
+	else
+		mp_decode_release_frame(d, &d->cur);
+
+	mp_queue_free(&d->packets);
+	mp_queue_free(&d->decoded);
+	mp_queue_free(&d->frames);
 
 	if (d->decoder) {
 		avcodec_close(d->decoder);
@@ -179,16 +224,11 @@ void mp_decode_free(struct mp_decode *d)
 	memset(d, 0, sizeof(*d));
 }
 
-void mp_decode_push_packet(struct mp_decode *decode, AVPacket *packet)
-{
-	circlebuf_push_back(&decode->packets, packet, sizeof(*packet));
-}
-
 static inline int64_t get_estimated_duration(struct mp_decode *d,
 		int64_t last_pts)
 {
 	if (last_pts)
-		return d->frame_pts - last_pts;
+		return d->decode_pts - last_pts;
 
 	if (d->audio) {
 		return av_rescale_q(d->frame->nb_samples,
@@ -251,38 +291,38 @@ static int decode_packet(struct mp_decode *d, int *got_frame)
 	return ret;
 }
 
-bool mp_decode_next(struct mp_decode *d)
+static bool mp_decode_next(struct mp_decode *d, bool *frame_ready)
 {
-	bool eof = d->m->eof;
 	int got_frame;
 	int ret;
 
-	d->frame_ready = false;
-
-	if (!eof && !d->packets.size)
-		return true;
+	*frame_ready = false;
 
-	while (!d->frame_ready) {
-		if (!d->packet_pending) {
-			if (!d->packets.size) {
-				if (eof) {
-					d->pkt.data = NULL;
-					d->pkt.size = 0;
-				} else {
-					return true;
-				}
-			} else {
-				circlebuf_pop_front(&d->packets, &d->orig_pkt,
-						sizeof(d->orig_pkt));
+	while (!*frame_ready) {
+		if (!d->packet_pending && !d->packets_eof) {
+			if (mp_queue_pop(&d->packets, &d->orig_pkt)) {
+				mp_decode_add_packet_bytes(d,
+						-(long)d->orig_pkt.size);
+				os_event_signal(d->m->demux_event);
 				d->pkt = d->orig_pkt;
 				d->packet_pending = true;
+
+			} else if (mp_queue_aborted(&d->packets)) {
+				return false;
+			} else {
+				d->packets_eof = true;
 			}
 		}
 
+		if (!d->packet_pending) {
+			d->pkt.data = NULL;
+			d->pkt.size = 0;
+		}
+
 		ret = decode_packet(d, &got_frame);
 
 		if (!got_frame && ret == 0) {
-			d->eof = true;
+			d->decoder_eof = true;
 			return true;
 		}
 		if (ret < 0) {
@@ -300,7 +340,7 @@ bool mp_decode_next(struct mp_decode *d)
 			return true;
 		}
 
-		d->frame_ready = !!got_frame;
+		*frame_ready = !!got_frame;
 
 		if (d->packet_pending) {
 			if (d->pkt.size) {
@@ -317,37 +357,142 @@ bool mp_decode_next(struct mp_decode *d)
 		}
 	}
 
-	if (d->frame_ready) {
-		int64_t last_pts = d->frame_pts;
-
-		if (d->frame->best_effort_timestamp == AV_NOPTS_VALUE)
-			d->frame_pts = d->next_pts;
-		else
-			d->frame_pts = av_rescale_q(
-					d->frame->best_effort_timestamp,
-					d->stream->time_base,
-					(AVRational){1, 1000000000});
-
-		int64_t duration = d->frame->pkt_duration;
-		if (!duration)
-			duration = get_estimated_duration(d, last_pts);
-		else
-			duration = av_rescale_q(duration,
-					d->stream->time_base,
-					(AVRational){1, 1000000000});
-
-		d->last_duration = duration;
-		d->next_pts = d->frame_pts + duration;
+	int64_t last_pts = d->decode_pts;
+
+	if (d->frame->best_effort_timestamp == AV_NOPTS_VALUE)
+		d->decode_pts = d->decode_next_pts;
+	else
+		d->decode_pts = av_rescale_q(
+				d->frame->best_effort_timestamp,
+				d->stream->time_base,
+				(AVRational){1, 1000000000});
+
+	int64_t duration = d->frame->pkt_duration;
+	if (!duration)
+		duration = get_estimated_duration(d, last_pts);
+	else
+		duration = av_rescale_q(duration,
+				d->stream->time_base,
+				(AVRational){1, 1000000000});
+
+	d->last_duration = duration;
+	d->decode_next_pts = d->decode_pts + duration;
+	return true;
+}
+
+static void *mp_decode_thread(void *opaque)
+{
+	struct mp_decode *d = opaque;
+	struct mp_queue *out = d->audio ? &d->frames : &d->decoded;
+	bool frame_ready;
+
+	os_set_thread_name(d->audio ?
+			"mp_decode_thread: audio" :
+			"mp_decode_thread: video");
+
+	while (!d->decoder_eof) {
+		struct mp_frame frame = {0};
+
+		if (!mp_decode_next(d, &frame_ready))
+			return NULL;
+		if (!frame_ready)
+			continue;
+
+		frame.frame = av_frame_alloc();
+		if (!frame.frame) {
+			blog(LOG_WARNING, "MP: Failed to allocate %s frame",
+					d->audio ? "audio" : "video");
+			av_frame_unref(d->frame);
+			continue;
+		}
+
+		av_frame_move_ref(frame.frame, d->frame);
+		frame.pts = d->decode_pts;
+		frame.next_pts = d->decode_next_pts;
+
+		if (!mp_queue_push(out, &frame)) {
+			mp_decode_release_frame(d, &frame);
+			return NULL;
+		}
+	}
+
+	mp_queue_finish(out);
+	return NULL;
+}
+
+bool mp_decode_start(struct mp_decode *d)
+{
+	if (d->decoder_eof) {
+		avcodec_flush_buffers(d->decoder);
+		d->decoder_eof = false;
 	}
 
+	d->packets_eof = false;
+	d->eof = false;
+
+	if (pthread_create(&d->thread, NULL, mp_decode_thread, d) != 0) {
+		blog(LOG_WARNING, "MP: Could not create %s decode thread",
+				d->audio ? "audio" : "video");
+		return false;
+	}
+
+	d->thread_valid = true;
+	return true;
+}
+
+void mp_decode_abort(struct mp_decode *d)
+{
+	mp_queue_abort(&d->packets);
+	if (!d->audio)
+		mp_queue_abort(&d->decoded);
+	mp_queue_abort(&d->frames);
+}
+
+void mp_decode_join(struct mp_decode *d)
+{
+	if (d->thread_valid) {
+		pthread_join(d->thread, NULL);
+		d->thread_valid = false;
+	}
+}
+
+bool mp_decode_frame(struct mp_decode *d)
+{
+	struct mp_frame frame;
+
+	if (d->frame_ready || d->eof)
+		return true;
+
+	mp_decode_release_frame(d, &d->cur);
+
+	if (!mp_queue_pop(&d->frames, &frame)) {
+		if (mp_queue_aborted(&d->frames))
+			return false;
+
+		/* the stream gets no packets for now, the other streams
+		 * don't wait for it */
+		if (mp_queue_idle(&d->frames) &&
+		    !mp_queue_finished(&d->frames))
+			return true;
+
+		d->eof = true;
+		return true;
+	}
+
+	d->cur = frame;
+	d->frame_pts = frame.pts;
+	d->next_pts = frame.next_pts;
+	d->frame_ready = true;
 	return true;
 }
 
 void mp_decode_flush(struct mp_decode *d)
 {
 	avcodec_flush_buffers(d->decoder);
-	mp_decode_clear_packets(d);
+	mp_decode_clear(d);
+	d->decoder_eof = false;
+	d->packets_eof = false;
 	d->eof = false;
+	d->decode_pts = 0;
 	d->frame_pts = 0;
-	d->frame_ready = false;
 }
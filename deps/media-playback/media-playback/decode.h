@@ -21,6 +21,7 @@ extern "C" {
 #endif
 
 #include <util/circlebuf.h>
+#include "queue.h"
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -51,6 +52,25 @@ extern "C" {
 #endif
 
 struct mp_media;
+struct mp_shared_frame;
+
+/* picture that a frame was converted to with swscale */
+struct mp_picture {
+	uint8_t               *data[4];
+	int                   linesize[4];
+	enum AVPixelFormat    format;
+};
+
+/* frame passed between the stages of the pipeline */
+struct mp_frame {
+	AVFrame               *frame;
+	struct mp_picture     pic;
+	int64_t               pts;
+	int64_t               next_pts;
+
+	/* set when the frame belongs to a shared decoder */
+	struct mp_shared_frame *shared;
+};
 
 struct mp_decode {
 	struct mp_media       *m;
@@ -60,28 +80,65 @@ struct mp_decode {
 	AVCodecContext        *decoder;
 	AVCodec               *codec;
 
+	/* decode thread */
 	int64_t               last_duration;
+	int64_t               decode_pts;
+	int64_t               decode_next_pts;
+	AVFrame               *frame;
+	bool                  packets_eof;
+	bool                  decoder_eof;
+
+	AVPacket              orig_pkt;
+	AVPacket              pkt;
+	bool                  packet_pending;
+
+	/* AVPacket, filled by the demux thread */
+	struct mp_queue       packets;
+	volatile long         packet_bytes;
+	int64_t               demux_ts;
+	bool                  demux_idle;
+	/* struct mp_frame, decoded video frames waiting to be converted */
+	struct mp_queue       decoded;
+	/* struct mp_frame, frames ready to be presented */
+	struct mp_queue       frames;
+
+	pthread_t             thread;
+	bool                  thread_valid;
+
+	/* media thread */
+	struct mp_frame       cur;
 	int64_t               frame_pts;
 	int64_t               next_pts;
-	AVFrame               *frame;
 	bool                  got_first_keyframe;
 	bool                  frame_ready;
 	bool                  eof;
 
-	AVPacket              orig_pkt;
-	AVPacket              pkt;
-	bool                  packet_pending;
-	struct circlebuf      packets;
+	/* next frame to read from a shared decoder */
+	uint64_t              shared_pos;
 };
 
+static inline void mp_decode_add_packet_bytes(struct mp_decode *d,
+		long bytes)
+{
+	long cur;
+
+	do {
+		cur = os_atomic_load_long(&d->packet_bytes);
+	} while (!os_atomic_compare_swap_long(&d->packet_bytes, cur,
+				cur + bytes));
+}
+
 extern bool mp_decode_init(struct mp_media *media, enum AVMediaType type,
 		bool hw);
 extern void mp_decode_free(struct mp_decode *decode);
 
-extern void mp_decode_clear_packets(struct mp_decode *decode);
+extern bool mp_decode_start(struct mp_decode *decode);
+extern void mp_decode_abort(struct mp_decode *decode);
+extern void mp_decode_join(struct mp_decode *decode);
 
-extern void mp_decode_push_packet(struct mp_decode *decode, AVPacket *pkt);
-extern bool mp_decode_next(struct mp_decode *decode);
+extern bool mp_decode_frame(struct mp_decode *decode);
+extern void mp_decode_release_frame(struct mp_decode *decode,
+		struct mp_frame *frame);
 extern void mp_decode_flush(struct mp_decode *decode);
 
 #ifdef __cplusplus
@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2017 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <obs.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/file-serializer.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <graphics/hash.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "index.h"
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#pragma warning(disable : 4204)
+#endif
+
+#include <libavformat/avformat.h>
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+/* bump whenever the entry layout changes */
+#define MP_INDEX_MAGIC   0x494B504DU /* "MPKI" */
+#define MP_INDEX_VERSION 1
+
+#define MP_INDEX_MAX_KEYFRAMES (16 * 1024 * 1024)
+
+struct mp_index {
+	char                  *path;
+
+	pthread_mutex_t       mutex;
+	DARRAY(struct mp_keyframe) keyframes;
+	bool                  ready;
+
+	volatile bool         abort;
+	pthread_t             thread;
+	bool                  thread_valid;
+};
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char *cache_path = NULL;
+
+void mp_index_set_cache_path(const char *path)
+{
+	if (path && os_mkdirs(path) == MKDIR_ERROR) {
+		blog(LOG_WARNING, "MP: Could not create '%s', keyframe "
+		                  "indexes will not be cached", path);
+		path = NULL;
+	}
+
+	pthread_mutex_lock(&cache_mutex);
+	bfree(cache_path);
+	cache_path = bstrdup(path);
+	pthread_mutex_unlock(&cache_mutex);
+}
+
+static bool get_entry_path(struct dstr *entry, const char *path)
+{
+	uint64_t hash = gs_hash_data(GS_HASH_INIT, path, strlen(path));
+	bool success = false;
+
+	pthread_mutex_lock(&cache_mutex);
+	if (cache_path) {
+		dstr_copy(entry, cache_path);
+		if (!dstr_is_empty(entry) && dstr_end(entry) != '/')
+			dstr_cat_ch(entry, '/');
+		dstr_catf(entry, "%016llx.keyframe-index",
+				(unsigned long long)hash);
+		success = true;
+	}
+	pthread_mutex_unlock(&cache_mutex);
+
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline bool read_u32(struct serializer *s, uint32_t *val)
+{
+	uint8_t data[4];
+
+	if (s_read(s, data, sizeof(data)) != sizeof(data))
+		return false;
+
+	*val = (uint32_t)data[0]         | ((uint32_t)data[1] << 8) |
+	       ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+	return true;
+}
+
+static inline bool read_u64(struct serializer *s, uint64_t *val)
+{
+	uint32_t low, high;
+
+	if (!read_u32(s, &low) || !read_u32(s, &high))
+		return false;
+
+	*val = (uint64_t)low | ((uint64_t)high << 32);
+	return true;
+}
+
+/* entries are only used for the same file with the same size and
+ * modification time, as hashes of different paths can collide */
+static bool read_header(struct serializer *s, const char *path,
+		uint64_t size, uint64_t mtime)
+{
+	uint32_t magic, version, len;
+	uint64_t entry_size, entry_mtime;
+	struct dstr entry_path = {0};
+	bool success;
+
+	if (!read_u32(s, &magic) || magic != MP_INDEX_MAGIC)
+		return false;
+	if (!read_u32(s, &version) || version != MP_INDEX_VERSION)
+		return false;
+	if (!read_u32(s, &len) || len != strlen(path))
+		return false;
+
+	dstr_resize(&entry_path, len);
+	success = s_read(s, entry_path.array, len) == len &&
+		strcmp(entry_path.array, path) == 0;
+	dstr_free(&entry_path);
+
+	return success &&
+		read_u64(s, &entry_size) && entry_size == size &&
+		read_u64(s, &entry_mtime) && entry_mtime == mtime;
+}
+
+static bool load_keyframes(const char *entry, const char *path,
+		uint64_t size, uint64_t mtime, struct darray *keyframes)
+{
+	struct serializer s;
+	uint32_t count;
+	bool success;
+
+	if (!file_input_serializer_init(&s, entry))
+		return false;
+
+	success = read_header(&s, path, size, mtime) &&
+		read_u32(&s, &count) && count <= MP_INDEX_MAX_KEYFRAMES;
+
+	if (success) {
+		darray_resize(sizeof(struct mp_keyframe), keyframes, count);
+
+		for (uint32_t i = 0; success && i < count; i++) {
+			struct mp_keyframe *kf = darray_item(
+					sizeof(struct mp_keyframe),
+					keyframes, i);
+			uint64_t pts, pos;
+
+			success = read_u64(&s, &pts) && read_u64(&s, &pos);
+			kf->pts = (int64_t)pts;
+			kf->pos = (int64_t)pos;
+		}
+	}
+
+	file_input_serializer_free(&s);
+	return success;
+}
+
+static void save_keyframes(const char *entry, const char *path,
+		uint64_t size, uint64_t mtime, const struct darray *keyframes)
+{
+	const struct mp_keyframe *kf = keyframes->array;
+	struct serializer s;
+	size_t len = strlen(path);
+
+	if (!file_output_serializer_init_safe(&s, entry, "tmp")) {
+		blog(LOG_DEBUG, "MP: Could not write '%s'", entry);
+		return;
+	}
+
+	s_wl32(&s, MP_INDEX_MAGIC);
+	s_wl32(&s, MP_INDEX_VERSION);
+	s_wl32(&s, (uint32_t)len);
+	s_write(&s, path, len);
+	s_wl64(&s, size);
+	s_wl64(&s, mtime);
+
+	s_wl32(&s, (uint32_t)keyframes->num);
+	for (size_t i = 0; i < keyframes->num; i++) {
+		s_wl64(&s, (uint64_t)kf[i].pts);
+		s_wl64(&s, (uint64_t)kf[i].pos);
+	}
+
+	file_output_serializer_free(&s);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int interrupt_callback(void *data)
+{
+	struct mp_index *index = data;
+	return os_atomic_load_bool(&index->abort);
+}
+
+static int cmp_keyframes(const void *a, const void *b)
+{
+	const struct mp_keyframe *kf_a = a;
+	const struct mp_keyframe *kf_b = b;
+
+	return kf_a->pts < kf_b->pts ? -1 : (kf_a->pts > kf_b->pts ? 1 : 0);
+}
+
+static bool scan_keyframes(struct mp_index *index, struct darray *keyframes)
+{
+	AVFormatContext *fmt = avformat_alloc_context();
+	AVStream *stream;
+	AVPacket pkt;
+	int ret;
+
+	fmt->interrupt_callback.callback = interrupt_callback;
+	fmt->interrupt_callback.opaque = index;
+
+	/* fmt is freed on failure */
+	if (avformat_open_input(&fmt, index->path, NULL, NULL) < 0)
+		return false;
+
+	if (avformat_find_stream_info(fmt, NULL) < 0) {
+		avformat_close_input(&fmt);
+		return false;
+	}
+
+	ret = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+	if (ret < 0) {
+		avformat_close_input(&fmt);
+		return false;
+	}
+
+	stream = fmt->streams[ret];
+	for (unsigned i = 0; i < fmt->nb_streams; i++) {
+		if (fmt->streams[i] != stream)
+			fmt->streams[i]->discard = AVDISCARD_ALL;
+	}
+
+	av_init_packet(&pkt);
+
+	while ((ret = av_read_frame(fmt, &pkt)) >= 0) {
+		int64_t ts = pkt.pts != AV_NOPTS_VALUE ? pkt.pts : pkt.dts;
+
+		if (pkt.stream_index == stream->index &&
+		    (pkt.flags & AV_PKT_FLAG_KEY) != 0 &&
+		    ts != AV_NOPTS_VALUE) {
+			struct mp_keyframe kf;
+
+			kf.pts = av_rescale_q(ts, stream->time_base,
+					(AVRational){1, 1000000000});
+			kf.pos = pkt.pos;
+			darray_push_back(sizeof(kf), keyframes, &kf);
+		}
+
+		av_packet_unref(&pkt);
+	}
+
+	avformat_close_input(&fmt);
+
+	if (ret != AVERROR_EOF)
+		return false;
+
+	/* keyframes are stored in decoding order, which may not be the
+	 * order they are presented in */
+	qsort(keyframes->array, keyframes->num, sizeof(struct mp_keyframe),
+			cmp_keyframes);
+	return true;
+}
+
+static void *mp_index_thread(void *opaque)
+{
+	struct mp_index *index = opaque;
+	struct darray keyframes = {0};
+	struct dstr entry = {0};
+	struct stat st;
+	uint64_t start = os_gettime_ns();
+	bool cached;
+
+	os_set_thread_name("mp_index_thread");
+
+	if (os_stat(index->path, &st) != 0)
+		return NULL;
+
+	cached = get_entry_path(&entry, index->path);
+
+	if (cached && load_keyframes(entry.array, index->path,
+				(uint64_t)st.st_size, (uint64_t)st.st_mtime,
+				&keyframes)) {
+		blog(LOG_DEBUG, "MP: Loaded keyframe index of '%s'",
+				index->path);
+		goto publish;
+	}
+
+	darray_free(&keyframes);
+
+	if (!scan_keyframes(index, &keyframes)) {
+		if (!os_atomic_load_bool(&index->abort))
+			blog(LOG_INFO, "MP: Could not index keyframes of '%s'",
+					index->path);
+		darray_free(&keyframes);
+		dstr_free(&entry);
+		return NULL;
+	}
+
+	blog(LOG_INFO, "MP: Indexed %d keyframes of '%s' in %d ms",
+			(int)keyframes.num, index->path,
+			(int)((os_gettime_ns() - start) / 1000000));
+
+	if (cached)
+		save_keyframes(entry.array, index->path,
+				(uint64_t)st.st_size, (uint64_t)st.st_mtime,
+				&keyframes);
+
+publish:
+	pthread_mutex_lock(&index->mutex);
+	darray_move(&index->keyframes.da, &keyframes);
+	index->ready = true;
+	pthread_mutex_unlock(&index->mutex);
+
+	dstr_free(&entry);
+	return NULL;
+}
+
+struct mp_index *mp_index_create(const char *path)
+{
+	struct mp_index *index = bzalloc(sizeof(*index));
+
+	index->path = bstrdup(path);
+
+	if (pthread_mutex_init(&index->mutex, NULL) != 0) {
+		blog(LOG_WARNING, "MP: Failed to init index mutex");
+		bfree(index->path);
+		bfree(index);
+		return NULL;
+	}
+
+	if (pthread_create(&index->thread, NULL, mp_index_thread,
+				index) != 0) {
+		blog(LOG_WARNING, "MP: Could not create index thread");
+		mp_index_destroy(index);
+		return NULL;
+	}
+
+	index->thread_valid = true;
+	return index;
+}
+
+void mp_index_destroy(struct mp_index *index)
+{
+	if (!index)
+		return;
+
+	os_atomic_set_bool(&index->abort, true);
+	if (index->thread_valid)
+		pthread_join(index->thread, NULL);
+
+	da_free(index->keyframes);
+	pthread_mutex_destroy(&index->mutex);
+	bfree(index->path);
+	bfree(index);
+}
+
+bool mp_index_find(struct mp_index *index, int64_t pts,
+		struct mp_keyframe *keyframe)
+{
+	bool found = false;
+
+	if (!index)
+		return false;
+
+	pthread_mutex_lock(&index->mutex);
+
+	if (index->ready && index->keyframes.num &&
+	    index->keyframes.array[0].pts <= pts) {
+		size_t low = 0;
+		size_t high = index->keyframes.num;
+
+		/* last keyframe with a pts that is not after pts */
+		while (high - low > 1) {
+			size_t mid = low + (high - low) / 2;
+
+			if (index->keyframes.array[mid].pts <= pts)
+				low = mid;
+			else
+				high = mid;
+		}
+
+		*keyframe = index->keyframes.array[low];
+		found = true;
+	}
+
+	pthread_mutex_unlock(&index->mutex);
+	return found;
+}
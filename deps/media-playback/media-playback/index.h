@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2017 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Index of the video keyframes of a local file, used to seek to the
+ * keyframe right before a position instead of relying on the demuxer to find
+ * one.  The index is built by a thread of its own that reads the whole file
+ * once, and is kept in the cache directory (if one is set) so that the file
+ * only has to be read again when its size or modification time changes.
+ */
+
+struct mp_keyframe {
+	/* in nanoseconds, in the time of the video stream */
+	int64_t               pts;
+	/* byte position of the packet in the file, or -1 if unknown */
+	int64_t               pos;
+};
+
+struct mp_index;
+
+extern void mp_index_set_cache_path(const char *path);
+
+extern struct mp_index *mp_index_create(const char *path);
+extern void mp_index_destroy(struct mp_index *index);
+
+/* finds the last keyframe at or before pts, fails until the index is built */
+extern bool mp_index_find(struct mp_index *index, int64_t pts,
+		struct mp_keyframe *keyframe);
+
+#ifdef __cplusplus
+}
+#endif
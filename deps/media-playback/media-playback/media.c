@@ -114,26 +114,154 @@ static int mp_media_next_packet(mp_media_t *media)
 
 	struct mp_decode *d = get_packet_decoder(media, &pkt);
 	if (d && pkt.size) {
+		int64_t ts = pkt.dts != AV_NOPTS_VALUE ? pkt.dts : pkt.pts;
+
+		if (ts != AV_NOPTS_VALUE) {
+			ts = av_rescale_q(ts, d->stream->time_base,
+					(AVRational){1, 1000000000});
+			d->demux_ts = ts;
+			if (media->demux_start_ts == AV_NOPTS_VALUE)
+				media->demux_start_ts = ts;
+			if (media->demux_ts == AV_NOPTS_VALUE ||
+			    ts > media->demux_ts)
+				media->demux_ts = ts;
+		}
+
 		av_packet_ref(&new_pkt, &pkt);
-		mp_decode_push_packet(d, &new_pkt);
+		mp_decode_add_packet_bytes(d, (long)new_pkt.size);
+		if (!mp_queue_push(&d->packets, &new_pkt)) {
+			mp_decode_add_packet_bytes(d, -(long)new_pkt.size);
+			av_packet_unref(&new_pkt);
+		}
 	}
 
 	av_packet_unref(&pkt);
 	return ret;
 }
 
-static inline bool mp_media_ready_to_start(mp_media_t *m)
+/* the demux thread reads ahead until every decoder has at least this many
+ * packets waiting, so that a decoder never starves while the others have
+ * enough to work with */
+#define MP_DEMUX_MIN_PACKETS 16
+
+/* but never past these limits, whatever the other decoders have */
+#define MP_DEMUX_MAX_PACKETS 1024
+#define MP_DEMUX_MAX_BYTES   (32 * 1024 * 1024)
+
+/* a stream that got no packet while this much of the other streams was
+ * read has ended early or has a gap, it doesn't count as starved and the
+ * media thread doesn't wait for its frames */
+#define MP_DEMUX_MAX_IDLE_NS 1000000000LL
+
+static inline bool mp_decode_demux_full(struct mp_decode *d)
+{
+	return mp_queue_size(&d->packets) >= MP_DEMUX_MAX_PACKETS ||
+		os_atomic_load_long(&d->packet_bytes) >= MP_DEMUX_MAX_BYTES;
+}
+
+static inline bool mp_decode_demux_idle(mp_media_t *m, struct mp_decode *d)
 {
-	if (m->has_audio && !m->a.eof && !m->a.frame_ready)
-		return false;
-	if (m->has_video && !m->v.eof && !m->v.frame_ready)
+	if (m->demux_ts == AV_NOPTS_VALUE)
 		return false;
-	return true;
+
+	int64_t ts = d->demux_ts != AV_NOPTS_VALUE ?
+		d->demux_ts : m->demux_start_ts;
+	return m->demux_ts - ts >= MP_DEMUX_MAX_IDLE_NS;
+}
+
+/* returns whether the decoder needs more packets */
+static bool mp_decode_demux_starved(mp_media_t *m, struct mp_decode *d,
+		bool full)
+{
+	size_t packets = mp_queue_size(&d->packets);
+	bool idle = mp_decode_demux_idle(m, d);
+
+	/* when reading stops at a limit, streams that have no packets left
+	 * can't get any frames until it continues */
+	if (full && !packets)
+		idle = true;
+
+	if (idle != d->demux_idle) {
+		mp_queue_set_idle(&d->frames, idle);
+		d->demux_idle = idle;
+	}
+
+	return !idle && packets < MP_DEMUX_MIN_PACKETS;
 }
 
-static inline bool mp_decode_frame(struct mp_decode *d)
+static inline bool mp_media_demux_should_wait(mp_media_t *m)
 {
-	return d->frame_ready || mp_decode_next(d);
+	bool starved = false;
+	bool full = false;
+	long bytes = 0;
+
+	if (m->has_video) {
+		full = full || mp_decode_demux_full(&m->v);
+		bytes += os_atomic_load_long(&m->v.packet_bytes);
+	}
+	if (m->has_audio) {
+		full = full || mp_decode_demux_full(&m->a);
+		bytes += os_atomic_load_long(&m->a.packet_bytes);
+	}
+	if (bytes >= MP_DEMUX_MAX_BYTES)
+		full = true;
+
+	if (m->has_video && mp_decode_demux_starved(m, &m->v, full))
+		starved = true;
+	if (m->has_audio && mp_decode_demux_starved(m, &m->a, full))
+		starved = true;
+
+	return full || !starved;
+}
+
+static inline bool mp_media_stopping(mp_media_t *m)
+{
+	bool stopping;
+
+	pthread_mutex_lock(&m->mutex);
+	stopping = m->kill || m->stopping;
+	pthread_mutex_unlock(&m->mutex);
+
+	return stopping;
+}
+
+static void *mp_media_demux_thread(void *opaque)
+{
+	mp_media_t *m = opaque;
+
+	os_set_thread_name("mp_media_demux_thread");
+
+	m->demux_ts = AV_NOPTS_VALUE;
+	m->demux_start_ts = AV_NOPTS_VALUE;
+	m->v.demux_ts = AV_NOPTS_VALUE;
+	m->a.demux_ts = AV_NOPTS_VALUE;
+	m->v.demux_idle = false;
+	m->a.demux_idle = false;
+
+	while (!os_atomic_load_bool(&m->pipeline_abort)) {
+		if (mp_media_demux_should_wait(m)) {
+			os_event_timedwait(m->demux_event, 100);
+			continue;
+		}
+
+		int ret = mp_media_next_packet(m);
+		if (ret == AVERROR_EOF) {
+			break;
+		} else if (ret < 0) {
+			/* reads are interrupted when stopping, which is not
+			 * an error */
+			if (!os_atomic_load_bool(&m->pipeline_abort) &&
+			    !mp_media_stopping(m))
+				os_atomic_set_bool(&m->pipeline_error, true);
+			break;
+		}
+	}
+
+	if (m->has_video)
+		mp_queue_finish(&m->v.packets);
+	if (m->has_audio)
+		mp_queue_finish(&m->a.packets);
+	return NULL;
 }
 
 static inline int get_sws_colorspace(enum AVColorSpace cs)
@@ -181,7 +309,15 @@ static bool mp_media_init_scaling(mp_media_t *m)
 	sws_setColorspaceDetails(m->swscale, coeff, range, coeff, range, 0,
 			FIXED_1_0, FIXED_1_0);
 
-	int ret = av_image_alloc(m->scale_pic, m->scale_linesizes,
+	return true;
+}
+
+static bool mp_media_get_picture(mp_media_t *m, struct mp_picture *pic)
+{
+	if (mp_queue_try_pop(&m->pics, pic))
+		return true;
+
+	int ret = av_image_alloc(pic->data, pic->linesize,
 			m->v.decoder->width, m->v.decoder->height,
 			m->scale_format, 1);
 	if (ret < 0) {
@@ -189,38 +325,186 @@ static bool mp_media_init_scaling(mp_media_t *m)
 		return false;
 	}
 
+	pic->format = m->scale_format;
 	return true;
 }
 
-static bool mp_media_prepare_frames(mp_media_t *m)
+static bool mp_media_convert_frame(mp_media_t *m, struct mp_frame *frame)
 {
-	while (!mp_media_ready_to_start(m)) {
-		if (!m->eof) {
-			int ret = mp_media_next_packet(m);
-			if (ret == AVERROR_EOF)
-				m->eof = true;
-			else if (ret < 0)
-				return false;
-		}
+	AVFrame *f = frame->frame;
 
-		if (m->has_video && !mp_decode_frame(&m->v))
-			return false;
-		if (m->has_audio && !mp_decode_frame(&m->a))
+	if (!m->swscale) {
+		m->scale_format = closest_format(f->format);
+		if (m->scale_format == f->format)
+			return true;
+		if (!mp_media_init_scaling(m))
 			return false;
 	}
 
-	if (m->has_video && m->v.frame_ready && !m->swscale) {
-		m->scale_format = closest_format(m->v.frame->format);
-		if (m->scale_format != m->v.frame->format) {
-			if (!mp_media_init_scaling(m)) {
-				return false;
-			}
+	if (!mp_media_get_picture(m, &frame->pic))
+		return false;
+
+	int ret = sws_scale(m->swscale,
+			(const uint8_t *const *)f->data, f->linesize,
+			0, f->height,
+			frame->pic.data, frame->pic.linesize);
+	if (ret < 0) {
+		mp_queue_push(&m->pics, &frame->pic);
+		memset(&frame->pic, 0, sizeof(frame->pic));
+	}
+
+	return true;
+}
+
+static void *mp_media_convert_thread(void *opaque)
+{
+	mp_media_t *m = opaque;
+	struct mp_decode *d = &m->v;
+	struct mp_frame frame;
+
+	os_set_thread_name("mp_media_convert_thread");
+
+	while (mp_queue_pop(&d->decoded, &frame)) {
+		/* frames before a seek target are dropped by the media thread
+		 * without being presented */
+		bool preroll = m->prerolling &&
+			frame.next_pts <= m->preroll_pts;
+
+		if (!preroll && !mp_media_convert_frame(m, &frame)) {
+			mp_decode_release_frame(d, &frame);
+			os_atomic_set_bool(&m->pipeline_error, true);
+			break;
 		}
+
+		if (!mp_queue_push(&d->frames, &frame)) {
+			mp_decode_release_frame(d, &frame);
+			return NULL;
+		}
+	}
+
+	mp_queue_finish(&d->frames);
+	return NULL;
+}
+
+/* aborts every queue of the pipeline, which makes all of its threads exit,
+ * and makes the media thread return from any frame it is waiting for */
+static void mp_media_abort_pipeline(mp_media_t *m)
+{
+	os_atomic_set_bool(&m->pipeline_abort, true);
+
+	if (m->shared) {
+		mp_shared_wake(m->shared);
+		return;
+	}
+
+	if (m->demux_event)
+		os_event_signal(m->demux_event);
+	if (m->has_video)
+		mp_decode_abort(&m->v);
+	if (m->has_audio)
+		mp_decode_abort(&m->a);
+}
+
+static void mp_media_stop_pipeline(mp_media_t *m)
+{
+	mp_media_abort_pipeline(m);
+
+	if (m->shared) {
+		mp_shared_detach(m->shared, m);
+		return;
+	}
+
+	if (m->demux_thread_valid) {
+		pthread_join(m->demux_thread, NULL);
+		m->demux_thread_valid = false;
+	}
+	if (m->convert_thread_valid) {
+		pthread_join(m->convert_thread, NULL);
+		m->convert_thread_valid = false;
+	}
+	if (m->has_video)
+		mp_decode_join(&m->v);
+	if (m->has_audio)
+		mp_decode_join(&m->a);
+}
+
+static bool mp_media_start_pipeline_internal(mp_media_t *m)
+{
+	/* consumers of a shared decoder attach to it after this */
+	if (m->shared) {
+		os_atomic_set_bool(&m->pipeline_abort, false);
+		return true;
+	}
+
+	if (m->has_video) {
+		mp_queue_restart(&m->v.packets);
+		mp_queue_restart(&m->v.decoded);
+		mp_queue_restart(&m->v.frames);
+	}
+	if (m->has_audio) {
+		mp_queue_restart(&m->a.packets);
+		mp_queue_restart(&m->a.frames);
+	}
+
+	os_atomic_set_bool(&m->pipeline_abort, false);
+	os_atomic_set_bool(&m->pipeline_error, false);
+
+	if (m->has_video && !mp_decode_start(&m->v))
+		return false;
+	if (m->has_audio && !mp_decode_start(&m->a))
+		return false;
+
+	if (m->has_video) {
+		if (pthread_create(&m->convert_thread, NULL,
+					mp_media_convert_thread, m) != 0) {
+			blog(LOG_WARNING, "MP: Could not create convert "
+					"thread");
+			return false;
+		}
+		m->convert_thread_valid = true;
+	}
+
+	if (pthread_create(&m->demux_thread, NULL, mp_media_demux_thread,
+				m) != 0) {
+		blog(LOG_WARNING, "MP: Could not create demux thread");
+		return false;
 	}
 
+	m->demux_thread_valid = true;
 	return true;
 }
 
+static bool mp_media_start_pipeline(mp_media_t *m)
+{
+	bool success = false;
+
+	/* the mutex keeps mp_kill_thread from aborting the pipeline before
+	 * it has been restarted */
+	pthread_mutex_lock(&m->mutex);
+	if (!m->kill)
+		success = mp_media_start_pipeline_internal(m);
+	pthread_mutex_unlock(&m->mutex);
+
+	return success;
+}
+
+static inline bool mp_media_decode_frame(mp_media_t *m,
+		struct mp_decode *d)
+{
+	return m->shared ? mp_shared_decode_frame(m->shared, d) :
+		mp_decode_frame(d);
+}
+
+static bool mp_media_prepare_frames(mp_media_t *m)
+{
+	if (m->has_video && !mp_media_decode_frame(m, &m->v))
+		return false;
+	if (m->has_audio && !mp_media_decode_frame(m, &m->a))
+		return false;
+
+	return !os_atomic_load_bool(&m->pipeline_error);
+}
+
 static inline int64_t mp_media_get_next_min_pts(mp_media_t *m)
 {
 	int64_t min_next_ns = 0x7FFFFFFFFFFFFFFFLL;
@@ -259,7 +543,7 @@ static void mp_media_next_audio(mp_media_t *m)
 {
 	struct mp_decode *d = &m->a;
 	struct obs_source_audio audio = {0};
-	AVFrame *f = d->frame;
+	AVFrame *f = d->cur.frame;
 
 	if (!mp_media_can_play_frame(m, d))
 		return;
@@ -291,7 +575,8 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 	enum video_format new_format;
 	enum video_colorspace new_space;
 	enum video_range_type new_range;
-	AVFrame *f = d->frame;
+	AVFrame *f = d->cur.frame;
+	struct mp_picture *pic = &d->cur.pic;
 
 	if (!preload) {
 		if (!mp_media_can_play_frame(m, d))
@@ -305,19 +590,17 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 		return;
 	}
 
-	bool flip = false;
-	if (m->swscale) {
-		int ret = sws_scale(m->swscale,
-				(const uint8_t *const *)f->data, f->linesize,
-				0, f->height,
-				m->scale_pic, m->scale_linesizes);
-		if (ret < 0)
-			return;
+	/* frames that needed to be converted but could not be are skipped */
+	bool scaled = !!pic->data[0];
+	if (!scaled && m->swscale)
+		return;
 
-		flip = m->scale_linesizes[0] < 0 && m->scale_linesizes[1] == 0;
+	bool flip = false;
+	if (scaled) {
+		flip = pic->linesize[0] < 0 && pic->linesize[1] == 0;
 		for (size_t i = 0; i < 4; i++) {
-			frame->data[i] = m->scale_pic[i];
-			frame->linesize[i] = abs(m->scale_linesizes[i]);
+			frame->data[i] = pic->data[i];
+			frame->linesize[i] = abs(pic->linesize[i]);
 		}
 
 	} else {
@@ -332,7 +615,7 @@ static void mp_media_next_video(mp_media_t *m, bool preload)
 	if (flip)
 		frame->data[0] -= frame->linesize[0] * (f->height - 1);
 
-	new_format = convert_pixel_format(m->scale_format);
+	new_format = convert_pixel_format(scaled ? pic->format : f->format);
 	new_space  = convert_color_space(f->colorspace);
 	new_range  = m->force_range == VIDEO_RANGE_DEFAULT
 		? convert_color_range(f->color_range)
@@ -402,13 +685,11 @@ static void mp_media_calc_next_ns(mp_media_t *m)
 	m->next_pts_ns = min_next_ns;
 }
 
-static bool mp_media_reset(mp_media_t *m)
+static void mp_media_seek_start(mp_media_t *m)
 {
 	AVStream *stream = m->fmt->streams[0];
 	int64_t seek_pos;
 	int seek_flags;
-	bool stopping;
-	bool active;
 
 	if (m->fmt->duration == AV_NOPTS_VALUE) {
 		seek_pos = 0;
@@ -422,24 +703,166 @@ static bool mp_media_reset(mp_media_t *m)
 		? av_rescale_q(seek_pos, AV_TIME_BASE_Q, stream->time_base)
 		: seek_pos;
 
-	if (m->is_local_file) {
-		int ret = av_seek_frame(m->fmt, 0, seek_target, seek_flags);
-		if (ret < 0) {
-			blog(LOG_WARNING, "MP: Failed to seek: %s",
-					av_err2str(ret));
-		}
+	int ret = av_seek_frame(m->fmt, 0, seek_target, seek_flags);
+	if (ret < 0) {
+		blog(LOG_WARNING, "MP: Failed to seek: %s",
+				av_err2str(ret));
 	}
 
-	if (m->has_video && m->is_local_file)
+	if (m->has_video)
 		mp_decode_flush(&m->v);
-	if (m->has_audio && m->is_local_file)
+	if (m->has_audio)
 		mp_decode_flush(&m->a);
+}
+
+/* seeks to the keyframe at or before pos, returns the position that was
+ * seeked to */
+static int64_t mp_media_seek_keyframe(mp_media_t *m, int64_t pos,
+		bool *indexed)
+{
+	AVRational time_base = AV_TIME_BASE_Q;
+	struct mp_keyframe keyframe;
+	int stream_index = -1;
+	int seek_flags = AVSEEK_FLAG_BACKWARD;
+	int64_t seek_target;
+
+	*indexed = m->has_video && mp_index_find(m->index, pos, &keyframe);
+	if (*indexed) {
+		pos = keyframe.pts;
+		stream_index = m->v.stream->index;
+		time_base = m->v.stream->time_base;
+	}
 
-	int64_t next_ts = mp_media_get_base_pts(m);
+	seek_target = av_rescale_q(pos, (AVRational){1, 1000000000},
+			time_base);
+
+	/* formats with timestamp discontinuities are not seeked to exactly
+	 * by timestamp, but the byte position of the keyframe is known */
+	if (*indexed && keyframe.pos >= 0 &&
+	    (m->fmt->iformat->flags & AVFMT_TS_DISCONT) != 0) {
+		seek_target = keyframe.pos;
+		seek_flags = AVSEEK_FLAG_BYTE;
+	}
+
+	int ret = av_seek_frame(m->fmt, stream_index, seek_target, seek_flags);
+	if (ret < 0) {
+		blog(LOG_WARNING, "MP: Failed to seek: %s",
+				av_err2str(ret));
+	}
+
+	if (m->has_video)
+		mp_decode_flush(&m->v);
+	if (m->has_audio)
+		mp_decode_flush(&m->a);
+	return pos;
+}
+
+static inline bool mp_media_seek_overshot(mp_media_t *m, int64_t target)
+{
+	struct mp_decode *d = m->has_video ? &m->v : &m->a;
+	return d->frame_ready && d->frame_pts > target;
+}
+
+/* drops the frames that end before the target, so that the first frames
+ * left can be presented as soon as the seek is done */
+static bool mp_media_preroll(mp_media_t *m, struct mp_decode *d,
+		int64_t target)
+{
+	while (d->frame_ready && d->next_pts <= target) {
+		d->frame_ready = false;
+		if (!mp_media_decode_frame(m, d))
+			return false;
+	}
+
+	return true;
+}
+
+#define MP_SEEK_MAX_RETRIES 3
+
+static bool mp_media_seek_frames(mp_media_t *m, int64_t target)
+{
+	int64_t start = m->fmt->start_time != AV_NOPTS_VALUE
+		? m->fmt->start_time * 1000
+		: 0;
+	int64_t pos = target;
+
+	for (int i = 0;; i++) {
+		bool indexed;
+
+		pos = mp_media_seek_keyframe(m, pos, &indexed);
+
+		if (!mp_media_start_pipeline(m))
+			return false;
+		if (!mp_media_prepare_frames(m))
+			return false;
+
+		if (!mp_media_seek_overshot(m, target) ||
+		    i == MP_SEEK_MAX_RETRIES || pos <= start)
+			break;
+
+		/* demuxers can land past the target when they have no index
+		 * of their own, in which case it is tried again from further
+		 * back */
+		mp_media_stop_pipeline(m);
+		pos = indexed ? pos - 1 : pos - (1000000000LL << i);
+	}
+
+	if (m->has_video && !mp_media_preroll(m, &m->v, target))
+		return false;
+	if (m->has_audio && !mp_media_preroll(m, &m->a, target))
+		return false;
+	return true;
+}
+
+static bool init_avformat(mp_media_t *m);
+
+/* used when the shared decoder no longer has the start of the file, or when
+ * seeking, which consumers of a shared decoder cannot do */
+static bool mp_media_unshare(mp_media_t *m)
+{
+	struct mp_shared *shared = m->shared;
+
+	pthread_mutex_lock(&m->mutex);
+	m->shared = NULL;
+	pthread_mutex_unlock(&m->mutex);
+
+	mp_shared_release(shared);
+
+	return init_avformat(m);
+}
+
+static bool mp_media_reset(mp_media_t *m)
+{
+	bool stopping;
+	bool active;
+	bool seeking;
+	int64_t seek_pos;
+
+	pthread_mutex_lock(&m->mutex);
+	seeking = m->seeking;
+	seek_pos = m->seek_pos;
+	m->seeking = false;
+	if (seeking)
+		m->reset = false;
+	pthread_mutex_unlock(&m->mutex);
+
+	mp_media_stop_pipeline(m);
+
+	if (seeking && m->shared) {
+		blog(LOG_INFO, "MP: Seeking in '%s', decoding it separately "
+				"from the shared decoder", m->path);
+		if (!mp_media_unshare(m))
+			return false;
+	}
+
+	if (!m->shared && m->is_local_file && !seeking)
+		mp_media_seek_start(m);
+
+	/* a seek continues the timeline from what was last presented */
+	int64_t next_ts = seeking ? m->next_pts_ns : mp_media_get_base_pts(m);
 	int64_t offset = next_ts - m->next_pts_ns;
 
-	m->eof = false;
-	m->base_ts += next_ts;
+	m->base_ts += next_ts - m->start_ts;
 
 	pthread_mutex_lock(&m->mutex);
 	stopping = m->stopping;
@@ -447,8 +870,37 @@ static bool mp_media_reset(mp_media_t *m)
 	m->stopping = false;
 	pthread_mutex_unlock(&m->mutex);
 
-	if (!mp_media_prepare_frames(m))
-		return false;
+	if (seeking) {
+		int64_t target = seek_pos > 0 ? seek_pos : 0;
+		if (m->fmt->start_time != AV_NOPTS_VALUE)
+			target += m->fmt->start_time * 1000;
+
+		if (m->has_video && !m->index)
+			m->index = mp_index_create(m->path);
+
+		m->prerolling = true;
+		m->preroll_pts = target;
+
+		if (!mp_media_seek_frames(m, target))
+			return false;
+	} else {
+		m->prerolling = false;
+
+		if (!mp_media_start_pipeline(m))
+			return false;
+
+		if (m->shared && !mp_shared_attach(m->shared, m)) {
+			blog(LOG_INFO, "MP: Start of '%s' is no longer cached "
+					"by the shared decoder, decoding it "
+					"separately", m->path);
+			if (!mp_media_unshare(m) ||
+			    !mp_media_start_pipeline(m))
+				return false;
+		}
+
+		if (!mp_media_prepare_frames(m))
+			return false;
+	}
 
 	if (active) {
 		if (!m->play_sys_ts)
@@ -464,6 +916,12 @@ static bool mp_media_reset(mp_media_t *m)
 
 	if (!active && m->is_local_file && m->v_preload_cb)
 		mp_media_next_video(m, true);
+
+	/* stopped consumers of a shared decoder let go of it until they are
+	 * played again, which resets them */
+	if (!active && m->shared)
+		mp_media_stop_pipeline(m);
+
 	if (stopping && m->stop_cb)
 		m->stop_cb(m->opaque);
 	return true;
@@ -524,6 +982,9 @@ static int interrupt_callback(void *data)
 		stop = m->kill || m->stopping;
 		pthread_mutex_unlock(&m->mutex);
 
+		if (os_atomic_load_bool(&m->pipeline_abort))
+			stop = true;
+
 		m->interrupt_poll_ts = ts;
 	}
 
@@ -580,7 +1041,9 @@ static inline bool mp_media_thread(mp_media_t *m)
 {
 	os_set_thread_name("mp_media_thread");
 
-	if (!init_avformat(m)) {
+	bool opened = m->shared ? mp_shared_open(m->shared, m) :
+		init_avformat(m);
+	if (!opened) {
 		return false;
 	}
 	if (!mp_media_reset(m)) {
@@ -642,7 +1105,11 @@ static void *mp_media_thread_start(void *opaque)
 {
 	mp_media_t *m = opaque;
 
-	if (!mp_media_thread(m)) {
+	bool success = mp_media_thread(m);
+
+	mp_media_stop_pipeline(m);
+
+	if (!success) {
 		if (m->stop_cb) {
 			m->stop_cb(m->opaque);
 		}
@@ -651,10 +1118,7 @@ static void *mp_media_thread_start(void *opaque)
 	return NULL;
 }
 
-static inline bool mp_media_init_internal(mp_media_t *m,
-		const char *path,
-		const char *format_name,
-		bool hw)
+static bool mp_media_init_sync(mp_media_t *m)
 {
 	if (pthread_mutex_init(&m->mutex, NULL) != 0) {
 		blog(LOG_WARNING, "MP: Failed to init mutex");
@@ -664,11 +1128,34 @@ static inline bool mp_media_init_internal(mp_media_t *m,
 		blog(LOG_WARNING, "MP: Failed to init semaphore");
 		return false;
 	}
+	if (os_event_init(&m->demux_event, OS_EVENT_TYPE_AUTO) != 0) {
+		blog(LOG_WARNING, "MP: Failed to init demux event");
+		return false;
+	}
+	if (!mp_queue_init(&m->pics, sizeof(struct mp_picture), 0)) {
+		blog(LOG_WARNING, "MP: Failed to init picture queue");
+		return false;
+	}
+
+	return true;
+}
+
+static inline bool mp_media_init_internal(mp_media_t *m,
+		const char *path,
+		const char *format_name,
+		bool hw,
+		bool shared)
+{
+	if (!mp_media_init_sync(m))
+		return false;
 
 	m->path = path ? bstrdup(path) : NULL;
 	m->format_name = format_name ? bstrdup(format_name) : NULL;
 	m->hw = hw;
 
+	if (shared && m->is_local_file && m->path && *m->path)
+		m->shared = mp_shared_acquire(m->path, hw, m->decode_ahead);
+
 	if (pthread_create(&m->thread, NULL, mp_media_thread_start, m) != 0) {
 		blog(LOG_WARNING, "MP: Could not create media thread");
 		return false;
@@ -689,7 +1176,9 @@ bool mp_media_init(mp_media_t *media,
 		mp_video_cb v_preload_cb,
 		bool hw_decoding,
 		bool is_local_file,
-		enum video_range_type force_range)
+		enum video_range_type force_range,
+		int decode_ahead,
+		bool shared)
 {
 	memset(media, 0, sizeof(*media));
 	pthread_mutex_init_value(&media->mutex);
@@ -701,6 +1190,8 @@ bool mp_media_init(mp_media_t *media,
 	media->force_range = force_range;
 	media->buffering = buffering;
 	media->is_local_file = is_local_file;
+	media->decode_ahead = decode_ahead > 0 ?
+		decode_ahead : MP_DEFAULT_DECODE_AHEAD;
 
 	static bool initialized = false;
 	if (!initialized) {
@@ -714,7 +1205,8 @@ bool mp_media_init(mp_media_t *media,
 	if (!base_sys_ts)
 		base_sys_ts = (int64_t)os_gettime_ns();
 
-	if (!mp_media_init_internal(media, path, format, hw_decoding)) {
+	if (!mp_media_init_internal(media, path, format, hw_decoding,
+				shared)) {
 		mp_media_free(media);
 		return false;
 	}
@@ -722,18 +1214,36 @@ bool mp_media_init(mp_media_t *media,
 	return true;
 }
 
+void mp_media_interrupt(mp_media_t *m)
+{
+	pthread_mutex_lock(&m->mutex);
+	m->kill = true;
+	mp_media_abort_pipeline(m);
+	pthread_mutex_unlock(&m->mutex);
+}
+
 static void mp_kill_thread(mp_media_t *m)
 {
 	if (m->thread_valid) {
-		pthread_mutex_lock(&m->mutex);
-		m->kill = true;
-		pthread_mutex_unlock(&m->mutex);
+		mp_media_interrupt(m);
 		os_sem_post(m->sem);
 
 		pthread_join(m->thread, NULL);
 	}
 }
 
+static void mp_media_free_pictures(mp_media_t *m)
+{
+	struct mp_picture pic;
+
+	if (!m->pics.item_size)
+		return;
+
+	while (mp_queue_try_pop(&m->pics, &pic))
+		av_freep(&pic.data[0]);
+	mp_queue_free(&m->pics);
+}
+
 void mp_media_free(mp_media_t *media)
 {
 	if (!media)
@@ -741,13 +1251,17 @@ void mp_media_free(mp_media_t *media)
 
 	mp_media_stop(media);
 	mp_kill_thread(media);
+	mp_media_stop_pipeline(media);
 	mp_decode_free(&media->v);
 	mp_decode_free(&media->a);
+	mp_shared_release(media->shared);
+	mp_index_destroy(media->index);
+	mp_media_free_pictures(media);
 	avformat_close_input(&media->fmt);
 	pthread_mutex_destroy(&media->mutex);
 	os_sem_destroy(media->sem);
+	os_event_destroy(media->demux_event);
 	sws_freeContext(media->swscale);
-	av_freep(&media->scale_pic[0]);
 	bfree(media->path);
 	bfree(media->format_name);
 	memset(media, 0, sizeof(*media));
@@ -758,7 +1272,7 @@ void mp_media_play(mp_media_t *m, bool loop)
 {
 	pthread_mutex_lock(&m->mutex);
 
-	if (m->active)
+	if (m->active || m->shared)
 		m->reset = true;
 
 	m->looping = loop;
@@ -780,3 +1294,87 @@ void mp_media_stop(mp_media_t *m)
 	}
 	pthread_mutex_unlock(&m->mutex);
 }
+
+void mp_media_seek(mp_media_t *m, int64_t pos, bool play, bool loop)
+{
+	pthread_mutex_lock(&m->mutex);
+
+	if (m->is_local_file) {
+		m->seek_pos = pos;
+		m->seeking = true;
+		m->reset = true;
+	}
+
+	/* set in the same lock as the seek, so that the media thread can't
+	 * reset in between and make the playback start over instead */
+	if (play) {
+		m->looping = loop;
+		m->active = true;
+	}
+
+	pthread_mutex_unlock(&m->mutex);
+
+	os_sem_post(m->sem);
+}
+
+bool mp_media_init_decoder(mp_media_t *m, const char *path, bool hw,
+		int decode_ahead)
+{
+	memset(m, 0, sizeof(*m));
+	pthread_mutex_init_value(&m->mutex);
+	m->is_local_file = true;
+	m->decode_ahead = decode_ahead;
+	m->path = bstrdup(path);
+	m->hw = hw;
+
+	return mp_media_init_sync(m);
+}
+
+bool mp_media_open(mp_media_t *m)
+{
+	return init_avformat(m) && mp_media_rewind(m);
+}
+
+bool mp_media_rewind(mp_media_t *m)
+{
+	mp_media_stop_pipeline(m);
+	mp_media_seek_start(m);
+	return mp_media_start_pipeline(m);
+}
+
+bool mp_media_pull_frame(mp_media_t *m, struct mp_frame *frame, bool *audio)
+{
+	for (;;) {
+		bool v_ready;
+		bool a_ready;
+		struct mp_decode *d;
+
+		if (!mp_media_prepare_frames(m))
+			return false;
+
+		v_ready = m->has_video && m->v.frame_ready;
+		a_ready = m->has_audio && m->a.frame_ready;
+
+		if (!v_ready && !a_ready) {
+			memset(frame, 0, sizeof(*frame));
+			return true;
+		}
+
+		if (v_ready && a_ready)
+			d = m->a.frame_pts < m->v.frame_pts ? &m->a : &m->v;
+		else
+			d = v_ready ? &m->v : &m->a;
+
+		*frame = d->cur;
+		*audio = d->audio;
+		memset(&d->cur, 0, sizeof(d->cur));
+		d->frame_ready = false;
+
+		/* frames that needed to be converted but could not be are
+		 * skipped */
+		if (d->audio || frame->pic.data[0] || !m->swscale)
+			return true;
+
+		mp_decode_release_frame(d, frame);
+	}
+}
@@ -18,6 +18,8 @@
 
 #include <obs.h>
 #include "decode.h"
+#include "shared.h"
+#include "index.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -38,6 +40,9 @@ extern "C" {
 #pragma warning(pop)
 #endif
 
+#define MP_DEFAULT_DECODE_AHEAD 4
+#define MP_MIN_AUDIO_FRAMES 16
+
 typedef void (*mp_video_cb)(void *opaque, struct obs_source_frame *frame);
 typedef void (*mp_audio_cb)(void *opaque, struct obs_source_audio *audio);
 typedef void (*mp_stop_cb)(void *opaque);
@@ -54,11 +59,12 @@ struct mp_media {
 	char *path;
 	char *format_name;
 	int buffering;
+	int decode_ahead;
 
 	enum AVPixelFormat scale_format;
 	struct SwsContext *swscale;
-	int scale_linesizes[4];
-	uint8_t *scale_pic[4];
+	/* struct mp_picture, unused scaled pictures */
+	struct mp_queue pics;
 
 	struct mp_decode v;
 	struct mp_decode a;
@@ -66,7 +72,6 @@ struct mp_media {
 	bool has_video;
 	bool has_audio;
 	bool is_file;
-	bool eof;
 	bool hw;
 
 	struct obs_source_frame obsframe;
@@ -92,6 +97,32 @@ struct mp_media {
 
 	bool thread_valid;
 	pthread_t thread;
+
+	/* the media thread only presents frames; packets are read by the
+	 * demux thread, decoded by a thread per stream, and video frames are
+	 * converted by the convert thread */
+	volatile bool pipeline_abort;
+	volatile bool pipeline_error;
+	os_event_t *demux_event;
+	pthread_t demux_thread;
+	pthread_t convert_thread;
+	bool demux_thread_valid;
+
+	/* newest and first packet times read by the demux thread */
+	int64_t demux_ts;
+	int64_t demux_start_ts;
+	bool convert_thread_valid;
+
+	/* set when frames are read from a shared decoder instead */
+	struct mp_shared *shared;
+
+	/* seeking is done on the media thread on the next reset; the frames
+	 * before the target are decoded but not converted or presented */
+	struct mp_index *index;
+	int64_t seek_pos;
+	int64_t preroll_pts;
+	bool prerolling;
+	bool seeking;
 };
 
 typedef struct mp_media mp_media_t;
@@ -107,11 +138,28 @@ extern bool mp_media_init(mp_media_t *media,
 		mp_video_cb v_preload_cb,
 		bool hardware_decoding,
 		bool is_local_file,
-		enum video_range_type force_range);
+		enum video_range_type force_range,
+		int decode_ahead,
+		bool shared);
 extern void mp_media_free(mp_media_t *media);
 
 extern void mp_media_play(mp_media_t *media, bool loop);
 extern void mp_media_stop(mp_media_t *media);
+/* pos is in nanoseconds from the start of the file.  If play is set, the
+ * media plays from there like with mp_media_play, otherwise the position is
+ * used the next time it plays */
+extern void mp_media_seek(mp_media_t *media, int64_t pos, bool play,
+		bool loop);
+
+/* used by the shared decoder, which runs the pipeline of a media object
+ * from its own thread instead of a media thread */
+extern bool mp_media_init_decoder(mp_media_t *media, const char *path,
+		bool hw, int decode_ahead);
+extern bool mp_media_open(mp_media_t *media);
+extern bool mp_media_rewind(mp_media_t *media);
+extern bool mp_media_pull_frame(mp_media_t *media, struct mp_frame *frame,
+		bool *audio);
+extern void mp_media_interrupt(mp_media_t *media);
 
 /* #define DETAILED_DEBUG_INFO */
 
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2017 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "queue.h"
+
+bool mp_queue_init(struct mp_queue *q, size_t item_size, size_t capacity)
+{
+	memset(q, 0, sizeof(*q));
+	q->item_size = item_size;
+	q->capacity = capacity;
+
+	if (pthread_mutex_init(&q->mutex, NULL) != 0)
+		return false;
+	if (pthread_cond_init(&q->cond, NULL) != 0) {
+		pthread_mutex_destroy(&q->mutex);
+		return false;
+	}
+
+	return true;
+}
+
+void mp_queue_free(struct mp_queue *q)
+{
+	if (!q->item_size)
+		return;
+
+	pthread_cond_destroy(&q->cond);
+	pthread_mutex_destroy(&q->mutex);
+	circlebuf_free(&q->items);
+	memset(q, 0, sizeof(*q));
+}
+
+static inline size_t num_items(struct mp_queue *q)
+{
+	return q->items.size / q->item_size;
+}
+
+bool mp_queue_push(struct mp_queue *q, const void *item)
+{
+	bool success = false;
+
+	pthread_mutex_lock(&q->mutex);
+
+	while (!q->aborted && q->capacity && num_items(q) >= q->capacity)
+		pthread_cond_wait(&q->cond, &q->mutex);
+
+	if (!q->aborted) {
+		circlebuf_push_back(&q->items, item, q->item_size);
+		pthread_cond_broadcast(&q->cond);
+		success = true;
+	}
+
+	pthread_mutex_unlock(&q->mutex);
+	return success;
+}
+
+static inline bool pop_item(struct mp_queue *q, void *item)
+{
+	if (!q->items.size)
+		return false;
+
+	circlebuf_pop_front(&q->items, item, q->item_size);
+	pthread_cond_broadcast(&q->cond);
+	return true;
+}
+
+bool mp_queue_pop(struct mp_queue *q, void *item)
+{
+	bool success;
+
+	pthread_mutex_lock(&q->mutex);
+
+	while (!q->aborted && !q->finished && !q->idle && !q->items.size)
+		pthread_cond_wait(&q->cond, &q->mutex);
+
+	success = !q->aborted && pop_item(q, item);
+
+	pthread_mutex_unlock(&q->mutex);
+	return success;
+}
+
+bool mp_queue_try_pop(struct mp_queue *q, void *item)
+{
+	bool success;
+
+	pthread_mutex_lock(&q->mutex);
+	success = pop_item(q, item);
+	pthread_mutex_unlock(&q->mutex);
+
+	return success;
+}
+
+void mp_queue_finish(struct mp_queue *q)
+{
+	pthread_mutex_lock(&q->mutex);
+	q->finished = true;
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->mutex);
+}
+
+void mp_queue_abort(struct mp_queue *q)
+{
+	pthread_mutex_lock(&q->mutex);
+	q->aborted = true;
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->mutex);
+}
+
+/* only call while nothing is using the queue */
+void mp_queue_restart(struct mp_queue *q)
+{
+	pthread_mutex_lock(&q->mutex);
+	q->aborted = false;
+	q->finished = false;
+	q->idle = false;
+	pthread_mutex_unlock(&q->mutex);
+}
+
+void mp_queue_set_idle(struct mp_queue *q, bool idle)
+{
+	pthread_mutex_lock(&q->mutex);
+	q->idle = idle;
+	pthread_cond_broadcast(&q->cond);
+	pthread_mutex_unlock(&q->mutex);
+}
+
+size_t mp_queue_size(struct mp_queue *q)
+{
+	size_t size;
+
+	pthread_mutex_lock(&q->mutex);
+	size = num_items(q);
+	pthread_mutex_unlock(&q->mutex);
+
+	return size;
+}
+
+bool mp_queue_aborted(struct mp_queue *q)
+{
+	bool aborted;
+
+	pthread_mutex_lock(&q->mutex);
+	aborted = q->aborted;
+	pthread_mutex_unlock(&q->mutex);
+
+	return aborted;
+}
+
+bool mp_queue_finished(struct mp_queue *q)
+{
+	bool finished;
+
+	pthread_mutex_lock(&q->mutex);
+	finished = q->finished;
+	pthread_mutex_unlock(&q->mutex);
+
+	return finished;
+}
+
+bool mp_queue_idle(struct mp_queue *q)
+{
+	bool idle;
+
+	pthread_mutex_lock(&q->mutex);
+	idle = q->idle;
+	pthread_mutex_unlock(&q->mutex);
+
+	return idle;
+}
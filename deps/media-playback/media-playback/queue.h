@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2017 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <util/circlebuf.h>
+#include <util/threading.h>
+
+/*
+ * Blocking queue used to connect the stages of the playback pipeline.  Items
+ * are copied in and out by value.  A capacity of 0 makes the queue
+ * unbounded.  The producer finishes the queue when it has no more items; the
+ * consumer then gets the remaining items, after which popping fails.
+ * Aborting the queue makes every blocked or later push/pop fail right away,
+ * which is used to stop the pipeline threads; mp_queue_try_pop still returns
+ * the remaining items so that the queue can be emptied afterwards.  Popping
+ * from an empty idle queue fails right away instead of waiting, which is used
+ * for streams that get no data for a while.
+ */
+
+struct mp_queue {
+	pthread_mutex_t       mutex;
+	pthread_cond_t        cond;
+	struct circlebuf      items;
+	size_t                item_size;
+	size_t                capacity;
+	bool                  finished;
+	bool                  aborted;
+	bool                  idle;
+};
+
+extern bool mp_queue_init(struct mp_queue *q, size_t item_size,
+		size_t capacity);
+extern void mp_queue_free(struct mp_queue *q);
+
+extern bool mp_queue_push(struct mp_queue *q, const void *item);
+extern bool mp_queue_pop(struct mp_queue *q, void *item);
+extern bool mp_queue_try_pop(struct mp_queue *q, void *item);
+
+extern void mp_queue_finish(struct mp_queue *q);
+extern void mp_queue_abort(struct mp_queue *q);
+extern void mp_queue_restart(struct mp_queue *q);
+extern void mp_queue_set_idle(struct mp_queue *q, bool idle);
+
+extern size_t mp_queue_size(struct mp_queue *q);
+extern bool mp_queue_aborted(struct mp_queue *q);
+extern bool mp_queue_finished(struct mp_queue *q);
+extern bool mp_queue_idle(struct mp_queue *q);
+
+#ifdef __cplusplus
+}
+#endif
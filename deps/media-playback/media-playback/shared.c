@@ -0,0 +1,637 @@
+/*
+ * Copyright (c) 2017 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <util/platform.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+
+#include "media.h"
+#include "shared.h"
+
+#include <libavutil/imgutils.h>
+
+struct mp_shared_list {
+	/* struct mp_shared_frame *, oldest first */
+	struct circlebuf      frames;
+	uint64_t              first_seq;
+	bool                  at_pass_start;
+};
+
+struct mp_shared {
+	struct mp_shared      *next;
+	struct mp_shared      **prev_next;
+	char                  *key;
+	long                  refs;
+
+	mp_media_t            producer;
+	pthread_t             thread;
+	bool                  thread_valid;
+
+	pthread_mutex_t       mutex;
+	pthread_cond_t        cond;
+	struct mp_shared_list video;
+	struct mp_shared_list audio;
+	DARRAY(mp_media_t *)  consumers;
+	size_t                size;
+	uint64_t              pass;
+	size_t                decode_ahead;
+	bool                  has_video;
+	bool                  has_audio;
+	bool                  opened;
+	bool                  failed;
+	bool                  complete;
+	bool                  kill;
+};
+
+static pthread_mutex_t shared_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct mp_shared *first_shared = NULL;
+
+/* ------------------------------------------------------------------------- */
+
+static inline size_t list_count(struct mp_shared_list *list)
+{
+	return list->frames.size / sizeof(struct mp_shared_frame *);
+}
+
+static inline uint64_t list_end(struct mp_shared_list *list)
+{
+	return list->first_seq + list_count(list);
+}
+
+static inline struct mp_shared_frame *list_get(struct mp_shared_list *list,
+		size_t idx)
+{
+	struct mp_shared_frame **f = circlebuf_data(&list->frames,
+			idx * sizeof(struct mp_shared_frame *));
+	return *f;
+}
+
+static inline size_t list_unread(struct mp_shared_list *list,
+		struct mp_decode *d)
+{
+	uint64_t pos = d->shared_pos;
+	uint64_t end = list_end(list);
+
+	if (pos < list->first_seq)
+		pos = list->first_seq;
+	return end > pos ? (size_t)(end - pos) : 0;
+}
+
+static inline struct mp_shared_list *get_list(struct mp_shared *s,
+		bool audio)
+{
+	return audio ? &s->audio : &s->video;
+}
+
+static inline struct mp_decode *get_decode(mp_media_t *m, bool audio)
+{
+	return audio ? &m->a : &m->v;
+}
+
+static size_t get_frame_size(const struct mp_frame *frame)
+{
+	AVFrame *f = frame->frame;
+	size_t size = 0;
+
+	if (!f)
+		return 0;
+
+	for (size_t i = 0; i < AV_NUM_DATA_POINTERS; i++) {
+		if (f->buf[i])
+			size += f->buf[i]->size;
+	}
+
+	if (frame->pic.data[0]) {
+		int pic_size = av_image_get_buffer_size(frame->pic.format,
+				f->width, f->height, 1);
+		if (pic_size > 0)
+			size += pic_size;
+	}
+
+	return size;
+}
+
+void mp_shared_frame_release(struct mp_shared_frame *f)
+{
+	if (f && os_atomic_dec_long(&f->refs) == 0) {
+		mp_media_t *p = &f->shared->producer;
+
+		mp_decode_release_frame(get_decode(p, f->audio), &f->frame);
+		bfree(f);
+	}
+}
+
+static void mp_shared_list_free(struct mp_shared_list *list)
+{
+	while (list_count(list)) {
+		struct mp_shared_frame *f;
+
+		circlebuf_pop_front(&list->frames, &f, sizeof(f));
+		mp_shared_frame_release(f);
+	}
+
+	circlebuf_free(&list->frames);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool frame_needed(struct mp_shared *s, uint64_t seq, bool audio)
+{
+	for (size_t i = 0; i < s->consumers.num; i++) {
+		mp_media_t *m = s->consumers.array[i];
+		if (get_decode(m, audio)->shared_pos <= seq)
+			return true;
+	}
+
+	return false;
+}
+
+/* frames of older passes are let go of as soon as no consumer needs them,
+ * frames of the current pass only when the cache is full */
+static void mp_shared_trim_list(struct mp_shared *s, bool audio)
+{
+	struct mp_shared_list *list = get_list(s, audio);
+
+	while (list_count(list)) {
+		struct mp_shared_frame *f = list_get(list, 0);
+		bool old_pass = f->pass < s->pass;
+
+		if (!old_pass && s->size <= MP_SHARED_MAX_CACHE_SIZE)
+			break;
+		if (frame_needed(s, list->first_seq, audio))
+			break;
+
+		circlebuf_pop_front(&list->frames, NULL, sizeof(f));
+		list->first_seq++;
+		s->size -= f->size;
+		mp_shared_frame_release(f);
+	}
+}
+
+static void mp_shared_trim(struct mp_shared *s)
+{
+	if (s->complete)
+		return;
+
+	mp_shared_trim_list(s, false);
+	mp_shared_trim_list(s, true);
+}
+
+static void mp_shared_push(struct mp_shared *s, struct mp_frame *frame,
+		bool audio)
+{
+	struct mp_shared_list *list = get_list(s, audio);
+	struct mp_shared_frame *f = bzalloc(sizeof(*f));
+
+	f->refs = 1;
+	f->shared = s;
+	f->frame = *frame;
+	f->audio = audio;
+	f->pass = s->pass;
+	f->pass_start = list->at_pass_start;
+	f->size = get_frame_size(frame);
+
+	list->at_pass_start = false;
+	circlebuf_push_back(&list->frames, &f, sizeof(f));
+	s->size += f->size;
+}
+
+static inline bool pass_cached(struct mp_shared_list *list, uint64_t pass)
+{
+	struct mp_shared_frame *f = list_count(list) ? list_get(list, 0) : NULL;
+	return f && f->pass == pass && f->pass_start;
+}
+
+/* returns true if a new pass has to be decoded */
+static bool mp_shared_end_pass(struct mp_shared *s)
+{
+	struct mp_frame end = {0};
+
+	if (s->has_video)
+		mp_shared_push(s, &end, false);
+	if (s->has_audio)
+		mp_shared_push(s, &end, true);
+
+	s->complete = (!s->has_video || pass_cached(&s->video, s->pass)) &&
+	              (!s->has_audio || pass_cached(&s->audio, s->pass));
+	if (s->complete) {
+		blog(LOG_INFO, "MP: '%s' is fully cached by the shared decoder",
+				s->producer.path);
+		return false;
+	}
+
+	s->pass++;
+	s->video.at_pass_start = true;
+	s->audio.at_pass_start = true;
+	return true;
+}
+
+/* the pipeline decodes ahead of the consumer that is furthest along, and
+ * keeps going while a consumer has no frame of a stream to read */
+static bool mp_shared_needs_frames(struct mp_shared *s)
+{
+	size_t ahead = s->decode_ahead;
+
+	if (!s->has_video && ahead < MP_MIN_AUDIO_FRAMES)
+		ahead = MP_MIN_AUDIO_FRAMES;
+
+	for (size_t i = 0; i < s->consumers.num; i++) {
+		mp_media_t *m = s->consumers.array[i];
+
+		if (s->has_video) {
+			if (list_unread(&s->video, &m->v) < ahead)
+				return true;
+			if (s->has_audio && !list_unread(&s->audio, &m->a))
+				return true;
+
+		} else if (list_unread(&s->audio, &m->a) < ahead) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void *mp_shared_thread(void *opaque)
+{
+	struct mp_shared *s = opaque;
+	mp_media_t *p = &s->producer;
+	bool success;
+
+	os_set_thread_name("mp_shared_thread");
+
+	success = mp_media_open(p);
+
+	pthread_mutex_lock(&s->mutex);
+	s->opened = success;
+	s->failed = !success;
+	s->has_video = p->has_video;
+	s->has_audio = p->has_audio;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mutex);
+
+	while (success) {
+		struct mp_frame frame;
+		bool audio = false;
+		bool rewind = false;
+		bool stop;
+
+		pthread_mutex_lock(&s->mutex);
+		while (!s->kill && !s->complete && !mp_shared_needs_frames(s))
+			pthread_cond_wait(&s->cond, &s->mutex);
+		stop = s->kill || s->complete;
+		pthread_mutex_unlock(&s->mutex);
+
+		if (stop)
+			break;
+
+		success = mp_media_pull_frame(p, &frame, &audio);
+		if (!success)
+			break;
+
+		pthread_mutex_lock(&s->mutex);
+		if (frame.frame)
+			mp_shared_push(s, &frame, audio);
+		else
+			rewind = mp_shared_end_pass(s);
+		mp_shared_trim(s);
+		pthread_cond_broadcast(&s->cond);
+		pthread_mutex_unlock(&s->mutex);
+
+		if (rewind)
+			success = mp_media_rewind(p);
+	}
+
+	pthread_mutex_lock(&s->mutex);
+	if (!success)
+		s->failed = true;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mutex);
+
+	/* nothing more is decoded once the file is cached */
+	mp_media_interrupt(p);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static struct mp_shared *mp_shared_create(char *key, const char *path,
+		bool hw, int decode_ahead)
+{
+	struct mp_shared *s = bzalloc(sizeof(*s));
+
+	s->key = key;
+	s->refs = 1;
+	s->decode_ahead = (size_t)decode_ahead;
+	s->video.at_pass_start = true;
+	s->audio.at_pass_start = true;
+
+	if (pthread_mutex_init(&s->mutex, NULL) != 0) {
+		blog(LOG_WARNING, "MP: Failed to init shared decoder mutex");
+		goto fail_mutex;
+	}
+	if (pthread_cond_init(&s->cond, NULL) != 0) {
+		blog(LOG_WARNING, "MP: Failed to init shared decoder cond");
+		goto fail_cond;
+	}
+	if (!mp_media_init_decoder(&s->producer, path, hw, decode_ahead))
+		goto fail;
+
+	if (pthread_create(&s->thread, NULL, mp_shared_thread, s) != 0) {
+		blog(LOG_WARNING, "MP: Could not create shared decoder "
+				"thread");
+		goto fail;
+	}
+
+	s->thread_valid = true;
+	return s;
+
+fail:
+	mp_media_free(&s->producer);
+	pthread_cond_destroy(&s->cond);
+fail_cond:
+	pthread_mutex_destroy(&s->mutex);
+fail_mutex:
+	bfree(s->key);
+	bfree(s);
+	return NULL;
+}
+
+static void mp_shared_destroy(struct mp_shared *s)
+{
+	pthread_mutex_lock(&s->mutex);
+	s->kill = true;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mutex);
+
+	mp_media_interrupt(&s->producer);
+	if (s->thread_valid)
+		pthread_join(s->thread, NULL);
+
+	mp_shared_list_free(&s->video);
+	mp_shared_list_free(&s->audio);
+	mp_media_free(&s->producer);
+
+	da_free(s->consumers);
+	pthread_cond_destroy(&s->cond);
+	pthread_mutex_destroy(&s->mutex);
+	bfree(s->key);
+	bfree(s);
+}
+
+struct mp_shared *mp_shared_acquire(const char *path, bool hw,
+		int decode_ahead)
+{
+	struct mp_shared *s;
+	struct dstr key = {0};
+
+	dstr_printf(&key, "%s|%d", path, hw ? 1 : 0);
+
+	pthread_mutex_lock(&shared_mutex);
+
+	s = first_shared;
+	while (s && strcmp(s->key, key.array) != 0)
+		s = s->next;
+
+	if (s) {
+		s->refs++;
+		dstr_free(&key);
+
+	} else {
+		s = mp_shared_create(key.array, path, hw, decode_ahead);
+		if (s) {
+			s->prev_next = &first_shared;
+			s->next = first_shared;
+			if (first_shared)
+				first_shared->prev_next = &s->next;
+			first_shared = s;
+		}
+	}
+
+	pthread_mutex_unlock(&shared_mutex);
+	return s;
+}
+
+void mp_shared_release(struct mp_shared *s)
+{
+	bool destroy;
+
+	if (!s)
+		return;
+
+	pthread_mutex_lock(&shared_mutex);
+
+	destroy = --s->refs == 0;
+	if (destroy) {
+		*s->prev_next = s->next;
+		if (s->next)
+			s->next->prev_next = s->prev_next;
+	}
+
+	pthread_mutex_unlock(&shared_mutex);
+
+	if (destroy)
+		mp_shared_destroy(s);
+}
+
+/* ------------------------------------------------------------------------- */
+
+bool mp_shared_open(struct mp_shared *s, mp_media_t *m)
+{
+	bool success;
+
+	pthread_mutex_lock(&s->mutex);
+
+	while (!s->opened && !s->failed &&
+	       !os_atomic_load_bool(&m->pipeline_abort))
+		pthread_cond_wait(&s->cond, &s->mutex);
+
+	success = s->opened;
+	m->has_video = s->has_video;
+	m->has_audio = s->has_audio;
+
+	pthread_mutex_unlock(&s->mutex);
+
+	m->v.m = m;
+	m->a.m = m;
+	m->a.audio = true;
+	return success;
+}
+
+static bool find_pass_start(struct mp_shared *s, struct mp_shared_list *list,
+		uint64_t pass, uint64_t *pos)
+{
+	for (size_t i = 0; i < list_count(list); i++) {
+		struct mp_shared_frame *f = list_get(list, i);
+
+		if (f->pass > pass)
+			break;
+		if (f->pass == pass && f->pass_start) {
+			*pos = list->first_seq + i;
+			return true;
+		}
+	}
+
+	/* nothing of the current pass has been decoded for this stream yet */
+	if (pass == s->pass && list->at_pass_start) {
+		*pos = list_end(list);
+		return true;
+	}
+
+	return false;
+}
+
+/* positions a consumer at the start of the newest pass that is still
+ * cached from its start */
+static bool mp_shared_find_start(struct mp_shared *s, mp_media_t *m)
+{
+	struct mp_shared_list *first = s->has_video ? &s->video : &s->audio;
+	uint64_t v_pos = 0;
+	uint64_t a_pos = 0;
+	uint64_t oldest;
+
+	if (s->complete) {
+		m->v.shared_pos = s->video.first_seq;
+		m->a.shared_pos = s->audio.first_seq;
+		return true;
+	}
+
+	oldest = list_count(first) ? list_get(first, 0)->pass : s->pass;
+
+	for (uint64_t pass = s->pass + 1; pass > oldest; pass--) {
+		if (s->has_video && !find_pass_start(s, &s->video, pass - 1,
+					&v_pos))
+			continue;
+		if (s->has_audio && !find_pass_start(s, &s->audio, pass - 1,
+					&a_pos))
+			continue;
+
+		m->v.shared_pos = v_pos;
+		m->a.shared_pos = a_pos;
+		return true;
+	}
+
+	return false;
+}
+
+bool mp_shared_attach(struct mp_shared *s, mp_media_t *m)
+{
+	bool at_end = (!s->has_video || m->v.eof) &&
+	              (!s->has_audio || m->a.eof);
+	bool success = true;
+
+	pthread_mutex_lock(&s->mutex);
+
+	/* consumers that reached the end of a pass go on with the next one
+	 * if it is still there, others start over */
+	if (!at_end ||
+	    m->v.shared_pos < s->video.first_seq ||
+	    m->a.shared_pos < s->audio.first_seq)
+		success = mp_shared_find_start(s, m);
+
+	if (success) {
+		m->v.eof = false;
+		m->a.eof = false;
+		da_push_back(s->consumers, &m);
+		pthread_cond_broadcast(&s->cond);
+	}
+
+	pthread_mutex_unlock(&s->mutex);
+	return success;
+}
+
+void mp_shared_detach(struct mp_shared *s, mp_media_t *m)
+{
+	pthread_mutex_lock(&s->mutex);
+	da_erase_item(s->consumers, &m);
+	mp_shared_trim(s);
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mutex);
+
+	mp_decode_release_frame(&m->v, &m->v.cur);
+	mp_decode_release_frame(&m->a, &m->a.cur);
+	m->v.frame_ready = false;
+	m->a.frame_ready = false;
+}
+
+void mp_shared_wake(struct mp_shared *s)
+{
+	pthread_mutex_lock(&s->mutex);
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->mutex);
+}
+
+bool mp_shared_decode_frame(struct mp_shared *s, struct mp_decode *d)
+{
+	struct mp_shared_list *list = get_list(s, d->audio);
+	struct mp_shared_frame *f = NULL;
+
+	if (d->frame_ready || d->eof)
+		return true;
+
+	mp_decode_release_frame(d, &d->cur);
+
+	pthread_mutex_lock(&s->mutex);
+
+	for (;;) {
+		if (s->failed || os_atomic_load_bool(&d->m->pipeline_abort))
+			break;
+
+		if (d->shared_pos < list->first_seq)
+			d->shared_pos = list->first_seq;
+
+		if (d->shared_pos < list_end(list)) {
+			f = list_get(list,
+				(size_t)(d->shared_pos - list->first_seq));
+			break;
+		}
+
+		/* the cached file is played again from its start */
+		if (s->complete && list_count(list)) {
+			d->shared_pos = list->first_seq;
+			continue;
+		}
+
+		pthread_cond_broadcast(&s->cond);
+		pthread_cond_wait(&s->cond, &s->mutex);
+	}
+
+	if (f) {
+		d->shared_pos++;
+		if (f->frame.frame)
+			os_atomic_inc_long(&f->refs);
+
+		/* lets the pipeline decode the frames after this one */
+		pthread_cond_broadcast(&s->cond);
+	}
+
+	pthread_mutex_unlock(&s->mutex);
+
+	if (!f)
+		return false;
+
+	if (!f->frame.frame) {
+		d->eof = true;
+		return true;
+	}
+
+	d->cur = f->frame;
+	d->cur.shared = f;
+	d->frame_pts = f->frame.pts;
+	d->next_pts = f->frame.next_pts;
+	d->frame_ready = true;
+	return true;
+}
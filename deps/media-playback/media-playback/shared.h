@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2017 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "decode.h"
+
+/*
+ * Shared decoder for local files that are played by more than one media
+ * object.  Media objects that opt in and play the same file with the same
+ * hardware decoding setting share a single pipeline, which decodes each
+ * pass over the file once.  Decoded frames are kept in a window of
+ * reference counted frames, and every consumer reads the window at its own
+ * position with its own clock.
+ *
+ * Frames are kept while a consumer still has to read them.  Frames of the
+ * current pass are also kept from its start for as long as the window is
+ * within MP_SHARED_MAX_CACHE_SIZE, so a consumer that restarts can begin at
+ * the start of the pass; when a whole pass fits, the file is only decoded
+ * once and later passes are played from memory.  A consumer that restarts
+ * when the start of the file is no longer kept decodes the file by itself
+ * from then on.
+ */
+
+#define MP_SHARED_MAX_CACHE_SIZE (256 * 1024 * 1024)
+
+struct mp_media;
+struct mp_shared;
+
+struct mp_shared_frame {
+	volatile long         refs;
+	struct mp_shared      *shared;
+	/* frame.frame is NULL for the entry that ends a pass */
+	struct mp_frame       frame;
+	bool                  audio;
+	bool                  pass_start;
+	uint64_t              pass;
+	size_t                size;
+};
+
+extern struct mp_shared *mp_shared_acquire(const char *path, bool hw,
+		int decode_ahead);
+extern void mp_shared_release(struct mp_shared *shared);
+
+extern bool mp_shared_open(struct mp_shared *shared, struct mp_media *media);
+extern bool mp_shared_attach(struct mp_shared *shared,
+		struct mp_media *media);
+extern void mp_shared_detach(struct mp_shared *shared,
+		struct mp_media *media);
+extern void mp_shared_wake(struct mp_shared *shared);
+
+extern bool mp_shared_decode_frame(struct mp_shared *shared,
+		struct mp_decode *decode);
+extern void mp_shared_frame_release(struct mp_shared_frame *frame);
+
+#ifdef __cplusplus
+}
+#endif
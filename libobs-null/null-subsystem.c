@@ -0,0 +1,695 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+
+#include <util/base.h>
+#include <graphics/vec4.h>
+#include "null-subsystem.h"
+
+const char *device_get_name(void)
+{
+	return "Null";
+}
+
+int device_get_type(void)
+{
+	return GS_DEVICE_NULL;
+}
+
+const char *device_preprocessor_name(void)
+{
+	return "_NULL";
+}
+
+bool device_enum_adapters(
+		bool (*callback)(void *param, const char *name, uint32_t id),
+		void *param)
+{
+	callback(param, "Null Adapter", 0);
+	return true;
+}
+
+int device_create(gs_device_t **p_device, uint32_t adapter)
+{
+	struct gs_device *device = bzalloc(sizeof(struct gs_device));
+
+	blog(LOG_INFO, "---------------------------------");
+	blog(LOG_INFO, "Initializing null graphics device (adapter %u), "
+	               "nothing will be rendered", adapter);
+
+	device->cur_cull_mode = GS_BACK;
+	matrix4_identity(&device->cur_proj);
+
+	*p_device = device;
+	return GS_SUCCESS;
+}
+
+static void log_stats(const struct gs_device_stats *stats)
+{
+	double frames = stats->frames ? (double)stats->frames : 1.0;
+
+	blog(LOG_INFO, "Null graphics device statistics:");
+	blog(LOG_INFO, "\tframes:                 %"PRIu64, stats->frames);
+	blog(LOG_INFO, "\tdraw calls:             %"PRIu64" (%.1f per frame)",
+			stats->draw_calls,
+			(double)stats->draw_calls / frames);
+	blog(LOG_INFO, "\tvertices:               %"PRIu64" (%.1f per frame)",
+			stats->vertices,
+			(double)stats->vertices / frames);
+	blog(LOG_INFO, "\ttexture uploads:        %"PRIu64" (%.1f per frame, "
+	               "%.1f KiB per frame)",
+			stats->texture_uploads,
+			(double)stats->texture_uploads / frames,
+			(double)stats->texture_upload_bytes / frames / 1024.0);
+	blog(LOG_INFO, "\trender target switches: %"PRIu64" (%.1f per frame)",
+			stats->render_target_switches,
+			(double)stats->render_target_switches / frames);
+	blog(LOG_INFO, "\tclears:                 %"PRIu64, stats->clears);
+	blog(LOG_INFO, "\ttexture copies:         %"PRIu64,
+			stats->texture_copies);
+	blog(LOG_INFO, "\tstage copies:           %"PRIu64,
+			stats->stage_copies);
+	blog(LOG_INFO, "\tpresents:               %"PRIu64,
+			stats->presents);
+}
+
+void device_destroy(gs_device_t *device)
+{
+	if (device) {
+		log_stats(&device->stats);
+
+		da_free(device->proj_stack);
+		bfree(device);
+	}
+}
+
+void device_enter_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_leave_context(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+void device_get_stats(const gs_device_t *device,
+		struct gs_device_stats *stats)
+{
+	*stats = device->stats;
+}
+
+gs_swapchain_t *device_swapchain_create(gs_device_t *device,
+		const struct gs_init_data *info)
+{
+	struct gs_swap_chain *swap = bzalloc(sizeof(struct gs_swap_chain));
+
+	swap->device = device;
+	swap->info   = *info;
+	return swap;
+}
+
+void gs_swapchain_destroy(gs_swapchain_t *swapchain)
+{
+	if (!swapchain)
+		return;
+
+	if (swapchain->device->cur_swap == swapchain)
+		device_load_swapchain(swapchain->device, NULL);
+
+	bfree(swapchain);
+}
+
+void device_resize(gs_device_t *device, uint32_t cx, uint32_t cy)
+{
+	if (device->cur_swap) {
+		device->cur_swap->info.cx = cx;
+		device->cur_swap->info.cy = cy;
+	} else {
+		blog(LOG_WARNING, "device_resize (null): No active swap");
+	}
+}
+
+void device_get_size(const gs_device_t *device, uint32_t *cx, uint32_t *cy)
+{
+	if (device->cur_swap) {
+		*cx = device->cur_swap->info.cx;
+		*cy = device->cur_swap->info.cy;
+	} else {
+		*cx = 0;
+		*cy = 0;
+	}
+}
+
+uint32_t device_get_width(const gs_device_t *device)
+{
+	return device->cur_swap ? device->cur_swap->info.cx : 0;
+}
+
+uint32_t device_get_height(const gs_device_t *device)
+{
+	return device->cur_swap ? device->cur_swap->info.cy : 0;
+}
+
+void device_load_swapchain(gs_device_t *device, gs_swapchain_t *swap)
+{
+	device->cur_swap = swap;
+}
+
+void device_present(gs_device_t *device)
+{
+	device->stats.presents++;
+}
+
+void device_flush(gs_device_t *device)
+{
+	device->stats.frames++;
+}
+
+enum gs_texture_type device_get_texture_type(const gs_texture_t *texture)
+{
+	return texture->type;
+}
+
+void null_texture_release_refs(gs_device_t *device, gs_texture_t *tex)
+{
+	if (device->cur_render_target == tex)
+		device->cur_render_target = NULL;
+
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++) {
+		if (device->cur_textures[i] == tex)
+			device->cur_textures[i] = NULL;
+	}
+}
+
+void device_load_texture(gs_device_t *device, gs_texture_t *tex, int unit)
+{
+	if (unit < 0 || unit >= GS_MAX_TEXTURES)
+		return;
+
+	device->cur_textures[unit] = tex;
+}
+
+void device_load_samplerstate(gs_device_t *device,
+		gs_samplerstate_t *samplerstate, int unit)
+{
+	if (unit < 0 || unit >= GS_MAX_TEXTURES)
+		return;
+
+	device->cur_samplers[unit] = samplerstate;
+}
+
+void device_load_default_samplerstate(gs_device_t *device, bool b_3d,
+		int unit)
+{
+	/* nothing is sampled, the default state is no state */
+	UNUSED_PARAMETER(b_3d);
+	device_load_samplerstate(device, NULL, unit);
+}
+
+void device_load_vertexbuffer(gs_device_t *device, gs_vertbuffer_t *vb)
+{
+	device->cur_vertex_buffer = vb;
+}
+
+void device_load_indexbuffer(gs_device_t *device, gs_indexbuffer_t *ib)
+{
+	device->cur_index_buffer = ib;
+}
+
+void device_load_vertexshader(gs_device_t *device, gs_shader_t *vertshader)
+{
+	if (vertshader && vertshader->type != GS_SHADER_VERTEX) {
+		blog(LOG_ERROR, "Specified shader is not a vertex shader");
+		return;
+	}
+
+	device->cur_vertex_shader = vertshader;
+}
+
+void device_load_pixelshader(gs_device_t *device, gs_shader_t *pixelshader)
+{
+	if (pixelshader && pixelshader->type != GS_SHADER_PIXEL) {
+		blog(LOG_ERROR, "Specified shader is not a pixel shader");
+		return;
+	}
+
+	device->cur_pixel_shader = pixelshader;
+}
+
+gs_shader_t *device_get_vertex_shader(const gs_device_t *device)
+{
+	return device->cur_vertex_shader;
+}
+
+gs_shader_t *device_get_pixel_shader(const gs_device_t *device)
+{
+	return device->cur_pixel_shader;
+}
+
+gs_texture_t *device_get_render_target(const gs_device_t *device)
+{
+	return device->cur_render_target;
+}
+
+gs_zstencil_t *device_get_zstencil_target(const gs_device_t *device)
+{
+	return device->cur_zstencil_buffer;
+}
+
+static void set_target(gs_device_t *device, gs_texture_t *tex, int side,
+		gs_zstencil_t *zs)
+{
+	if (device->cur_render_target   == tex &&
+	    device->cur_render_side     == side &&
+	    device->cur_zstencil_buffer == zs)
+		return;
+
+	device->cur_render_target   = tex;
+	device->cur_render_side     = side;
+	device->cur_zstencil_buffer = zs;
+	device->stats.render_target_switches++;
+}
+
+void device_set_render_target(gs_device_t *device, gs_texture_t *tex,
+		gs_zstencil_t *zstencil)
+{
+	if (tex) {
+		if (tex->type != GS_TEXTURE_2D) {
+			blog(LOG_ERROR, "device_set_render_target (null): "
+			                "texture is not a 2D texture");
+			return;
+		}
+		if (!tex->is_render_target) {
+			blog(LOG_ERROR, "device_set_render_target (null): "
+			                "texture is not a render target");
+			return;
+		}
+	}
+
+	set_target(device, tex, 0, zstencil);
+}
+
+void device_set_cube_render_target(gs_device_t *device, gs_texture_t *cubetex,
+		int side, gs_zstencil_t *zstencil)
+{
+	if (cubetex) {
+		if (cubetex->type != GS_TEXTURE_CUBE) {
+			blog(LOG_ERROR, "device_set_cube_render_target (null): "
+			                "texture is not a cube texture");
+			return;
+		}
+		if (!cubetex->is_render_target) {
+			blog(LOG_ERROR, "device_set_cube_render_target (null): "
+			                "texture is not a render target");
+			return;
+		}
+	}
+
+	set_target(device, cubetex, side, zstencil);
+}
+
+void device_copy_texture_region(gs_device_t *device,
+		gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y,
+		gs_texture_t *src, uint32_t src_x, uint32_t src_y,
+		uint32_t src_w, uint32_t src_h)
+{
+	uint32_t bytes_pp;
+
+	if (!src || !dst || !src->data || !dst->data) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+		                "invalid 2D texture");
+		return;
+	}
+	if (src->format != dst->format) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+		                "source and destination formats do not match");
+		return;
+	}
+
+	if (src_w == 0)
+		src_w = src->width - src_x;
+	if (src_h == 0)
+		src_h = src->height - src_y;
+
+	if (src_x + src_w > src->width  || src_y + src_h > src->height ||
+	    dst_x + src_w > dst->width  || dst_y + src_h > dst->height) {
+		blog(LOG_ERROR, "device_copy_texture_region (null): "
+		                "region is out of bounds");
+		return;
+	}
+
+	bytes_pp = gs_get_format_bpp(src->format) / 8;
+
+	for (uint32_t y = 0; y < src_h; y++) {
+		const uint8_t *in = src->data + (src_y + y) * src->linesize +
+			src_x * bytes_pp;
+		uint8_t *out = dst->data + (dst_y + y) * dst->linesize +
+			dst_x * bytes_pp;
+
+		memcpy(out, in, src_w * bytes_pp);
+	}
+
+	device->stats.texture_copies++;
+}
+
+void device_copy_texture(gs_device_t *device, gs_texture_t *dst,
+		gs_texture_t *src)
+{
+	device_copy_texture_region(device, dst, 0, 0, src, 0, 0, 0, 0);
+}
+
+void device_stage_texture(gs_device_t *device, gs_stagesurf_t *dst,
+		gs_texture_t *src)
+{
+	uint32_t row_size;
+
+	if (!src || !src->data || src->type != GS_TEXTURE_2D) {
+		blog(LOG_ERROR, "device_stage_texture (null): "
+		                "Source is not a 2D texture");
+		return;
+	}
+	if (src->format != dst->format ||
+	    src->width  != dst->width ||
+	    src->height != dst->height) {
+		blog(LOG_ERROR, "device_stage_texture (null): "
+		                "Source and destination do not match");
+		return;
+	}
+
+	row_size = src->linesize < dst->linesize ?
+		src->linesize : dst->linesize;
+
+	for (uint32_t y = 0; y < src->height; y++)
+		memcpy(dst->data + y * dst->linesize,
+				src->data + y * src->linesize, row_size);
+
+	device->stats.stage_copies++;
+}
+
+void device_begin_scene(gs_device_t *device)
+{
+	for (size_t i = 0; i < GS_MAX_TEXTURES; i++)
+		device->cur_textures[i] = NULL;
+}
+
+void device_end_scene(gs_device_t *device)
+{
+	UNUSED_PARAMETER(device);
+}
+
+static inline bool can_render(const gs_device_t *device)
+{
+	if (!device->cur_vertex_shader) {
+		blog(LOG_ERROR, "No vertex shader specified");
+		return false;
+	}
+
+	if (!device->cur_pixel_shader) {
+		blog(LOG_ERROR, "No pixel shader specified");
+		return false;
+	}
+
+	if (!device->cur_vertex_buffer) {
+		blog(LOG_ERROR, "No vertex buffer specified");
+		return false;
+	}
+
+	return true;
+}
+
+void device_draw(gs_device_t *device, enum gs_draw_mode draw_mode,
+		uint32_t start_vert, uint32_t num_verts)
+{
+	struct gs_index_buffer *ib = device->cur_index_buffer;
+
+	UNUSED_PARAMETER(draw_mode);
+	UNUSED_PARAMETER(start_vert);
+
+	if (!can_render(device)) {
+		blog(LOG_ERROR, "device_draw (null) failed");
+		return;
+	}
+
+	if (!num_verts)
+		num_verts = ib ? (uint32_t)ib->num :
+			(uint32_t)device->cur_vertex_buffer->data->num;
+
+	device->stats.draw_calls++;
+	device->stats.vertices += num_verts;
+}
+
+static inline uint8_t color_to_byte(float val)
+{
+	if (val <= 0.0f)
+		return 0;
+	if (val >= 1.0f)
+		return 255;
+	return (uint8_t)(val * 255.0f + 0.5f);
+}
+
+static void clear_target(gs_texture_t *tex, const struct vec4 *color)
+{
+	uint8_t r = color_to_byte(color->x);
+	uint8_t g = color_to_byte(color->y);
+	uint8_t b = color_to_byte(color->z);
+	uint8_t a = color_to_byte(color->w);
+	uint8_t pixel[4];
+
+	if (tex->format == GS_RGBA) {
+		pixel[0] = r; pixel[1] = g; pixel[2] = b; pixel[3] = a;
+	} else if (tex->format == GS_BGRA || tex->format == GS_BGRX) {
+		pixel[0] = b; pixel[1] = g; pixel[2] = r; pixel[3] = a;
+	} else {
+		/* only 8 bit per channel formats are filled in */
+		memset(tex->data, 0, tex->linesize * tex->height);
+		return;
+	}
+
+	for (uint32_t y = 0; y < tex->height; y++) {
+		uint8_t *row = tex->data + y * tex->linesize;
+
+		for (uint32_t x = 0; x < tex->width; x++)
+			memcpy(row + x * 4, pixel, 4);
+	}
+}
+
+void device_clear(gs_device_t *device, uint32_t clear_flags,
+		const struct vec4 *color, float depth, uint8_t stencil)
+{
+	gs_texture_t *tex = device->cur_render_target;
+
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(stencil);
+
+	if ((clear_flags & GS_CLEAR_COLOR) != 0 && tex && tex->data)
+		clear_target(tex, color);
+
+	device->stats.clears++;
+}
+
+void device_set_cull_mode(gs_device_t *device, enum gs_cull_mode mode)
+{
+	device->cur_cull_mode = mode;
+}
+
+enum gs_cull_mode device_get_cull_mode(const gs_device_t *device)
+{
+	return device->cur_cull_mode;
+}
+
+void device_enable_blending(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_depth_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_test(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_stencil_write(gs_device_t *device, bool enable)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(enable);
+}
+
+void device_enable_color(gs_device_t *device, bool red, bool green,
+		bool blue, bool alpha)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(red);
+	UNUSED_PARAMETER(green);
+	UNUSED_PARAMETER(blue);
+	UNUSED_PARAMETER(alpha);
+}
+
+void device_blend_function(gs_device_t *device, enum gs_blend_type src,
+		enum gs_blend_type dest)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(src);
+	UNUSED_PARAMETER(dest);
+}
+
+void device_blend_function_separate(gs_device_t *device,
+		enum gs_blend_type src_c, enum gs_blend_type dest_c,
+		enum gs_blend_type src_a, enum gs_blend_type dest_a)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(src_c);
+	UNUSED_PARAMETER(dest_c);
+	UNUSED_PARAMETER(src_a);
+	UNUSED_PARAMETER(dest_a);
+}
+
+void device_depth_function(gs_device_t *device, enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_function(gs_device_t *device, enum gs_stencil_side side,
+		enum gs_depth_test test)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(test);
+}
+
+void device_stencil_op(gs_device_t *device, enum gs_stencil_side side,
+		enum gs_stencil_op_type fail, enum gs_stencil_op_type zfail,
+		enum gs_stencil_op_type zpass)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(side);
+	UNUSED_PARAMETER(fail);
+	UNUSED_PARAMETER(zfail);
+	UNUSED_PARAMETER(zpass);
+}
+
+void device_set_viewport(gs_device_t *device, int x, int y, int width,
+		int height)
+{
+	device->cur_viewport.x  = x;
+	device->cur_viewport.y  = y;
+	device->cur_viewport.cx = width;
+	device->cur_viewport.cy = height;
+}
+
+void device_get_viewport(const gs_device_t *device, struct gs_rect *rect)
+{
+	*rect = device->cur_viewport;
+}
+
+void device_set_scissor_rect(gs_device_t *device, const struct gs_rect *rect)
+{
+	UNUSED_PARAMETER(device);
+	UNUSED_PARAMETER(rect);
+}
+
+void device_ortho(gs_device_t *device, float left, float right,
+		float top, float bottom, float near, float far)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml = right-left;
+	float bmt = bottom-top;
+	float fmn = far-near;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x =         2.0f /  rml;
+	dst->t.x = (left+right) / -rml;
+
+	dst->y.y =         2.0f / -bmt;
+	dst->t.y = (bottom+top) /  bmt;
+
+	dst->z.z =        -2.0f /  fmn;
+	dst->t.z =   (far+near) / -fmn;
+
+	dst->t.w = 1.0f;
+}
+
+void device_frustum(gs_device_t *device, float left, float right,
+		float top, float bottom, float near, float far)
+{
+	struct matrix4 *dst = &device->cur_proj;
+
+	float rml    = right-left;
+	float tmb    = top-bottom;
+	float nmf    = near-far;
+	float nearx2 = 2.0f*near;
+
+	vec4_zero(&dst->x);
+	vec4_zero(&dst->y);
+	vec4_zero(&dst->z);
+	vec4_zero(&dst->t);
+
+	dst->x.x =            nearx2 / rml;
+	dst->z.x =      (left+right) / rml;
+
+	dst->y.y =            nearx2 / tmb;
+	dst->z.y =      (bottom+top) / tmb;
+
+	dst->z.z =        (far+near) / nmf;
+	dst->t.z = 2.0f * (near*far) / nmf;
+
+	dst->z.w = -1.0f;
+}
+
+void device_projection_push(gs_device_t *device)
+{
+	da_push_back(device->proj_stack, &device->cur_proj);
+}
+
+void device_projection_pop(gs_device_t *device)
+{
+	struct matrix4 *end;
+	if (!device->proj_stack.num)
+		return;
+
+	end = da_end(device->proj_stack);
+	device->cur_proj = *end;
+	da_pop_back(device->proj_stack);
+}
+
+#ifdef _WIN32
+/* GDI and shared textures are Direct3D features, the null device has
+ * neither, but libobs requires these to be exported on windows */
+EXPORT bool device_gdi_texture_available(void)
+{
+	return false;
+}
+
+EXPORT bool device_shared_texture_available(void)
+{
+	return false;
+}
+#endif
@@ -22,6 +22,9 @@
 #include <graphics/vec4.h>
 #include <graphics/matrix3.h>
 #include <graphics/matrix4.h>
+#include <graphics/hash.h>
+#include <util/file-serializer.h>
+#include <util/platform.h>
 #include "gl-subsystem.h"
 #include "gl-shaderparser.h"
 
@@ -187,6 +190,11 @@ static inline bool gl_process_attribs(struct gs_shader *shader,
 	return true;
 }
 
+static inline uint64_t hash_string(uint64_t hash, const char *str)
+{
+	return str ? gs_hash_data(hash, str, strlen(str)) : hash;
+}
+
 static bool gl_shader_init(struct gs_shader *shader,
 		struct gl_shader_parser *glsp,
 		const char *file, char **error_string)
@@ -199,6 +207,9 @@ static bool gl_shader_init(struct gs_shader *shader,
 	if (!gl_success("glCreateShader") || !shader->obj)
 		return false;
 
+	shader->hash = hash_string(GS_HASH_INIT,
+			glsp->gl_string.array);
+
 	glShaderSource(shader->obj, 1, (const GLchar**)&glsp->gl_string.array,
 			0);
 	if (!gl_success("glShaderSource"))
@@ -596,38 +607,200 @@ static inline bool assign_program_params(struct gs_program *program)
 	return true;
 }
 
-struct gs_program *gs_program_create(struct gs_device *device)
+/* linked programs are kept in the program cache directory, keyed by the
+ * text of both shaders and by the driver that linked them */
+#define PROGRAM_CACHE_MAGIC   0x5047424FU /* "OBGP" */
+#define PROGRAM_CACHE_VERSION 1
+
+#define PROGRAM_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+struct program_cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t driver;
+	uint64_t vertex_shader;
+	uint64_t pixel_shader;
+	uint32_t format;
+	uint32_t size;
+};
+
+static void get_program_cache_header(struct gs_program *program,
+		struct program_cache_header *header)
 {
-	struct gs_program *program = bzalloc(sizeof(*program));
-	int linked = false;
+	memset(header, 0, sizeof(*header));
+	header->magic         = PROGRAM_CACHE_MAGIC;
+	header->version       = PROGRAM_CACHE_VERSION;
+	header->driver        = program->device->program_cache_driver;
+	header->vertex_shader = program->vertex_shader->hash;
+	header->pixel_shader  = program->pixel_shader->hash;
+}
 
-	program->device        = device;
-	program->vertex_shader = device->cur_vertex_shader;
-	program->pixel_shader  = device->cur_pixel_shader;
+static void get_program_cache_file(struct gs_program *program,
+		const struct program_cache_header *header, struct dstr *path)
+{
+	uint64_t hash = gs_hash_data(header->driver, &header->vertex_shader,
+			sizeof(header->vertex_shader));
+	hash = gs_hash_data(hash, &header->pixel_shader,
+			sizeof(header->pixel_shader));
 
-	program->obj = glCreateProgram();
-	if (!gl_success("glCreateProgram"))
-		goto error_detach_neither;
+	dstr_copy(path, program->device->program_cache_path);
+	if (!dstr_is_empty(path) && dstr_end(path) != '/')
+		dstr_cat_ch(path, '/');
+	dstr_catf(path, "%016llx.gl-program", (unsigned long long)hash);
+}
+
+static bool load_program_binary(struct gs_program *program)
+{
+	struct program_cache_header expected;
+	struct program_cache_header header;
+	struct dstr path = {0};
+	struct serializer s;
+	uint8_t *data = NULL;
+	int linked = GL_FALSE;
+
+	if (!program->device->program_cache_path)
+		return false;
+
+	get_program_cache_header(program, &expected);
+	get_program_cache_file(program, &expected, &path);
+
+	if (!file_input_serializer_init(&s, path.array))
+		goto exit;
+
+	if (s_read(&s, &header, sizeof(header)) != sizeof(header))
+		goto exit_close;
+
+	expected.format = header.format;
+	expected.size = header.size;
+	if (memcmp(&header, &expected, sizeof(header)) != 0 ||
+	    !header.size || header.size > PROGRAM_CACHE_MAX_SIZE)
+		goto exit_close;
+
+	data = bmalloc(header.size);
+	if (s_read(&s, data, header.size) != header.size)
+		goto exit_close;
+
+	glProgramBinary(program->obj, header.format, data, header.size);
+	if (!gl_success("glProgramBinary"))
+		goto exit_close;
+
+	glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
+	if (!gl_success("glGetProgramiv"))
+		linked = GL_FALSE;
+
+	/* the driver can refuse binaries it created, for example after an
+	 * update that kept the same version string */
+	if (linked == GL_FALSE)
+		blog(LOG_DEBUG, "load_program_binary: Driver rejected '%s'",
+				path.array);
+
+exit_close:
+	file_input_serializer_free(&s);
+exit:
+	bfree(data);
+	dstr_free(&path);
+	return linked == GL_TRUE;
+}
+
+static void save_program_binary(struct gs_program *program)
+{
+	struct program_cache_header header;
+	struct dstr path = {0};
+	struct serializer s;
+	uint8_t *data = NULL;
+	GLint size = 0;
+	GLenum format = 0;
+
+	if (!program->device->program_cache_path)
+		return;
+
+	glGetProgramiv(program->obj, GL_PROGRAM_BINARY_LENGTH, &size);
+	if (!gl_success("glGetProgramiv") || size <= 0 ||
+	    size > PROGRAM_CACHE_MAX_SIZE)
+		return;
+
+	data = bmalloc(size);
+	glGetProgramBinary(program->obj, size, &size, &format, data);
+	if (!gl_success("glGetProgramBinary") || size <= 0)
+		goto exit;
+
+	get_program_cache_header(program, &header);
+	get_program_cache_file(program, &header, &path);
+	header.format = (uint32_t)format;
+	header.size = (uint32_t)size;
+
+	if (!file_output_serializer_init_safe(&s, path.array, "tmp")) {
+		blog(LOG_DEBUG, "save_program_binary: Could not write '%s'",
+				path.array);
+		goto exit;
+	}
+
+	s_write(&s, &header, sizeof(header));
+	s_write(&s, data, size);
+	file_output_serializer_free(&s);
+
+exit:
+	bfree(data);
+	dstr_free(&path);
+}
+
+static bool link_program(struct gs_program *program)
+{
+	int linked = false;
 
 	glAttachShader(program->obj, program->vertex_shader->obj);
 	if (!gl_success("glAttachShader (vertex)"))
-		goto error_detach_neither;
+		return false;
 
 	glAttachShader(program->obj, program->pixel_shader->obj);
 	if (!gl_success("glAttachShader (pixel)"))
-		goto error_detach_vertex;
+		goto detach_vertex;
+
+	if (program->device->program_cache_path) {
+		glProgramParameteri(program->obj,
+				GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		gl_success("glProgramParameteri");
+	}
 
 	glLinkProgram(program->obj);
 	if (!gl_success("glLinkProgram"))
-		goto error;
+		goto detach_pixel;
 
 	glGetProgramiv(program->obj, GL_LINK_STATUS, &linked);
 	if (!gl_success("glGetProgramiv"))
-		goto error;
+		linked = GL_FALSE;
 
-	if (linked == GL_FALSE) {
+	if (linked == GL_FALSE)
 		print_link_errors(program->obj);
+
+detach_pixel:
+	glDetachShader(program->obj, program->pixel_shader->obj);
+	gl_success("glDetachShader (pixel)");
+
+detach_vertex:
+	glDetachShader(program->obj, program->vertex_shader->obj);
+	gl_success("glDetachShader (vertex)");
+
+	return linked == GL_TRUE;
+}
+
+struct gs_program *gs_program_create(struct gs_device *device)
+{
+	struct gs_program *program = bzalloc(sizeof(*program));
+
+	program->device        = device;
+	program->vertex_shader = device->cur_vertex_shader;
+	program->pixel_shader  = device->cur_pixel_shader;
+
+	program->obj = glCreateProgram();
+	if (!gl_success("glCreateProgram"))
 		goto error;
+
+	if (!load_program_binary(program)) {
+		if (!link_program(program))
+			goto error;
+
+		save_program_binary(program);
 	}
 
 	if (!assign_program_attribs(program))
@@ -635,12 +808,6 @@ struct gs_program *gs_program_create(struct gs_device *device)
 	if (!assign_program_params(program))
 		goto error;
 
-	glDetachShader(program->obj, program->vertex_shader->obj);
-	gl_success("glDetachShader (vertex)");
-
-	glDetachShader(program->obj, program->pixel_shader->obj);
-	gl_success("glDetachShader (pixel)");
-
 	program->next = device->first_program;
 	program->prev_next = &device->first_program;
 	device->first_program = program;
@@ -650,18 +817,37 @@ struct gs_program *gs_program_create(struct gs_device *device)
 	return program;
 
 error:
-	glDetachShader(program->obj, program->pixel_shader->obj);
-	gl_success("glDetachShader (pixel)");
-
-error_detach_vertex:
-	glDetachShader(program->obj, program->vertex_shader->obj);
-	gl_success("glDetachShader (vertex)");
-
-error_detach_neither:
 	gs_program_destroy(program);
 	return NULL;
 }
 
+void device_set_program_cache_path(gs_device_t *device, const char *path)
+{
+	GLint formats = 0;
+	uint64_t driver;
+
+	bfree(device->program_cache_path);
+	device->program_cache_path = NULL;
+
+	if (!path || (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary))
+		return;
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (!gl_success("glGetIntegerv") || formats <= 0) {
+		blog(LOG_DEBUG, "device_set_program_cache_path (GL): "
+		                "Driver does not support program binaries");
+		return;
+	}
+
+	driver = hash_string(GS_HASH_INIT,
+			(const char*)glGetString(GL_VENDOR));
+	driver = hash_string(driver, (const char*)glGetString(GL_RENDERER));
+	driver = hash_string(driver, (const char*)glGetString(GL_VERSION));
+
+	device->program_cache_driver = driver;
+	device->program_cache_path = bstrdup(path);
+}
+
 void gs_program_destroy(struct gs_program *program)
 {
 	if (!program)
@@ -258,6 +258,7 @@ void device_destroy(gs_device_t *device)
 
 		da_free(device->proj_stack);
 		da_free(device->fbos);
+		bfree(device->program_cache_path);
 		gl_platform_destroy(device->plat);
 		bfree(device);
 	}
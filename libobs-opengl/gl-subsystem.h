@@ -331,6 +331,7 @@ struct gs_shader {
 	gs_device_t          *device;
 	enum gs_shader_type  type;
 	GLuint               obj;
+	uint64_t             hash;
 
 	struct gs_shader_param  *viewproj;
 	struct gs_shader_param  *world;
@@ -503,6 +504,9 @@ struct gs_device {
 
 	DARRAY(struct fbo_info*) fbos;
 	struct fbo_info          *cur_fbo;
+
+	char                     *program_cache_path;
+	uint64_t                 program_cache_driver;
 };
 
 extern struct fbo_info *get_fbo(struct gs_device *device,
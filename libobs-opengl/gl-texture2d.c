@@ -226,6 +226,42 @@ failed:
 	blog(LOG_ERROR, "gs_texture_unmap (GL) failed");
 }
 
+void gs_texture_set_image_rect(gs_texture_t *tex, const uint8_t *data,
+		uint32_t linesize, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d*)tex;
+	uint32_t bytes_per_pixel;
+	bool success;
+
+	if (!is_texture_2d(tex, "gs_texture_set_image_rect"))
+		goto fail;
+
+	bytes_per_pixel = gs_get_format_bpp(tex->format) / 8;
+	if (!bytes_per_pixel || gs_is_compressed_format(tex->format))
+		goto fail;
+
+	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0))
+		goto fail;
+	if (!gl_bind_texture(tex2d->base.gl_target, tex2d->base.texture))
+		goto fail;
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize / bytes_per_pixel);
+	glTexSubImage2D(tex2d->base.gl_target, 0, x, y, cx, cy,
+			tex->gl_format, tex->gl_type,
+			data + y * linesize + x * bytes_per_pixel);
+	success = gl_success("glTexSubImage2D");
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+	gl_bind_texture(tex2d->base.gl_target, 0);
+
+	if (success)
+		return;
+
+fail:
+	blog(LOG_ERROR, "gs_texture_set_image_rect (GL) failed");
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	const struct gs_texture_2d *tex2d = (const struct gs_texture_2d*)tex;
@@ -111,6 +111,10 @@ EXPORT void device_clear(gs_device_t *device, uint32_t clear_flags,
 		const struct vec4 *color, float depth, uint8_t stencil);
 EXPORT void device_present(gs_device_t *device);
 EXPORT void device_flush(gs_device_t *device);
+EXPORT void device_get_stats(const gs_device_t *device,
+		struct gs_device_stats *stats);
+EXPORT void device_set_program_cache_path(gs_device_t *device,
+		const char *path);
 EXPORT void device_set_cull_mode(gs_device_t *device, enum gs_cull_mode mode);
 EXPORT enum gs_cull_mode device_get_cull_mode(const gs_device_t *device);
 EXPORT void device_enable_blending(gs_device_t *device, bool enable);
@@ -0,0 +1,466 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "../util/platform.h"
+#include "../util/file-serializer.h"
+#include "effect-cache.h"
+#include "hash.h"
+#include "effect.h"
+
+/* bump whenever the entry layout or the shader text generated by the effect
+ * parser changes */
+#define EFFECT_CACHE_MAGIC   0x4546424FU /* "OBFE" */
+#define EFFECT_CACHE_VERSION 1
+
+#define EFFECT_CACHE_MAX_STRING (16 * 1024 * 1024)
+
+extern const char *gs_preprocessor_name(void);
+
+static inline uint64_t hash_string(const char *str)
+{
+	return gs_hash_data(GS_HASH_INIT, str, strlen(str));
+}
+
+static uint64_t hash_file(const char *path)
+{
+	char *data = os_quick_read_utf8_file(path);
+	uint64_t hash;
+
+	if (!data)
+		return 0;
+
+	hash = hash_string(data);
+	bfree(data);
+	return hash;
+}
+
+/* the shader text depends on what the graphics module defines for the
+ * preprocessor, so entries from another module are never used */
+static void get_backend_name(struct dstr *name)
+{
+	const char *device_name = gs_get_device_name();
+	const char *preprocessor_name = gs_preprocessor_name();
+
+	dstr_copy(name, device_name ? device_name : "");
+	dstr_cat_ch(name, ':');
+	dstr_cat(name, preprocessor_name ? preprocessor_name : "");
+}
+
+static void get_entry_path(struct dstr *path, const char *cache_path,
+		const char *file, const char *backend)
+{
+	uint64_t hash = hash_string(file);
+	hash = gs_hash_data(hash, backend, strlen(backend));
+
+	dstr_copy(path, cache_path);
+	if (!dstr_is_empty(path) && dstr_end(path) != '/')
+		dstr_cat_ch(path, '/');
+	dstr_catf(path, "%016llx.effect-cache", (unsigned long long)hash);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline void write_str(struct serializer *s, const char *str)
+{
+	size_t len = str ? strlen(str) : 0;
+
+	s_wl32(s, (uint32_t)len);
+	s_write(s, str, len);
+}
+
+static inline void write_data(struct serializer *s, const void *data,
+		size_t size)
+{
+	s_wl32(s, (uint32_t)size);
+	s_write(s, data, size);
+}
+
+static void write_pass_params(struct serializer *s,
+		const struct darray *pass_params)
+{
+	const struct pass_shaderparam *params = pass_params->array;
+
+	s_wl32(s, (uint32_t)pass_params->num);
+	for (size_t i = 0; i < pass_params->num; i++)
+		write_str(s, params[i].eparam ? params[i].eparam->name : NULL);
+}
+
+static void write_pass(struct serializer *s, const struct gs_effect_pass *pass,
+		const struct ep_pass *pass_in)
+{
+	write_str(s, pass->name);
+	write_str(s, pass_in->vertex_string.array);
+	write_pass_params(s, &pass->vertshader_params.da);
+	write_str(s, pass_in->fragment_string.array);
+	write_pass_params(s, &pass->pixelshader_params.da);
+}
+
+static void write_technique(struct serializer *s,
+		const struct gs_effect_technique *tech,
+		const struct ep_technique *tech_in)
+{
+	write_str(s, tech->name);
+
+	s_wl32(s, (uint32_t)tech->passes.num);
+	for (size_t i = 0; i < tech->passes.num; i++)
+		write_pass(s, tech->passes.array + i,
+				tech_in->passes.array + i);
+}
+
+bool effect_cache_save(const struct effect_parser *ep,
+		const char *cache_path, const char *effect_string,
+		const char *file)
+{
+	const struct cf_preprocessor *pp = &ep->cfp.pp;
+	const gs_effect_t *effect = ep->effect;
+	struct dstr backend = {0};
+	struct dstr path = {0};
+	struct serializer s;
+	bool success;
+
+	get_backend_name(&backend);
+	get_entry_path(&path, cache_path, file, backend.array);
+
+	success = file_output_serializer_init_safe(&s, path.array, "tmp");
+	if (!success) {
+		blog(LOG_DEBUG, "effect_cache_save: Could not write '%s'",
+				path.array);
+		goto exit;
+	}
+
+	s_wl32(&s, EFFECT_CACHE_MAGIC);
+	s_wl32(&s, EFFECT_CACHE_VERSION);
+	write_str(&s, backend.array);
+	s_wl64(&s, hash_string(effect_string));
+
+	s_wl32(&s, (uint32_t)pp->dependencies.num);
+	for (size_t i = 0; i < pp->dependencies.num; i++) {
+		const char *dep = pp->dependencies.array[i].file;
+		write_str(&s, dep);
+		s_wl64(&s, hash_file(dep));
+	}
+
+	s_wl32(&s, (uint32_t)effect->params.num);
+	for (size_t i = 0; i < effect->params.num; i++) {
+		const struct gs_effect_param *param = effect->params.array + i;
+
+		write_str(&s, param->name);
+		s_wl32(&s, (uint32_t)param->type);
+		write_data(&s, param->default_val.array,
+				param->default_val.num);
+	}
+
+	s_wl32(&s, (uint32_t)effect->techniques.num);
+	for (size_t i = 0; i < effect->techniques.num; i++)
+		write_technique(&s, effect->techniques.array + i,
+				ep->techniques.array + i);
+
+	file_output_serializer_free(&s);
+
+exit:
+	dstr_free(&backend);
+	dstr_free(&path);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline bool read_u32(struct serializer *s, uint32_t *val)
+{
+	uint8_t data[4];
+
+	if (s_read(s, data, sizeof(data)) != sizeof(data))
+		return false;
+
+	*val = (uint32_t)data[0]         | ((uint32_t)data[1] << 8) |
+	       ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+	return true;
+}
+
+static inline bool read_u64(struct serializer *s, uint64_t *val)
+{
+	uint32_t low, high;
+
+	if (!read_u32(s, &low) || !read_u32(s, &high))
+		return false;
+
+	*val = (uint64_t)low | ((uint64_t)high << 32);
+	return true;
+}
+
+static bool read_data(struct serializer *s, struct darray *data)
+{
+	uint32_t size;
+
+	if (!read_u32(s, &size) || size > EFFECT_CACHE_MAX_STRING)
+		return false;
+
+	darray_resize(1, data, size);
+	return s_read(s, data->array, size) == size;
+}
+
+static bool read_str(struct serializer *s, struct dstr *str)
+{
+	uint32_t len;
+
+	if (!read_u32(s, &len) || len > EFFECT_CACHE_MAX_STRING)
+		return false;
+
+	dstr_resize(str, len);
+	if (!len) {
+		dstr_copy(str, "");
+		return true;
+	}
+
+	return s_read(s, str->array, len) == len;
+}
+
+static bool read_header(struct serializer *s, const char *effect_string)
+{
+	struct dstr backend = {0};
+	struct dstr str = {0};
+	uint32_t magic, version, num;
+	uint64_t hash;
+	bool success = false;
+
+	if (!read_u32(s, &magic) || magic != EFFECT_CACHE_MAGIC)
+		goto exit;
+	if (!read_u32(s, &version) || version != EFFECT_CACHE_VERSION)
+		goto exit;
+
+	get_backend_name(&backend);
+	if (!read_str(s, &str) || dstr_cmp(&str, backend.array) != 0)
+		goto exit;
+
+	if (!read_u64(s, &hash) || hash != hash_string(effect_string))
+		goto exit;
+
+	if (!read_u32(s, &num))
+		goto exit;
+
+	for (uint32_t i = 0; i < num; i++) {
+		if (!read_str(s, &str) || !read_u64(s, &hash))
+			goto exit;
+		if (hash != hash_file(str.array))
+			goto exit;
+	}
+
+	success = true;
+
+exit:
+	dstr_free(&backend);
+	dstr_free(&str);
+	return success;
+}
+
+static bool read_params(struct serializer *s, gs_effect_t *effect)
+{
+	struct dstr name = {0};
+	uint32_t num;
+
+	if (!read_u32(s, &num) || num > EFFECT_CACHE_MAX_STRING)
+		return false;
+
+	da_resize(effect->params, num);
+
+	for (uint32_t i = 0; i < num; i++) {
+		struct gs_effect_param *param = effect->params.array + i;
+		uint32_t type;
+
+		if (!read_str(s, &name) || !read_u32(s, &type))
+			goto fail;
+		if (!read_data(s, &param->default_val.da))
+			goto fail;
+
+		param->name    = bstrdup(name.array);
+		param->section = EFFECT_PARAM;
+		param->effect  = effect;
+		param->type    = (enum gs_shader_param_type)type;
+
+		if (strcmp(param->name, "ViewProj") == 0)
+			effect->view_proj = param;
+		else if (strcmp(param->name, "World") == 0)
+			effect->world = param;
+	}
+
+	dstr_free(&name);
+	return true;
+
+fail:
+	dstr_free(&name);
+	return false;
+}
+
+static bool read_pass_shader(struct serializer *s,
+		struct gs_effect_technique *tech, struct gs_effect_pass *pass,
+		size_t pass_idx, enum gs_shader_type type, const char *file)
+{
+	struct darray *pass_params;
+	struct dstr shader_str = {0};
+	struct dstr location = {0};
+	struct dstr name = {0};
+	gs_shader_t *shader;
+	uint32_t num;
+	bool success = false;
+
+	if (!read_str(s, &shader_str) || !read_u32(s, &num) ||
+	    num > EFFECT_CACHE_MAX_STRING)
+		goto exit;
+
+	dstr_copy(&location, file);
+	dstr_catf(&location, " (%s shader, technique %s, pass %u)",
+			type == GS_SHADER_VERTEX ? "Vertex" : "Pixel",
+			tech->name, (unsigned)pass_idx);
+
+	if (type == GS_SHADER_VERTEX) {
+		pass->vertshader = gs_vertexshader_create(shader_str.array,
+				location.array, NULL);
+		shader = pass->vertshader;
+		pass_params = &pass->vertshader_params.da;
+	} else {
+		pass->pixelshader = gs_pixelshader_create(shader_str.array,
+				location.array, NULL);
+		shader = pass->pixelshader;
+		pass_params = &pass->pixelshader_params.da;
+	}
+
+	if (!shader)
+		goto exit;
+
+	darray_resize(sizeof(struct pass_shaderparam), pass_params, num);
+
+	for (uint32_t i = 0; i < num; i++) {
+		struct pass_shaderparam *param = darray_item(
+				sizeof(struct pass_shaderparam),
+				pass_params, i);
+
+		if (!read_str(s, &name))
+			goto exit;
+
+		param->eparam = gs_effect_get_param_by_name(tech->effect,
+				name.array);
+		param->sparam = gs_shader_get_param_by_name(shader,
+				name.array);
+		if (!param->sparam)
+			goto exit;
+	}
+
+	success = true;
+
+exit:
+	dstr_free(&shader_str);
+	dstr_free(&location);
+	dstr_free(&name);
+	return success;
+}
+
+static bool read_techniques(struct serializer *s, gs_effect_t *effect,
+		const char *file)
+{
+	struct dstr name = {0};
+	uint32_t num;
+
+	if (!read_u32(s, &num) || num > EFFECT_CACHE_MAX_STRING)
+		return false;
+
+	da_resize(effect->techniques, num);
+
+	for (uint32_t i = 0; i < num; i++) {
+		struct gs_effect_technique *tech = effect->techniques.array + i;
+		uint32_t num_passes;
+
+		if (!read_str(s, &name) || !read_u32(s, &num_passes) ||
+		    num_passes > EFFECT_CACHE_MAX_STRING)
+			goto fail;
+
+		tech->name    = bstrdup(name.array);
+		tech->section = EFFECT_TECHNIQUE;
+		tech->effect  = effect;
+
+		da_resize(tech->passes, num_passes);
+
+		for (uint32_t j = 0; j < num_passes; j++) {
+			struct gs_effect_pass *pass = tech->passes.array + j;
+
+			if (!read_str(s, &name))
+				goto fail;
+
+			pass->name    = bstrdup(name.array);
+			pass->section = EFFECT_PASS;
+
+			if (!read_pass_shader(s, tech, pass, j,
+						GS_SHADER_VERTEX, file))
+				goto fail;
+			if (!read_pass_shader(s, tech, pass, j,
+						GS_SHADER_PIXEL, file))
+				goto fail;
+		}
+	}
+
+	dstr_free(&name);
+	return true;
+
+fail:
+	dstr_free(&name);
+	return false;
+}
+
+static void reset_effect(gs_effect_t *effect)
+{
+	for (size_t i = 0; i < effect->params.num; i++)
+		effect_param_free(effect->params.array + i);
+	for (size_t i = 0; i < effect->techniques.num; i++)
+		effect_technique_free(effect->techniques.array + i);
+
+	da_free(effect->params);
+	da_free(effect->techniques);
+
+	effect->view_proj = NULL;
+	effect->world = NULL;
+}
+
+bool effect_cache_load(gs_effect_t *effect, const char *cache_path,
+		const char *effect_string, const char *file)
+{
+	struct dstr backend = {0};
+	struct dstr path = {0};
+	struct serializer s;
+	bool success = false;
+
+	get_backend_name(&backend);
+	get_entry_path(&path, cache_path, file, backend.array);
+
+	if (!file_input_serializer_init(&s, path.array))
+		goto exit;
+
+	success = read_header(&s, effect_string) &&
+	          read_params(&s, effect) &&
+	          read_techniques(&s, effect, file);
+
+	file_input_serializer_free(&s);
+
+	if (!success) {
+		blog(LOG_DEBUG, "effect_cache_load: Entry '%s' for '%s' is "
+		                "out of date or invalid", path.array, file);
+		reset_effect(effect);
+	}
+
+exit:
+	dstr_free(&backend);
+	dstr_free(&path);
+	return success;
+}
@@ -0,0 +1,43 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "effect-parser.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The effect cache keeps the output of the effect parser on disk: the
+ * parameters, the techniques and passes, and the shader text generated for
+ * each pass.  An entry is keyed by the effect file name and is only used if
+ * the effect text, every file it includes, and the graphics module are the
+ * same as when it was stored, so loading an entry skips the preprocessor
+ * and the parser entirely.
+ */
+
+extern bool effect_cache_load(gs_effect_t *effect, const char *cache_path,
+		const char *effect_string, const char *file);
+extern bool effect_cache_save(const struct effect_parser *ep,
+		const char *cache_path, const char *effect_string,
+		const char *file);
+
+#ifdef __cplusplus
+}
+#endif
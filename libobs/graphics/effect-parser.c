@@ -1435,6 +1435,11 @@ static inline bool ep_compile_pass_shader(struct effect_parser *ep,
 	else
 		success = false;
 
+	if (type == GS_SHADER_VERTEX)
+		dstr_move(&pass_in->vertex_string, &shader_str);
+	else if (type == GS_SHADER_PIXEL)
+		dstr_move(&pass_in->fragment_string, &shader_str);
+
 	dstr_free(&location);
 	dstr_array_free(used_params.array, used_params.num);
 	darray_free(&used_params);
@@ -163,6 +163,10 @@ struct ep_pass {
 	DARRAY(struct cf_token) vertex_program;
 	DARRAY(struct cf_token) fragment_program;
 	struct gs_effect_pass *pass;
+
+	/* generated shader text, kept for the effect cache */
+	struct dstr vertex_string;
+	struct dstr fragment_string;
 };
 
 static inline void ep_pass_init(struct ep_pass *epp)
@@ -175,6 +179,8 @@ static inline void ep_pass_free(struct ep_pass *epp)
 	bfree(epp->name);
 	da_free(epp->vertex_program);
 	da_free(epp->fragment_program);
+	dstr_free(&epp->vertex_string);
+	dstr_free(&epp->fragment_string);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -184,6 +184,70 @@ static inline void upload_parameters(struct gs_effect *effect,
 	reset_params(pshader_params);
 }
 
+void effect_upload_params(gs_effect_t *effect, bool changed_only)
+{
+	upload_parameters(effect, changed_only);
+}
+
+static void save_shader_params(const struct darray *pass_params,
+		struct darray *data)
+{
+	const struct pass_shaderparam *params = pass_params->array;
+
+	for (size_t i = 0; i < pass_params->num; i++) {
+		const struct gs_effect_param *eparam = params[i].eparam;
+		const struct darray *val = eparam->cur_val.num ?
+			&eparam->cur_val.da : &eparam->default_val.da;
+		size_t size = val->num;
+
+		darray_push_back_array(1, data, &eparam->next_sampler,
+				sizeof(eparam->next_sampler));
+		darray_push_back_array(1, data, &size, sizeof(size));
+		if (size)
+			darray_push_back_array(1, data, val->array, size);
+	}
+}
+
+static const uint8_t *load_shader_params(const struct darray *pass_params,
+		const uint8_t *data)
+{
+	const struct pass_shaderparam *params = pass_params->array;
+
+	for (size_t i = 0; i < pass_params->num; i++) {
+		gs_sparam_t *sparam = params[i].sparam;
+		gs_samplerstate_t *sampler;
+		size_t size;
+
+		memcpy(&sampler, data, sizeof(sampler));
+		data += sizeof(sampler);
+		memcpy(&size, data, sizeof(size));
+		data += sizeof(size);
+
+		if (sampler)
+			gs_shader_set_next_sampler(sparam, sampler);
+		if (size)
+			gs_shader_set_val(sparam, data, size);
+
+		data += size;
+	}
+
+	return data;
+}
+
+void effect_pass_save_params(const struct gs_effect_pass *pass,
+		struct darray *data)
+{
+	save_shader_params(&pass->vertshader_params.da, data);
+	save_shader_params(&pass->pixelshader_params.da, data);
+}
+
+void effect_pass_load_params(const struct gs_effect_pass *pass,
+		const uint8_t *data)
+{
+	data = load_shader_params(&pass->vertshader_params.da, data);
+	load_shader_params(&pass->pixelshader_params.da, data);
+}
+
 void gs_effect_update_params(gs_effect_t *effect)	
 {
 	if (effect)
@@ -253,6 +317,12 @@ void gs_technique_end_pass(gs_technique_t *tech)
 	tech->effect->cur_pass = NULL;
 }
 
+void effect_pass_clear_textures(struct gs_effect_pass *pass)
+{
+	clear_tex_params(&pass->vertshader_params.da);
+	clear_tex_params(&pass->pixelshader_params.da);
+}
+
 size_t gs_effect_get_num_params(const gs_effect_t *effect)
 {
 	return effect ? effect->params.num : 0;
@@ -332,6 +402,28 @@ static inline void effect_setval_inline(gs_eparam_t *param,
 	}
 }
 
+void *gs_effect_get_val(gs_eparam_t *param)
+{
+	void *data;
+
+	if (!param) {
+		blog(LOG_ERROR, "gs_effect_get_val: invalid param");
+		return NULL;
+	}
+
+	if (!param->cur_val.num)
+		return NULL;
+
+	data = bmalloc(param->cur_val.num);
+	memcpy(data, param->cur_val.array, param->cur_val.num);
+	return data;
+}
+
+size_t gs_effect_get_val_size(gs_eparam_t *param)
+{
+	return param ? param->cur_val.num : 0;
+}
+
 void gs_effect_set_bool(gs_eparam_t *param, bool val)
 {
 	int b_val = (int)val;
@@ -179,6 +179,13 @@ static inline void effect_free(gs_effect_t *effect)
 }
 
 EXPORT void effect_upload_params(gs_effect_t *effect, bool changed_only);
+
+/* used by sprite batching to replay the parameters of a pass later */
+EXPORT void effect_pass_save_params(const struct gs_effect_pass *pass,
+		struct darray *data);
+EXPORT void effect_pass_load_params(const struct gs_effect_pass *pass,
+		const uint8_t *data);
+EXPORT void effect_pass_clear_textures(struct gs_effect_pass *pass);
 EXPORT void effect_upload_shader_params(gs_effect_t *effect,
 		gs_shader_t *shader, struct darray *pass_params,
 		bool changed_only);
@@ -87,6 +87,8 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(device_clear);
 	GRAPHICS_IMPORT(device_present);
 	GRAPHICS_IMPORT(device_flush);
+	GRAPHICS_IMPORT_OPTIONAL(device_get_stats);
+	GRAPHICS_IMPORT_OPTIONAL(device_set_program_cache_path);
 	GRAPHICS_IMPORT(device_set_cull_mode);
 	GRAPHICS_IMPORT(device_get_cull_mode);
 	GRAPHICS_IMPORT(device_enable_blending);
@@ -115,6 +117,7 @@ bool load_graphics_imports(struct gs_exports *exports, void *module,
 	GRAPHICS_IMPORT(gs_texture_get_color_format);
 	GRAPHICS_IMPORT(gs_texture_map);
 	GRAPHICS_IMPORT(gs_texture_unmap);
+	GRAPHICS_IMPORT_OPTIONAL(gs_texture_set_image_rect);
 	GRAPHICS_IMPORT_OPTIONAL(gs_texture_is_rect);
 	GRAPHICS_IMPORT(gs_texture_get_obj);
 
@@ -113,6 +113,10 @@ struct gs_exports {
 			const struct vec4 *color, float depth, uint8_t stencil);
 	void (*device_present)(gs_device_t *device);
 	void (*device_flush)(gs_device_t *device);
+	void (*device_get_stats)(const gs_device_t *device,
+			struct gs_device_stats *stats);
+	void (*device_set_program_cache_path)(gs_device_t *device,
+			const char *path);
 	void (*device_set_cull_mode)(gs_device_t *device,
 			enum gs_cull_mode mode);
 	enum gs_cull_mode (*device_get_cull_mode)(const gs_device_t *device);
@@ -159,6 +163,9 @@ struct gs_exports {
 	bool     (*gs_texture_map)(gs_texture_t *tex, uint8_t **ptr,
 			uint32_t *linesize);
 	void     (*gs_texture_unmap)(gs_texture_t *tex);
+	void     (*gs_texture_set_image_rect)(gs_texture_t *tex,
+			const uint8_t *data, uint32_t linesize,
+			uint32_t x, uint32_t y, uint32_t cx, uint32_t cy);
 	bool     (*gs_texture_is_rect)(const gs_texture_t *tex);
 	void    *(*gs_texture_get_obj)(const gs_texture_t *tex);
 
@@ -272,6 +279,43 @@ struct blend_state {
 	enum gs_blend_type dest_a;
 };
 
+#define SPRITE_BATCH_MAX 128
+
+/* sprites drawn with the same effect pass and parameters, waiting to be
+ * submitted as a single draw.  vertices are already transformed by the world
+ * matrix they were drawn with */
+struct sprite_batch {
+	int                    depth;
+	gs_vertbuffer_t        *buffer;
+	size_t                 count;
+	struct gs_effect_pass  *pass;
+	DARRAY(uint8_t)        params;
+	DARRAY(uint8_t)        scratch;
+};
+
+/* render targets of pooled texrenders.  a pooled texrender gives its target
+ * back when it goes a whole frame without being used, and targets that stay
+ * unclaimed for TEXRENDER_POOL_MAX_IDLE frames are destroyed */
+#define TEXRENDER_POOL_MAX_IDLE 60
+
+struct texrender_pool_target {
+	gs_texture_t            *target;
+	gs_zstencil_t           *zs;
+	uint32_t                cx, cy;
+	enum gs_color_format    format;
+	enum gs_zstencil_format zsformat;
+	uint64_t                released_frame;
+};
+
+struct texrender_pool {
+	struct gs_texture_render *first_active;
+	DARRAY(struct texrender_pool_target) idle;
+	uint64_t               frame;
+	struct gs_texrender_pool_stats stats;
+};
+
+extern void texrender_pool_free(struct texrender_pool *pool);
+
 struct graphics_subsystem {
 	void                   *module;
 	gs_device_t            *device;
@@ -286,6 +330,9 @@ struct graphics_subsystem {
 	struct gs_effect       *cur_effect;
 
 	gs_vertbuffer_t        *sprite_buffer;
+	struct sprite_batch    sprite_batch;
+
+	struct texrender_pool  texrender_pool;
 
 	bool                   using_immediate;
 	struct gs_vb_data      *vbd;
@@ -297,6 +344,8 @@ struct graphics_subsystem {
 
 	pthread_mutex_t        effect_mutex;
 	struct gs_effect       *first_effect;
+	char                   *effect_cache_path;
+	struct gs_effect_cache_stats effect_cache_stats;
 
 	pthread_mutex_t        mutex;
 	volatile long          ref;
@@ -26,6 +26,7 @@
 #include "quat.h"
 #include "axisang.h"
 #include "effect-parser.h"
+#include "effect-cache.h"
 #include "effect.h"
 
 #ifdef _MSC_VER
@@ -98,6 +99,56 @@ extern void gs_free_image_deps(void);
 bool load_graphics_imports(struct gs_exports *exports, void *module,
 		const char *module_name);
 
+static void sprite_batch_submit(graphics_t *graphics)
+{
+	struct sprite_batch *batch = &graphics->sprite_batch;
+	struct gs_effect *cur_effect = graphics->cur_effect;
+	gs_device_t *device = graphics->device;
+	size_t count = batch->count;
+	gs_shader_t *vs, *ps;
+
+	/* cleared first so that nothing called from here submits again */
+	batch->count = 0;
+
+	vs = graphics->exports.device_get_vertex_shader(device);
+	ps = graphics->exports.device_get_pixel_shader(device);
+
+	graphics->exports.device_load_vertexshader(device,
+			batch->pass->vertshader);
+	graphics->exports.device_load_pixelshader(device,
+			batch->pass->pixelshader);
+	effect_pass_load_params(batch->pass, batch->params.array);
+
+	graphics->exports.gs_vertexbuffer_flush(batch->buffer);
+	graphics->exports.device_load_vertexbuffer(device, batch->buffer);
+	graphics->exports.device_load_indexbuffer(device, NULL);
+
+	/* the draw would otherwise upload pending parameters of the effect
+	 * that is currently active */
+	graphics->cur_effect = NULL;
+
+	gs_matrix_push();
+	gs_matrix_identity();
+	graphics->exports.device_draw(device, GS_TRIS, 0,
+			(uint32_t)(count * 6));
+	gs_matrix_pop();
+
+	graphics->cur_effect = cur_effect;
+
+	/* restore whatever was being set up when the batch was submitted */
+	effect_pass_clear_textures(batch->pass);
+	graphics->exports.device_load_vertexshader(device, vs);
+	graphics->exports.device_load_pixelshader(device, ps);
+	if (cur_effect && cur_effect->cur_pass)
+		effect_upload_params(cur_effect, false);
+}
+
+static inline void flush_sprite_batch(graphics_t *graphics)
+{
+	if (graphics->sprite_batch.count)
+		sprite_batch_submit(graphics);
+}
+
 static bool graphics_init_immediate_vb(struct graphics_subsystem *graphics)
 {
 	struct gs_vb_data *vbd;
@@ -144,6 +195,27 @@ static bool graphics_init_sprite_vb(struct graphics_subsystem *graphics)
 	return true;
 }
 
+static bool graphics_init_sprite_batch_vb(struct graphics_subsystem *graphics)
+{
+	struct gs_vb_data *vbd;
+	size_t num = SPRITE_BATCH_MAX * 6;
+
+	vbd = gs_vbdata_create();
+	vbd->num     = num;
+	vbd->points  = bzalloc(sizeof(struct vec3) * num);
+	vbd->num_tex = 1;
+	vbd->tvarray = bmalloc(sizeof(struct gs_tvertarray));
+	vbd->tvarray[0].width = 2;
+	vbd->tvarray[0].array = bzalloc(sizeof(struct vec2) * num);
+
+	graphics->sprite_batch.buffer = graphics->exports.
+		device_vertexbuffer_create(graphics->device, vbd, GS_DYNAMIC);
+	if (!graphics->sprite_batch.buffer)
+		return false;
+
+	return true;
+}
+
 static bool graphics_init(struct graphics_subsystem *graphics)
 {
 	struct matrix4 top_mat;
@@ -157,6 +229,8 @@ static bool graphics_init(struct graphics_subsystem *graphics)
 		return false;
 	if (!graphics_init_sprite_vb(graphics))
 		return false;
+	if (!graphics_init_sprite_batch_vb(graphics))
+		return false;
 	if (pthread_mutex_init(&graphics->mutex, NULL) != 0)
 		return false;
 	if (pthread_mutex_init(&graphics->effect_mutex, NULL) != 0)
@@ -234,8 +308,12 @@ void gs_destroy(graphics_t *graphics)
 			effect = next;
 		}
 
+		texrender_pool_free(&graphics->texrender_pool);
+
 		graphics->exports.gs_vertexbuffer_destroy(
 				graphics->sprite_buffer);
+		graphics->exports.gs_vertexbuffer_destroy(
+				graphics->sprite_batch.buffer);
 		graphics->exports.gs_vertexbuffer_destroy(
 				graphics->immediate_vertbuffer);
 		graphics->exports.device_destroy(graphics->device);
@@ -248,6 +326,9 @@ void gs_destroy(graphics_t *graphics)
 	da_free(graphics->matrix_stack);
 	da_free(graphics->viewport_stack);
 	da_free(graphics->blend_state_stack);
+	da_free(graphics->sprite_batch.params);
+	da_free(graphics->sprite_batch.scratch);
+	bfree(graphics->effect_cache_path);
 	if (graphics->module)
 		os_dlclose(graphics->module);
 	bfree(graphics);
@@ -281,6 +362,7 @@ void gs_leave_context(void)
 		if (!os_atomic_dec_long(&thread_graphics->ref)) {
 			graphics_t *graphics = thread_graphics;
 
+			flush_sprite_batch(graphics);
 			graphics->exports.device_leave_context(
 					graphics->device);
 			pthread_mutex_unlock(&graphics->mutex);
@@ -819,39 +901,365 @@ gs_effect_t *gs_effect_create(const char *effect_string, const char *filename,
 	if (!gs_valid_p("gs_effect_create", effect_string))
 		return NULL;
 
+	graphics_t *graphics = thread_graphics;
 	struct gs_effect *effect = bzalloc(sizeof(struct gs_effect));
 	struct effect_parser parser;
-	bool success;
+	uint64_t start_time = os_gettime_ns();
+	char *cache_path = NULL;
+	bool cache_hit = false;
+	bool cache_stored = false;
+	bool success = true;
 
 	effect->graphics = thread_graphics;
 	effect->effect_path = bstrdup(filename);
 
+	if (filename) {
+		pthread_mutex_lock(&graphics->effect_mutex);
+		cache_path = bstrdup(graphics->effect_cache_path);
+		pthread_mutex_unlock(&graphics->effect_mutex);
+	}
+
+	if (cache_path)
+		cache_hit = effect_cache_load(effect, cache_path,
+				effect_string, filename);
+
 	ep_init(&parser);
-	success = ep_parse(&parser, effect, effect_string, filename);
+
+	if (!cache_hit)
+		success = ep_parse(&parser, effect, effect_string, filename);
+
 	if (!success) {
 		if (error_string)
 			*error_string = error_data_buildstring(
 					&parser.cfp.error_list);
 		gs_effect_destroy(effect);
 		effect = NULL;
+
+	} else if (cache_path && !cache_hit) {
+		cache_stored = effect_cache_save(&parser, cache_path,
+				effect_string, filename);
 	}
 
 	if (effect) {
-		pthread_mutex_lock(&thread_graphics->effect_mutex);
+		pthread_mutex_lock(&graphics->effect_mutex);
 
 		if (effect->effect_path) {
 			effect->cached = true;
-			effect->next = thread_graphics->first_effect;
-			thread_graphics->first_effect = effect;
+			effect->next = graphics->first_effect;
+			graphics->first_effect = effect;
 		}
 
-		pthread_mutex_unlock(&thread_graphics->effect_mutex);
+		pthread_mutex_unlock(&graphics->effect_mutex);
 	}
 
+	if (filename) {
+		struct gs_effect_cache_stats *stats =
+			&graphics->effect_cache_stats;
+
+		pthread_mutex_lock(&graphics->effect_mutex);
+
+		if (cache_hit)
+			stats->hits++;
+		else if (cache_path)
+			stats->misses++;
+		if (cache_stored)
+			stats->stores++;
+		stats->load_time_ns += os_gettime_ns() - start_time;
+
+		pthread_mutex_unlock(&graphics->effect_mutex);
+	}
+
+	bfree(cache_path);
 	ep_free(&parser);
 	return effect;
 }
 
+void gs_set_effect_cache_path(const char *path)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid("gs_set_effect_cache_path"))
+		return;
+
+	if (path && os_mkdirs(path) == MKDIR_ERROR) {
+		blog(LOG_WARNING, "gs_set_effect_cache_path: Could not create "
+		                  "'%s', effects will not be cached", path);
+		path = NULL;
+	}
+
+	pthread_mutex_lock(&graphics->effect_mutex);
+	bfree(graphics->effect_cache_path);
+	graphics->effect_cache_path = bstrdup(path);
+	pthread_mutex_unlock(&graphics->effect_mutex);
+
+	if (graphics->exports.device_set_program_cache_path)
+		graphics->exports.device_set_program_cache_path(
+				graphics->device, path);
+}
+
+void gs_get_effect_cache_stats(struct gs_effect_cache_stats *stats)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p("gs_get_effect_cache_stats", stats))
+		return;
+
+	pthread_mutex_lock(&graphics->effect_mutex);
+	*stats = graphics->effect_cache_stats;
+	pthread_mutex_unlock(&graphics->effect_mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline bool fuse_token_is_space(const struct cf_token *token)
+{
+	return token->type == CFTOKEN_SPACETAB ||
+	       token->type == CFTOKEN_NEWLINE;
+}
+
+static inline bool fuse_token_is_char(const struct cf_token *token, char ch)
+{
+	return token->type == CFTOKEN_OTHER && *token->str.array == ch;
+}
+
+static inline const struct cf_token *fuse_next_token(
+		const struct cf_token *token)
+{
+	do {
+		token++;
+	} while (fuse_token_is_space(token));
+
+	return token;
+}
+
+static inline bool fuse_has_name(const struct darray *names,
+		const struct strref *name)
+{
+	const struct strref *array = names->array;
+
+	for (size_t i = 0; i < names->num; i++)
+		if (strref_cmp_strref(array + i, name) == 0)
+			return true;
+
+	return false;
+}
+
+/* gathers the names of everything declared at file scope: uniforms, samplers,
+ * structs and functions.  a file scope declaration is a name that is followed
+ * by one of ; = ( [ { and that isn't a semantic */
+static void fuse_get_names(const struct cf_token *token,
+		struct darray *names)
+{
+	const struct cf_token *prev = NULL;
+	int depth = 0;
+
+	for (; token->type != CFTOKEN_NONE; token++) {
+		if (fuse_token_is_space(token))
+			continue;
+
+		if (fuse_token_is_char(token, '{') ||
+		    fuse_token_is_char(token, '(')) {
+			depth++;
+
+		} else if (fuse_token_is_char(token, '}') ||
+		           fuse_token_is_char(token, ')')) {
+			depth--;
+
+		} else if (token->type == CFTOKEN_NAME && depth == 0 &&
+		           (!prev || !fuse_token_is_char(prev, ':'))) {
+			const struct cf_token *next = fuse_next_token(token);
+
+			if (next->type == CFTOKEN_OTHER &&
+			    strchr(";=([{", *next->str.array) &&
+			    !fuse_has_name(names, &token->str))
+				darray_push_back(sizeof(struct strref), names,
+						&token->str);
+		}
+
+		prev = token;
+	}
+}
+
+/* writes the file with every file scope name prefixed and its techniques
+ * left out, so that several files can be put in one effect */
+static void fuse_write_stage(struct dstr *out, const struct cf_token *token,
+		const struct darray *names, const char *prefix)
+{
+	const struct cf_token *prev = NULL;
+
+	for (; token->type != CFTOKEN_NONE; token++) {
+		if (token->type == CFTOKEN_NAME &&
+		    strref_cmp(&token->str, "technique") == 0) {
+			int depth = 0;
+
+			while (token->type != CFTOKEN_NONE) {
+				if (fuse_token_is_char(token, '{')) {
+					depth++;
+				} else if (fuse_token_is_char(token, '}')) {
+					if (--depth == 0)
+						break;
+				}
+				token++;
+			}
+
+			if (token->type == CFTOKEN_NONE)
+				break;
+			continue;
+		}
+
+		if (token->type == CFTOKEN_NAME &&
+		    (!prev || !fuse_token_is_char(prev, '.')) &&
+		    fuse_has_name(names, &token->str))
+			dstr_cat(out, prefix);
+
+		dstr_ncat(out, token->str.array, token->str.len);
+
+		if (!fuse_token_is_space(token))
+			prev = token;
+	}
+
+	dstr_cat(out, "\n");
+}
+
+static bool fuse_add_stage(struct dstr *out, const gs_effect_t *effect,
+		const char *func, size_t idx, char **error_string)
+{
+	struct cf_parser cfp;
+	DARRAY(struct strref) names;
+	struct strref func_ref;
+	struct dstr prefix = {0};
+	char *file_string;
+	bool success = false;
+
+	file_string = os_quick_read_utf8_file(effect->effect_path);
+	if (!file_string) {
+		blog(LOG_ERROR, "Could not load effect file '%s'",
+				effect->effect_path);
+		return false;
+	}
+
+	da_init(names);
+	cf_parser_init(&cfp);
+
+	if (!cf_parser_parse(&cfp, file_string, effect->effect_path)) {
+		if (error_string)
+			*error_string = error_data_buildstring(
+					&cfp.error_list);
+		goto fail;
+	}
+
+	fuse_get_names(cfp.cur_token, &names.da);
+
+	strref_set(&func_ref, func, strlen(func));
+	if (!fuse_has_name(&names.da, &func_ref)) {
+		blog(LOG_ERROR, "gs_effect_create_fused: '%s' has no "
+		                "function named '%s'",
+		                effect->effect_path, func);
+		goto fail;
+	}
+
+	dstr_printf(&prefix, "f%d_", (int)idx);
+	fuse_write_stage(out, cfp.cur_token, &names.da, prefix.array);
+	success = true;
+
+fail:
+	dstr_free(&prefix);
+	cf_parser_free(&cfp);
+	da_free(names);
+	bfree(file_string);
+	return success;
+}
+
+static const char *fused_effect_start =
+"uniform float4x4 ViewProj;\n"
+"uniform texture2d image;\n\n";
+
+static const char *fused_effect_end =
+"sampler_state fused_sampler {\n"
+"	Filter   = Linear;\n"
+"	AddressU = Clamp;\n"
+"	AddressV = Clamp;\n"
+"};\n\n"
+"struct FusedVertData {\n"
+"	float4 pos : POSITION;\n"
+"	float2 uv  : TEXCOORD0;\n"
+"};\n\n"
+"FusedVertData VSFused(FusedVertData v_in)\n"
+"{\n"
+"	FusedVertData vert_out;\n"
+"	vert_out.pos = mul(float4(v_in.pos.xyz, 1.0), ViewProj);\n"
+"	vert_out.uv  = v_in.uv;\n"
+"	return vert_out;\n"
+"}\n\n"
+"float4 PSFused(FusedVertData v_in) : TARGET\n"
+"{\n"
+"	float4 rgba = image.Sample(fused_sampler, v_in.uv);\n";
+
+static const char *fused_effect_technique =
+"	return rgba;\n"
+"}\n\n"
+"technique Draw\n"
+"{\n"
+"	pass\n"
+"	{\n"
+"		vertex_shader = VSFused(v_in);\n"
+"		pixel_shader  = PSFused(v_in);\n"
+"	}\n"
+"}\n";
+
+gs_effect_t *gs_effect_create_fused(gs_effect_t *const *effects,
+		const char *const *funcs, size_t count, char **error_string)
+{
+	struct dstr key = {0};
+	struct dstr effect_string = {0};
+	gs_effect_t *effect = NULL;
+
+	if (!gs_valid_p2("gs_effect_create_fused", effects, funcs))
+		return NULL;
+
+	dstr_copy(&key, "fused:");
+	for (size_t i = 0; i < count; i++) {
+		if (!effects[i] || !effects[i]->effect_path || !funcs[i]) {
+			blog(LOG_ERROR, "gs_effect_create_fused: effect %d "
+			                "was not created from a file", (int)i);
+			goto done;
+		}
+
+		dstr_catf(&key, "%s#%s;", effects[i]->effect_path, funcs[i]);
+	}
+
+	effect = find_cached_effect(key.array);
+	if (effect)
+		goto done;
+
+	dstr_copy(&effect_string, fused_effect_start);
+	for (size_t i = 0; i < count; i++) {
+		if (!fuse_add_stage(&effect_string, effects[i], funcs[i], i,
+					error_string))
+			goto done;
+	}
+
+	dstr_cat(&effect_string, fused_effect_end);
+
+	/* the output of each pass is written to an 8 bit render target, so
+	 * clamp in between to get the same result */
+	for (size_t i = 0; i < count; i++)
+		dstr_catf(&effect_string, i + 1 < count ?
+				"\trgba = saturate(f%d_%s(rgba));\n" :
+				"\trgba = f%d_%s(rgba);\n",
+				(int)i, funcs[i]);
+
+	dstr_cat(&effect_string, fused_effect_technique);
+
+	effect = gs_effect_create(effect_string.array, key.array,
+			error_string);
+
+done:
+	dstr_free(&effect_string);
+	dstr_free(&key);
+	return effect;
+}
+
 gs_shader_t *gs_vertexshader_create_from_file(const char *file,
 		char **error_string)
 {
@@ -1001,6 +1409,116 @@ static inline void build_sprite_rect(struct gs_vb_data *data, gs_texture_t *tex,
 	build_sprite(data, fcx, fcy, start_u, end_u, start_v, end_v);
 }
 
+static inline void flush_on_blend_change(graphics_t *graphics,
+		enum gs_blend_type src_c, enum gs_blend_type dest_c,
+		enum gs_blend_type src_a, enum gs_blend_type dest_a)
+{
+	struct blend_state *cur = &graphics->cur_blend_state;
+
+	if (cur->src_c != src_c || cur->dest_c != dest_c ||
+	    cur->src_a != src_a || cur->dest_a != dest_a)
+		flush_sprite_batch(graphics);
+}
+
+/* effects load their own shaders and parameters again after a batch is
+ * submitted, so only shaders used without an effect need to submit it */
+static inline void flush_sprite_batch_no_effect(graphics_t *graphics)
+{
+	if (!graphics->cur_effect)
+		flush_sprite_batch(graphics);
+}
+
+static inline bool sprite_batch_params_match(const struct sprite_batch *batch)
+{
+	return batch->params.num == batch->scratch.num &&
+		memcmp(batch->params.array, batch->scratch.array,
+				batch->params.num) == 0;
+}
+
+/* the strip 0-1-2-3 of a single sprite as two triangles with the same
+ * winding */
+static const size_t sprite_tri_order[6] = {0, 1, 2, 2, 1, 3};
+
+static bool sprite_batch_add(graphics_t *graphics, gs_texture_t *tex,
+		uint32_t flip, float fcx, float fcy)
+{
+	struct sprite_batch *batch = &graphics->sprite_batch;
+	struct gs_effect *effect = graphics->cur_effect;
+	struct gs_effect_pass *pass = effect ? effect->cur_pass : NULL;
+	struct gs_vb_data *sprite;
+	struct gs_vb_data *data;
+	struct vec2 *sprite_tv;
+	struct vec2 *tv;
+	struct matrix4 world;
+	size_t start;
+
+	/* vertices are transformed here, so shaders that use the world
+	 * matrix on their own can't be batched */
+	if (!pass || graphics->exports.gs_shader_get_world_matrix(
+				pass->vertshader))
+		return false;
+
+	da_resize(batch->scratch, 0);
+	effect_pass_save_params(pass, &batch->scratch.da);
+
+	if (batch->count && (batch->pass != pass ||
+	                     batch->count == SPRITE_BATCH_MAX ||
+	                     !sprite_batch_params_match(batch)))
+		sprite_batch_submit(graphics);
+
+	if (!batch->count) {
+		struct darray params = batch->params.da;
+
+		batch->pass = pass;
+		batch->params.da = batch->scratch.da;
+		batch->scratch.da = params;
+	}
+
+	sprite = gs_vertexbuffer_get_data(graphics->sprite_buffer);
+	if (tex && gs_texture_is_rect(tex))
+		build_sprite_rect(sprite, tex, fcx, fcy, flip);
+	else
+		build_sprite_norm(sprite, fcx, fcy, flip);
+
+	gs_matrix_get(&world);
+
+	data = gs_vertexbuffer_get_data(batch->buffer);
+	sprite_tv = sprite->tvarray[0].array;
+	tv = data->tvarray[0].array;
+	start = batch->count * 6;
+
+	for (size_t i = 0; i < 6; i++) {
+		size_t idx = sprite_tri_order[i];
+
+		vec3_transform(data->points + start + i, sprite->points + idx,
+				&world);
+		vec2_copy(tv + start + i, sprite_tv + idx);
+	}
+
+	batch->count++;
+	return true;
+}
+
+void gs_sprite_batch_begin(void)
+{
+	if (!gs_valid("gs_sprite_batch_begin"))
+		return;
+
+	thread_graphics->sprite_batch.depth++;
+}
+
+void gs_sprite_batch_end(void)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid("gs_sprite_batch_end"))
+		return;
+
+	if (graphics->sprite_batch.depth > 0 &&
+	    --graphics->sprite_batch.depth == 0)
+		flush_sprite_batch(graphics);
+}
+
 void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 		uint32_t height)
 {
@@ -1024,6 +1542,10 @@ void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 	fcx = width  ? (float)width  : (float)gs_texture_get_width(tex);
 	fcy = height ? (float)height : (float)gs_texture_get_height(tex);
 
+	if (graphics->sprite_batch.depth &&
+	    sprite_batch_add(graphics, tex, flip, fcx, fcy))
+		return;
+
 	data = gs_vertexbuffer_get_data(graphics->sprite_buffer);
 	if (tex && gs_texture_is_rect(tex))
 		build_sprite_rect(data, tex, fcx, fcy, flip);
@@ -1192,6 +1714,8 @@ void gs_perspective(float angle, float aspect, float near, float far)
 	if (!gs_valid("gs_perspective"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	ymax = near * tanf(RAD(angle)*0.5f);
 	ymin = -ymax;
 
@@ -1284,6 +1808,8 @@ void gs_resize(uint32_t x, uint32_t y)
 	if (!gs_valid("gs_resize"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_resize(graphics->device, x, y);
 }
 
@@ -1548,6 +2074,8 @@ void gs_load_vertexbuffer(gs_vertbuffer_t *vertbuffer)
 	if (!gs_valid("gs_load_vertexbuffer"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_load_vertexbuffer(graphics->device,
 			vertbuffer);
 }
@@ -1559,6 +2087,8 @@ void gs_load_indexbuffer(gs_indexbuffer_t *indexbuffer)
 	if (!gs_valid("gs_load_indexbuffer"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_load_indexbuffer(graphics->device,
 			indexbuffer);
 }
@@ -1570,6 +2100,8 @@ void gs_load_texture(gs_texture_t *tex, int unit)
 	if (!gs_valid("gs_load_texture"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_load_texture(graphics->device, tex, unit);
 }
 
@@ -1580,6 +2112,8 @@ void gs_load_samplerstate(gs_samplerstate_t *samplerstate, int unit)
 	if (!gs_valid("gs_load_samplerstate"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_load_samplerstate(graphics->device,
 			samplerstate, unit);
 }
@@ -1591,6 +2125,8 @@ void gs_load_vertexshader(gs_shader_t *vertshader)
 	if (!gs_valid("gs_load_vertexshader"))
 		return;
 
+	flush_sprite_batch_no_effect(graphics);
+
 	graphics->exports.device_load_vertexshader(graphics->device,
 			vertshader);
 }
@@ -1602,6 +2138,8 @@ void gs_load_pixelshader(gs_shader_t *pixelshader)
 	if (!gs_valid("gs_load_pixelshader"))
 		return;
 
+	flush_sprite_batch_no_effect(graphics);
+
 	graphics->exports.device_load_pixelshader(graphics->device,
 			pixelshader);
 }
@@ -1613,6 +2151,8 @@ void gs_load_default_samplerstate(bool b_3d, int unit)
 	if (!gs_valid("gs_load_default_samplerstate"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_load_default_samplerstate(graphics->device,
 			b_3d, unit);
 }
@@ -1664,6 +2204,8 @@ void gs_set_render_target(gs_texture_t *tex, gs_zstencil_t *zstencil)
 	if (!gs_valid("gs_set_render_target"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_set_render_target(graphics->device, tex,
 			zstencil);
 }
@@ -1676,6 +2218,8 @@ void gs_set_cube_render_target(gs_texture_t *cubetex, int side,
 	if (!gs_valid("gs_set_cube_render_target"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_set_cube_render_target(graphics->device,
 			cubetex, side, zstencil);
 }
@@ -1687,6 +2231,8 @@ void gs_copy_texture(gs_texture_t *dst, gs_texture_t *src)
 	if (!gs_valid_p2("gs_copy_texture", dst, src))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_copy_texture(graphics->device, dst, src);
 }
 
@@ -1699,6 +2245,8 @@ void gs_copy_texture_region(gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y,
 	if (!gs_valid_p("gs_copy_texture_region", dst))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_copy_texture_region(graphics->device,
 			dst, dst_x, dst_y,
 			src, src_x, src_y, src_w, src_h);
@@ -1711,6 +2259,8 @@ void gs_stage_texture(gs_stagesurf_t *dst, gs_texture_t *src)
 	if (!gs_valid("gs_stage_texture"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_stage_texture(graphics->device, dst, src);
 }
 
@@ -1721,6 +2271,8 @@ void gs_begin_scene(void)
 	if (!gs_valid("gs_begin_scene"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_begin_scene(graphics->device);
 }
 
@@ -1732,6 +2284,8 @@ void gs_draw(enum gs_draw_mode draw_mode, uint32_t start_vert,
 	if (!gs_valid("gs_draw"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_draw(graphics->device, draw_mode,
 			start_vert, num_verts);
 }
@@ -1743,6 +2297,8 @@ void gs_end_scene(void)
 	if (!gs_valid("gs_end_scene"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_end_scene(graphics->device);
 }
 
@@ -1753,6 +2309,8 @@ void gs_load_swapchain(gs_swapchain_t *swapchain)
 	if (!gs_valid("gs_load_swapchain"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_load_swapchain(graphics->device, swapchain);
 }
 
@@ -1764,6 +2322,8 @@ void gs_clear(uint32_t clear_flags, const struct vec4 *color, float depth,
 	if (!gs_valid("gs_clear"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_clear(graphics->device, clear_flags, color,
 			depth, stencil);
 }
@@ -1775,6 +2335,8 @@ void gs_present(void)
 	if (!gs_valid("gs_present"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_present(graphics->device);
 }
 
@@ -1785,9 +2347,24 @@ void gs_flush(void)
 	if (!gs_valid("gs_flush"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_flush(graphics->device);
 }
 
+bool gs_get_device_stats(struct gs_device_stats *stats)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p("gs_get_device_stats", stats))
+		return false;
+	if (!graphics->exports.device_get_stats)
+		return false;
+
+	graphics->exports.device_get_stats(graphics->device, stats);
+	return true;
+}
+
 void gs_set_cull_mode(enum gs_cull_mode mode)
 {
 	graphics_t *graphics = thread_graphics;
@@ -1795,6 +2372,8 @@ void gs_set_cull_mode(enum gs_cull_mode mode)
 	if (!gs_valid("gs_set_cull_mode"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_set_cull_mode(graphics->device, mode);
 }
 
@@ -1815,6 +2394,9 @@ void gs_enable_blending(bool enable)
 	if (!gs_valid("gs_enable_blending"))
 		return;
 
+	if (graphics->cur_blend_state.enabled != enable)
+		flush_sprite_batch(graphics);
+
 	graphics->cur_blend_state.enabled = enable;
 	graphics->exports.device_enable_blending(graphics->device, enable);
 }
@@ -1826,6 +2408,8 @@ void gs_enable_depth_test(bool enable)
 	if (!gs_valid("gs_enable_depth_test"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_enable_depth_test(graphics->device, enable);
 }
 
@@ -1836,6 +2420,8 @@ void gs_enable_stencil_test(bool enable)
 	if (!gs_valid("gs_enable_stencil_test"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_enable_stencil_test(graphics->device, enable);
 }
 
@@ -1846,6 +2432,8 @@ void gs_enable_stencil_write(bool enable)
 	if (!gs_valid("gs_enable_stencil_write"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_enable_stencil_write(graphics->device, enable);
 }
 
@@ -1856,6 +2444,8 @@ void gs_enable_color(bool red, bool green, bool blue, bool alpha)
 	if (!gs_valid("gs_enable_color"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_enable_color(graphics->device, red, green,
 			blue, alpha);
 }
@@ -1867,6 +2457,8 @@ void gs_blend_function(enum gs_blend_type src, enum gs_blend_type dest)
 	if (!gs_valid("gs_blend_function"))
 		return;
 
+	flush_on_blend_change(graphics, src, dest, src, dest);
+
 	graphics->cur_blend_state.src_c  = src;
 	graphics->cur_blend_state.dest_c = dest;
 	graphics->cur_blend_state.src_a  = src;
@@ -1883,6 +2475,8 @@ void gs_blend_function_separate(
 	if (!gs_valid("gs_blend_function_separate"))
 		return;
 
+	flush_on_blend_change(graphics, src_c, dest_c, src_a, dest_a);
+
 	graphics->cur_blend_state.src_c  = src_c;
 	graphics->cur_blend_state.dest_c = dest_c;
 	graphics->cur_blend_state.src_a  = src_a;
@@ -1898,6 +2492,8 @@ void gs_depth_function(enum gs_depth_test test)
 	if (!gs_valid("gs_depth_function"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_depth_function(graphics->device, test);
 }
 
@@ -1908,6 +2504,8 @@ void gs_stencil_function(enum gs_stencil_side side, enum gs_depth_test test)
 	if (!gs_valid("gs_stencil_function"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_stencil_function(graphics->device, side, test);
 }
 
@@ -1919,6 +2517,8 @@ void gs_stencil_op(enum gs_stencil_side side, enum gs_stencil_op_type fail,
 	if (!gs_valid("gs_stencil_op"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_stencil_op(graphics->device, side, fail, zfail,
 			zpass);
 }
@@ -1930,6 +2530,8 @@ void gs_set_viewport(int x, int y, int width, int height)
 	if (!gs_valid("gs_set_viewport"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_set_viewport(graphics->device, x, y, width,
 			height);
 }
@@ -1951,6 +2553,8 @@ void gs_set_scissor_rect(const struct gs_rect *rect)
 	if (!gs_valid("gs_set_scissor_rect"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_set_scissor_rect(graphics->device, rect);
 }
 
@@ -1962,6 +2566,8 @@ void gs_ortho(float left, float right, float top, float bottom, float znear,
 	if (!gs_valid("gs_ortho"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_ortho(graphics->device, left, right, top,
 			bottom, znear, zfar);
 }
@@ -1974,6 +2580,8 @@ void gs_frustum(float left, float right, float top, float bottom, float znear,
 	if (!gs_valid("gs_frustum"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_frustum(graphics->device, left, right, top,
 			bottom, znear, zfar);
 }
@@ -1995,6 +2603,8 @@ void gs_projection_pop(void)
 	if (!gs_valid("gs_projection_pop"))
 		return;
 
+	flush_sprite_batch(graphics);
+
 	graphics->exports.device_projection_pop(graphics->device);
 }
 
@@ -2016,6 +2626,8 @@ void gs_shader_destroy(gs_shader_t *shader)
 
 	if (!gs_valid("gs_shader_destroy"))
 		return;
+
+	flush_sprite_batch(graphics);
 	if (!shader)
 		return;
 
@@ -2090,6 +2702,8 @@ void gs_shader_set_bool(gs_sparam_t *param, bool val)
 	if (!gs_valid_p("gs_shader_set_bool", param))
 		return;
 
+	flush_sprite_batch_no_effect(graphics);
+
 	graphics->exports.gs_shader_set_bool(param, val);
 }
 
@@ -2100,6 +2714,8 @@ void gs_shader_set_float(gs_sparam_t *param, float val)
 	if (!gs_valid_p("gs_shader_set_float", param))
 		return;
 
+	flush_sprite_batch_no_effect(graphics);
+
 	graphics->exports.gs_shader_set_float(param, val);
 }
 
@@ -2110,6 +2726,8 @@ void gs_shader_set_int(gs_sparam_t *param, int val)
 	if (!gs_valid_p("gs_shader_set_int", param))
 		return;
 
+	flush_sprite_batch_no_effect(graphics);
+
 	graphics->exports.gs_shader_set_int(param, val);
 }
 
@@ -2120,6 +2738,8 @@ void gs_shader_set_matrix3(gs_sparam_t *param, const struct matrix3 *val)
 	if (!gs_valid_p2("gs_shader_set_matrix3", param, val))
 		return;
 
+	flush_sprite_batch_no_effect(graphics);
+
 	graphics->exports.gs_shader_set_matrix3(param, val);
 }
 
@@ -2130,6 +2750,8 @@ void gs_shader_set_matrix4(gs_sparam_t *param, const struct matrix4 *val)
 	if (!gs_valid_p2("gs_shader_set_matrix4", param, val))
 		return;
 
+	flush_sprite_batch_no_effect(graphics);
+
 	graphics->exports.gs_shader_set_matrix4(param, val);
 }
 
@@ -2140,6 +2762,8 @@ void gs_shader_set_vec2(gs_sparam_t *param, const struct vec2 *val)
 	if (!gs_valid_p2("gs_shader_set_vec2", param, val))
 		return;
 
+	flush_sprite_batch_no_effect(graphics);
+
 	graphics->exports.gs_shader_set_vec2(param, val);
 }
 
@@ -2150,6 +2774,8 @@ void gs_shader_set_vec3(gs_sparam_t *param, const struct vec3 *val)
 	if (!gs_valid_p2("gs_shader_set_vec3", param, val))
 		return;
 
+	flush_sprite_batch_no_effect(graphics);
+
 	graphics->exports.gs_shader_set_vec3(param, val);
 }
 
@@ -2160,6 +2786,8 @@ void gs_shader_set_vec4(gs_sparam_t *param, const struct vec4 *val)
 	if (!gs_valid_p2("gs_shader_set_vec4", param, val))
 		return;
 
+	flush_sprite_batch_no_effect(graphics);
+
 	graphics->exports.gs_shader_set_vec4(param, val);
 }
 
@@ -2170,6 +2798,8 @@ void gs_shader_set_texture(gs_sparam_t *param, gs_texture_t *val)
 	if (!gs_valid_p("gs_shader_set_texture", param))
 		return;
 
+	flush_sprite_batch_no_effect(graphics);
+
 	graphics->exports.gs_shader_set_texture(param, val);
 }
 
@@ -2180,6 +2810,8 @@ void gs_shader_set_val(gs_sparam_t *param, const void *val, size_t size)
 	if (!gs_valid_p2("gs_shader_set_val", param, val))
 		return;
 
+	flush_sprite_batch_no_effect(graphics);
+
 	graphics->exports.gs_shader_set_val(param, val, size);
 }
 
@@ -2190,6 +2822,8 @@ void gs_shader_set_default(gs_sparam_t *param)
 	if (!gs_valid_p("gs_shader_set_default", param))
 		return;
 
+	flush_sprite_batch_no_effect(graphics);
+
 	graphics->exports.gs_shader_set_default(param);
 }
 
@@ -2200,6 +2834,8 @@ void gs_shader_set_next_sampler(gs_sparam_t *param, gs_samplerstate_t *sampler)
 	if (!gs_valid_p("gs_shader_set_next_sampler", param))
 		return;
 
+	flush_sprite_batch_no_effect(graphics);
+
 	graphics->exports.gs_shader_set_next_sampler(param, sampler);
 }
 
@@ -2209,6 +2845,8 @@ void gs_texture_destroy(gs_texture_t *tex)
 
 	if (!gs_valid("gs_texture_destroy"))
 		return;
+
+	flush_sprite_batch(graphics);
 	if (!tex)
 		return;
 
@@ -2252,6 +2890,8 @@ bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
 	if (!gs_valid_p3("gs_texture_map", tex, ptr, linesize))
 		return false;
 
+	flush_sprite_batch(graphics);
+
 	return graphics->exports.gs_texture_map(tex, ptr, linesize);
 }
 
@@ -2265,6 +2905,31 @@ void gs_texture_unmap(gs_texture_t *tex)
 	graphics->exports.gs_texture_unmap(tex);
 }
 
+void gs_texture_set_image_rect(gs_texture_t *tex, const uint8_t *data,
+		uint32_t linesize, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy)
+{
+	graphics_t *graphics = thread_graphics;
+
+	if (!gs_valid_p2("gs_texture_set_image_rect", tex, data))
+		return;
+
+	if (!graphics->exports.gs_texture_set_image_rect) {
+		gs_texture_set_image(tex, data, linesize, false);
+		return;
+	}
+
+	if (!cx || !cy ||
+	    x + cx > gs_texture_get_width(tex) ||
+	    y + cy > gs_texture_get_height(tex))
+		return;
+
+	flush_sprite_batch(graphics);
+
+	graphics->exports.gs_texture_set_image_rect(tex, data, linesize,
+			x, y, cx, cy);
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	graphics_t *graphics = thread_graphics;
@@ -2294,6 +2959,8 @@ void gs_cubetexture_destroy(gs_texture_t *cubetex)
 
 	if (!gs_valid("gs_cubetexture_destroy"))
 		return;
+
+	flush_sprite_batch(graphics);
 	if (!cubetex)
 		return;
 
@@ -2327,6 +2994,8 @@ void gs_voltexture_destroy(gs_texture_t *voltex)
 
 	if (!gs_valid("gs_voltexture_destroy"))
 		return;
+
+	flush_sprite_batch(graphics);
 	if (!voltex)
 		return;
 
@@ -2451,6 +3120,8 @@ void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate)
 {
 	if (!gs_valid("gs_samplerstate_destroy"))
 		return;
+
+	flush_sprite_batch(thread_graphics);
 	if (!samplerstate)
 		return;
 
@@ -2571,6 +3242,8 @@ bool gs_texture_rebind_iosurface(gs_texture_t *texture, void *iosurf)
 
 	if (!gs_valid_p("gs_texture_rebind_iosurface", texture))
 		return false;
+
+	flush_sprite_batch(graphics);
 	if (!graphics->exports.gs_texture_rebind_iosurface)
 		return false;
 
@@ -2635,6 +3308,8 @@ bool gs_duplicator_update_frame(gs_duplicator_t *duplicator)
 {
 	if (!gs_valid_p("gs_duplicator_update_frame", duplicator))
 		return false;
+
+	flush_sprite_batch(thread_graphics);
 	if (!thread_graphics->exports.gs_duplicator_get_texture)
 		return false;
 
@@ -2670,6 +3345,8 @@ void *gs_texture_get_dc(gs_texture_t *gdi_tex)
 	if (!gs_valid_p("gs_texture_release_dc", gdi_tex))
 		return NULL;
 
+	flush_sprite_batch(thread_graphics);
+
 	if (thread_graphics->exports.gs_texture_get_dc)
 		return thread_graphics->exports.gs_texture_get_dc(gdi_tex);
 	return NULL;
@@ -395,6 +395,11 @@ EXPORT void gs_effect_set_vec4(gs_eparam_t *param, const struct vec4 *val);
 EXPORT void gs_effect_set_texture(gs_eparam_t *param, gs_texture_t *val);
 EXPORT void gs_effect_set_val(gs_eparam_t *param, const void *val, size_t size);
 EXPORT void gs_effect_set_default(gs_eparam_t *param);
+
+/** Returns a copy of the param's current value, which must be freed with
+ * bfree, or NULL if no value has been set since the last technique ended */
+EXPORT void *gs_effect_get_val(gs_eparam_t *param);
+EXPORT size_t gs_effect_get_val_size(gs_eparam_t *param);
 EXPORT void gs_effect_set_next_sampler(gs_eparam_t *param,
 		gs_samplerstate_t *sampler);
 
@@ -413,6 +418,36 @@ EXPORT void gs_texrender_end(gs_texrender_t *texrender);
 EXPORT void gs_texrender_reset(gs_texrender_t *texrender);
 EXPORT gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender);
 
+/**
+ * Creates a texrender that borrows its render target from a pool shared by
+ * all pooled texrenders of the graphics context.  If the texrender is not
+ * used (begun or queried for its texture) for a whole frame, its target goes
+ * back to the pool and gs_texrender_get_texture returns NULL until it is
+ * rendered again.
+ */
+EXPORT gs_texrender_t *gs_texrender_create_pooled(enum gs_color_format format,
+		enum gs_zstencil_format zsformat);
+
+/**
+ * Ends a frame for the texrender pool: returns the targets of pooled
+ * texrenders that went unused this frame, and destroys targets that have
+ * been sitting in the pool for too long.  Call once per frame.
+ */
+EXPORT void gs_texrender_pool_end_frame(void);
+
+struct gs_texrender_pool_stats {
+	uint32_t active;
+	uint32_t idle;
+	uint64_t active_bytes;
+	uint64_t idle_bytes;
+	uint64_t reused;
+	uint64_t created;
+	uint64_t released;
+	uint64_t destroyed;
+};
+
+EXPORT void gs_texrender_pool_get_stats(struct gs_texrender_pool_stats *stats);
+
 /* ---------------------------------------------------
  * graphics subsystem
  * --------------------------------------------------- */
@@ -455,6 +490,7 @@ struct gs_init_data {
 
 #define GS_DEVICE_OPENGL      1
 #define GS_DEVICE_DIRECT3D_11 2
+#define GS_DEVICE_NULL        3
 
 EXPORT const char *gs_get_device_name(void);
 EXPORT int gs_get_device_type(void);
@@ -507,6 +543,45 @@ EXPORT gs_effect_t *gs_effect_create_from_file(const char *file,
 EXPORT gs_effect_t *gs_effect_create(const char *effect_string,
 		const char *filename, char **error_string);
 
+/**
+ * Creates an effect that draws in a single pass what drawing with each of the
+ * given effects in turn would.  Each effect must have been created from a
+ * file and have a function with the signature "float4 func(float4 rgba)"
+ * that computes its output pixel from its input pixel.
+ *
+ * The "Draw" technique of the fused effect samples "image" once and passes
+ * the pixel through the function of each effect in order.  The fused effect
+ * has the ViewProj and image params, followed by the params of each effect
+ * in the same order they have in that effect.
+ *
+ * Fused effects are cached the same way effect files are.
+ */
+EXPORT gs_effect_t *gs_effect_create_fused(gs_effect_t *const *effects,
+		const char *const *funcs, size_t count, char **error_string);
+
+/**
+ * Sets the directory used to keep compiled effects between runs, or NULL to
+ * disable the cache.  Effects created with a filename are stored there after
+ * they are parsed, and are loaded from there instead of being parsed again
+ * as long as neither the effect file, the files it includes, nor the graphics
+ * module have changed.  Graphics modules that support it also keep their
+ * linked shader programs there.
+ */
+EXPORT void gs_set_effect_cache_path(const char *path);
+
+struct gs_effect_cache_stats {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t stores;
+	uint64_t load_time_ns;
+};
+
+/**
+ * Gets how many effects were loaded from the effect cache and how many had to
+ * be parsed, along with the total time spent creating effects from files.
+ */
+EXPORT void gs_get_effect_cache_stats(struct gs_effect_cache_stats *stats);
+
 EXPORT gs_shader_t *gs_vertexshader_create_from_file(const char *file,
 		char **error_string);
 EXPORT gs_shader_t *gs_pixelshader_create_from_file(const char *file,
@@ -529,6 +604,16 @@ EXPORT uint8_t *gs_create_texture_file_data(const char *file,
 EXPORT void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 		uint32_t height);
 
+/**
+ * Batches sprites until gs_sprite_batch_end is called.  Consecutive
+ * gs_draw_sprite calls that use the same effect pass and effect parameters
+ * are combined into a single draw.  Anything else that draws or changes
+ * render state submits the pending sprites first, so the result is the same
+ * as drawing them one by one.  Calls can be nested.
+ */
+EXPORT void gs_sprite_batch_begin(void);
+EXPORT void gs_sprite_batch_end(void);
+
 EXPORT void gs_draw_sprite_subregion(gs_texture_t *tex, uint32_t flip,
 		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy);
 
@@ -639,6 +724,29 @@ EXPORT void gs_clear(uint32_t clear_flags, const struct vec4 *color,
 EXPORT void gs_present(void);
 EXPORT void gs_flush(void);
 
+/**
+ * Counters of the work submitted to the graphics device since it was
+ * created.  A frame is counted each time the device is flushed.
+ */
+struct gs_device_stats {
+	uint64_t frames;
+	uint64_t draw_calls;
+	uint64_t vertices;
+	uint64_t texture_uploads;
+	uint64_t texture_upload_bytes;
+	uint64_t render_target_switches;
+	uint64_t clears;
+	uint64_t texture_copies;
+	uint64_t stage_copies;
+	uint64_t presents;
+};
+
+/**
+ * Gets the device statistics.  Returns false if the graphics module does not
+ * keep track of them.
+ */
+EXPORT bool gs_get_device_stats(struct gs_device_stats *stats);
+
 EXPORT void gs_set_cull_mode(enum gs_cull_mode mode);
 EXPORT enum gs_cull_mode gs_get_cull_mode(void);
 
@@ -683,6 +791,15 @@ EXPORT enum gs_color_format gs_texture_get_color_format(
 EXPORT bool     gs_texture_map(gs_texture_t *tex, uint8_t **ptr,
 		uint32_t *linesize);
 EXPORT void     gs_texture_unmap(gs_texture_t *tex);
+/**
+ * Updates part of a dynamic texture.  data points to the start of the whole
+ * image, of which only the given rectangle is uploaded.  Falls back to
+ * uploading the whole image if the graphics subsystem can't update part of a
+ * texture.
+ */
+EXPORT void     gs_texture_set_image_rect(gs_texture_t *tex,
+		const uint8_t *data, uint32_t linesize,
+		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy);
 /** special-case function (GL only) - specifies whether the texture is a
  * GL_TEXTURE_RECTANGLE type, which doesn't use normalized texture
  * coordinates, doesn't support mipmapping, and requires address clamping */
@@ -0,0 +1,48 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+/*
+ * 64 bit FNV-1a hash, used to identify cached effects and shader programs.
+ * Start with GS_HASH_INIT and pass the previous hash to continue hashing.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GS_HASH_INIT 0xCBF29CE484222325ULL
+
+static inline uint64_t gs_hash_data(uint64_t hash, const void *data,
+		size_t size)
+{
+	const uint8_t *bytes = (const uint8_t*)data;
+
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+#ifdef __cplusplus
+}
+#endif
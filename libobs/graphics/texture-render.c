@@ -21,7 +21,7 @@
  */
 
 #include <assert.h>
-#include "graphics.h"
+#include "graphics-internal.h"
 
 struct gs_texture_render {
 	gs_texture_t  *target, *prev_target;
@@ -33,8 +33,198 @@ struct gs_texture_render {
 	enum gs_zstencil_format zsformat;
 
 	bool rendered;
+
+	/* pooled texrenders are linked into the pool while holding a target */
+	bool pooled;
+	bool used;
+	struct gs_texture_render *next;
+	struct gs_texture_render **prev_next;
 };
 
+/* ------------------------------------------------------------------------- */
+
+static inline uint64_t zstencil_bytes(enum gs_zstencil_format zsformat)
+{
+	switch (zsformat) {
+	case GS_ZS_NONE:         return 0;
+	case GS_Z16:             return 2;
+	case GS_Z24_S8:          return 4;
+	case GS_Z32F:            return 4;
+	case GS_Z32F_S8X24:      return 8;
+	}
+
+	return 0;
+}
+
+static inline uint64_t target_bytes(uint32_t cx, uint32_t cy,
+		enum gs_color_format format, enum gs_zstencil_format zsformat)
+{
+	uint64_t pixels = (uint64_t)cx * cy;
+	return pixels * gs_get_format_bpp(format) / 8 +
+		pixels * zstencil_bytes(zsformat);
+}
+
+static inline uint64_t texrender_bytes(const gs_texrender_t *texrender)
+{
+	return target_bytes(texrender->cx, texrender->cy, texrender->format,
+			texrender->zsformat);
+}
+
+static inline uint64_t pool_target_bytes(
+		const struct texrender_pool_target *pt)
+{
+	return target_bytes(pt->cx, pt->cy, pt->format, pt->zsformat);
+}
+
+static inline struct texrender_pool *get_pool(void)
+{
+	graphics_t *graphics = gs_get_context();
+	return graphics ? &graphics->texrender_pool : NULL;
+}
+
+static inline void pool_target_destroy(struct texrender_pool *pool,
+		size_t idx)
+{
+	struct texrender_pool_target *pt = pool->idle.array + idx;
+
+	pool->stats.idle--;
+	pool->stats.idle_bytes -= pool_target_bytes(pt);
+	pool->stats.destroyed++;
+
+	gs_texture_destroy(pt->target);
+	gs_zstencil_destroy(pt->zs);
+	da_erase(pool->idle, idx);
+}
+
+static inline void pool_link(struct texrender_pool *pool,
+		gs_texrender_t *texrender)
+{
+	texrender->prev_next = &pool->first_active;
+	texrender->next = pool->first_active;
+	if (pool->first_active)
+		pool->first_active->prev_next = &texrender->next;
+	pool->first_active = texrender;
+}
+
+static inline void pool_unlink(gs_texrender_t *texrender)
+{
+	if (!texrender->prev_next)
+		return;
+
+	*texrender->prev_next = texrender->next;
+	if (texrender->next)
+		texrender->next->prev_next = texrender->prev_next;
+	texrender->next = NULL;
+	texrender->prev_next = NULL;
+}
+
+/* takes a matching target from the pool, returns false if there was none */
+static bool pool_acquire(struct texrender_pool *pool,
+		gs_texrender_t *texrender)
+{
+	for (size_t i = pool->idle.num; i > 0; i--) {
+		struct texrender_pool_target *pt = pool->idle.array + (i - 1);
+
+		if (pt->cx != texrender->cx || pt->cy != texrender->cy ||
+		    pt->format != texrender->format ||
+		    pt->zsformat != texrender->zsformat)
+			continue;
+
+		texrender->target = pt->target;
+		texrender->zs     = pt->zs;
+
+		pool->stats.idle--;
+		pool->stats.idle_bytes -= pool_target_bytes(pt);
+		pool->stats.reused++;
+
+		da_erase(pool->idle, i - 1);
+		return true;
+	}
+
+	return false;
+}
+
+static void pool_release(struct texrender_pool *pool,
+		gs_texrender_t *texrender)
+{
+	struct texrender_pool_target *pt;
+
+	if (!texrender->target)
+		return;
+
+	pool->stats.active--;
+	pool->stats.active_bytes -= texrender_bytes(texrender);
+	pool->stats.released++;
+
+	pt = da_push_back_new(pool->idle);
+	pt->target         = texrender->target;
+	pt->zs             = texrender->zs;
+	pt->cx             = texrender->cx;
+	pt->cy             = texrender->cy;
+	pt->format         = texrender->format;
+	pt->zsformat       = texrender->zsformat;
+	pt->released_frame = pool->frame;
+
+	pool->stats.idle++;
+	pool->stats.idle_bytes += pool_target_bytes(pt);
+
+	pool_unlink(texrender);
+
+	texrender->target   = NULL;
+	texrender->zs       = NULL;
+	texrender->cx       = 0;
+	texrender->cy       = 0;
+	texrender->rendered = false;
+}
+
+void texrender_pool_free(struct texrender_pool *pool)
+{
+	while (pool->idle.num)
+		pool_target_destroy(pool, pool->idle.num - 1);
+	da_free(pool->idle);
+}
+
+void gs_texrender_pool_end_frame(void)
+{
+	struct texrender_pool *pool = get_pool();
+	gs_texrender_t *texrender;
+
+	if (!pool)
+		return;
+
+	texrender = pool->first_active;
+	while (texrender) {
+		gs_texrender_t *next = texrender->next;
+
+		if (!texrender->used)
+			pool_release(pool, texrender);
+		texrender->used = false;
+
+		texrender = next;
+	}
+
+	for (size_t i = pool->idle.num; i > 0; i--) {
+		struct texrender_pool_target *pt = pool->idle.array + (i - 1);
+
+		if (pool->frame - pt->released_frame >= TEXRENDER_POOL_MAX_IDLE)
+			pool_target_destroy(pool, i - 1);
+	}
+
+	pool->frame++;
+}
+
+void gs_texrender_pool_get_stats(struct gs_texrender_pool_stats *stats)
+{
+	struct texrender_pool *pool = get_pool();
+
+	if (pool)
+		*stats = pool->stats;
+	else
+		memset(stats, 0, sizeof(*stats));
+}
+
+/* ------------------------------------------------------------------------- */
+
 gs_texrender_t *gs_texrender_create(enum gs_color_format format,
 		enum gs_zstencil_format zsformat)
 {
@@ -46,36 +236,42 @@ gs_texrender_t *gs_texrender_create(enum gs_color_format format,
 	return texrender;
 }
 
+gs_texrender_t *gs_texrender_create_pooled(enum gs_color_format format,
+		enum gs_zstencil_format zsformat)
+{
+	gs_texrender_t *texrender = gs_texrender_create(format, zsformat);
+	texrender->pooled = true;
+
+	return texrender;
+}
+
 void gs_texrender_destroy(gs_texrender_t *texrender)
 {
 	if (texrender) {
-		gs_texture_destroy(texrender->target);
-		gs_zstencil_destroy(texrender->zs);
+		struct texrender_pool *pool = get_pool();
+
+		if (texrender->pooled && pool) {
+			pool_release(pool, texrender);
+		} else {
+			pool_unlink(texrender);
+			gs_texture_destroy(texrender->target);
+			gs_zstencil_destroy(texrender->zs);
+		}
+
 		bfree(texrender);
 	}
 }
 
-static bool texrender_resetbuffer(gs_texrender_t *texrender, uint32_t cx,
-		uint32_t cy)
+static bool texrender_createbuffer(gs_texrender_t *texrender)
 {
-	if (!texrender)
-		return false;
-
-	gs_texture_destroy(texrender->target);
-	gs_zstencil_destroy(texrender->zs);
-
-	texrender->target = NULL;
-	texrender->zs     = NULL;
-	texrender->cx     = cx;
-	texrender->cy     = cy;
-
-	texrender->target = gs_texture_create(cx, cy, texrender->format,
-			1, NULL, GS_RENDER_TARGET);
+	texrender->target = gs_texture_create(texrender->cx, texrender->cy,
+			texrender->format, 1, NULL, GS_RENDER_TARGET);
 	if (!texrender->target)
 		return false;
 
 	if (texrender->zsformat != GS_ZS_NONE) {
-		texrender->zs = gs_zstencil_create(cx, cy, texrender->zsformat);
+		texrender->zs = gs_zstencil_create(texrender->cx,
+				texrender->cy, texrender->zsformat);
 		if (!texrender->zs) {
 			gs_texture_destroy(texrender->target);
 			texrender->target = NULL;
@@ -87,9 +283,60 @@ static bool texrender_resetbuffer(gs_texrender_t *texrender, uint32_t cx,
 	return true;
 }
 
+static bool texrender_resetbuffer_pooled(gs_texrender_t *texrender,
+		uint32_t cx, uint32_t cy)
+{
+	struct texrender_pool *pool = get_pool();
+
+	pool_release(pool, texrender);
+
+	texrender->cx = cx;
+	texrender->cy = cy;
+
+	if (!pool_acquire(pool, texrender)) {
+		if (!texrender_createbuffer(texrender)) {
+			texrender->cx = 0;
+			texrender->cy = 0;
+			return false;
+		}
+
+		pool->stats.created++;
+	}
+
+	pool->stats.active++;
+	pool->stats.active_bytes += texrender_bytes(texrender);
+	pool_link(pool, texrender);
+	return true;
+}
+
+static bool texrender_resetbuffer(gs_texrender_t *texrender, uint32_t cx,
+		uint32_t cy)
+{
+	if (!texrender)
+		return false;
+
+	if (texrender->pooled && get_pool())
+		return texrender_resetbuffer_pooled(texrender, cx, cy);
+
+	gs_texture_destroy(texrender->target);
+	gs_zstencil_destroy(texrender->zs);
+
+	texrender->target = NULL;
+	texrender->zs     = NULL;
+	texrender->cx     = cx;
+	texrender->cy     = cy;
+
+	return texrender_createbuffer(texrender);
+}
+
 bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx, uint32_t cy)
 {
-	if (!texrender || texrender->rendered)
+	if (!texrender)
+		return false;
+
+	texrender->used = true;
+
+	if (texrender->rendered)
 		return false;
 
 	if (!cx || !cy)
@@ -138,5 +385,10 @@ void gs_texrender_reset(gs_texrender_t *texrender)
 
 gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender)
 {
-	return texrender ? texrender->target : NULL;
+	if (!texrender)
+		return NULL;
+
+	/* the texture being asked for means the target is still in use */
+	((gs_texrender_t*)texrender)->used = true;
+	return texrender->target;
 }
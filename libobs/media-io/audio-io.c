@@ -251,6 +251,7 @@ static void *audio_thread(void *param)
 				1000000);
 
 	os_set_thread_name("audio-io: audio thread");
+	bmem_set_thread_tag(bmem_register_tag("audio output"));
 
 	const char *audio_thread_name =
 		profile_store_name(obs_get_profiler_name_store(),
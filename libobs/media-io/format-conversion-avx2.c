@@ -0,0 +1,348 @@
+/******************************************************************************
+    Copyright (C) 2013 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ * AVX2 versions of the format conversion functions.  This file is compiled
+ * with AVX2 code generation enabled, so nothing in here may be called unless
+ * the CPU has been checked for AVX2 support first.
+ *
+ * Each function only processes the part of each line that is a multiple of
+ * the vector width and returns how many pixels of each line it handled; the
+ * callers finish the rest of the line with the regular code.
+ */
+
+#include "format-conversion-avx2.h"
+#include <immintrin.h>
+
+#define store_lo64(ptr, val) _mm_storel_epi64((__m128i*)(ptr), val)
+
+/* packs the masked byte of each pixel of two lines into 8 bytes per line */
+static FORCE_INLINE void pack_lines(uint8_t *plane, uint32_t pos0,
+		uint32_t pos1, __m256i line1, __m256i line2, __m256i mask,
+		const int shift)
+{
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 0, 4, 1, 5);
+	__m256i val1 = _mm256_and_si256(line1, mask);
+	__m256i val2 = _mm256_and_si256(line2, mask);
+	__m256i packed;
+	__m128i result;
+
+	if (shift == 1) {
+		val1 = _mm256_srli_epi32(val1, 8);
+		val2 = _mm256_srli_epi32(val2, 8);
+	} else if (shift == 2) {
+		val1 = _mm256_srli_epi32(val1, 16);
+		val2 = _mm256_srli_epi32(val2, 16);
+	}
+
+	/* pack instructions work per 128bit lane, so reorder afterwards */
+	packed = _mm256_packs_epi32(val1, val2);
+	packed = _mm256_packus_epi16(packed, packed);
+	packed = _mm256_permutevar8x32_epi32(packed, order);
+
+	result = _mm256_castsi256_si128(packed);
+	store_lo64(plane + pos0, result);
+	store_lo64(plane + pos1, _mm_unpackhi_epi64(result, result));
+}
+
+/* averages the chroma of 2x2 blocks of pixels, returns U0 U1 V0 V1 in the
+ * first dword of each 128bit lane */
+static FORCE_INLINE __m256i average_chroma(__m256i line1, __m256i line2,
+		__m256i uv_mask)
+{
+	__m256i add_val = _mm256_add_epi64(
+			_mm256_and_si256(line1, uv_mask),
+			_mm256_and_si256(line2, uv_mask));
+	__m256i avg_val = _mm256_add_epi64(add_val,
+			_mm256_shuffle_epi32(add_val, _MM_SHUFFLE(2, 3, 0, 1)));
+	avg_val = _mm256_srai_epi16(avg_val, 2);
+	return _mm256_shuffle_epi32(avg_val, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+uint32_t compress_uyvx_to_i420_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[],
+		uint32_t width)
+{
+	uint8_t  *lum_plane = output[0];
+	uint8_t  *u_plane   = output[1];
+	uint8_t  *v_plane   = output[2];
+	uint32_t width8     = width & ~7;
+	uint32_t y;
+
+	__m256i lum_mask = _mm256_set1_epi32(0x0000FF00);
+	__m256i uv_mask  = _mm256_set1_epi16(0x00FF);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width8; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+			uint32_t chroma_pos = chroma_y_pos + (x>>1);
+			uint32_t lo, hi;
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+			__m256i avg_val;
+
+			pack_lines(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, lum_mask, 1);
+
+			avg_val = average_chroma(line1, line2, uv_mask);
+			avg_val = _mm256_packus_epi16(avg_val, avg_val);
+
+			/* lo: U0 V0 U1 V1, hi: U2 V2 U3 V3 */
+			lo = (uint32_t)_mm_cvtsi128_si32(
+					_mm256_castsi256_si128(avg_val));
+			hi = (uint32_t)_mm_cvtsi128_si32(
+					_mm256_extracti128_si256(avg_val, 1));
+
+			*(uint32_t*)(u_plane + chroma_pos) =
+				(lo & 0xFF) | ((lo >> 8) & 0xFF00) |
+				((hi & 0xFF) << 16) | ((hi & 0xFF0000) << 8);
+			*(uint32_t*)(v_plane + chroma_pos) =
+				((lo >> 8) & 0xFF) | ((lo >> 16) & 0xFF00) |
+				((hi & 0xFF00) << 8) | ((hi & 0xFF000000));
+		}
+	}
+
+	return width8;
+}
+
+uint32_t compress_uyvx_to_nv12_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[],
+		uint32_t width)
+{
+	uint8_t  *lum_plane    = output[0];
+	uint8_t  *chroma_plane = output[1];
+	uint32_t width8        = width & ~7;
+	uint32_t y;
+
+	__m256i lum_mask = _mm256_set1_epi32(0x0000FF00);
+	__m256i uv_mask  = _mm256_set1_epi16(0x00FF);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos        = y      * in_linesize;
+		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
+		uint32_t lum_y_pos    = y      * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width8; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+			__m256i avg_val;
+			__m128i packed;
+
+			pack_lines(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, lum_mask, 1);
+
+			avg_val = average_chroma(line1, line2, uv_mask);
+			avg_val = _mm256_packus_epi16(avg_val, avg_val);
+			avg_val = _mm256_permutevar8x32_epi32(avg_val,
+					_mm256_setr_epi32(0, 4, 0, 4,
+						0, 4, 0, 4));
+
+			packed = _mm256_castsi256_si128(avg_val);
+			store_lo64(chroma_plane + chroma_y_pos + x, packed);
+		}
+	}
+
+	return width8;
+}
+
+uint32_t convert_uyvx_to_i444_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output[], const uint32_t out_linesize[],
+		uint32_t width)
+{
+	uint8_t  *lum_plane = output[0];
+	uint8_t  *u_plane   = output[1];
+	uint8_t  *v_plane   = output[2];
+	uint32_t width8     = width & ~7;
+	uint32_t y;
+
+	__m256i lum_mask = _mm256_set1_epi32(0x0000FF00);
+	__m256i u_mask   = _mm256_set1_epi32(0x000000FF);
+	__m256i v_mask   = _mm256_set1_epi32(0x00FF0000);
+
+	for (y = start_y; y < end_y; y += 2) {
+		uint32_t y_pos     = y * in_linesize;
+		uint32_t lum_y_pos = y * out_linesize[0];
+		uint32_t x;
+
+		for (x = 0; x < width8; x += 8) {
+			const uint8_t *img = input + y_pos + x*4;
+			uint32_t lum_pos0  = lum_y_pos + x;
+			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
+
+			__m256i line1 = _mm256_loadu_si256((const __m256i*)img);
+			__m256i line2 = _mm256_loadu_si256(
+					(const __m256i*)(img + in_linesize));
+
+			pack_lines(lum_plane, lum_pos0, lum_pos1,
+					line1, line2, lum_mask, 1);
+			pack_lines(u_plane, lum_pos0, lum_pos1,
+					line1, line2, u_mask, 0);
+			pack_lines(v_plane, lum_pos0, lum_pos1,
+					line1, line2, v_mask, 2);
+		}
+	}
+
+	return width8;
+}
+
+/* duplicates each of the four 16bit chroma pairs and widens them to one
+ * dword per pixel */
+static FORCE_INLINE __m256i expand_chroma(__m128i pairs)
+{
+	return _mm256_cvtepu16_epi32(_mm_unpacklo_epi16(pairs, pairs));
+}
+
+uint32_t decompress_420_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		uint32_t width)
+{
+	uint32_t width8    = width & ~7;
+	uint32_t height_d2 = end_y/2;
+	uint32_t y;
+
+	for (y = start_y/2; y < height_d2; y++) {
+		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
+		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
+		const uint8_t *lum0    = input[0] + y * 2 * in_linesize[0];
+		const uint8_t *lum1    = lum0 + in_linesize[0];
+		uint8_t *output0       = output + y * 2 * out_linesize;
+		uint8_t *output1       = output0 + out_linesize;
+		uint32_t x;
+
+		for (x = 0; x < width8; x += 8) {
+			__m128i u = _mm_cvtsi32_si128(
+					*(const int32_t*)(chroma0 + x/2));
+			__m128i v = _mm_cvtsi32_si128(
+					*(const int32_t*)(chroma1 + x/2));
+			__m256i uv = expand_chroma(_mm_unpacklo_epi8(v, u));
+			__m256i y0, y1;
+
+			y0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+					(const __m128i*)(lum0 + x)));
+			y1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+					(const __m128i*)(lum1 + x)));
+
+			_mm256_storeu_si256((__m256i*)(output0 + x*4),
+					_mm256_or_si256(
+						_mm256_slli_epi32(y0, 16), uv));
+			_mm256_storeu_si256((__m256i*)(output1 + x*4),
+					_mm256_or_si256(
+						_mm256_slli_epi32(y1, 16), uv));
+		}
+	}
+
+	return width8;
+}
+
+uint32_t decompress_nv12_avx2(
+		const uint8_t *const input[], const uint32_t in_linesize[],
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		uint32_t width)
+{
+	uint32_t width8    = width & ~7;
+	uint32_t height_d2 = end_y/2;
+	uint32_t y;
+
+	for (y = start_y/2; y < height_d2; y++) {
+		const uint8_t *chroma = input[1] + y * in_linesize[1];
+		const uint8_t *lum0   = input[0] + y * 2 * in_linesize[0];
+		const uint8_t *lum1   = lum0 + in_linesize[0];
+		uint8_t *output0      = output + y * 2 * out_linesize;
+		uint8_t *output1      = output0 + out_linesize;
+		uint32_t x;
+
+		for (x = 0; x < width8; x += 8) {
+			__m256i uv = expand_chroma(_mm_loadl_epi64(
+					(const __m128i*)(chroma + x)));
+			__m256i y0, y1;
+
+			uv = _mm256_slli_epi32(uv, 8);
+			y0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+					(const __m128i*)(lum0 + x)));
+			y1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64(
+					(const __m128i*)(lum1 + x)));
+
+			_mm256_storeu_si256((__m256i*)(output0 + x*4),
+					_mm256_or_si256(y0, uv));
+			_mm256_storeu_si256((__m256i*)(output1 + x*4),
+					_mm256_or_si256(y1, uv));
+		}
+	}
+
+	return width8;
+}
+
+uint32_t decompress_422_avx2(
+		const uint8_t *input, uint32_t in_linesize,
+		uint32_t start_y, uint32_t end_y,
+		uint8_t *output, uint32_t out_linesize,
+		bool leading_lum, uint32_t width)
+{
+	uint32_t width8 = width & ~7;
+	uint32_t y;
+
+	/* every macro pixel (two pixels sharing chroma) becomes two full
+	 * pixels, with the luma of the second copied over the first */
+	const __m256i shuffle = leading_lum ?
+		_mm256_setr_epi8(
+			0, 1, 2, 3,  2, 1, 2, 3,  4, 5, 6, 7,  6, 5, 6, 7,
+			8, 9,10,11, 10, 9,10,11, 12,13,14,15, 14,13,14,15) :
+		_mm256_setr_epi8(
+			0, 1, 2, 3,  0, 3, 2, 3,  4, 5, 6, 7,  4, 7, 6, 7,
+			8, 9,10,11,  8,11,10,11, 12,13,14,15, 12,15,14,15);
+
+	for (y = start_y; y < end_y; y++) {
+		const uint8_t *in = input + y * in_linesize;
+		uint8_t *out      = output + y * out_linesize;
+		uint32_t x;
+
+		for (x = 0; x < width8; x += 8) {
+			__m128i src = _mm_loadu_si128(
+					(const __m128i*)(in + x*2));
+			__m256i val = _mm256_broadcastsi128_si256(src);
+
+			_mm256_storeu_si256((__m256i*)(out + x*4),
+					_mm256_shuffle_epi8(val, shuffle));
+		}
+	}
+
+	return width8;
+}
@@ -16,9 +16,18 @@
 ******************************************************************************/
 
 #include "format-conversion.h"
+#include "format-conversion-avx2.h"
+#include "../util/threading.h"
+#include "../util/platform.h"
+#include "../util/bmem.h"
 #include <xmmintrin.h>
 #include <emmintrin.h>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
 /* ...surprisingly, if I don't use a macro to force inlining, it causes the
  * CPU usage to boost by a tremendous amount in debug builds. */
 
@@ -89,6 +98,37 @@ static FORCE_INLINE uint32_t min_uint32(uint32_t a, uint32_t b)
 	return a < b ? a : b;
 }
 
+static bool detect_avx2(void)
+{
+#ifdef _MSC_VER
+	int info[4];
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	/* the OS also has to save the upper halves of the ymm registers */
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+static inline bool avx2_supported(void)
+{
+	static volatile long supported = -1;
+
+	if (supported == -1)
+		supported = detect_avx2() ? 1 : 0;
+	return supported == 1;
+}
+
 void compress_uyvx_to_i420(
 		const uint8_t *input, uint32_t in_linesize,
 		uint32_t start_y, uint32_t end_y,
@@ -98,18 +138,23 @@ void compress_uyvx_to_i420(
 	uint8_t  *u_plane     = output[1];
 	uint8_t  *v_plane     = output[2];
 	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t start_x      = 0;
 	uint32_t y;
 
 	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
 	__m128i uv_mask  = _mm_set1_epi16(0x00FF);
 
+	if (avx2_supported())
+		start_x = compress_uyvx_to_i420_avx2(input, in_linesize,
+				start_y, end_y, output, out_linesize, width);
+
 	for (y = start_y; y < end_y; y += 2) {
 		uint32_t y_pos        = y      * in_linesize;
 		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
 		uint32_t lum_y_pos    = y      * out_linesize[0];
 		uint32_t x;
 
-		for (x = 0; x < width; x += 4) {
+		for (x = start_x; x < width; x += 4) {
 			const uint8_t *img = input + y_pos + x*4;
 			uint32_t lum_pos0  = lum_y_pos + x;
 			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
@@ -135,18 +180,23 @@ void compress_uyvx_to_nv12(
 	uint8_t *lum_plane    = output[0];
 	uint8_t *chroma_plane = output[1];
 	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t start_x      = 0;
 	uint32_t y;
 
 	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
 	__m128i uv_mask  = _mm_set1_epi16(0x00FF);
 
+	if (avx2_supported())
+		start_x = compress_uyvx_to_nv12_avx2(input, in_linesize,
+				start_y, end_y, output, out_linesize, width);
+
 	for (y = start_y; y < end_y; y += 2) {
 		uint32_t y_pos        = y      * in_linesize;
 		uint32_t chroma_y_pos = (y>>1) * out_linesize[1];
 		uint32_t lum_y_pos    = y      * out_linesize[0];
 		uint32_t x;
 
-		for (x = 0; x < width; x += 4) {
+		for (x = start_x; x < width; x += 4) {
 			const uint8_t *img = input + y_pos + x*4;
 			uint32_t lum_pos0  = lum_y_pos + x;
 			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
@@ -172,18 +222,23 @@ void convert_uyvx_to_i444(
 	uint8_t  *u_plane     = output[1];
 	uint8_t  *v_plane     = output[2];
 	uint32_t width        = min_uint32(in_linesize, out_linesize[0]);
+	uint32_t start_x      = 0;
 	uint32_t y;
 
 	__m128i lum_mask = _mm_set1_epi32(0x0000FF00);
 	__m128i u_mask   = _mm_set1_epi32(0x000000FF);
 	__m128i v_mask   = _mm_set1_epi32(0x00FF0000);
 
+	if (avx2_supported())
+		start_x = convert_uyvx_to_i444_avx2(input, in_linesize,
+				start_y, end_y, output, out_linesize, width);
+
 	for (y = start_y; y < end_y; y += 2) {
 		uint32_t y_pos        = y      * in_linesize;
 		uint32_t lum_y_pos    = y      * out_linesize[0];
 		uint32_t x;
 
-		for (x = 0; x < width; x += 4) {
+		for (x = start_x; x < width; x += 4) {
 			const uint8_t *img = input + y_pos + x*4;
 			uint32_t lum_pos0  = lum_y_pos + x;
 			uint32_t lum_pos1  = lum_pos0 + out_linesize[0];
@@ -210,8 +265,14 @@ void decompress_420(
 	uint32_t start_y_d2 = start_y/2;
 	uint32_t width_d2   = in_linesize[0]/2;
 	uint32_t height_d2  = end_y/2;
+	uint32_t start_x    = 0;
 	uint32_t y;
 
+	if (avx2_supported())
+		start_x = decompress_420_avx2(input, in_linesize,
+				start_y, end_y, output, out_linesize,
+				width_d2 * 2) / 2;
+
 	for (y = start_y_d2; y < height_d2; y++) {
 		const uint8_t *chroma0 = input[1] + y * in_linesize[1];
 		const uint8_t *chroma1 = input[2] + y * in_linesize[2];
@@ -219,12 +280,15 @@ void decompress_420(
 		register uint32_t *output0, *output1;
 		uint32_t x;
 
-		lum0 = input[0] + y * 2 * in_linesize[0];
+		chroma0 += start_x;
+		chroma1 += start_x;
+		lum0 = input[0] + y * 2 * in_linesize[0] + start_x * 2;
 		lum1 = lum0 + in_linesize[0];
-		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output0 = (uint32_t*)(output + y * 2 * out_linesize) +
+			start_x * 2;
 		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
+		for (x = start_x; x < width_d2; x++) {
 			uint32_t out;
 			out = (*(chroma0++) << 8) | *(chroma1++);
 
@@ -245,21 +309,29 @@ void decompress_nv12(
 	uint32_t start_y_d2 = start_y/2;
 	uint32_t width_d2   = min_uint32(in_linesize[0], out_linesize)/2;
 	uint32_t height_d2  = end_y/2;
+	uint32_t start_x    = 0;
 	uint32_t y;
 
+	if (avx2_supported())
+		start_x = decompress_nv12_avx2(input, in_linesize,
+				start_y, end_y, output, out_linesize,
+				width_d2 * 2) / 2;
+
 	for (y = start_y_d2; y < height_d2; y++) {
 		const uint16_t *chroma;
 		register const uint8_t *lum0, *lum1;
 		register uint32_t *output0, *output1;
 		uint32_t x;
 
-		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]);
-		lum0 = input[0] + y * 2 * in_linesize[0];
+		chroma = (const uint16_t*)(input[1] + y * in_linesize[1]) +
+			start_x;
+		lum0 = input[0] + y * 2 * in_linesize[0] + start_x * 2;
 		lum1 = lum0 + in_linesize[0];
-		output0 = (uint32_t*)(output + y * 2 * out_linesize);
+		output0 = (uint32_t*)(output + y * 2 * out_linesize) +
+			start_x * 2;
 		output1 = (uint32_t*)((uint8_t*)output0 + out_linesize);
 
-		for (x = 0; x < width_d2; x++) {
+		for (x = start_x; x < width_d2; x++) {
 			uint32_t out = *(chroma++) << 8;
 
 			*(output0++) = *(lum0++) | out;
@@ -278,18 +350,27 @@ void decompress_422(
 		bool leading_lum)
 {
 	uint32_t width_d2 = min_uint32(in_linesize, out_linesize)/2;
+	uint32_t start_x  = 0;
 	uint32_t y;
 
 	register const uint32_t *input32;
 	register const uint32_t *input32_end;
 	register uint32_t       *output32;
 
+	if (avx2_supported())
+		start_x = decompress_422_avx2(input, in_linesize,
+				start_y, end_y, output, out_linesize,
+				leading_lum, width_d2 * 2) / 2;
+
 	if (leading_lum) {
 		for (y = start_y; y < end_y; y++) {
 			input32     = (const uint32_t*)(input + y*in_linesize);
 			input32_end = input32 + width_d2;
 			output32    = (uint32_t*)(output + y*out_linesize);
 
+			input32  += start_x;
+			output32 += start_x * 2;
+
 			while(input32 < input32_end) {
 				register uint32_t dw = *input32;
 
@@ -308,6 +389,9 @@ void decompress_422(
 			input32_end = input32 + width_d2;
 			output32    = (uint32_t*)(output + y*out_linesize);
 
+			input32  += start_x;
+			output32 += start_x * 2;
+
 			while (input32 < input32_end) {
 				register uint32_t dw = *input32;
 
@@ -322,3 +406,149 @@ void decompress_422(
 		}
 	}
 }
+
+
+/* ------------------------------------------------------------------------- */
+
+#define MIN_SLICE_HEIGHT 64
+#define MAX_POOL_THREADS 8
+
+struct format_conversion_pool {
+	pthread_t                 *threads;
+	int                       num_threads;
+
+	pthread_mutex_t           run_mutex;
+	os_sem_t                  *work_sem;
+	os_sem_t                  *done_sem;
+	bool                      stop;
+
+	format_conversion_slice_t func;
+	void                      *param;
+	uint32_t                  height;
+	uint32_t                  slice_height;
+	long                      num_slices;
+	volatile long             next_slice;
+};
+
+static void run_slices(struct format_conversion_pool *pool)
+{
+	long slice;
+
+	while ((slice = os_atomic_inc_long(&pool->next_slice) - 1) <
+			pool->num_slices) {
+		uint32_t start_y = (uint32_t)slice * pool->slice_height;
+		uint32_t end_y   = min_uint32(start_y + pool->slice_height,
+				pool->height);
+
+		pool->func(pool->param, start_y, end_y);
+	}
+}
+
+static void *conversion_thread(void *data)
+{
+	struct format_conversion_pool *pool = data;
+
+	os_set_thread_name("format conversion");
+
+	for (;;) {
+		os_sem_wait(pool->work_sem);
+		if (pool->stop)
+			break;
+
+		run_slices(pool);
+		os_sem_post(pool->done_sem);
+	}
+
+	return NULL;
+}
+
+format_conversion_pool_t *format_conversion_pool_create(int threads)
+{
+	struct format_conversion_pool *pool;
+
+	if (threads <= 0)
+		threads = os_get_physical_cores() - 1;
+	if (threads > MAX_POOL_THREADS)
+		threads = MAX_POOL_THREADS;
+	if (threads <= 0)
+		return NULL;
+
+	pool = bzalloc(sizeof(struct format_conversion_pool));
+	pthread_mutex_init_value(&pool->run_mutex);
+
+	if (pthread_mutex_init(&pool->run_mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&pool->work_sem, 0) != 0)
+		goto fail;
+	if (os_sem_init(&pool->done_sem, 0) != 0)
+		goto fail;
+
+	pool->threads = bzalloc(sizeof(pthread_t) * threads);
+	for (int i = 0; i < threads; i++) {
+		if (pthread_create(&pool->threads[i], NULL,
+					conversion_thread, pool) != 0)
+			goto fail;
+		pool->num_threads++;
+	}
+
+	return pool;
+
+fail:
+	format_conversion_pool_destroy(pool);
+	return NULL;
+}
+
+void format_conversion_pool_destroy(format_conversion_pool_t *pool)
+{
+	if (!pool)
+		return;
+
+	pool->stop = true;
+	for (int i = 0; i < pool->num_threads; i++)
+		os_sem_post(pool->work_sem);
+	for (int i = 0; i < pool->num_threads; i++)
+		pthread_join(pool->threads[i], NULL);
+
+	os_sem_destroy(pool->work_sem);
+	os_sem_destroy(pool->done_sem);
+	pthread_mutex_destroy(&pool->run_mutex);
+	bfree(pool->threads);
+	bfree(pool);
+}
+
+void format_conversion_pool_run(format_conversion_pool_t *pool,
+		uint32_t height, format_conversion_slice_t func, void *param)
+{
+	uint32_t max_slices;
+	uint32_t slices;
+	int      helpers;
+
+	max_slices = pool ? (uint32_t)pool->num_threads + 1 : 1;
+	slices = min_uint32(height / MIN_SLICE_HEIGHT, max_slices);
+
+	if (slices <= 1) {
+		func(param, 0, height);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->run_mutex);
+
+	pool->func         = func;
+	pool->param        = param;
+	pool->height       = height;
+	pool->slice_height = ((height + slices - 1) / slices + 1) & ~1;
+	pool->num_slices   = (long)((height + pool->slice_height - 1) /
+			pool->slice_height);
+	pool->next_slice   = 0;
+
+	helpers = (int)pool->num_slices - 1;
+	for (int i = 0; i < helpers; i++)
+		os_sem_post(pool->work_sem);
+
+	run_slices(pool);
+
+	for (int i = 0; i < helpers; i++)
+		os_sem_wait(pool->done_sem);
+
+	pthread_mutex_unlock(&pool->run_mutex);
+}
@@ -58,6 +58,35 @@ EXPORT void decompress_422(
 		uint8_t *output, uint32_t out_linesize,
 		bool leading_lum);
 
+/*
+ * Thread pool for running the conversion functions above over horizontal
+ * slices of a frame in parallel
+ */
+
+struct format_conversion_pool;
+typedef struct format_conversion_pool format_conversion_pool_t;
+
+typedef void (*format_conversion_slice_t)(void *param,
+		uint32_t start_y, uint32_t end_y);
+
+/**
+ * Creates a slice conversion pool
+ *
+ * @param  threads  Number of worker threads, the calling thread always
+ *                  converts a slice as well.  0 to pick automatically.
+ */
+EXPORT format_conversion_pool_t *format_conversion_pool_create(int threads);
+EXPORT void format_conversion_pool_destroy(format_conversion_pool_t *pool);
+
+/**
+ * Splits the lines 0 to height into slices and calls func for each of them,
+ * returning when all slices are done.  Slices always start on an even line,
+ * so chroma subsampled formats can be converted safely.  If pool is NULL or
+ * the frame is small, func is called once for the whole frame.
+ */
+EXPORT void format_conversion_pool_run(format_conversion_pool_t *pool,
+		uint32_t height, format_conversion_slice_t func, void *param);
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,6 +16,7 @@
 ******************************************************************************/
 
 #include <inttypes.h>
+#include <limits.h>
 #include "obs-internal.h"
 
 struct ts_info {
@@ -35,7 +36,161 @@ static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 		da_push_back(audio->render_order, &source);
 	}
 
-	UNUSED_PARAMETER(parent);
+	/* the tree is enumerated children first, so the level of the source
+	 * is final by the time it is enumerated with its parent */
+	if (parent && parent->audio_render_level <= source->audio_render_level)
+		parent->audio_render_level = source->audio_render_level + 1;
+}
+
+/* ------------------------------------------------------------------------- */
+/* audio render threads */
+
+static void render_audio_source(struct obs_core_audio *audio,
+		obs_source_t *source)
+{
+	uint64_t start_time = os_gettime_ns();
+	uint64_t render_time;
+
+	obs_source_audio_render(source, audio->render_mixers,
+			audio->render_channels, audio->render_sample_rate,
+			audio->render_size);
+
+	render_time = os_gettime_ns() - start_time;
+	if (render_time > LONG_MAX)
+		render_time = LONG_MAX;
+	os_atomic_set_long(&source->audio_render_time_ns, (long)render_time);
+}
+
+static void render_level_sources(struct obs_core_audio *audio)
+{
+	long num = (long)audio->render_level.num;
+	long idx;
+
+	while ((idx = os_atomic_inc_long(&audio->render_next) - 1) < num)
+		render_audio_source(audio, audio->render_level.array[idx]);
+}
+
+static void *audio_render_thread(void *param)
+{
+	struct obs_core_audio *audio = param;
+
+	os_set_thread_name("libobs: audio render thread");
+	bmem_set_thread_tag(bmem_register_tag("audio render"));
+
+	while (os_sem_wait(audio->render_start_sem) == 0) {
+		if (os_atomic_load_bool(&audio->render_threads_stop))
+			break;
+
+		render_level_sources(audio);
+		os_sem_post(audio->render_done_sem);
+	}
+
+	return NULL;
+}
+
+void obs_start_audio_render_threads(struct obs_core_audio *audio)
+{
+	int num_threads = os_get_logical_cores() - 1;
+
+	if (num_threads > MAX_AUDIO_RENDER_THREADS)
+		num_threads = MAX_AUDIO_RENDER_THREADS;
+	if (num_threads <= 0)
+		return;
+
+	if (os_sem_init(&audio->render_start_sem, 0) != 0 ||
+	    os_sem_init(&audio->render_done_sem, 0) != 0) {
+		blog(LOG_WARNING, "Failed to create audio render semaphores, "
+		                  "audio will be rendered on the audio thread");
+		return;
+	}
+
+	for (int i = 0; i < num_threads; i++) {
+		if (pthread_create(&audio->render_threads[i], NULL,
+					audio_render_thread, audio) != 0)
+			break;
+		audio->num_render_threads++;
+	}
+}
+
+void obs_stop_audio_render_threads(struct obs_core_audio *audio)
+{
+	os_atomic_set_bool(&audio->render_threads_stop, true);
+
+	for (int i = 0; i < audio->num_render_threads; i++)
+		os_sem_post(audio->render_start_sem);
+	for (int i = 0; i < audio->num_render_threads; i++)
+		pthread_join(audio->render_threads[i], NULL);
+
+	os_sem_destroy(audio->render_start_sem);
+	os_sem_destroy(audio->render_done_sem);
+	da_free(audio->render_level);
+	da_free(audio->render_serial);
+
+	audio->num_render_threads = 0;
+	audio->render_start_sem = NULL;
+	audio->render_done_sem = NULL;
+	audio->render_threads_stop = false;
+}
+
+static void render_level(struct obs_core_audio *audio)
+{
+	int num_threads = audio->num_render_threads;
+
+	if (num_threads > (int)audio->render_level.num - 1)
+		num_threads = (int)audio->render_level.num - 1;
+
+	os_atomic_set_long(&audio->render_next, 0);
+
+	for (int i = 0; i < num_threads; i++)
+		os_sem_post(audio->render_start_sem);
+
+	render_level_sources(audio);
+
+	for (int i = 0; i < num_threads; i++)
+		os_sem_wait(audio->render_done_sem);
+
+	for (size_t i = 0; i < audio->render_serial.num; i++)
+		render_audio_source(audio, audio->render_serial.array[i]);
+}
+
+/* every source only writes to its own buffers, and only reads from the
+ * sources of earlier levels, so the result doesn't depend on how the
+ * sources of a level end up being split between threads */
+static void render_audio_sources(struct obs_core_audio *audio,
+		uint32_t mixers, size_t channels, size_t sample_rate,
+		size_t size)
+{
+	int max_level = 0;
+
+	audio->render_mixers      = mixers;
+	audio->render_channels    = channels;
+	audio->render_sample_rate = sample_rate;
+	audio->render_size        = size;
+
+	for (size_t i = 0; i < audio->render_order.num; i++) {
+		obs_source_t *source = audio->render_order.array[i];
+		if (source->audio_render_level > max_level)
+			max_level = source->audio_render_level;
+	}
+
+	for (int level = 0; level <= max_level; level++) {
+		da_resize(audio->render_level, 0);
+		da_resize(audio->render_serial, 0);
+
+		for (size_t i = 0; i < audio->render_order.num; i++) {
+			obs_source_t *source = audio->render_order.array[i];
+			if (source->audio_render_level != level)
+				continue;
+
+			if (source->info.output_flags &
+					OBS_SOURCE_SERIAL_AUDIO_RENDER)
+				da_push_back(audio->render_serial, &source);
+			else
+				da_push_back(audio->render_level, &source);
+		}
+
+		render_level(audio);
+	}
 }
 
 static inline size_t convert_time_to_frames(size_t sample_rate, uint64_t t)
@@ -360,8 +515,13 @@ static inline void calc_min_ts(struct obs_core_data *data,
 
 static inline void release_audio_sources(struct obs_core_audio *audio)
 {
-	for (size_t i = 0; i < audio->render_order.num; i++)
-		obs_source_release(audio->render_order.array[i]);
+	for (size_t i = 0; i < audio->render_order.num; i++) {
+		obs_source_t *source = audio->render_order.array[i];
+
+		/* the tree can change by the next tick */
+		source->audio_render_level = 0;
+		obs_source_release(source);
+	}
 }
 
 bool audio_callback(void *param,
@@ -416,11 +576,8 @@ bool audio_callback(void *param,
 
 	/* ------------------------------------------------ */
 	/* render audio data */
-	for (size_t i = 0; i < audio->render_order.num; i++) {
-		obs_source_t *source = audio->render_order.array[i];
-		obs_source_audio_render(source, mixers, channels, sample_rate,
-				audio_size);
-	}
+	render_audio_sources(audio, mixers, channels, sample_rate,
+			audio_size);
 
 	/* ------------------------------------------------ */
 	/* get minimum audio timestamp */
@@ -459,6 +616,7 @@ bool audio_callback(void *param,
 	source = data->first_audio_source;
 	while (source) {
 		pthread_mutex_lock(&source->audio_buf_mutex);
+		obs_source_drain_audio_input(source);
 		discard_audio(audio, source, channels, sample_rate, &ts);
 		pthread_mutex_unlock(&source->audio_buf_mutex);
 
@@ -30,6 +30,7 @@ extern "C" {
 #endif
 
 #define OBS_ENCODER_CAP_DEPRECATED             (1<<0)
+#define OBS_ENCODER_CAP_DYN_BITRATE            (1<<1)
 
 /** Specifies the encoder type */
 enum obs_encoder_type {
@@ -20,6 +20,7 @@
 #include "util/c99defs.h"
 #include "util/darray.h"
 #include "util/circlebuf.h"
+#include "util/spsc-circlebuf.h"
 #include "util/dstr.h"
 #include "util/threading.h"
 #include "util/platform.h"
@@ -33,6 +34,7 @@
 #include "media-io/audio-resampler.h"
 #include "media-io/video-io.h"
 #include "media-io/audio-io.h"
+#include "media-io/format-conversion.h"
 
 #include "obs.h"
 
@@ -72,6 +74,21 @@ static inline bool obs_object_valid(const void *obj, const char *f,
 /* ------------------------------------------------------------------------- */
 /* modules */
 
+enum obs_module_registration_type {
+	MODULE_REGISTRATION_SOURCE,
+	MODULE_REGISTRATION_OUTPUT,
+	MODULE_REGISTRATION_ENCODER,
+	MODULE_REGISTRATION_SERVICE,
+	MODULE_REGISTRATION_MODAL_UI,
+	MODULE_REGISTRATION_MODELESS_UI
+};
+
+struct obs_module_registration {
+	enum obs_module_registration_type type;
+	void   *info;
+	size_t size;
+};
+
 struct obs_module {
 	char *mod_name;
 	const char *file;
@@ -90,6 +107,13 @@ struct obs_module {
 	const char *(*name)(void);
 	const char *(*description)(void);
 	const char *(*author)(void);
+	bool        (*load_thread_safe)(void);
+
+	uint64_t    load_time_ns;
+
+	/* types registered by a module that was loaded on a worker thread,
+	 * registered with libobs in module order after all modules load */
+	DARRAY(struct obs_module_registration) deferred;
 
 	struct obs_module *next;
 };
@@ -251,6 +275,8 @@ struct obs_core_video {
 	pthread_t                       video_thread;
 	uint32_t                        total_frames;
 	uint32_t                        lagged_frames;
+	volatile long                   items_culled;
+	uint32_t                        last_items_culled;
 	bool                            thread_initialized;
 
 	bool                            gpu_conversion;
@@ -259,6 +285,7 @@ struct obs_core_video {
 	uint32_t                        plane_offsets[3];
 	uint32_t                        plane_sizes[3];
 	uint32_t                        plane_linewidth[3];
+	format_conversion_pool_t        *conversion_pool;
 
 	uint32_t                        output_width;
 	uint32_t                        output_height;
@@ -283,12 +310,33 @@ struct obs_core_video {
 
 struct audio_monitor;
 
+#define MAX_AUDIO_RENDER_THREADS 4
+
 struct obs_core_audio {
 	audio_t                         *audio;
 
 	DARRAY(struct obs_source*)      render_order;
 	DARRAY(struct obs_source*)      root_nodes;
 
+	/* the render order is rendered a level at a time, so that sources
+	 * are rendered after the sources they mix.  the sources of a level
+	 * are independent, so they are split between the audio thread and
+	 * the render threads.  sources with OBS_SOURCE_SERIAL_AUDIO_RENDER
+	 * are rendered by the audio thread alone after the rest of their
+	 * level. */
+	DARRAY(struct obs_source*)      render_level;
+	DARRAY(struct obs_source*)      render_serial;
+	pthread_t                       render_threads[MAX_AUDIO_RENDER_THREADS];
+	int                             num_render_threads;
+	os_sem_t                        *render_start_sem;
+	os_sem_t                        *render_done_sem;
+	volatile bool                   render_threads_stop;
+	volatile long                   render_next;
+	uint32_t                        render_mixers;
+	size_t                          render_channels;
+	size_t                          render_sample_rate;
+	size_t                          render_size;
+
 	uint64_t                        buffered_ts;
 	struct circlebuf                buffered_timestamps;
 	int                             buffering_wait_ticks;
@@ -320,6 +368,13 @@ struct obs_core_data {
 	pthread_mutex_t                 draw_callbacks_mutex;
 	DARRAY(struct draw_callback)    draw_callbacks;
 
+	/* sources that need to be ticked by the graphics thread */
+	pthread_mutex_t                 tick_mutex;
+	DARRAY(struct obs_source*)      tick_sources;
+
+	/* serializes the creation of deferred sources */
+	pthread_mutex_t                 deferred_mutex;
+
 	struct obs_view                 main_view;
 
 	long long                       unnamed_index;
@@ -402,6 +457,9 @@ extern bool audio_callback(void *param,
 		uint64_t start_ts_in, uint64_t end_ts_in, uint64_t *out_ts,
 		uint32_t mixers, struct audio_output_data *mixes);
 
+extern void obs_start_audio_render_threads(struct obs_core_audio *audio);
+extern void obs_stop_audio_render_threads(struct obs_core_audio *audio);
+
 
 /* ------------------------------------------------------------------------- */
 /* obs shared context data */
@@ -537,6 +595,10 @@ struct obs_source {
 	/* signals to call the source update in the video thread */
 	bool                            defer_update;
 
+	/* the source was loaded without being created, and is created when
+	 * it is first shown or activated (see obs_source_instantiate) */
+	volatile bool                   deferred;
+
 	/* ensures show/hide are only called once */
 	volatile long                   show_refs;
 
@@ -551,9 +613,19 @@ struct obs_source {
 	bool                            active;
 	bool                            showing;
 
+	/* source is in the tick list (protected by the data tick_mutex) */
+	bool                            tick_queued;
+
+	/* incremented whenever the rendered output may have changed, also by
+	 * the filters of the source */
+	volatile long                   content_generation;
+
 	/* used to temporarily disable sources if needed */
 	bool                            enabled;
 
+	/* set by the source if it covers its entire area with opaque pixels */
+	bool                            opaque;
+
 	/* timing (if video is present, is based upon video) */
 	volatile bool                   timing_set;
 	volatile uint64_t               timing_adjust;
@@ -576,6 +648,16 @@ struct obs_source {
 	uint64_t                        audio_ts;
 	struct circlebuf                audio_input_buf[MAX_AUDIO_CHANNELS];
 	size_t                          last_audio_input_buf_size;
+
+	/* audio output by the source, queued without locking and moved to
+	 * audio_input_buf by whoever holds audio_buf_mutex */
+	struct spsc_circlebuf           audio_input_queue;
+	DARRAY(uint8_t)                 audio_input_packet;
+
+	/* level in the audio render order, 0 if the source mixes no other
+	 * sources (only used by the audio thread) */
+	int                             audio_render_level;
+	volatile long                   audio_render_time_ns;
 	DARRAY(struct audio_action)     audio_actions;
 	float                           *audio_output_buf[MAX_AUDIO_MIXES][MAX_AUDIO_CHANNELS];
 	struct resample_info            sample_info;
@@ -640,9 +722,22 @@ struct obs_source {
 	DARRAY(struct obs_source*)      filters;
 	pthread_mutex_t                 filter_mutex;
 	gs_texrender_t                  *filter_texrender;
+	long                            filter_texrender_generation;
+	int                             filter_texrender_cx;
+	int                             filter_texrender_cy;
+	size_t                          filter_texrender_fused;
 	enum obs_allow_direct_render    allow_direct;
 	bool                            rendering_filter;
 
+	/* filters drawn in the same pass as the filter above them */
+	struct obs_source               *fused_input;
+	size_t                          fused_count;
+	gs_effect_t                     *fused_stage_effect;
+	DARRAY(uint8_t)                 fused_stage_values;
+	bool                            fuse_collecting;
+	bool                            fuse_collected;
+	bool                            fuse_failed;
+
 	/* sources specific hotkeys */
 	obs_hotkey_pair_id              mute_unmute_key;
 	obs_hotkey_id                   push_to_mute_key;
@@ -706,6 +801,8 @@ void audio_monitor_reset(struct audio_monitor *monitor);
 extern void audio_monitor_destroy(struct audio_monitor *monitor);
 
 extern void obs_source_destroy(struct obs_source *source);
+extern obs_source_t *obs_source_create_deferred(const char *id,
+		const char *name, obs_data_t *settings, obs_data_t *hotkey_data);
 
 enum view_type {
 	MAIN_VIEW,
@@ -752,12 +849,19 @@ static inline enum gs_color_format convert_video_format(
 extern void obs_source_activate(obs_source_t *source, enum view_type type);
 extern void obs_source_deactivate(obs_source_t *source, enum view_type type);
 extern void obs_source_video_tick(obs_source_t *source, float seconds);
+extern bool obs_source_content_tracked(const obs_source_t *source);
+extern void obs_source_queue_tick(obs_source_t *source);
+extern bool obs_source_is_opaque(obs_source_t *source);
+extern bool obs_source_needs_tick(obs_source_t *source);
 extern float obs_source_get_target_volume(obs_source_t *source,
 		obs_source_t *target);
 
 extern void obs_source_audio_render(obs_source_t *source, uint32_t mixers,
 		size_t channels, size_t sample_rate, size_t size);
 
+/* must be called with audio_buf_mutex locked */
+extern void obs_source_drain_audio_input(obs_source_t *source);
+
 extern void add_alignment(struct vec2 *v, uint32_t align, int cx, int cy);
 
 extern struct obs_source_frame *filter_async_video(obs_source_t *source,
@@ -16,6 +16,7 @@
 ******************************************************************************/
 
 #include "util/platform.h"
+#include "util/threading.h"
 #include "util/dstr.h"
 
 #include "obs-defs.h"
@@ -23,6 +24,18 @@
 #include "obs-module.h"
 
 extern const char *get_module_extension(void);
+extern void obs_regsiter_modal_ui_s(const struct obs_modal_ui *info,
+		size_t size);
+extern void obs_regsiter_modeless_ui_s(const struct obs_modeless_ui *info,
+		size_t size);
+
+/* module whose obs_module_load is running on this thread while its types
+ * are being deferred */
+#ifdef _MSC_VER
+static __declspec(thread) struct obs_module *deferring_module = NULL;
+#else
+static __thread struct obs_module *deferring_module = NULL;
+#endif
 
 static inline int req_func_not_found(const char *name, const char *path)
 {
@@ -54,6 +67,8 @@ static int load_module_exports(struct obs_module *mod, const char *path)
 	mod->name        = os_dlsym(mod->module, "obs_module_name");
 	mod->description = os_dlsym(mod->module, "obs_module_description");
 	mod->author      = os_dlsym(mod->module, "obs_module_author");
+	mod->load_thread_safe = os_dlsym(mod->module,
+			"obs_module_load_thread_safe");
 	return MODULE_SUCCESS;
 }
 
@@ -76,15 +91,12 @@ static inline char *get_module_name(const char *file)
 extern void reset_win32_symbol_paths(void);
 #endif
 
-int obs_open_module(obs_module_t **module, const char *path,
+static int open_module(struct obs_module **module, const char *path,
 		const char *data_path)
 {
 	struct obs_module mod = {0};
 	int errorcode;
 
-	if (!module || !path || !obs)
-		return MODULE_ERROR;
-
 	blog(LOG_DEBUG, "---------------------------------");
 
 	mod.module = os_dlopen(path);
@@ -102,14 +114,12 @@ int obs_open_module(obs_module_t **module, const char *path,
 	mod.file      = (!mod.file) ? mod.bin_path : (mod.file + 1);
 	mod.mod_name  = get_module_name(mod.file);
 	mod.data_path = bstrdup(data_path);
-	mod.next      = obs->first_module;
 
 	if (mod.file) {
 		blog(LOG_DEBUG, "Loading module: %s", mod.file);
 	}
 
 	*module = bmemdup(&mod, sizeof(mod));
-	obs->first_module = (*module);
 	mod.set_pointer(*module);
 
 	if (mod.set_locale)
@@ -118,6 +128,27 @@ int obs_open_module(obs_module_t **module, const char *path,
 	return MODULE_SUCCESS;
 }
 
+static inline void link_module(struct obs_module *module)
+{
+	module->next = obs->first_module;
+	obs->first_module = module;
+}
+
+int obs_open_module(obs_module_t **module, const char *path,
+		const char *data_path)
+{
+	int errorcode;
+
+	if (!module || !path || !obs)
+		return MODULE_ERROR;
+
+	errorcode = open_module(module, path, data_path);
+	if (errorcode == MODULE_SUCCESS)
+		link_module(*module);
+
+	return errorcode;
+}
+
 bool obs_init_module(obs_module_t *module)
 {
 	if (!module || !obs)
@@ -130,7 +161,10 @@ bool obs_init_module(obs_module_t *module)
 				"obs_init_module(%s)", module->file);
 	profile_start(profile_name);
 
+	uint64_t start_time = os_gettime_ns();
 	module->loaded = module->load();
+	module->load_time_ns += os_gettime_ns() - start_time;
+
 	if (!module->loaded)
 		blog(LOG_WARNING, "Failed to initialize module '%s'",
 				module->file);
@@ -144,7 +178,8 @@ void obs_log_loaded_modules(void)
 	blog(LOG_INFO, "  Loaded Modules:");
 
 	for (obs_module_t *mod = obs->first_module; !!mod; mod = mod->next)
-		blog(LOG_INFO, "    %s", mod->file);
+		blog(LOG_INFO, "    %s (%.1f ms)", mod->file,
+				(double)mod->load_time_ns / 1000000.0);
 }
 
 const char *obs_get_module_file_name(obs_module_t *module)
@@ -222,20 +257,154 @@ void obs_add_module_path(const char *bin, const char *data)
 	da_push_back(obs->module_paths, &omp);
 }
 
-static void load_all_callback(void *param, const struct obs_module_info *info)
+/* modules are opened on a pool of threads, and modules that declare their
+ * load thread-safe are also loaded there.  everything else, including adding
+ * the types those modules registered, happens afterwards on this thread in
+ * the order the modules were found, so the result is the same as loading
+ * them one by one */
+#define MAX_MODULE_LOAD_THREADS 8
+
+struct module_load_task {
+	char               *bin_path;
+	char               *data_path;
+	struct obs_module  *module;
+	int                code;
+	bool               loaded_in_thread;
+};
+
+struct module_loader {
+	DARRAY(struct module_load_task) tasks;
+	volatile long next_task;
+};
+
+static void find_module_callback(void *param,
+		const struct obs_module_info *info)
+{
+	struct module_loader *loader = param;
+	struct module_load_task *task = da_push_back_new(loader->tasks);
+
+	task->bin_path  = bstrdup(info->bin_path);
+	task->data_path = bstrdup(info->data_path);
+}
+
+static void run_module_load_task(struct module_load_task *task)
 {
-	obs_module_t *module;
+	uint64_t start_time = os_gettime_ns();
+	struct obs_module *module;
 
-	int code = obs_open_module(&module, info->bin_path, info->data_path);
-	if (code != MODULE_SUCCESS) {
-		blog(LOG_DEBUG, "Failed to load module file '%s': %d",
-				info->bin_path, code);
+	task->code = open_module(&task->module, task->bin_path,
+			task->data_path);
+	if (task->code != MODULE_SUCCESS)
 		return;
+
+	module = task->module;
+	module->load_time_ns = os_gettime_ns() - start_time;
+
+	if (module->load_thread_safe && module->load_thread_safe()) {
+		deferring_module = module;
+		obs_init_module(module);
+		deferring_module = NULL;
+
+		task->loaded_in_thread = true;
+	}
+}
+
+static void *module_load_thread(void *param)
+{
+	struct module_loader *loader = param;
+
+	for (;;) {
+		long idx = os_atomic_inc_long(&loader->next_task) - 1;
+		if (idx >= (long)loader->tasks.num)
+			break;
+
+		run_module_load_task(loader->tasks.array + idx);
+	}
+
+	return NULL;
+}
+
+static void register_deferred(struct obs_module *module)
+{
+	for (size_t i = 0; i < module->deferred.num; i++) {
+		struct obs_module_registration *reg =
+			module->deferred.array + i;
+
+		switch (reg->type) {
+		case MODULE_REGISTRATION_SOURCE:
+			obs_register_source_s(reg->info, reg->size);
+			break;
+		case MODULE_REGISTRATION_OUTPUT:
+			obs_register_output_s(reg->info, reg->size);
+			break;
+		case MODULE_REGISTRATION_ENCODER:
+			obs_register_encoder_s(reg->info, reg->size);
+			break;
+		case MODULE_REGISTRATION_SERVICE:
+			obs_register_service_s(reg->info, reg->size);
+			break;
+		case MODULE_REGISTRATION_MODAL_UI:
+			obs_regsiter_modal_ui_s(reg->info, reg->size);
+			break;
+		case MODULE_REGISTRATION_MODELESS_UI:
+			obs_regsiter_modeless_ui_s(reg->info, reg->size);
+			break;
+		}
+
+		bfree(reg->info);
+	}
+
+	da_free(module->deferred);
+}
+
+static void load_modules(struct module_loader *loader)
+{
+	pthread_t threads[MAX_MODULE_LOAD_THREADS];
+	uint64_t start_time = os_gettime_ns();
+	int num_threads = os_get_logical_cores() - 1;
+	int num_parallel = 0;
+
+	if (num_threads > MAX_MODULE_LOAD_THREADS)
+		num_threads = MAX_MODULE_LOAD_THREADS;
+	if (num_threads > (int)loader->tasks.num - 1)
+		num_threads = (int)loader->tasks.num - 1;
+
+	for (int i = 0; i < num_threads; i++) {
+		if (pthread_create(&threads[i], NULL, module_load_thread,
+					loader) != 0) {
+			num_threads = i;
+			break;
+		}
 	}
 
-	obs_init_module(module);
+	module_load_thread(loader);
+
+	for (int i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
 
-	UNUSED_PARAMETER(param);
+	for (size_t i = 0; i < loader->tasks.num; i++) {
+		struct module_load_task *task = loader->tasks.array + i;
+
+		if (task->code != MODULE_SUCCESS) {
+			blog(LOG_DEBUG, "Failed to load module file '%s': %d",
+					task->bin_path, task->code);
+			continue;
+		}
+
+		link_module(task->module);
+
+		if (task->loaded_in_thread) {
+			register_deferred(task->module);
+			num_parallel++;
+		} else {
+			obs_init_module(task->module);
+		}
+	}
+
+	blog(LOG_INFO, "Loaded %d modules in %.1f ms (%d in parallel on "
+	               "%d threads)", (int)loader->tasks.num,
+	               (double)(os_gettime_ns() - start_time) / 1000000.0,
+	               num_parallel, num_threads + 1);
 }
 
 static const char *obs_load_all_modules_name = "obs_load_all_modules";
@@ -245,8 +414,18 @@ static const char *reset_win32_symbol_paths_name = "reset_win32_symbol_paths";
 
 void obs_load_all_modules(void)
 {
+	struct module_loader loader = {0};
+
 	profile_start(obs_load_all_modules_name);
-	obs_find_modules(load_all_callback, NULL);
+	obs_find_modules(find_module_callback, &loader);
+	load_modules(&loader);
+
+	for (size_t i = 0; i < loader.tasks.num; i++) {
+		bfree(loader.tasks.array[i].bin_path);
+		bfree(loader.tasks.array[i].data_path);
+	}
+	da_free(loader.tasks);
+
 #ifdef _WIN32
 	profile_start(reset_win32_symbol_paths_name);
 	reset_win32_symbol_paths();
@@ -440,6 +619,10 @@ void free_module(struct obs_module *mod)
 		/* os_dlclose(mod->module); */
 	}
 
+	for (size_t i = 0; i < mod->deferred.num; i++)
+		bfree(mod->deferred.array[i].info);
+	da_free(mod->deferred);
+
 	bfree(mod->mod_name);
 	bfree(mod->bin_path);
 	bfree(mod->data_path);
@@ -539,6 +722,22 @@ cleanup:
 			info->free_type_data(info->type_data);            \
 	} while (false)
 
+static bool defer_registration(enum obs_module_registration_type type,
+		const void *info, size_t size)
+{
+	struct obs_module *module = deferring_module;
+	struct obs_module_registration reg;
+
+	if (!module || !size)
+		return false;
+
+	reg.type = type;
+	reg.info = bmemdup(info, size);
+	reg.size = size;
+	da_push_back(module->deferred, &reg);
+	return true;
+}
+
 #define source_warn(format, ...) \
 	blog(LOG_WARNING, "obs_register_source: " format, ##__VA_ARGS__)
 #define output_warn(format, ...) \
@@ -553,6 +752,9 @@ void obs_register_source_s(const struct obs_source_info *info, size_t size)
 	struct obs_source_info data = {0};
 	struct darray *array = NULL;
 
+	if (defer_registration(MODULE_REGISTRATION_SOURCE, info, size))
+		return;
+
 	if (info->type == OBS_SOURCE_TYPE_INPUT) {
 		array = &obs->input_types.da;
 	} else if (info->type == OBS_SOURCE_TYPE_FILTER) {
@@ -643,6 +845,9 @@ error:
 
 void obs_register_output_s(const struct obs_output_info *info, size_t size)
 {
+	if (defer_registration(MODULE_REGISTRATION_OUTPUT, info, size))
+		return;
+
 	if (find_output(info->id)) {
 		output_warn("Output id '%s' already exists!  "
 		                  "Duplicate library?", info->id);
@@ -679,6 +884,9 @@ error:
 
 void obs_register_encoder_s(const struct obs_encoder_info *info, size_t size)
 {
+	if (defer_registration(MODULE_REGISTRATION_ENCODER, info, size))
+		return;
+
 	if (find_encoder(info->id)) {
 		encoder_warn("Encoder id '%s' already exists!  "
 		                  "Duplicate library?", info->id);
@@ -705,6 +913,9 @@ error:
 
 void obs_register_service_s(const struct obs_service_info *info, size_t size)
 {
+	if (defer_registration(MODULE_REGISTRATION_SERVICE, info, size))
+		return;
+
 	if (find_service(info->id)) {
 		service_warn("Service id '%s' already exists!  "
 		                  "Duplicate library?", info->id);
@@ -727,6 +938,9 @@ error:
 
 void obs_regsiter_modal_ui_s(const struct obs_modal_ui *info, size_t size)
 {
+	if (defer_registration(MODULE_REGISTRATION_MODAL_UI, info, size))
+		return;
+
 #define CHECK_REQUIRED_VAL_(info, val, func) \
 	CHECK_REQUIRED_VAL(struct obs_modal_ui, info, val, func)
 	CHECK_REQUIRED_VAL_(info, task,   obs_regsiter_modal_ui);
@@ -743,6 +957,9 @@ error:
 
 void obs_regsiter_modeless_ui_s(const struct obs_modeless_ui *info, size_t size)
 {
+	if (defer_registration(MODULE_REGISTRATION_MODELESS_UI, info, size))
+		return;
+
 #define CHECK_REQUIRED_VAL_(info, val, func) \
 	CHECK_REQUIRED_VAL(struct obs_modeless_ui, info, val, func)
 	CHECK_REQUIRED_VAL_(info, task,   obs_regsiter_modeless_ui);
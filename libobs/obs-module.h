@@ -100,6 +100,16 @@ MODULE_EXPORT void obs_module_unload(void);
 /** Optional: Called when all modules have finished loading */
 MODULE_EXPORT void obs_module_post_load(void);
 
+/**
+ * Optional: Declares that obs_module_load only registers types and touches
+ * nothing else in libobs, so libobs may call it on a worker thread while other
+ * modules are loading.  Types registered this way are added to libobs in the
+ * same order as if the modules had been loaded one at a time.
+ */
+#define OBS_MODULE_LOAD_THREAD_SAFE() \
+	MODULE_EXPORT bool obs_module_load_thread_safe(void); \
+	bool obs_module_load_thread_safe(void) {return true;}
+
 /** Called to set the current locale data for the module.  */
 MODULE_EXPORT void obs_module_set_locale(const char *locale);
 
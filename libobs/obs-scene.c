@@ -462,6 +462,25 @@ static void render_item_texture(struct obs_scene_item *item)
 		obs_source_draw(tex, 0, 0, 0, 0, 0);
 }
 
+static inline bool item_render_changed(struct obs_scene_item *item,
+		uint32_t cx, uint32_t cy)
+{
+	uint32_t generation = obs_source_get_content_generation(item->source);
+
+	if (obs_source_content_tracked(item->source) &&
+	    generation == item->render_generation &&
+	    cx == item->render_cx &&
+	    cy == item->render_cy &&
+	    memcmp(&item->crop, &item->render_crop, sizeof(item->crop)) == 0)
+		return false;
+
+	item->render_generation = generation;
+	item->render_cx = cx;
+	item->render_cy = cy;
+	item->render_crop = item->crop;
+	return true;
+}
+
 static inline void render_item(struct obs_scene_item *item)
 {
 	if (item->item_render) {
@@ -470,6 +489,9 @@ static inline void render_item(struct obs_scene_item *item)
 		uint32_t cx = calc_cx(item, width);
 		uint32_t cy = calc_cy(item, height);
 
+		if (item_render_changed(item, cx, cy))
+			gs_texrender_reset(item->item_render);
+
 		if (cx && cy && gs_texrender_begin(item->item_render, cx, cy)) {
 			float cx_scale = (float)width  / (float)cx;
 			float cy_scale = (float)height / (float)cy;
@@ -504,21 +526,150 @@ static inline void render_item(struct obs_scene_item *item)
 	gs_matrix_pop();
 }
 
-static void scene_video_tick(void *data, float seconds)
+struct cull_rect {
+	float x0, y0;
+	float x1, y1;
+};
+
+static inline bool item_fully_cropped(const struct obs_scene_item *item,
+		uint32_t width, uint32_t height)
 {
-	struct obs_scene *scene = data;
-	struct obs_scene_item *item;
+	return crop_enabled(&item->crop) &&
+		((int64_t)item->crop.left + item->crop.right >=
+				(int64_t)width ||
+		 (int64_t)item->crop.top + item->crop.bottom >=
+				(int64_t)height);
+}
 
-	video_lock(scene);
-	item = scene->first_item;
-	while (item) {
-		if (item->item_render)
-			gs_texrender_reset(item->item_render);
+/* scenes always render to item_render, but if they were ever drawn directly
+ * they could draw outside of their own size */
+static inline bool item_bounded(const struct obs_scene_item *item)
+{
+	return !item_is_scene(item) || item->item_render;
+}
+
+static void get_item_bounds(const struct obs_scene_item *item,
+		uint32_t cx, uint32_t cy, struct cull_rect *rect)
+{
+	struct vec3 corners[4];
+
+	vec3_set(&corners[0], 0.0f,      0.0f,      0.0f);
+	vec3_set(&corners[1], (float)cx, 0.0f,      0.0f);
+	vec3_set(&corners[2], 0.0f,      (float)cy, 0.0f);
+	vec3_set(&corners[3], (float)cx, (float)cy, 0.0f);
+
+	rect->x0 = rect->y0 = M_INFINITE;
+	rect->x1 = rect->y1 = -M_INFINITE;
+
+	for (size_t i = 0; i < 4; i++) {
+		vec3_transform(&corners[i], &corners[i], &item->draw_transform);
+
+		rect->x0 = fminf(rect->x0, corners[i].x);
+		rect->y0 = fminf(rect->y0, corners[i].y);
+		rect->x1 = fmaxf(rect->x1, corners[i].x);
+		rect->y1 = fmaxf(rect->y1, corners[i].y);
+	}
+}
+
+static inline bool rect_contains(const struct cull_rect *outer,
+		const struct cull_rect *inner)
+{
+	return inner->x0 >= outer->x0 && inner->y0 >= outer->y0 &&
+	       inner->x1 <= outer->x1 && inner->y1 <= outer->y1;
+}
+
+/* only counts the pixels the item is guaranteed to cover completely, and
+ * only if it's not rotated at an angle */
+static inline bool get_occluder_rect(const struct obs_scene_item *item,
+		const struct cull_rect *bounds, struct cull_rect *rect)
+{
+	if (fmodf(item->rot, 90.0f) != 0.0f ||
+	    !obs_source_is_opaque(item->source))
+		return false;
+
+	rect->x0 = ceilf(bounds->x0);
+	rect->y0 = ceilf(bounds->y0);
+	rect->x1 = floorf(bounds->x1);
+	rect->y1 = floorf(bounds->y1);
+	return rect->x0 < rect->x1 && rect->y0 < rect->y1;
+}
+
+static inline void cull_item(struct obs_scene_item *item)
+{
+	item->culled = true;
+	os_atomic_inc_long(&obs->video.items_culled);
+}
+
+/*
+ * Walks the items from the top down and marks the ones that can't contribute
+ * any pixels: off-canvas, fully cropped, or completely covered by an opaque
+ * item above them.  Also updates item transforms if the source size changed.
+ */
+static void cull_items(struct obs_scene *scene)
+{
+	DARRAY(struct cull_rect) occluders;
+	struct obs_scene_item *item = scene->first_item;
+	float canvas_cx = (float)obs_source_get_width(scene->source);
+	float canvas_cy = (float)obs_source_get_height(scene->source);
+
+	if (!item)
+		return;
+	while (item->next)
 		item = item->next;
+
+	da_init(occluders);
+
+	for (; item; item = item->prev) {
+		uint32_t width, height;
+		struct cull_rect bounds;
+		struct cull_rect occluder;
+
+		item->culled = false;
+
+		if (obs_source_removed(item->source))
+			continue;
+
+		if (source_size_changed(item))
+			update_item_transform(item);
+
+		if (!item->user_visible)
+			continue;
+
+		width  = obs_source_get_width(item->source);
+		height = obs_source_get_height(item->source);
+
+		if (item_fully_cropped(item, width, height)) {
+			cull_item(item);
+			continue;
+		}
+
+		if (!width || !height || !item_bounded(item))
+			continue;
+
+		get_item_bounds(item, calc_cx(item, width),
+				calc_cy(item, height), &bounds);
+
+		if (bounds.x1 <= 0.0f || bounds.y1 <= 0.0f ||
+		    bounds.x0 >= canvas_cx || bounds.y0 >= canvas_cy) {
+			cull_item(item);
+			continue;
+		}
+
+		for (size_t i = 0; i < occluders.num; i++) {
+			if (rect_contains(occluders.array + i, &bounds)) {
+				cull_item(item);
+				break;
+			}
+		}
+
+		if (item->culled)
+			continue;
+
+		if (get_occluder_rect(item, &bounds, &occluder))
+			da_push_back(occluders, &occluder);
 	}
-	video_unlock(scene);
 
-	UNUSED_PARAMETER(seconds);
+	da_free(occluders);
 }
 
 static void scene_video_render(void *data, gs_effect_t *effect)
@@ -526,10 +677,12 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 	DARRAY(struct obs_scene_item*) remove_items;
 	struct obs_scene *scene = data;
 	struct obs_scene_item *item;
+	bool batching = false;
 
 	da_init(remove_items);
 
 	video_lock(scene);
+	cull_items(scene);
 	item = scene->first_item;
 
 	gs_blend_state_push();
@@ -545,15 +698,27 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 			continue;
 		}
 
-		if (source_size_changed(item))
-			update_item_transform(item);
+		if (item->user_visible && !item->culled) {
+			/* items drawn directly can have their sprites
+			 * combined, items with their own render target
+			 * would split the batch anyway */
+			bool batch = !item->item_render;
+
+			if (batch && !batching)
+				gs_sprite_batch_begin();
+			else if (!batch && batching)
+				gs_sprite_batch_end();
+			batching = batch;
 
-		if (item->user_visible)
 			render_item(item);
+		}
 
 		item = item->next;
 	}
 
+	if (batching)
+		gs_sprite_batch_end();
+
 	gs_blend_state_pop();
 
 	video_unlock(scene);
@@ -667,7 +832,7 @@ static void scene_load_item(struct obs_scene *scene, obs_data_t *item_data)
 
 	} else if (!item->item_render && item_texture_enabled(item)) {
 		obs_enter_graphics();
-		item->item_render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		item->item_render = gs_texrender_create_pooled(GS_RGBA, GS_ZS_NONE);
 		obs_leave_graphics();
 	}
 
@@ -997,7 +1162,6 @@ const struct obs_source_info scene_info =
 	.get_name      = scene_getname,
 	.create        = scene_create,
 	.destroy       = scene_destroy,
-	.video_tick    = scene_video_tick,
 	.video_render  = scene_video_render,
 	.audio_render  = scene_audio_render,
 	.get_width     = scene_getwidth,
@@ -1139,7 +1303,8 @@ obs_scene_t *obs_scene_duplicate(obs_scene_t *scene, const char *name,
 			if (!new_item->item_render &&
 			    item_texture_enabled(new_item)) {
 				obs_enter_graphics();
-				new_item->item_render = gs_texrender_create(
+				new_item->item_render =
+					gs_texrender_create_pooled(
 						GS_RGBA, GS_ZS_NONE);
 				obs_leave_graphics();
 			}
@@ -1395,7 +1560,7 @@ obs_sceneitem_t *obs_scene_add(obs_scene_t *scene, obs_source_t *source)
 
 	if (item_texture_enabled(item)) {
 		obs_enter_graphics();
-		item->item_render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		item->item_render = gs_texrender_create_pooled(GS_RGBA, GS_ZS_NONE);
 		obs_leave_graphics();
 	}
 
@@ -1937,7 +2102,7 @@ void obs_sceneitem_set_crop(obs_sceneitem_t *item,
 		item->item_render = NULL;
 
 	} else if (!item->item_render) {
-		item->item_render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		item->item_render = gs_texrender_create_pooled(GS_RGBA, GS_ZS_NONE);
 	}
 
 	memcpy(&item->crop, crop, sizeof(*crop));
@@ -1977,7 +2142,7 @@ void obs_sceneitem_set_scale_filter(obs_sceneitem_t *item,
 		item->item_render = NULL;
 
 	} else if (!item->item_render) {
-		item->item_render = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+		item->item_render = gs_texrender_create_pooled(GS_RGBA, GS_ZS_NONE);
 	}
 
 	obs_leave_graphics();
@@ -43,9 +43,19 @@ struct obs_scene_item {
 	bool                  selected;
 	bool                  locked;
 
+	/* set for the current render if the item can't contribute any pixels */
+	bool                  culled;
+
 	gs_texrender_t        *item_render;
 	struct obs_sceneitem_crop crop;
 
+	/* what item_render currently contains, it's only rendered again when
+	 * the source content or any of these change */
+	uint32_t              render_generation;
+	uint32_t              render_cx;
+	uint32_t              render_cy;
+	struct obs_sceneitem_crop render_crop;
+
 	struct vec2           pos;
 	struct vec2           scale;
 	float                 rot;
@@ -194,7 +194,7 @@ void set_deinterlace_texture_size(obs_source_t *source)
 {
 	if (source->async_gpu_conversion) {
 		source->async_prev_texrender =
-			gs_texrender_create(GS_BGRX, GS_ZS_NONE);
+			gs_texrender_create_pooled(GS_BGRX, GS_ZS_NONE);
 
 		source->async_prev_texture = gs_texture_create(
 				source->async_convert_width,
@@ -414,6 +414,8 @@ void obs_source_set_deinterlace_mode(obs_source_t *source,
 		source->deinterlace_effect = get_effect(mode);
 		obs_leave_graphics();
 	}
+
+	obs_source_content_changed(source);
 }
 
 enum obs_deinterlace_mode obs_source_get_deinterlace_mode(
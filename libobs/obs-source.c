@@ -67,10 +67,12 @@ static const char *source_signals[] = {
 	"void enable(ptr source, bool enabled)",
 	"void rename(ptr source, string new_name, string prev_name)",
 	"void volume(ptr source, in out float volume)",
+	"void update(ptr source)",
 	"void update_properties(ptr source)",
 	"void update_flags(ptr source, int flags)",
 	"void audio_sync(ptr source, int out int offset)",
 	"void audio_mixers(ptr source, in out int mixers)",
+	"void audio_monitoring(ptr source, int type)",
 	"void filter_add(ptr source, ptr filter)",
 	"void filter_remove(ptr source, ptr filter)",
 	"void reorder_filters(ptr source)",
@@ -114,6 +116,19 @@ static void allocate_audio_output_buffer(struct obs_source *source)
 	}
 }
 
+/* enough for a second of audio, it is drained on every audio tick */
+static void allocate_audio_input_queue(struct obs_source *source)
+{
+	audio_t *audio = obs->audio.audio;
+	size_t channels = audio ?
+		audio_output_get_channels(audio) : MAX_AUDIO_CHANNELS;
+	size_t sample_rate = audio ?
+		audio_output_get_sample_rate(audio) : 48000;
+
+	spsc_circlebuf_init(&source->audio_input_queue,
+			channels * sample_rate * sizeof(float), true);
+}
+
 static inline bool is_async_video_source(const struct obs_source *source)
 {
 	return (source->info.output_flags & OBS_SOURCE_ASYNC_VIDEO) ==
@@ -177,6 +192,8 @@ bool obs_source_init(struct obs_source *source)
 	source->audio_mixers = 0xFF;
 
 	if (is_audio_source(source)) {
+		allocate_audio_input_queue(source);
+
 		pthread_mutex_lock(&obs->data.audio_sources_mutex);
 
 		source->next_audio_source = obs->data.first_audio_source;
@@ -195,6 +212,9 @@ bool obs_source_init(struct obs_source *source)
 	obs_context_data_insert(&source->context,
 			&obs->data.sources_mutex,
 			&obs->data.first_source);
+
+	if (obs_source_needs_tick(source))
+		obs_source_queue_tick(source);
 	return true;
 }
 
@@ -294,7 +314,7 @@ static void obs_source_init_audio_hotkeys(struct obs_source *source)
 
 static obs_source_t *obs_source_create_internal(const char *id,
 		const char *name, obs_data_t *settings,
-		obs_data_t *hotkey_data, bool private)
+		obs_data_t *hotkey_data, bool private, bool deferred)
 {
 	struct obs_source *source = bzalloc(sizeof(struct obs_source));
 
@@ -332,16 +352,22 @@ static obs_source_t *obs_source_create_internal(const char *id,
 	if (!private)
 		obs_source_init_audio_hotkeys(source);
 
+	/* only inputs can wait to be created; scenes, transitions and filters
+	 * are needed as soon as they exist */
+	if (deferred && info && info->type == OBS_SOURCE_TYPE_INPUT)
+		source->deferred = true;
+
 	/* allow the source to be created even if creation fails so that the
 	 * user's data doesn't become lost */
-	if (info)
+	if (info && !source->deferred)
 		source->context.data = info->create(source->context.settings,
 				source);
-	if (!source->context.data)
+	if (!source->context.data && !source->deferred)
 		blog(LOG_ERROR, "Failed to create source '%s'!", name);
 
-	blog(LOG_DEBUG, "%ssource '%s' (%s) created",
-			private ? "private " : "", name, id);
+	blog(LOG_DEBUG, "%ssource '%s' (%s) %s",
+			private ? "private " : "", name, id,
+			source->deferred ? "deferred" : "created");
 	obs_source_dosignal(source, "source_create", NULL);
 
 	source->flags = source->default_flags;
@@ -358,13 +384,64 @@ obs_source_t *obs_source_create(const char *id, const char *name,
 		obs_data_t *settings, obs_data_t *hotkey_data)
 {
 	return obs_source_create_internal(id, name, settings, hotkey_data,
-			false);
+			false, false);
 }
 
 obs_source_t *obs_source_create_private(const char *id, const char *name,
 		obs_data_t *settings)
 {
-	return obs_source_create_internal(id, name, settings, NULL, true);
+	return obs_source_create_internal(id, name, settings, NULL, true,
+			false);
+}
+
+obs_source_t *obs_source_create_deferred(const char *id, const char *name,
+		obs_data_t *settings, obs_data_t *hotkey_data)
+{
+	return obs_source_create_internal(id, name, settings, hotkey_data,
+			false, true);
+}
+
+bool obs_source_instantiate(obs_source_t *source)
+{
+	uint64_t start_time;
+
+	if (!obs_source_valid(source, "obs_source_instantiate"))
+		return false;
+	if (!source->deferred)
+		return source->context.data != NULL;
+
+	pthread_mutex_lock(&obs->data.deferred_mutex);
+
+	if (source->deferred) {
+		start_time = os_gettime_ns();
+
+		source->context.data = source->info.create(
+				source->context.settings, source);
+		source->deferred = false;
+
+		if (source->context.data) {
+			obs_source_load(source);
+			blog(LOG_INFO, "Created deferred source '%s' (%s) "
+					"in %.1f ms",
+					source->context.name,
+					source->info.id,
+					(double)(os_gettime_ns() - start_time) /
+					1000000.0);
+		} else {
+			blog(LOG_ERROR, "Failed to create source '%s'!",
+					source->context.name);
+		}
+	}
+
+	pthread_mutex_unlock(&obs->data.deferred_mutex);
+
+	return source->context.data != NULL;
+}
+
+bool obs_source_deferred(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_deferred") ?
+		source->deferred : false;
 }
 
 static char *get_new_filter_name(obs_source_t *dst, const char *name)
@@ -515,6 +592,13 @@ void obs_source_destroy(struct obs_source *source)
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 		obs_transition_clear(source);
 
+	pthread_mutex_lock(&obs->data.tick_mutex);
+	if (source->tick_queued) {
+		da_erase_item(obs->data.tick_sources, &source);
+		source->tick_queued = false;
+	}
+	pthread_mutex_unlock(&obs->data.tick_mutex);
+
 	pthread_mutex_lock(&obs->data.audio_sources_mutex);
 	if (source->prev_next_audio_source) {
 		*source->prev_next_audio_source = source->next_audio_source;
@@ -569,6 +653,8 @@ void obs_source_destroy(struct obs_source *source)
 		bfree(source->audio_data.data[i]);
 	for (i = 0; i < MAX_AUDIO_CHANNELS; i++)
 		circlebuf_free(&source->audio_input_buf[i]);
+	spsc_circlebuf_free(&source->audio_input_queue);
+	da_free(source->audio_input_packet);
 	audio_resampler_destroy(source->resampler);
 	bfree(source->audio_output_buf[0][0]);
 
@@ -582,6 +668,7 @@ void obs_source_destroy(struct obs_source *source)
 	da_free(source->async_cache);
 	da_free(source->async_frames);
 	da_free(source->filters);
+	da_free(source->fused_stage_values);
 	pthread_mutex_destroy(&source->filter_mutex);
 	pthread_mutex_destroy(&source->audio_actions_mutex);
 	pthread_mutex_destroy(&source->audio_buf_mutex);
@@ -741,6 +828,10 @@ bool obs_source_configurable(const obs_source_t *source)
 
 obs_properties_t *obs_source_properties(const obs_source_t *source)
 {
+	/* the source has to exist to list its properties */
+	if (source && source->deferred)
+		obs_source_instantiate((obs_source_t*)source);
+
 	if (!data_valid(source, "obs_source_properties"))
 		return NULL;
 
@@ -766,6 +857,85 @@ uint32_t obs_get_source_output_flags(const char *id)
 	return info ? info->output_flags : 0;
 }
 
+/* filters are tracked through their settings updates, enable/disable and
+ * add/remove/reorder, and through obs_source_content_changed if they
+ * animate.  other sources that don't report their content changes are
+ * assumed to change every frame. */
+bool obs_source_content_tracked(const obs_source_t *source)
+{
+	uint32_t flags = source->info.output_flags;
+
+	if (source->info.type == OBS_SOURCE_TYPE_FILTER)
+		return true;
+	if ((flags & OBS_SOURCE_ASYNC) != 0)
+		return !deinterlacing_enabled(source);
+
+	return (flags & OBS_SOURCE_TRACKS_CONTENT) != 0;
+}
+
+/* a change in a filter also changes the output of the source it's attached
+ * to, so that the generation of the parent covers the entire filter chain */
+static inline void mark_content_changed(obs_source_t *source)
+{
+	obs_source_t *parent = source->filter_parent;
+
+	os_atomic_inc_long(&source->content_generation);
+	if (parent)
+		os_atomic_inc_long(&parent->content_generation);
+}
+
+void obs_source_content_changed(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_content_changed"))
+		return;
+
+	mark_content_changed(source);
+}
+
+uint32_t obs_source_get_content_generation(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_get_content_generation") ?
+		(uint32_t)source->content_generation : 0;
+}
+
+void obs_source_set_opaque(obs_source_t *source, bool opaque)
+{
+	if (!obs_source_valid(source, "obs_source_set_opaque"))
+		return;
+
+	source->opaque = opaque;
+}
+
+static inline bool async_format_opaque(enum video_format format)
+{
+	return format != VIDEO_FORMAT_NONE &&
+	       format != VIDEO_FORMAT_RGBA &&
+	       format != VIDEO_FORMAT_BGRA;
+}
+
+/* filters can change the alpha of the source, so any source with filters is
+ * treated as transparent */
+bool obs_source_is_opaque(obs_source_t *source)
+{
+	bool has_filters;
+
+	if (!source->enabled)
+		return false;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	has_filters = source->filters.num != 0;
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	if (has_filters)
+		return false;
+
+	if ((source->info.output_flags & OBS_SOURCE_ASYNC) != 0)
+		return source->async_active && source->async_texture &&
+			async_format_opaque(source->async_format);
+
+	return source->opaque;
+}
+
 static void obs_source_deferred_update(obs_source_t *source)
 {
 	if (source->context.data && source->info.update)
@@ -773,6 +943,7 @@ static void obs_source_deferred_update(obs_source_t *source)
 				source->context.settings);
 
 	source->defer_update = false;
+	mark_content_changed(source);
 }
 
 void obs_source_update(obs_source_t *source, obs_data_t *settings)
@@ -785,10 +956,13 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 
 	if (source->info.output_flags & OBS_SOURCE_VIDEO) {
 		source->defer_update = true;
+		obs_source_queue_tick(source);
 	} else if (source->context.data && source->info.update) {
 		source->info.update(source->context.data,
 				source->context.settings);
 	}
+
+	obs_source_dosignal(source, NULL, "update");
 }
 
 void obs_source_update_properties(obs_source_t *source)
@@ -901,6 +1075,7 @@ static void activate_tree(obs_source_t *parent, obs_source_t *child,
 		void *param)
 {
 	os_atomic_inc_long(&child->activate_refs);
+	obs_source_queue_tick(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -910,6 +1085,7 @@ static void deactivate_tree(obs_source_t *parent, obs_source_t *child,
 		void *param)
 {
 	os_atomic_dec_long(&child->activate_refs);
+	obs_source_queue_tick(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -918,6 +1094,7 @@ static void deactivate_tree(obs_source_t *parent, obs_source_t *child,
 static void show_tree(obs_source_t *parent, obs_source_t *child, void *param)
 {
 	os_atomic_inc_long(&child->show_refs);
+	obs_source_queue_tick(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -926,6 +1103,7 @@ static void show_tree(obs_source_t *parent, obs_source_t *child, void *param)
 static void hide_tree(obs_source_t *parent, obs_source_t *child, void *param)
 {
 	os_atomic_dec_long(&child->show_refs);
+	obs_source_queue_tick(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -943,6 +1121,8 @@ void obs_source_activate(obs_source_t *source, enum view_type type)
 		os_atomic_inc_long(&source->activate_refs);
 		obs_source_enum_active_tree(source, activate_tree, NULL);
 	}
+
+	obs_source_queue_tick(source);
 }
 
 void obs_source_deactivate(obs_source_t *source, enum view_type type)
@@ -962,6 +1142,8 @@ void obs_source_deactivate(obs_source_t *source, enum view_type type)
 					NULL);
 		}
 	}
+
+	obs_source_queue_tick(source);
 }
 
 static inline struct obs_source_frame *get_closest_frame(obs_source_t *source,
@@ -991,9 +1173,61 @@ static void async_tick(obs_source_t *source)
 	source->last_sys_timestamp = sys_time;
 	pthread_mutex_unlock(&source->async_mutex);
 
-	if (source->cur_async_frame)
+	if (source->cur_async_frame) {
 		source->async_update_texture = set_async_texture_size(source,
 				source->cur_async_frame);
+		mark_content_changed(source);
+	}
+}
+
+/*
+ * Filters are ticked along with the source they are attached to, so they are
+ * never put in the tick list themselves.
+ */
+void obs_source_queue_tick(obs_source_t *source)
+{
+	if (source->info.type == OBS_SOURCE_TYPE_FILTER)
+		return;
+
+	pthread_mutex_lock(&obs->data.tick_mutex);
+	if (!source->tick_queued) {
+		da_push_back(obs->data.tick_sources, &source);
+		source->tick_queued = true;
+	}
+	pthread_mutex_unlock(&obs->data.tick_mutex);
+}
+
+bool obs_source_needs_tick(obs_source_t *source)
+{
+	bool has_frames;
+
+	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
+		return true;
+	if ((source->info.output_flags & OBS_SOURCE_ALWAYS_TICK) != 0)
+		return true;
+
+	/* show/hide and activate/deactivate are processed in the tick */
+	if (source->show_refs || source->activate_refs)
+		return true;
+	if (source->showing || source->active)
+		return true;
+
+	if (source->defer_update)
+		return true;
+
+	pthread_mutex_lock(&source->async_mutex);
+	has_frames = source->cur_async_frame || source->async_frames.num;
+	pthread_mutex_unlock(&source->async_mutex);
+
+	return has_frames;
+}
+
+static void tick_filters(obs_source_t *source, float seconds)
+{
+	pthread_mutex_lock(&source->filter_mutex);
+	for (size_t i = 0; i < source->filters.num; i++)
+		obs_source_video_tick(source->filters.array[i], seconds);
+	pthread_mutex_unlock(&source->filter_mutex);
 }
 
 void obs_source_video_tick(obs_source_t *source, float seconds)
@@ -1003,6 +1237,11 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 	if (!obs_source_valid(source, "obs_source_video_tick"))
 		return;
 
+	/* deferred sources are created when they are first needed, before
+	 * they are shown or activated */
+	if (source->deferred && (source->show_refs || source->activate_refs))
+		obs_source_instantiate(source);
+
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 		obs_transition_tick(source);
 
@@ -1012,10 +1251,6 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 	if (source->defer_update)
 		obs_source_deferred_update(source);
 
-	/* reset the filter render texture information once every frame */
-	if (source->filter_texrender)
-		gs_texrender_reset(source->filter_texrender);
-
 	/* call show/hide if the reference changed */
 	now_showing = !!source->show_refs;
 	if (now_showing != source->showing) {
@@ -1045,6 +1280,9 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 
 	source->async_rendered = false;
 	source->deinterlace_rendered = false;
+
+	if (source->filters.num)
+		tick_filters(source, seconds);
 }
 
 /* unless the value is 3+ hours worth of frames, this won't overflow */
@@ -1087,6 +1325,18 @@ static void reset_audio_data(obs_source_t *source, uint64_t os_time)
 
 	source->last_audio_input_buf_size = 0;
 	source->audio_ts = os_time;
+}
+
+/* must be called with both audio_mutex and audio_buf_mutex locked */
+static void reset_audio_input(obs_source_t *source, uint64_t os_time)
+{
+	struct spsc_circlebuf *queue = &source->audio_input_queue;
+	size_t queued = spsc_circlebuf_size(queue);
+
+	if (queued)
+		spsc_circlebuf_pop_front(queue, NULL, queued);
+
+	reset_audio_data(source, os_time);
 	source->next_audio_sys_ts_min = os_time;
 }
 
@@ -1097,9 +1347,7 @@ static void handle_ts_jump(obs_source_t *source, uint64_t expected,
 	                "expected value %"PRIu64", input value %"PRIu64,
 	                source->context.name, diff, expected, ts);
 
-	pthread_mutex_lock(&source->audio_buf_mutex);
 	reset_audio_timing(source, ts, os_time);
-	pthread_mutex_unlock(&source->audio_buf_mutex);
 }
 
 static void source_signal_audio_data(obs_source_t *source,
@@ -1184,6 +1432,91 @@ static inline void source_output_audio_push_back(obs_source_t *source,
 	source->last_audio_input_buf_size = 0;
 }
 
+static inline void source_input_audio(obs_source_t *source,
+		const struct audio_data *in, bool push_back)
+{
+	if (push_back && source->audio_ts)
+		source_output_audio_push_back(source, in);
+	else
+		source_output_audio_place(source, in);
+}
+
+/*
+ * Audio is output by the source on its own thread while the audio thread
+ * reads audio_input_buf, so rather than locking audio_buf_mutex, each packet
+ * is queued and only moved to audio_input_buf when the audio buffers are
+ * locked for something else anyway.
+ */
+
+struct audio_input_packet {
+	uint64_t timestamp;
+	uint32_t frames;
+	uint32_t channels;
+	bool     push_back;
+};
+
+static bool queue_audio_input(obs_source_t *source,
+		const struct audio_data *in, bool push_back)
+{
+	struct spsc_circlebuf *queue = &source->audio_input_queue;
+	struct audio_input_packet packet;
+	size_t channels = audio_output_get_channels(obs->audio.audio);
+	size_t size = in->frames * sizeof(float);
+	size_t offset = sizeof(packet);
+
+	if (!spsc_circlebuf_reserve_back(queue, offset + channels * size))
+		return false;
+
+	packet.timestamp = in->timestamp;
+	packet.frames    = in->frames;
+	packet.channels  = (uint32_t)channels;
+	packet.push_back = push_back;
+	spsc_circlebuf_place_back(queue, 0, &packet, sizeof(packet));
+
+	for (size_t i = 0; i < channels; i++) {
+		spsc_circlebuf_place_back(queue, offset, in->data[i], size);
+		offset += size;
+	}
+
+	spsc_circlebuf_commit_back(queue, offset);
+	return true;
+}
+
+void obs_source_drain_audio_input(obs_source_t *source)
+{
+	struct spsc_circlebuf *queue = &source->audio_input_queue;
+	size_t queued = spsc_circlebuf_size(queue);
+
+	while (queued) {
+		struct audio_input_packet packet;
+		struct audio_data in = {0};
+		size_t frames_size;
+		size_t size;
+		uint8_t *data;
+
+		spsc_circlebuf_peek_front(queue, &packet, sizeof(packet));
+		frames_size = packet.frames * sizeof(float);
+		size = sizeof(packet) + packet.channels * frames_size;
+
+		data = spsc_circlebuf_data(queue, size);
+		if (!data) {
+			da_resize(source->audio_input_packet, size);
+			data = source->audio_input_packet.array;
+			spsc_circlebuf_peek_front(queue, data, size);
+		}
+
+		for (uint32_t i = 0; i < packet.channels; i++)
+			in.data[i] = data + sizeof(packet) + i * frames_size;
+		in.frames    = packet.frames;
+		in.timestamp = packet.timestamp;
+
+		source_input_audio(source, &in, packet.push_back);
+
+		spsc_circlebuf_pop_front(queue, NULL, size);
+		queued -= size;
+	}
+}
+
 static inline bool source_muted(obs_source_t *source, uint64_t os_time)
 {
 	if (source->push_to_mute_enabled && source->user_push_to_mute_pressed)
@@ -1243,8 +1576,6 @@ static void source_output_audio_data(obs_source_t *source,
 
 	in.timestamp += source->timing_adjust;
 
-	pthread_mutex_lock(&source->audio_buf_mutex);
-
 	if (source->next_audio_sys_ts_min == in.timestamp) {
 		push_back = true;
 
@@ -1280,15 +1611,16 @@ static void source_output_audio_data(obs_source_t *source,
 		source->last_sync_offset = sync_offset;
 	}
 
-	if (source->monitoring_type != OBS_MONITORING_TYPE_MONITOR_ONLY) {
-		if (push_back && source->audio_ts)
-			source_output_audio_push_back(source, &in);
-		else
-			source_output_audio_place(source, &in);
+	/* if the queue is full (or the audio thread is stuck), fall back to
+	 * locking and writing to the audio buffers directly */
+	if (source->monitoring_type != OBS_MONITORING_TYPE_MONITOR_ONLY &&
+	    !queue_audio_input(source, &in, push_back)) {
+		pthread_mutex_lock(&source->audio_buf_mutex);
+		obs_source_drain_audio_input(source);
+		source_input_audio(source, &in, push_back);
+		pthread_mutex_unlock(&source->audio_buf_mutex);
 	}
 
-	pthread_mutex_unlock(&source->audio_buf_mutex);
-
 	source_signal_audio_data(source, data, source_muted(source, os_time));
 }
 
@@ -1414,7 +1746,7 @@ bool set_async_texture_size(struct obs_source *source,
 		source->async_gpu_conversion = true;
 
 		source->async_texrender =
-			gs_texrender_create(GS_BGRX, GS_ZS_NONE);
+			gs_texrender_create_pooled(GS_BGRX, GS_ZS_NONE);
 
 		source->async_texture = gs_texture_create(
 				source->async_convert_width,
@@ -1509,14 +1841,11 @@ static inline void set_eparami(gs_effect_t *effect, const char *name, int val)
 	gs_effect_set_int(param, val);
 }
 
-static bool update_async_texrender(struct obs_source *source,
-		const struct obs_source_frame *frame,
+static bool render_async_texrender(struct obs_source *source,
 		gs_texture_t *tex, gs_texrender_t *texrender)
 {
 	gs_texrender_reset(texrender);
 
-	upload_raw_frame(tex, frame);
-
 	uint32_t cx = source->async_width;
 	uint32_t cy = source->async_height;
 
@@ -1524,7 +1853,7 @@ static bool update_async_texrender(struct obs_source *source,
 
 	gs_effect_t *conv = obs->video.conversion_effect;
 	gs_technique_t *tech = gs_effect_get_technique(conv,
-			select_conversion_technique(frame->format));
+			select_conversion_technique(source->async_format));
 
 	if (!gs_texrender_begin(texrender, cx, cy))
 		return false;
@@ -1558,11 +1887,76 @@ static bool update_async_texrender(struct obs_source *source,
 	return true;
 }
 
+static bool update_async_texrender(struct obs_source *source,
+		const struct obs_source_frame *frame,
+		gs_texture_t *tex, gs_texrender_t *texrender)
+{
+	upload_raw_frame(tex, frame);
+	return render_async_texrender(source, tex, texrender);
+}
+
+/* async texrenders are pooled, so their target is taken back if the source
+ * goes a frame without being rendered.  the raw frame is still in the upload
+ * texture though, so just convert it again */
+static inline void restore_async_texrender(struct obs_source *source,
+		gs_texture_t *tex, gs_texrender_t *texrender)
+{
+	if (tex && texrender && !gs_texrender_get_texture(texrender))
+		render_async_texrender(source, tex, texrender);
+}
+
+static void restore_async_textures(struct obs_source *source)
+{
+	if (!source->async_gpu_conversion || !source->async_active)
+		return;
+
+	restore_async_texrender(source, source->async_texture,
+			source->async_texrender);
+	if (deinterlacing_enabled(source))
+		restore_async_texrender(source, source->async_prev_texture,
+				source->async_prev_texrender);
+}
+
+struct decompress_frame_data {
+	const struct obs_source_frame *frame;
+	enum convert_type             type;
+	uint8_t                       *ptr;
+	uint32_t                      linesize;
+};
+
+static void decompress_frame_slice(void *param,
+		uint32_t start_y, uint32_t end_y)
+{
+	struct decompress_frame_data *data = param;
+	const struct obs_source_frame *frame = data->frame;
+
+	if (data->type == CONVERT_420)
+		decompress_420((const uint8_t* const*)frame->data,
+				frame->linesize,
+				start_y, end_y, data->ptr, data->linesize);
+
+	else if (data->type == CONVERT_NV12)
+		decompress_nv12((const uint8_t* const*)frame->data,
+				frame->linesize,
+				start_y, end_y, data->ptr, data->linesize);
+
+	else if (data->type == CONVERT_422_Y)
+		decompress_422(frame->data[0], frame->linesize[0],
+				start_y, end_y, data->ptr, data->linesize,
+				true);
+
+	else if (data->type == CONVERT_422_U)
+		decompress_422(frame->data[0], frame->linesize[0],
+				start_y, end_y, data->ptr, data->linesize,
+				false);
+}
+
 bool update_async_texture(struct obs_source *source,
 		const struct obs_source_frame *frame,
 		gs_texture_t *tex, gs_texrender_t *texrender)
 {
 	enum convert_type type      = get_convert_type(frame->format);
+	struct decompress_frame_data data;
 	uint8_t           *ptr;
 	uint32_t          linesize;
 
@@ -1587,23 +1981,13 @@ bool update_async_texture(struct obs_source *source,
 	if (!gs_texture_map(tex, &ptr, &linesize))
 		return false;
 
-	if (type == CONVERT_420)
-		decompress_420((const uint8_t* const*)frame->data,
-				frame->linesize,
-				0, frame->height, ptr, linesize);
+	data.frame    = frame;
+	data.type     = type;
+	data.ptr      = ptr;
+	data.linesize = linesize;
 
-	else if (type == CONVERT_NV12)
-		decompress_nv12((const uint8_t* const*)frame->data,
-				frame->linesize,
-				0, frame->height, ptr, linesize);
-
-	else if (type == CONVERT_422_Y)
-		decompress_422(frame->data[0], frame->linesize[0],
-				0, frame->height, ptr, linesize, true);
-
-	else if (type == CONVERT_422_U)
-		decompress_422(frame->data[0], frame->linesize[0],
-				0, frame->height, ptr, linesize, false);
+	format_conversion_pool_run(obs->video.conversion_pool, frame->height,
+			decompress_frame_slice, &data);
 
 	gs_texture_unmap(tex);
 	return true;
@@ -1757,6 +2141,7 @@ static inline void render_video(obs_source_t *source)
 		if (deinterlacing_enabled(source))
 			deinterlace_update_async_video(source);
 		obs_source_update_async_video(source);
+		restore_async_textures(source);
 	}
 
 	if (!source->context.data || !source->enabled) {
@@ -1915,6 +2300,13 @@ static bool filter_compatible(obs_source_t *source, obs_source_t *filter)
 	return (s_caps & f_caps) == f_caps;
 }
 
+/* filters that could not be fused are retried whenever the chain changes */
+static inline void reset_fuse_failed(obs_source_t *source)
+{
+	for (size_t i = 0; i < source->filters.num; i++)
+		source->filters.array[i]->fuse_failed = false;
+}
+
 void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 {
 	struct calldata cd;
@@ -1946,9 +2338,12 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 		source : source->filters.array[0];
 
 	da_insert(source->filters, 0, &filter);
+	reset_fuse_failed(source);
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	mark_content_changed(source);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -1981,9 +2376,13 @@ static bool obs_source_filter_remove_refless(obs_source_t *source,
 	}
 
 	da_erase(source->filters, idx);
+	reset_fuse_failed(source);
+	filter->fuse_failed = false;
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	mark_content_changed(source);
+
 	calldata_init_fixed(&cd, stack, sizeof(stack));
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
@@ -2093,6 +2492,7 @@ static bool move_filter_dir(obs_source_t *source,
 		source->filters.array[i]->filter_target = next_filter;
 	}
 
+	reset_fuse_failed(source);
 	return true;
 }
 
@@ -2110,8 +2510,10 @@ void obs_source_filter_set_order(obs_source_t *source, obs_source_t *filter,
 	success = move_filter_dir(source, filter, movement);
 	pthread_mutex_unlock(&source->filter_mutex);
 
-	if (success)
+	if (success) {
+		mark_content_changed(source);
 		obs_source_dosignal(source, NULL, "reorder_filters");
+	}
 }
 
 obs_data_t *obs_source_get_settings(const obs_source_t *source)
@@ -2368,6 +2770,7 @@ void obs_source_output_video(obs_source_t *source,
 
 	if (!frame) {
 		source->async_active = false;
+		mark_content_changed(source);
 		return;
 	}
 
@@ -2381,6 +2784,8 @@ void obs_source_output_video(obs_source_t *source,
 		da_push_back(source->async_frames, &output);
 		pthread_mutex_unlock(&source->async_mutex);
 		source->async_active = true;
+
+		obs_source_queue_tick(source);
 	}
 }
 
@@ -2432,12 +2837,15 @@ void obs_source_show_preloaded_video(obs_source_t *source)
 		return;
 
 	source->async_active = true;
+	mark_content_changed(source);
 
+	pthread_mutex_lock(&source->audio_mutex);
 	pthread_mutex_lock(&source->audio_buf_mutex);
 	sys_ts = os_gettime_ns();
 	reset_audio_timing(source, source->last_frame_ts, sys_ts);
-	reset_audio_data(source, sys_ts);
+	reset_audio_input(source, sys_ts);
 	pthread_mutex_unlock(&source->audio_buf_mutex);
+	pthread_mutex_unlock(&source->audio_mutex);
 }
 
 static inline struct obs_audio_data *filter_async_audio(obs_source_t *source,
@@ -2868,6 +3276,240 @@ static inline bool can_bypass(obs_source_t *target, obs_source_t *parent,
 		((parent_flags & OBS_SOURCE_ASYNC) == 0);
 }
 
+static inline bool filter_input_changed(obs_source_t *filter,
+		obs_source_t *parent, int cx, int cy)
+{
+	long generation = parent->content_generation;
+
+	if (obs_source_content_tracked(parent) &&
+	    generation == filter->filter_texrender_generation &&
+	    cx == filter->filter_texrender_cx &&
+	    cy == filter->filter_texrender_cy &&
+	    filter->fused_count == filter->filter_texrender_fused)
+		return false;
+
+	filter->filter_texrender_generation = generation;
+	filter->filter_texrender_cx = cx;
+	filter->filter_texrender_cy = cy;
+	filter->filter_texrender_fused = filter->fused_count;
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* fused filters
+ *
+ * a filter that declares a fuse function draws the fusable filters directly
+ * below it in its own pass.  those filters still get their video_render
+ * called so they can set their effect parameters, but begin/end only save
+ * the parameters instead of drawing.  the filter on top then renders the
+ * input of the lowest of them, and draws it once with an effect combining
+ * all of their functions. */
+
+#define MAX_FUSED_FILTERS 8
+
+static inline bool filter_fusable(const obs_source_t *filter)
+{
+	return filter->info.type == OBS_SOURCE_TYPE_FILTER &&
+		filter->info.fuse_function &&
+		filter->context.data &&
+		filter->enabled &&
+		!filter->fuse_failed;
+}
+
+/* effects are shared between filters of the same type, so the parameters
+ * have to be saved before the next filter sets its own */
+static void fuse_save_values(obs_source_t *filter, gs_effect_t *effect)
+{
+	size_t num = gs_effect_get_num_params(effect);
+
+	filter->fused_stage_effect = effect;
+	da_resize(filter->fused_stage_values, 0);
+
+	for (size_t i = 0; i < num; i++) {
+		gs_eparam_t *param = gs_effect_get_param_by_idx(effect, i);
+		size_t size = gs_effect_get_val_size(param);
+		void *val = gs_effect_get_val(param);
+
+		da_push_back_array(filter->fused_stage_values,
+				(uint8_t*)&size, sizeof(size));
+		if (val)
+			da_push_back_array(filter->fused_stage_values,
+					val, size);
+
+		bfree(val);
+	}
+}
+
+static void fuse_load_values(obs_source_t *filter, gs_effect_t *fused,
+		size_t *idx)
+{
+	const uint8_t *data = filter->fused_stage_values.array;
+	size_t num = gs_effect_get_num_params(filter->fused_stage_effect);
+
+	for (size_t i = 0; i < num; i++) {
+		gs_eparam_t *param = gs_effect_get_param_by_idx(fused,
+				(*idx)++);
+		size_t size;
+
+		memcpy(&size, data, sizeof(size));
+		data += sizeof(size);
+
+		if (size)
+			gs_effect_set_val(param, data, size);
+		data += size;
+	}
+}
+
+/* returns the source whose output the filter and the filters fused into it
+ * are drawn from */
+static obs_source_t *collect_fused_filters(obs_source_t *filter,
+		obs_source_t *parent)
+{
+	obs_source_t *target = obs_filter_get_target(filter);
+	size_t count = 0;
+
+	if (filter_fusable(filter)) {
+		while (target != parent &&
+		       count + 1 < MAX_FUSED_FILTERS &&
+		       filter_fusable(target)) {
+			target->fuse_collecting = true;
+			target->fuse_collected = false;
+			obs_source_main_render(target);
+			target->fuse_collecting = false;
+
+			if (!target->fuse_collected)
+				break;
+
+			/* its own texture is no longer up to date */
+			target->filter_texrender_cx = 0;
+
+			count++;
+			target = obs_filter_get_target(target);
+		}
+	}
+
+	filter->fused_count = count;
+	filter->fused_input = target;
+	return target;
+}
+
+static inline bool fuse_collect_end(obs_source_t *filter, gs_effect_t *effect,
+		uint32_t width, uint32_t height, const char *tech_name)
+{
+	if (!filter->fuse_collecting)
+		return false;
+
+	if (effect && !width && !height &&
+	    (!tech_name || strcmp(tech_name, "Draw") == 0)) {
+		fuse_save_values(filter, effect);
+		filter->fuse_collected = true;
+	}
+
+	return true;
+}
+
+static void fuse_failed(obs_source_t *filter)
+{
+	obs_source_t *stage = filter;
+
+	blog(LOG_WARNING, "Could not combine filters of '%s', drawing them "
+	                  "separately", filter->context.name);
+
+	for (size_t i = 0; i <= filter->fused_count; i++) {
+		stage->fuse_failed = true;
+		stage = obs_filter_get_target(stage);
+	}
+}
+
+/* draws the input of the filter again without fusing, so the filters that
+ * were supposed to be fused still show up in the frame in which fusing them
+ * failed */
+static void fuse_fallback(obs_source_t *filter, gs_effect_t *effect)
+{
+	obs_source_t *target = obs_filter_get_target(filter);
+	uint32_t cx = get_base_width(target);
+	uint32_t cy = get_base_height(target);
+	size_t idx = 0;
+
+	fuse_failed(filter);
+	filter->fused_count = 0;
+	filter->fused_input = target;
+
+	if (!cx || !cy)
+		return;
+
+	if (!filter->filter_texrender)
+		filter->filter_texrender = gs_texrender_create_pooled(GS_RGBA,
+				GS_ZS_NONE);
+
+	/* the target may share its effect with the filter, so the parameters
+	 * of the filter are restored after the target has been rendered */
+	fuse_save_values(filter, effect);
+
+	gs_texrender_reset(filter->filter_texrender);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	if (gs_texrender_begin(filter->filter_texrender, cx, cy)) {
+		struct vec4 clear_color;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+		obs_source_video_render(target);
+
+		gs_texrender_end(filter->filter_texrender);
+	}
+
+	gs_blend_state_pop();
+
+	fuse_load_values(filter, effect, &idx);
+}
+
+static gs_effect_t *get_fused_effect(obs_source_t *filter,
+		gs_effect_t *effect, const char *tech_name)
+{
+	obs_source_t *stages[MAX_FUSED_FILTERS];
+	gs_effect_t *effects[MAX_FUSED_FILTERS];
+	const char *funcs[MAX_FUSED_FILTERS];
+	size_t count = filter->fused_count + 1;
+	obs_source_t *stage = filter;
+	gs_effect_t *fused = NULL;
+	size_t idx = 2;
+
+	if (!tech_name || strcmp(tech_name, "Draw") == 0) {
+		fuse_save_values(filter, effect);
+
+		for (size_t i = count; i > 0; i--) {
+			stages[i - 1] = stage;
+			stage = obs_filter_get_target(stage);
+		}
+
+		for (size_t i = 0; i < count; i++) {
+			effects[i] = stages[i]->fused_stage_effect;
+			funcs[i] = stages[i]->info.fuse_function;
+		}
+
+		fused = gs_effect_create_fused(effects, funcs, count, NULL);
+	}
+
+	if (!fused) {
+		fuse_fallback(filter, effect);
+		return effect;
+	}
+
+	/* the fused effect has ViewProj and image, followed by the params of
+	 * each stage in order */
+	for (size_t i = 0; i < count; i++)
+		fuse_load_values(stages[i], fused, &idx);
+
+	return fused;
+}
+
+/* ------------------------------------------------------------------------- */
+
 bool obs_source_process_filter_begin(obs_source_t *filter,
 		enum gs_color_format format,
 		enum obs_allow_direct_render allow_direct)
@@ -2879,6 +3521,10 @@ bool obs_source_process_filter_begin(obs_source_t *filter,
 	if (!obs_ptr_valid(filter, "obs_source_process_filter_begin"))
 		return false;
 
+	/* only saving parameters for the filter above */
+	if (filter->fuse_collecting)
+		return true;
+
 	target       = obs_filter_get_target(filter);
 	parent       = obs_filter_get_parent(filter);
 
@@ -2893,6 +3539,7 @@ bool obs_source_process_filter_begin(obs_source_t *filter,
 		return false;
 	}
 
+	target       = collect_fused_filters(filter, parent);
 	parent_flags = parent->info.output_flags;
 	cx           = get_base_width(target);
 	cy           = get_base_height(target);
@@ -2913,9 +3560,14 @@ bool obs_source_process_filter_begin(obs_source_t *filter,
 	}
 
 	if (!filter->filter_texrender)
-		filter->filter_texrender = gs_texrender_create(format,
+		filter->filter_texrender = gs_texrender_create_pooled(format,
 				GS_ZS_NONE);
 
+	/* only render the target again if the source or any of its filters
+	 * changed since the last time, otherwise reuse the texture */
+	if (filter_input_changed(filter, parent, cx, cy))
+		gs_texrender_reset(filter->filter_texrender);
+
 	gs_blend_state_push();
 	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
 
@@ -2949,7 +3601,15 @@ void obs_source_process_filter_tech_end(obs_source_t *filter, gs_effect_t *effec
 
 	if (!filter) return;
 
-	target       = obs_filter_get_target(filter);
+	if (fuse_collect_end(filter, effect, width, height, tech_name))
+		return;
+
+	/* falls back to the unfused input if fusing fails */
+	if (filter->fused_count)
+		effect = get_fused_effect(filter, effect, tech_name);
+
+	target       = filter->fused_count ? filter->fused_input :
+	                                     obs_filter_get_target(filter);
 	parent       = obs_filter_get_parent(filter);
 
 	if (!target || !parent)
@@ -2978,7 +3638,15 @@ void obs_source_process_filter_end(obs_source_t *filter, gs_effect_t *effect,
 	if (!obs_ptr_valid(filter, "obs_source_process_filter_end"))
 		return;
 
-	target       = obs_filter_get_target(filter);
+	if (fuse_collect_end(filter, effect, width, height, NULL))
+		return;
+
+	/* falls back to the unfused input if fusing fails */
+	if (filter->fused_count)
+		effect = get_fused_effect(filter, effect, NULL);
+
+	target       = filter->fused_count ? filter->fused_input :
+	                                     obs_filter_get_target(filter);
 	parent       = obs_filter_get_parent(filter);
 	parent_flags = parent->info.output_flags;
 
@@ -3000,6 +3668,8 @@ void obs_source_skip_video_filter(obs_source_t *filter)
 
 	if (!obs_ptr_valid(filter, "obs_source_skip_video_filter"))
 		return;
+	if (filter->fuse_collecting)
+		return;
 
 	target = obs_filter_get_target(filter);
 	parent = obs_filter_get_parent(filter);
@@ -3383,6 +4053,14 @@ uint32_t obs_source_get_audio_mixers(const obs_source_t *source)
 	return source->audio_mixers;
 }
 
+uint64_t obs_source_get_audio_render_time_ns(const obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_get_audio_render_time_ns"))
+		return 0;
+
+	return (uint64_t)os_atomic_load_long(&source->audio_render_time_ns);
+}
+
 void obs_source_draw_set_color_matrix(const struct matrix4 *color_matrix,
 		const struct vec3 *color_range_min,
 		const struct vec3 *color_range_max)
@@ -3521,6 +4199,7 @@ void obs_source_set_enabled(obs_source_t *source, bool enabled)
 		return;
 
 	source->enabled = enabled;
+	mark_content_changed(source);
 
 	calldata_init_fixed(&data, stack, sizeof(stack));
 	calldata_set_ptr(&data, "source", source);
@@ -3908,6 +4587,8 @@ static inline void process_audio_source_tick(obs_source_t *source,
 {
 	pthread_mutex_lock(&source->audio_buf_mutex);
 
+	obs_source_drain_audio_input(source);
+
 	if (source->audio_input_buf[0].size < size) {
 		source->audio_pending = true;
 		pthread_mutex_unlock(&source->audio_buf_mutex);
@@ -4025,6 +4706,8 @@ void obs_source_remove_audio_capture_callback(obs_source_t *source,
 void obs_source_set_monitoring_type(obs_source_t *source,
 		enum obs_monitoring_type type)
 {
+	struct calldata data;
+	uint8_t stack[128];
 	bool was_on;
 	bool now_on;
 
@@ -4046,6 +4729,13 @@ void obs_source_set_monitoring_type(obs_source_t *source,
 	}
 
 	source->monitoring_type = type;
+
+	calldata_init_fixed(&data, stack, sizeof(stack));
+	calldata_set_ptr(&data, "source", source);
+	calldata_set_int(&data, "type", (long long)type);
+
+	signal_handler_signal(source->context.signals, "audio_monitoring",
+			&data);
 }
 
 enum obs_monitoring_type obs_source_get_monitoring_type(
@@ -4085,10 +4775,12 @@ void obs_source_set_async_decoupled(obs_source_t *source, bool decouple)
 
 	source->async_decoupled = decouple;
 	if (decouple) {
+		pthread_mutex_lock(&source->audio_mutex);
 		pthread_mutex_lock(&source->audio_buf_mutex);
 		source->timing_set = false;
-		reset_audio_data(source, 0);
+		reset_audio_input(source, 0);
 		pthread_mutex_unlock(&source->audio_buf_mutex);
+		pthread_mutex_unlock(&source->audio_mutex);
 	}
 }
 
@@ -130,6 +130,46 @@ enum obs_source_type {
  */
 #define OBS_SOURCE_DO_NOT_SELF_MONITOR (1<<9)
 
+/**
+ * Source must be ticked even when it is not showing or active
+ *
+ * By default video_tick is only called for sources that are shown or active
+ * somewhere (and for a frame after they stop being so), sources with pending
+ * async frames or deferred updates, and transitions.  Sources that need to
+ * keep track of time while hidden must specify this flag.
+ */
+#define OBS_SOURCE_ALWAYS_TICK (1<<10)
+
+/**
+ * Source reports when its rendered content changes
+ *
+ * Sources that do not specify this flag are assumed to render something new
+ * every frame, so anything that caches their output (scene item crop/scale
+ * textures, filter input textures) has to re-render them every frame.
+ * Sources with this flag must call obs_source_content_changed whenever their
+ * output changes for any reason other than a settings update, for example
+ * when an animation advances or an image is reloaded.  Settings updates are
+ * already tracked by libobs.
+ *
+ * Async video sources are tracked automatically and do not need this flag.
+ * Filters are always tracked, so filters whose output changes without a
+ * settings update (for example animated filters) must call
+ * obs_source_content_changed as well.
+ */
+#define OBS_SOURCE_TRACKS_CONTENT (1<<11)
+
+/**
+ * Source audio must be rendered on the audio thread
+ *
+ * The audio_render callbacks of sources that do not depend on each other may
+ * be called at the same time from different audio render threads.  Sources
+ * whose audio_render callback touches state shared with other sources
+ * without locking must specify this flag, which makes the audio thread
+ * render them by itself after the other sources at the same depth of the
+ * audio tree are done.
+ */
+#define OBS_SOURCE_SERIAL_AUDIO_RENDER (1<<12)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -428,6 +468,18 @@ struct obs_source_info {
 
 	void (*transition_start)(void *data);
 	void (*transition_stop)(void *data);
+
+	/**
+	 * Name of a function in the filter's effect with the signature
+	 * "float4 func(float4 rgba)" that does to a pixel what the Draw
+	 * technique of the effect does.  Consecutive filters that have one are
+	 * drawn in a single pass with a combined effect.
+	 *
+	 * The filter must draw with obs_source_process_filter_begin and
+	 * obs_source_process_filter_end without changing the size of its
+	 * target.
+	 */
+	const char *fuse_function;
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
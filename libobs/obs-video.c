@@ -30,6 +30,9 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 	struct obs_source    *source;
 	uint64_t             delta_time;
 	float                seconds;
+	DARRAY(struct obs_source*) tick_list;
+
+	da_init(tick_list);
 
 	if (!last_time)
 		last_time = cur_time -
@@ -38,16 +41,35 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 	delta_time = cur_time - last_time;
 	seconds = (float)((double)delta_time / 1000000000.0);
 
-	pthread_mutex_lock(&data->sources_mutex);
-
-	/* call the tick function of each source */
-	source = data->first_source;
-	while (source) {
-		obs_source_video_tick(source, seconds);
-		source = (struct obs_source*)source->context.next;
+	/* only sources in the tick list are ticked.  the list is copied (with
+	 * references) so sources can be added or destroyed while ticking */
+	pthread_mutex_lock(&data->tick_mutex);
+	da_reserve(tick_list, data->tick_sources.num);
+	for (size_t i = 0; i < data->tick_sources.num; i++) {
+		source = obs_source_get_ref(data->tick_sources.array[i]);
+		if (source)
+			da_push_back(tick_list, &source);
+	}
+	pthread_mutex_unlock(&data->tick_mutex);
+
+	for (size_t i = 0; i < tick_list.num; i++)
+		obs_source_video_tick(tick_list.array[i], seconds);
+
+	/* drop sources that went idle, they are queued again as soon as they
+	 * are shown, activated, updated or receive async frames */
+	pthread_mutex_lock(&data->tick_mutex);
+	for (size_t i = 0; i < tick_list.num; i++) {
+		source = tick_list.array[i];
+		if (source->tick_queued && !obs_source_needs_tick(source)) {
+			da_erase_item(data->tick_sources, &source);
+			source->tick_queued = false;
+		}
 	}
+	pthread_mutex_unlock(&data->tick_mutex);
 
-	pthread_mutex_unlock(&data->sources_mutex);
+	for (size_t i = 0; i < tick_list.num; i++)
+		obs_source_release(tick_list.array[i]);
+	da_free(tick_list);
 
 	return cur_time;
 }
@@ -435,31 +457,53 @@ static void set_gpu_converted_data(struct obs_core_video *video,
 	}
 }
 
-static void convert_frame(
-		struct video_frame *output, const struct video_data *input,
-		const struct video_output_info *info)
+struct convert_frame_data {
+	struct video_frame      *output;
+	const struct video_data *input;
+	enum video_format       format;
+};
+
+static void convert_frame_slice(void *param, uint32_t start_y, uint32_t end_y)
 {
-	if (info->format == VIDEO_FORMAT_I420) {
+	struct convert_frame_data *data = param;
+	struct video_frame *output = data->output;
+	const struct video_data *input = data->input;
+
+	if (data->format == VIDEO_FORMAT_I420) {
 		compress_uyvx_to_i420(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
 
-	} else if (info->format == VIDEO_FORMAT_NV12) {
+	} else if (data->format == VIDEO_FORMAT_NV12) {
 		compress_uyvx_to_nv12(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
 
-	} else if (info->format == VIDEO_FORMAT_I444) {
+	} else {
 		convert_uyvx_to_i444(
 				input->data[0], input->linesize[0],
-				0, info->height,
+				start_y, end_y,
 				output->data, output->linesize);
+	}
+}
 
-	} else {
+static void convert_frame(
+		struct video_frame *output, const struct video_data *input,
+		const struct video_output_info *info)
+{
+	struct convert_frame_data data = {output, input, info->format};
+
+	if (info->format != VIDEO_FORMAT_I420 &&
+	    info->format != VIDEO_FORMAT_NV12 &&
+	    info->format != VIDEO_FORMAT_I444) {
 		blog(LOG_ERROR, "convert_frame: unsupported texture format");
+		return;
 	}
+
+	format_conversion_pool_run(obs->video.conversion_pool, info->height,
+			convert_frame_slice, &data);
 }
 
 static inline void copy_rgbx_frame(
@@ -558,6 +602,8 @@ static inline void output_frame(void)
 	frame_ready = download_frame(video, prev_texture, &frame);
 	profile_end(output_frame_download_frame_name);
 
+	gs_texrender_pool_end_frame();
+
 	profile_start(output_frame_gs_flush_name);
 	gs_flush();
 	profile_end(output_frame_gs_flush_name);
@@ -596,6 +642,7 @@ void *obs_graphics_thread(void *param)
 	obs->video.video_time = os_gettime_ns();
 
 	os_set_thread_name("libobs: graphics thread");
+	bmem_set_thread_tag(bmem_register_tag("graphics"));
 
 	const char *video_thread_name =
 		profile_store_name(obs_get_profiler_name_store(),
@@ -622,6 +669,9 @@ void *obs_graphics_thread(void *param)
 		output_frame();
 		profile_end(output_frame_name);
 
+		obs->video.last_items_culled = (uint32_t)os_atomic_set_long(
+				&obs->video.items_culled, 0);
+
 		frame_time_ns = os_gettime_ns() - frame_start;
 
 		profile_end(video_thread_name);
@@ -226,6 +226,33 @@ gs_effect_t *obs_load_effect(gs_effect_t **effect, const char *file)
 	return *effect;
 }
 
+static void set_effect_cache_path(void)
+{
+	struct dstr path = {0};
+
+	if (!obs->module_config_path)
+		return;
+
+	dstr_copy(&path, obs->module_config_path);
+	if (!dstr_is_empty(&path) && dstr_end(&path) != '/')
+		dstr_cat_ch(&path, '/');
+	dstr_cat(&path, "libobs/effect-cache");
+
+	gs_set_effect_cache_path(path.array);
+	dstr_free(&path);
+}
+
+static void log_effect_cache_stats(void)
+{
+	struct gs_effect_cache_stats stats;
+	gs_get_effect_cache_stats(&stats);
+
+	blog(LOG_INFO, "Core effects loaded in %.1f ms "
+	               "(effect cache: %u loaded, %u parsed)",
+	               (double)stats.load_time_ns / 1000000.0,
+	               stats.hits, stats.misses);
+}
+
 static int obs_init_graphics(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
@@ -250,6 +277,8 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 
 	gs_enter_context(video->graphics);
 
+	set_effect_cache_path();
+
 	char *filename = find_libobs_data_file("default.effect");
 	video->default_effect = gs_effect_create_from_file(filename,
 			NULL);
@@ -297,6 +326,8 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 			NULL);
 	bfree(filename);
 
+	log_effect_cache_stats();
+
 	video->point_sampler = gs_samplerstate_create(&point_sampler);
 
 	obs->video.transparent_texture = gs_texture_create(2, 2, GS_RGBA, 1,
@@ -384,6 +415,8 @@ static int obs_init_video(struct obs_video_info *ovi)
 
 	gs_leave_context();
 
+	video->conversion_pool = format_conversion_pool_create(0);
+
 	errorcode = pthread_create(&video->video_thread, NULL,
 			obs_graphics_thread, obs);
 	if (errorcode != 0)
@@ -443,6 +476,9 @@ static void obs_free_video(void)
 
 		circlebuf_free(&video->vframe_info_buffer);
 
+		format_conversion_pool_destroy(video->conversion_pool);
+		video->conversion_pool = NULL;
+
 		memset(&video->textures_rendered, 0,
 				sizeof(video->textures_rendered));
 		memset(&video->textures_output, 0,
@@ -505,6 +541,8 @@ static bool obs_init_audio(struct audio_output_info *ai)
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
 
+	obs_start_audio_render_threads(audio);
+
 	errorcode = audio_output_open(&audio->audio, ai);
 	if (errorcode == AUDIO_OUTPUT_SUCCESS)
 		return true;
@@ -522,6 +560,8 @@ static void obs_free_audio(void)
 	if (audio->audio)
 		audio_output_close(audio->audio);
 
+	obs_stop_audio_render_threads(audio);
+
 	circlebuf_free(&audio->buffered_timestamps);
 	da_free(audio->render_order);
 	da_free(audio->root_nodes);
@@ -543,6 +583,8 @@ static bool obs_init_data(void)
 
 	pthread_mutex_init_value(&obs->data.displays_mutex);
 	pthread_mutex_init_value(&obs->data.draw_callbacks_mutex);
+	pthread_mutex_init_value(&obs->data.tick_mutex);
+	pthread_mutex_init_value(&obs->data.deferred_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -560,8 +602,12 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init(&data->services_mutex, &attr) != 0)
 		goto fail;
+	if (pthread_mutex_init(&data->deferred_mutex, &attr) != 0)
+		goto fail;
 	if (pthread_mutex_init(&obs->data.draw_callbacks_mutex, NULL) != 0)
 		goto fail;
+	if (pthread_mutex_init(&obs->data.tick_mutex, NULL) != 0)
+		goto fail;
 	if (!obs_view_init(&data->main_view))
 		goto fail;
 
@@ -618,7 +664,10 @@ static void obs_free_data(void)
 	pthread_mutex_destroy(&data->encoders_mutex);
 	pthread_mutex_destroy(&data->services_mutex);
 	pthread_mutex_destroy(&data->draw_callbacks_mutex);
+	pthread_mutex_destroy(&data->tick_mutex);
+	pthread_mutex_destroy(&data->deferred_mutex);
 	da_free(data->draw_callbacks);
+	da_free(data->tick_sources);
 }
 
 static const char *obs_signals[] = {
@@ -1449,7 +1498,8 @@ float obs_get_master_volume(void)
 	return obs ? obs->audio.user_volume : 0.0f;
 }
 
-static obs_source_t *obs_load_source_type(obs_data_t *source_data)
+static obs_source_t *obs_load_source_type(obs_data_t *source_data,
+		bool defer)
 {
 	obs_data_array_t *filters = obs_data_get_array(source_data, "filters");
 	obs_source_t *source;
@@ -1465,7 +1515,13 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 	int          di_mode;
 	int          monitoring_type;
 
-	source = obs_source_create(id, name, settings, hotkeys);
+	/* monitored sources are heard even when they aren't active */
+	monitoring_type = (int)obs_data_get_int(source_data, "monitoring_type");
+	if (defer && monitoring_type == OBS_MONITORING_TYPE_NONE)
+		source = obs_source_create_deferred(id, name, settings,
+				hotkeys);
+	else
+		source = obs_source_create(id, name, settings, hotkeys);
 
 	obs_data_release(hotkeys);
 
@@ -1515,7 +1571,6 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 	obs_source_set_deinterlace_field_order(source,
 			(enum obs_deinterlace_field_order)di_order);
 
-	monitoring_type = (int)obs_data_get_int(source_data, "monitoring_type");
 	obs_source_set_monitoring_type(source,
 			(enum obs_monitoring_type)monitoring_type);
 
@@ -1533,7 +1588,7 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 				obs_data_array_item(filters, i);
 
 			obs_source_t *filter = obs_load_source_type(
-					filter_data);
+					filter_data, false);
 			if (filter) {
 				obs_source_filter_add(source, filter);
 				obs_source_release(filter);
@@ -1552,14 +1607,13 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data)
 
 obs_source_t *obs_load_source(obs_data_t *source_data)
 {
-	return obs_load_source_type(source_data);
+	return obs_load_source_type(source_data, false);
 }
 
-void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
+static void load_sources(obs_data_array_t *array,
+		const bool *deferred, obs_load_source_cb cb,
 		void *private_data)
 {
-	if (!obs) return;
-
 	struct obs_core_data *data = &obs->data;
 	DARRAY(obs_source_t*) sources;
 	size_t count;
@@ -1574,7 +1628,8 @@ void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 
 	for (i = 0; i < count; i++) {
 		obs_data_t   *source_data = obs_data_array_item(array, i);
-		obs_source_t *source      = obs_load_source(source_data);
+		obs_source_t *source      = obs_load_source_type(source_data,
+				deferred && deferred[i]);
 
 		da_push_back(sources, &source);
 
@@ -1602,6 +1657,103 @@ void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 	da_free(sources);
 }
 
+void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
+		void *private_data)
+{
+	if (!obs) return;
+
+	load_sources(array, NULL, cb, private_data);
+}
+
+static inline bool is_scene_data(obs_data_t *source_data)
+{
+	return strcmp(obs_data_get_string(source_data, "id"), "scene") == 0;
+}
+
+static size_t find_source_data(obs_data_t **source_data, size_t count,
+		const char *name)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (strcmp(obs_data_get_string(source_data[i], "name"),
+					name) == 0)
+			return i;
+	}
+
+	return DARRAY_INVALID;
+}
+
+static void mark_needed(obs_data_t **source_data, size_t count,
+		bool *needed, const char *name)
+{
+	size_t idx = find_source_data(source_data, count, name);
+	obs_data_t *settings;
+	obs_data_array_t *items;
+	size_t num_items;
+
+	if (idx == DARRAY_INVALID || needed[idx])
+		return;
+
+	needed[idx] = true;
+	if (!is_scene_data(source_data[idx]))
+		return;
+
+	settings = obs_data_get_obj(source_data[idx], "settings");
+	items = obs_data_get_array(settings, "items");
+	num_items = obs_data_array_count(items);
+
+	for (size_t i = 0; i < num_items; i++) {
+		obs_data_t *item = obs_data_array_item(items, i);
+		mark_needed(source_data, count, needed,
+				obs_data_get_string(item, "name"));
+		obs_data_release(item);
+	}
+
+	obs_data_array_release(items);
+	obs_data_release(settings);
+}
+
+void obs_load_sources_deferred(obs_data_array_t *array,
+		const char **scenes, size_t num_scenes,
+		obs_load_source_cb cb, void *private_data)
+{
+	obs_data_t **source_data;
+	bool *needed;
+	bool *deferred;
+	size_t count;
+	size_t num_deferred = 0;
+
+	if (!obs) return;
+
+	count = obs_data_array_count(array);
+	source_data = bmalloc(sizeof(obs_data_t*) * (count ? count : 1));
+	needed = bzalloc(sizeof(bool) * (count ? count : 1));
+	deferred = bzalloc(sizeof(bool) * (count ? count : 1));
+
+	for (size_t i = 0; i < count; i++)
+		source_data[i] = obs_data_array_item(array, i);
+
+	/* everything the given scenes draw is created right away, including
+	 * the contents of nested scenes */
+	for (size_t i = 0; i < num_scenes; i++)
+		mark_needed(source_data, count, needed, scenes[i]);
+
+	for (size_t i = 0; i < count; i++) {
+		deferred[i] = !needed[i] && !is_scene_data(source_data[i]);
+		if (deferred[i])
+			num_deferred++;
+		obs_data_release(source_data[i]);
+	}
+
+	blog(LOG_INFO, "Deferring creation of %d of %d sources",
+			(int)num_deferred, (int)count);
+
+	load_sources(array, deferred, cb, private_data);
+
+	bfree(source_data);
+	bfree(needed);
+	bfree(deferred);
+}
+
 obs_data_t *obs_save_source(obs_source_t *source)
 {
 	obs_data_array_t *filters = obs_data_array_create();
@@ -1629,7 +1781,13 @@ obs_data_t *obs_save_source(obs_source_t *source)
 	obs_source_save(source);
 	hotkeys = obs_hotkeys_save_source(source);
 
-	if (hotkeys) {
+	if (hotkeys && source->deferred && hotkey_data) {
+		/* a deferred source hasn't registered its own hotkeys yet, so
+		 * keep the bindings it was loaded with */
+		obs_data_apply(hotkey_data, hotkeys);
+		obs_data_release(hotkeys);
+
+	} else if (hotkeys) {
 		obs_data_release(hotkey_data);
 		source->context.hotkey_data = hotkeys;
 		hotkey_data = hotkeys;
@@ -1988,3 +2146,8 @@ uint32_t obs_get_lagged_frames(void)
 {
 	return obs ? obs->video.lagged_frames : 0;
 }
+
+uint32_t obs_get_scene_items_culled(void)
+{
+	return obs ? obs->video.last_items_culled : 0;
+}
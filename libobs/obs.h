@@ -570,6 +570,16 @@ typedef void (*obs_load_source_cb)(void *private_data, obs_source_t *source);
 EXPORT void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 		void *private_data);
 
+/**
+ * Loads sources from a data array, but only creates the inputs used by the
+ * given scenes.  The other inputs are loaded with their settings and filters
+ * and are created the first time they are shown or activated, or when
+ * obs_source_instantiate is called.
+ */
+EXPORT void obs_load_sources_deferred(obs_data_array_t *array,
+		const char **scenes, size_t num_scenes,
+		obs_load_source_cb cb, void *private_data);
+
 /** Saves sources to a data array */
 EXPORT obs_data_array_t *obs_save_sources(void);
 
@@ -639,6 +649,12 @@ EXPORT uint64_t obs_get_average_frame_time_ns(void);
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
+/**
+ * Gets the number of scene items that were skipped in the last frame because
+ * they were off-canvas, fully cropped or covered by an opaque item
+ */
+EXPORT uint32_t obs_get_scene_items_culled(void);
+
 
 /* ------------------------------------------------------------------------- */
 /* Display context */
@@ -746,6 +762,16 @@ EXPORT bool obs_is_source_configurable(const char *id);
 
 EXPORT bool obs_source_configurable(const obs_source_t *source);
 
+/**
+ * Creates a source that was deferred by obs_load_sources_deferred.  Returns
+ * true if the source exists afterwards.  Must not be called from within the
+ * graphics context.
+ */
+EXPORT bool obs_source_instantiate(obs_source_t *source);
+
+/** Returns true if the source has not been created yet */
+EXPORT bool obs_source_deferred(const obs_source_t *source);
+
 /**
  * Returns the properties list for a specific existing source.  Free with
  * obs_properties_destroy
@@ -868,6 +894,10 @@ EXPORT void obs_source_set_audio_mixers(obs_source_t *source, uint32_t mixers);
 /** Gets audio mixer flags */
 EXPORT uint32_t obs_source_get_audio_mixers(const obs_source_t *source);
 
+/** Gets how long the last audio render of the source took, in nanoseconds */
+EXPORT uint64_t obs_source_get_audio_render_time_ns(
+		const obs_source_t *source);
+
 /**
  * Increments the 'showing' reference counter to indicate that the source is
  * being shown somewhere.  If the reference counter was 0, will call the 'show'
@@ -1015,6 +1045,29 @@ EXPORT void obs_source_output_audio(obs_source_t *source,
 /** Signal an update to any currently used properties via 'update_properties' */
 EXPORT void obs_source_update_properties(obs_source_t *source);
 
+/**
+ * Signals that the rendered content of the source has changed.  Only needed
+ * for filters and for sources with the OBS_SOURCE_TRACKS_CONTENT output flag.
+ */
+EXPORT void obs_source_content_changed(obs_source_t *source);
+
+/**
+ * Gets the content generation of the source.  The value changes whenever the
+ * rendered output of the source or any of its filters may have changed, and
+ * can be compared against a previously stored value to decide whether cached
+ * renders of the source are still valid.  Sources without the
+ * OBS_SOURCE_TRACKS_CONTENT flag (other than async video sources) may change
+ * every frame without it changing.
+ */
+EXPORT uint32_t obs_source_get_content_generation(const obs_source_t *source);
+
+/**
+ * Sets whether the source covers its entire area with opaque pixels, which
+ * allows scenes to skip rendering items underneath it.  Async video sources
+ * are detected automatically from their frame format.
+ */
+EXPORT void obs_source_set_opaque(obs_source_t *source, bool opaque);
+
 /** Gets the current async video frame */
 EXPORT struct obs_source_frame *obs_source_get_frame(obs_source_t *source);
 
@@ -14,6 +14,7 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+
 #include <stdlib.h>
 #include <string.h>
 #include "base.h"
@@ -21,67 +22,52 @@
 #include "platform.h"
 #include "threading.h"
 
-/*
- * NOTE: totally jacked the mem alignment trick from ffmpeg, credit to them:
- *   http://www.ffmpeg.org/
- */
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
 #define ALIGNMENT 32
 
-/* TODO: use memalign for non-windows systems */
-#if defined(_WIN32)
-#define ALIGNED_MALLOC 1
-#else
-#define ALIGNMENT_HACK 1
-#endif
-
 static void *a_malloc(size_t size)
 {
-#ifdef ALIGNED_MALLOC
+#ifdef _WIN32
 	return _aligned_malloc(size, ALIGNMENT);
-#elif ALIGNMENT_HACK
+#else
 	void *ptr = NULL;
-	long diff;
-
-	ptr  = malloc(size + ALIGNMENT);
-	if (ptr) {
-		diff = ((~(long)ptr) & (ALIGNMENT - 1)) + 1;
-		ptr  = (char *)ptr + diff;
-		((char *)ptr)[-1] = (char)diff;
-	}
-
+	if (posix_memalign(&ptr, ALIGNMENT, size) != 0)
+		return NULL;
 	return ptr;
-#else
-	return malloc(size);
 #endif
 }
 
 static void *a_realloc(void *ptr, size_t size)
 {
-#ifdef ALIGNED_MALLOC
+#ifdef _WIN32
 	return _aligned_realloc(ptr, size, ALIGNMENT);
-#elif ALIGNMENT_HACK
-	long diff;
+#else
+	void *new_ptr;
 
 	if (!ptr)
 		return a_malloc(size);
-	diff = ((char *)ptr)[-1];
-	ptr = realloc((char*)ptr - diff, size + diff);
-	if (ptr)
-		ptr = (char *)ptr + diff;
-	return ptr;
-#else
-	return realloc(ptr, size);
+
+	/* realloc does not keep the alignment, so if the memory happens to
+	 * end up unaligned, move it again */
+	ptr = realloc(ptr, size);
+	if (!ptr || ((uintptr_t)ptr & (ALIGNMENT - 1)) == 0)
+		return ptr;
+
+	new_ptr = a_malloc(size);
+	if (new_ptr)
+		memcpy(new_ptr, ptr, size);
+	free(ptr);
+	return new_ptr;
 #endif
 }
 
 static void a_free(void *ptr)
 {
-#ifdef ALIGNED_MALLOC
+#ifdef _WIN32
 	_aligned_free(ptr);
-#elif ALIGNMENT_HACK
-	if (ptr)
-		free((char *)ptr - ((char*)ptr)[-1]);
 #else
 	free(ptr);
 #endif
@@ -95,43 +81,383 @@ void base_set_allocator(struct base_allocator *defs)
 	memcpy(&alloc, defs, sizeof(struct base_allocator));
 }
 
-void *bmalloc(size_t size)
+/* ------------------------------------------------------------------------- */
+/* allocation header */
+
+/*
+ * Every allocation starts with a header that stores its size and tag, so
+ * that it can be accounted for when it is freed.  The header takes up
+ * ALIGNMENT bytes so the memory after it stays aligned.
+ */
+
+struct bmem_header {
+	size_t   size;
+	uint32_t tag;
+	/* size class + 1 if the memory can be cached, 0 otherwise */
+	uint32_t size_class;
+};
+
+#define HEADER_SIZE ALIGNMENT
+
+static inline struct bmem_header *get_header(void *ptr)
+{
+	return (struct bmem_header*)((uint8_t*)ptr - HEADER_SIZE);
+}
+
+static inline void *get_data(struct bmem_header *header)
+{
+	return (uint8_t*)header + HEADER_SIZE;
+}
+
+/* ------------------------------------------------------------------------- */
+/* statistics */
+
+/*
+ * Statistics are off by default, counting every allocation in shared
+ * counters is too costly to always do.  Allocations made while they're off
+ * are marked as uncounted, so they're not subtracted when freed later.
+ */
+
+#define UNCOUNTED_TAG 0xFFFFFFFF
+
+static volatile bool stats_enabled = false;
+
+static inline int64_t atomic_add64(volatile int64_t *ptr, int64_t val)
+{
+#ifdef _WIN32
+	return InterlockedExchangeAdd64((volatile LONG64*)ptr, val) + val;
+#else
+	return __sync_add_and_fetch(ptr, val);
+#endif
+}
+
+static inline int64_t load64(const volatile int64_t *ptr)
+{
+#if defined(_WIN64)
+	return *ptr;
+#elif defined(_WIN32)
+	return InterlockedCompareExchange64((volatile LONG64*)ptr, 0, 0);
+#else
+	return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline void atomic_max64(volatile int64_t *ptr, int64_t val)
+{
+	int64_t cur = load64(ptr);
+
+	while (val > cur) {
+#ifdef _WIN32
+		int64_t prev = InterlockedCompareExchange64(
+				(volatile LONG64*)ptr, val, cur);
+#else
+		int64_t prev = __sync_val_compare_and_swap(ptr, cur, val);
+#endif
+		if (prev == cur)
+			break;
+		cur = prev;
+	}
+}
+
+/* aligned to a cache line so tags used by different threads don't share
+ * one */
+#ifdef _MSC_VER
+#define CACHE_ALIGNED __declspec(align(64))
+#else
+#define CACHE_ALIGNED __attribute__((aligned(64)))
+#endif
+
+struct CACHE_ALIGNED bmem_counters {
+	volatile int64_t bytes;
+	volatile int64_t peak_bytes;
+	volatile int64_t allocs;
+	volatile int64_t total_allocs;
+	volatile int64_t total_bytes;
+};
+
+static struct bmem_counters tag_counters[BMEM_MAX_TAGS];
+static struct bmem_counters total_counters;
+static char tag_names[BMEM_MAX_TAGS][32] = {"untagged"};
+static volatile long num_tags = 1;
+static pthread_mutex_t tag_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline void add_bytes(struct bmem_counters *counters, int64_t size)
+{
+	int64_t bytes = atomic_add64(&counters->bytes, size);
+	if (size > 0) {
+		atomic_add64(&counters->total_bytes, size);
+		atomic_max64(&counters->peak_bytes, bytes);
+	}
+}
+
+static inline void add_alloc(struct bmem_counters *counters, int64_t count)
+{
+	atomic_add64(&counters->allocs, count);
+	if (count > 0)
+		atomic_add64(&counters->total_allocs, count);
+}
+
+static inline void stats_alloc(uint32_t tag, size_t size)
+{
+	if (tag == UNCOUNTED_TAG)
+		return;
+
+	add_alloc(&tag_counters[tag], 1);
+	add_alloc(&total_counters, 1);
+	add_bytes(&tag_counters[tag], (int64_t)size);
+	add_bytes(&total_counters, (int64_t)size);
+}
+
+static inline void stats_free(uint32_t tag, size_t size)
+{
+	if (tag == UNCOUNTED_TAG)
+		return;
+
+	add_alloc(&tag_counters[tag], -1);
+	add_alloc(&total_counters, -1);
+	add_bytes(&tag_counters[tag], -(int64_t)size);
+	add_bytes(&total_counters, -(int64_t)size);
+}
+
+static inline void stats_resize(uint32_t tag, size_t old_size, size_t size)
+{
+	int64_t diff = (int64_t)size - (int64_t)old_size;
+
+	if (tag == UNCOUNTED_TAG)
+		return;
+
+	add_bytes(&tag_counters[tag], diff);
+	add_bytes(&total_counters, diff);
+}
+
+static void get_counters(struct bmem_counters *counters,
+		struct bmem_stats *stats)
+{
+	stats->bytes        = (uint64_t)load64(&counters->bytes);
+	stats->peak_bytes   = (uint64_t)load64(&counters->peak_bytes);
+	stats->allocs       = (uint64_t)load64(&counters->allocs);
+	stats->total_allocs = (uint64_t)load64(&counters->total_allocs);
+	stats->total_bytes  = (uint64_t)load64(&counters->total_bytes);
+}
+
+/* ------------------------------------------------------------------------- */
+/* per-thread data */
+
+/*
+ * Small allocations are rounded up to a power of two size class, and when
+ * freed are kept by the thread that frees them so that the next allocation
+ * of that class on the thread does not have to go through the allocator.
+ */
+
+#define MIN_CLASS_SIZE     32
+#define NUM_SIZE_CLASSES   7 /* up to 2048 bytes */
+#define MAX_CACHED_BYTES   16384 /* per size class and thread */
+
+struct bmem_thread {
+	uint32_t           tag;
+	struct bmem_header *blocks[NUM_SIZE_CLASSES];
+	size_t             num_blocks[NUM_SIZE_CLASSES];
+};
+
+#ifdef _MSC_VER
+static __declspec(thread) struct bmem_thread *thread_data = NULL;
+#else
+static __thread struct bmem_thread *thread_data = NULL;
+#endif
+
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_key;
+static volatile bool thread_cache_enabled = false;
+
+static inline size_t class_size(uint32_t size_class)
+{
+	return (size_t)MIN_CLASS_SIZE << size_class;
+}
+
+static inline int get_size_class(size_t size)
 {
-	void *ptr = alloc.malloc(size);
-	if (!ptr && !size)
-		ptr = alloc.malloc(1);
-	if (!ptr) {
+	uint32_t size_class = 0;
+
+	if (size > class_size(NUM_SIZE_CLASSES - 1))
+		return -1;
+
+	while (class_size(size_class) < size)
+		size_class++;
+	return (int)size_class;
+}
+
+static void free_thread_data(void *data)
+{
+	struct bmem_thread *thread = data;
+
+	for (size_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+		struct bmem_header *header = thread->blocks[i];
+
+		while (header) {
+			struct bmem_header *next =
+				*(struct bmem_header**)get_data(header);
+			alloc.free(header);
+			header = next;
+		}
+	}
+
+	alloc.free(thread);
+	thread_data = NULL;
+}
+
+static void create_thread_key(void)
+{
+	pthread_key_create(&thread_key, free_thread_data);
+}
+
+static struct bmem_thread *get_thread_data(void)
+{
+	struct bmem_thread *thread = thread_data;
+	if (thread)
+		return thread;
+
+	pthread_once(&thread_key_once, create_thread_key);
+
+	thread = alloc.malloc(sizeof(struct bmem_thread));
+	if (!thread)
+		return NULL;
+
+	memset(thread, 0, sizeof(struct bmem_thread));
+	pthread_setspecific(thread_key, thread);
+	thread_data = thread;
+	return thread;
+}
+
+static inline uint32_t get_thread_tag(void)
+{
+	struct bmem_thread *thread = thread_data;
+	return thread ? thread->tag : 0;
+}
+
+static inline struct bmem_header *cache_pop(int size_class)
+{
+	struct bmem_thread *thread = get_thread_data();
+	struct bmem_header *header;
+
+	if (!thread || !thread->blocks[size_class])
+		return NULL;
+
+	header = thread->blocks[size_class];
+	thread->blocks[size_class] = *(struct bmem_header**)get_data(header);
+	thread->num_blocks[size_class]--;
+	return header;
+}
+
+static inline bool cache_push(struct bmem_header *header)
+{
+	uint32_t size_class = header->size_class - 1;
+	struct bmem_thread *thread = get_thread_data();
+
+	if (!thread || thread->num_blocks[size_class] >=
+			MAX_CACHED_BYTES / class_size(size_class))
+		return false;
+
+	*(struct bmem_header**)get_data(header) = thread->blocks[size_class];
+	thread->blocks[size_class] = header;
+	thread->num_blocks[size_class]++;
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void *tagged_malloc(size_t size, uint32_t tag)
+{
+	struct bmem_header *header = NULL;
+	int size_class = thread_cache_enabled ? get_size_class(size) : -1;
+
+	if (size_class != -1) {
+		header = cache_pop(size_class);
+		if (!header)
+			header = alloc.malloc(HEADER_SIZE +
+					class_size(size_class));
+	} else {
+		header = alloc.malloc(HEADER_SIZE + size);
+	}
+
+	if (!header) {
 		os_breakpoint();
 		bcrash("Out of memory while trying to allocate %lu bytes",
 				(unsigned long)size);
 	}
 
+	if (!stats_enabled)
+		tag = UNCOUNTED_TAG;
+	else if (tag == UNCOUNTED_TAG)
+		tag = get_thread_tag();
+
+	header->size = size;
+	header->tag = tag;
+	header->size_class = (uint32_t)(size_class + 1);
+
+	stats_alloc(tag, size);
 	os_atomic_inc_long(&num_allocs);
-	return ptr;
+	return get_data(header);
+}
+
+void *bmalloc(size_t size)
+{
+	return tagged_malloc(size, get_thread_tag());
 }
 
 void *brealloc(void *ptr, size_t size)
 {
+	struct bmem_header *header;
+	size_t old_size;
+
 	if (!ptr)
-		os_atomic_inc_long(&num_allocs);
+		return bmalloc(size);
+
+	header = get_header(ptr);
+	old_size = header->size;
 
-	ptr = alloc.realloc(ptr, size);
-	if (!ptr && !size)
-		ptr = alloc.realloc(ptr, 1);
-	if (!ptr) {
+	if (header->size_class) {
+		void *new_ptr;
+
+		/* still fits in its size class */
+		if (size <= class_size(header->size_class - 1)) {
+			stats_resize(header->tag, old_size, size);
+			header->size = size;
+			return ptr;
+		}
+
+		new_ptr = tagged_malloc(size, header->tag);
+		memcpy(new_ptr, ptr, old_size);
+		bfree(ptr);
+		return new_ptr;
+	}
+
+	header = alloc.realloc(header, HEADER_SIZE + size);
+	if (!header) {
 		os_breakpoint();
 		bcrash("Out of memory while trying to allocate %lu bytes",
 				(unsigned long)size);
 	}
 
-	return ptr;
+	stats_resize(header->tag, old_size, size);
+	header->size = size;
+	return get_data(header);
 }
 
 void bfree(void *ptr)
 {
-	if (ptr)
-		os_atomic_dec_long(&num_allocs);
-	alloc.free(ptr);
+	struct bmem_header *header;
+
+	if (!ptr)
+		return;
+
+	header = get_header(ptr);
+	stats_free(header->tag, header->size);
+	os_atomic_dec_long(&num_allocs);
+
+	if (header->size_class && thread_cache_enabled && cache_push(header))
+		return;
+
+	alloc.free(header);
 }
 
 long bnum_allocs(void)
@@ -152,3 +478,91 @@ void *bmemdup(const void *ptr, size_t size)
 
 	return out;
 }
+
+/* ------------------------------------------------------------------------- */
+
+void bmem_enable_thread_cache(bool enable)
+{
+	thread_cache_enabled = enable;
+}
+
+void bmem_enable_stats(bool enable)
+{
+	stats_enabled = enable;
+}
+
+int bmem_register_tag(const char *name)
+{
+	long count;
+	int tag = 0;
+
+	if (!name || !*name)
+		return 0;
+
+	pthread_mutex_lock(&tag_mutex);
+
+	count = num_tags;
+	for (long i = 0; i < count; i++) {
+		if (strcmp(tag_names[i], name) == 0) {
+			tag = (int)i;
+			goto unlock;
+		}
+	}
+
+	if (count == BMEM_MAX_TAGS) {
+		blog(LOG_WARNING, "bmem_register_tag: Too many tags, "
+		                  "'%s' will be counted as untagged", name);
+		goto unlock;
+	}
+
+	strncpy(tag_names[count], name, sizeof(tag_names[count]) - 1);
+	os_atomic_set_long(&num_tags, count + 1);
+	tag = (int)count;
+
+unlock:
+	pthread_mutex_unlock(&tag_mutex);
+	return tag;
+}
+
+int bmem_set_thread_tag(int tag)
+{
+	struct bmem_thread *thread;
+	int prev_tag;
+
+	if (tag < 0 || tag >= os_atomic_load_long(&num_tags))
+		tag = 0;
+
+	thread = get_thread_data();
+	if (!thread)
+		return 0;
+
+	prev_tag = (int)thread->tag;
+	thread->tag = (uint32_t)tag;
+	return prev_tag;
+}
+
+int bmem_num_tags(void)
+{
+	return (int)os_atomic_load_long(&num_tags);
+}
+
+const char *bmem_get_tag_name(int tag)
+{
+	if (tag < 0 || tag >= os_atomic_load_long(&num_tags))
+		return NULL;
+	return tag_names[tag];
+}
+
+bool bmem_get_tag_stats(int tag, struct bmem_stats *stats)
+{
+	if (tag < 0 || tag >= os_atomic_load_long(&num_tags))
+		return false;
+
+	get_counters(&tag_counters[tag], stats);
+	return true;
+}
+
+void bmem_get_stats(struct bmem_stats *stats)
+{
+	get_counters(&total_counters, stats);
+}
@@ -43,6 +43,37 @@ EXPORT long bnum_allocs(void);
 
 EXPORT void *bmemdup(const void *ptr, size_t size);
 
+/* keeps freed small allocations in per-thread caches for reuse */
+EXPORT void bmem_enable_thread_cache(bool enable);
+
+/*
+ * Allocation statistics, only kept while enabled with bmem_enable_stats.
+ * Allocations are counted under the tag of the thread that makes them (see
+ * bmem_set_thread_tag), and stay counted under that tag until they're freed,
+ * whichever thread frees them.
+ */
+
+#define BMEM_MAX_TAGS 64
+
+struct bmem_stats {
+	/* currently allocated */
+	uint64_t bytes;
+	uint64_t peak_bytes;
+	uint64_t allocs;
+
+	/* allocated since startup, sample these to get the allocation rate */
+	uint64_t total_allocs;
+	uint64_t total_bytes;
+};
+
+EXPORT void bmem_enable_stats(bool enable);
+EXPORT int bmem_register_tag(const char *name);
+EXPORT int bmem_set_thread_tag(int tag);
+EXPORT int bmem_num_tags(void);
+EXPORT const char *bmem_get_tag_name(int tag);
+EXPORT bool bmem_get_tag_stats(int tag, struct bmem_stats *stats);
+EXPORT void bmem_get_stats(struct bmem_stats *stats);
+
 static inline void *bzalloc(size_t size)
 {
 	void *mem = bmalloc(size);
@@ -27,6 +27,8 @@
 #include <glob.h>
 #include <time.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 #include "obsconfig.h"
 
@@ -46,6 +48,10 @@
 #include <spawn.h>
 #endif
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
 #include "darray.h"
 #include "dstr.h"
 #include "platform.h"
@@ -901,3 +907,81 @@ uint64_t os_get_free_disk_space(const char *dir)
 
 	return (uint64_t)info.f_frsize * (uint64_t)info.f_bavail;
 }
+
+size_t os_mirrored_alloc_granularity(void)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	return page_size > 0 ? (size_t)page_size : 4096;
+}
+
+static int create_mirrored_fd(void)
+{
+#if defined(__linux__)
+#ifdef SYS_memfd_create
+	return (int)syscall(SYS_memfd_create, "obs-mirrored", 0);
+#else
+	return -1;
+#endif
+#else
+	static volatile long counter = 0;
+	struct dstr name = {0};
+	int fd;
+
+	/* kept short, macOS limits the names to 31 characters */
+	dstr_printf(&name, "/obs-mr-%d-%ld", (int)getpid(),
+			os_atomic_inc_long(&counter));
+	fd = shm_open(name.array, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd != -1)
+		shm_unlink(name.array);
+
+	dstr_free(&name);
+	return fd;
+#endif
+}
+
+void *os_mirrored_alloc(size_t size)
+{
+	uint8_t *ptr;
+	void *first;
+	void *second;
+	int fd;
+
+	if (!size || size % os_mirrored_alloc_granularity() != 0)
+		return NULL;
+
+	fd = create_mirrored_fd();
+	if (fd == -1)
+		return NULL;
+
+	if (ftruncate(fd, (off_t)size) != 0) {
+		close(fd);
+		return NULL;
+	}
+
+	/* reserve the whole range first so nothing else can be mapped in
+	 * between the two mappings */
+	ptr = mmap(NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+	if (ptr == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+
+	first = mmap(ptr, size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_FIXED, fd, 0);
+	second = mmap(ptr + size, size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_FIXED, fd, 0);
+	close(fd);
+
+	if (first != ptr || second != ptr + size) {
+		munmap(ptr, size * 2);
+		return NULL;
+	}
+
+	return ptr;
+}
+
+void os_mirrored_free(void *ptr, size_t size)
+{
+	if (ptr)
+		munmap(ptr, size * 2);
+}
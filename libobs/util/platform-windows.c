@@ -1038,3 +1038,66 @@ uint64_t os_get_free_disk_space(const char *dir)
 
 	return success ? free.QuadPart : 0;
 }
+
+size_t os_mirrored_alloc_granularity(void)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwAllocationGranularity;
+}
+
+void *os_mirrored_alloc(size_t size)
+{
+	uint64_t size64 = (uint64_t)size;
+	HANDLE mapping;
+	void *ptr = NULL;
+
+	if (!size || size % os_mirrored_alloc_granularity() != 0)
+		return NULL;
+
+	mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL,
+			PAGE_READWRITE, (DWORD)(size64 >> 32), (DWORD)size64,
+			NULL);
+	if (!mapping)
+		return NULL;
+
+	/* find a free range big enough for both views, then map the views
+	 * into it.  another thread can take the range in between, so retry
+	 * a few times if that happens. */
+	for (int i = 0; i < 8 && !ptr; i++) {
+		uint8_t *base = VirtualAlloc(NULL, size * 2, MEM_RESERVE,
+				PAGE_NOACCESS);
+		void *first;
+		void *second;
+
+		if (!base)
+			break;
+		VirtualFree(base, 0, MEM_RELEASE);
+
+		first = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0,
+				size, base);
+		second = MapViewOfFileEx(mapping, FILE_MAP_ALL_ACCESS, 0, 0,
+				size, base + size);
+
+		if (first == base && second == base + size) {
+			ptr = base;
+		} else {
+			if (first)
+				UnmapViewOfFile(first);
+			if (second)
+				UnmapViewOfFile(second);
+		}
+	}
+
+	/* the views keep the mapping alive */
+	CloseHandle(mapping);
+	return ptr;
+}
+
+void os_mirrored_free(void *ptr, size_t size)
+{
+	if (ptr) {
+		UnmapViewOfFile(ptr);
+		UnmapViewOfFile((uint8_t*)ptr + size);
+	}
+}
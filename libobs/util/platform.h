@@ -193,6 +193,14 @@ EXPORT bool os_get_proc_memory_usage(os_proc_memory_usage_t *usage);
 EXPORT uint64_t os_get_proc_resident_size(void);
 EXPORT uint64_t os_get_proc_virtual_size(void);
 
+/* Maps the same memory twice in a row, so that anything that wraps around
+ * the end of the first mapping can be accessed contiguously through the
+ * second one.  The size has to be a multiple of the granularity.  Returns
+ * NULL if it could not be done (or is not supported on this system). */
+EXPORT size_t os_mirrored_alloc_granularity(void);
+EXPORT void *os_mirrored_alloc(size_t size);
+EXPORT void os_mirrored_free(void *ptr, size_t size);
+
 #ifdef _MSC_VER
 #define strtoll _strtoi64
 #if _MSC_VER < 1900
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2017 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+#include <string.h>
+#include <assert.h>
+
+#include "bmem.h"
+#include "platform.h"
+#include "threading.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fixed size circular buffer for a single producer thread and a single
+ * consumer thread, which can push and pop at the same time without locking.
+ * The capacity is rounded up to a power of two and never changes, so
+ * pushing fails instead of growing the buffer when it is full.
+ *
+ * Mirrored buffers map their memory twice in a row, so data that wraps
+ * around the end of the buffer can still be accessed in place with
+ * spsc_circlebuf_data.
+ *
+ * The positions are free running counters, the producer only writes the end
+ * position and the consumer only writes the start position.  Each is kept
+ * on a cache line of its own so the two threads don't keep stealing the
+ * line from each other.
+ */
+
+#define SPSC_CIRCLEBUF_CACHE_LINE 64
+
+struct spsc_circlebuf {
+	uint8_t         *data;
+	size_t          capacity;
+	size_t          mask;
+	bool            mirrored;
+
+	uint8_t         pad1[SPSC_CIRCLEBUF_CACHE_LINE];
+
+	/* producer */
+	volatile long   end_pos;
+	long            start_pos_cache;
+
+	uint8_t         pad2[SPSC_CIRCLEBUF_CACHE_LINE];
+
+	/* consumer */
+	volatile long   start_pos;
+
+	uint8_t         pad3[SPSC_CIRCLEBUF_CACHE_LINE];
+};
+
+static inline void spsc_circlebuf_init(struct spsc_circlebuf *cb,
+		size_t capacity, bool mirrored)
+{
+	size_t size = mirrored ? os_mirrored_alloc_granularity() : 1;
+
+	memset(cb, 0, sizeof(struct spsc_circlebuf));
+
+	while (size < capacity)
+		size <<= 1;
+
+	/* positions are longs, which are only 32 bits wide on windows */
+	assert(size <= (1UL << 30));
+
+	if (mirrored) {
+		cb->data = os_mirrored_alloc(size);
+		cb->mirrored = cb->data != NULL;
+	}
+	if (!cb->data)
+		cb->data = bmalloc(size);
+
+	cb->capacity = size;
+	cb->mask = size - 1;
+}
+
+static inline void spsc_circlebuf_free(struct spsc_circlebuf *cb)
+{
+	if (cb->mirrored)
+		os_mirrored_free(cb->data, cb->capacity);
+	else
+		bfree(cb->data);
+	memset(cb, 0, sizeof(struct spsc_circlebuf));
+}
+
+static inline void spsc_circlebuf_copy_in(struct spsc_circlebuf *cb,
+		unsigned long pos, const void *data, size_t size)
+{
+	size_t start = (size_t)pos & cb->mask;
+
+	if (cb->mirrored || start + size <= cb->capacity) {
+		memcpy(cb->data + start, data, size);
+	} else {
+		size_t back_size = cb->capacity - start;
+		memcpy(cb->data + start, data, back_size);
+		memcpy(cb->data, (const uint8_t*)data + back_size,
+				size - back_size);
+	}
+}
+
+static inline void spsc_circlebuf_copy_out(struct spsc_circlebuf *cb,
+		unsigned long pos, void *data, size_t size)
+{
+	size_t start = (size_t)pos & cb->mask;
+
+	if (cb->mirrored || start + size <= cb->capacity) {
+		memcpy(data, cb->data + start, size);
+	} else {
+		size_t back_size = cb->capacity - start;
+		memcpy(data, cb->data + start, back_size);
+		memcpy((uint8_t*)data + back_size, cb->data,
+				size - back_size);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* producer */
+
+/* returns whether size bytes can be pushed right now */
+static inline bool spsc_circlebuf_reserve_back(struct spsc_circlebuf *cb,
+		size_t size)
+{
+	unsigned long end = (unsigned long)cb->end_pos;
+	unsigned long start = (unsigned long)cb->start_pos_cache;
+
+	if (size > cb->capacity)
+		return false;
+	if ((size_t)(end - start) + size <= cb->capacity)
+		return true;
+
+	/* only look at the consumer's position when the cached one is not
+	 * enough, to keep its cache line where it is */
+	cb->start_pos_cache = os_atomic_load_long(&cb->start_pos);
+	start = (unsigned long)cb->start_pos_cache;
+	return (size_t)(end - start) + size <= cb->capacity;
+}
+
+/* writes data at offset from the end without making it visible to the
+ * consumer, the space has to be reserved first */
+static inline void spsc_circlebuf_place_back(struct spsc_circlebuf *cb,
+		size_t offset, const void *data, size_t size)
+{
+	unsigned long end = (unsigned long)cb->end_pos;
+	spsc_circlebuf_copy_in(cb, end + (unsigned long)offset, data, size);
+}
+
+/* makes size bytes written with spsc_circlebuf_place_back visible */
+static inline void spsc_circlebuf_commit_back(struct spsc_circlebuf *cb,
+		size_t size)
+{
+	long end = cb->end_pos;
+	long new_end = (long)((unsigned long)end + (unsigned long)size);
+
+	/* full barrier, the data has to be visible before the position */
+	os_atomic_compare_swap_long(&cb->end_pos, end, new_end);
+}
+
+static inline bool spsc_circlebuf_push_back(struct spsc_circlebuf *cb,
+		const void *data, size_t size)
+{
+	if (!spsc_circlebuf_reserve_back(cb, size))
+		return false;
+
+	spsc_circlebuf_place_back(cb, 0, data, size);
+	spsc_circlebuf_commit_back(cb, size);
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* consumer */
+
+static inline size_t spsc_circlebuf_size(struct spsc_circlebuf *cb)
+{
+	unsigned long start = (unsigned long)cb->start_pos;
+	unsigned long end = (unsigned long)os_atomic_load_long(&cb->end_pos);
+	return (size_t)(end - start);
+}
+
+static inline void spsc_circlebuf_peek_front(struct spsc_circlebuf *cb,
+		void *data, size_t size)
+{
+	assert(size <= spsc_circlebuf_size(cb));
+	spsc_circlebuf_copy_out(cb, (unsigned long)cb->start_pos, data, size);
+}
+
+/* returns a pointer to the first size bytes, or NULL if they wrap around the
+ * end of a buffer that is not mirrored */
+static inline void *spsc_circlebuf_data(struct spsc_circlebuf *cb,
+		size_t size)
+{
+	size_t start = (size_t)cb->start_pos & cb->mask;
+
+	assert(size <= spsc_circlebuf_size(cb));
+
+	if (!cb->mirrored && start + size > cb->capacity)
+		return NULL;
+	return cb->data + start;
+}
+
+static inline void spsc_circlebuf_pop_front(struct spsc_circlebuf *cb,
+		void *data, size_t size)
+{
+	long start = cb->start_pos;
+	long new_start = (long)((unsigned long)start + (unsigned long)size);
+
+	assert(size <= spsc_circlebuf_size(cb));
+
+	if (data)
+		spsc_circlebuf_copy_out(cb, (unsigned long)start, data, size);
+
+	/* full barrier, the data has to be read before the producer can
+	 * overwrite it */
+	os_atomic_compare_swap_long(&cb->start_pos, start, new_start);
+}
+
+#ifdef __cplusplus
+}
+#endif
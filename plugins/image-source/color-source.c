@@ -25,6 +25,8 @@ static void color_source_update(void *data, obs_data_t *settings)
 	context->color = color;
 	context->width = width;
 	context->height = height;
+
+	obs_source_set_opaque(context->src, (color >> 24) == 0xFF);
 }
 
 static void *color_source_create(obs_data_t *settings, obs_source_t *source)
@@ -107,7 +109,8 @@ static void color_source_defaults(obs_data_t *settings)
 struct obs_source_info color_source_info = {
 	.id             = "color_source",
 	.type           = OBS_SOURCE_TYPE_INPUT,
-	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW,
+	.output_flags   = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
+	                  OBS_SOURCE_TRACKS_CONTENT,
 	.create         = color_source_create,
 	.destroy        = color_source_destroy,
 	.update         = color_source_update,
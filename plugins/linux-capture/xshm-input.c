@@ -21,6 +21,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <xcb/shm.h>
 #include <xcb/xfixes.h>
 #include <xcb/xinerama.h>
+#ifdef HAVE_XCB_DAMAGE
+#include <xcb/damage.h>
+#endif
 
 #include <obs-module.h>
 #include <util/dstr.h>
@@ -31,6 +34,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "xshm-input: " msg, ##__VA_ARGS__)
 
+/* fall back to a full refresh when damage is this fragmented */
+#define XSHM_MAX_DAMAGE_BANDS 16
+
 struct xshm_data {
 	obs_source_t     *source;
 
@@ -48,6 +54,18 @@ struct xshm_data {
 
 	gs_texture_t     *texture;
 
+#ifdef HAVE_XCB_DAMAGE
+	xcb_damage_damage_t damage;
+	xcb_xfixes_region_t damage_region;
+#endif
+	bool             use_damage;
+	bool             full_refresh;
+
+	/* bands of rows fetched since the last upload as top, bottom, left
+	 * and right of the damage in them, -1 if everything was fetched */
+	int              num_bands;
+	int_fast32_t     bands[XSHM_MAX_DAMAGE_BANDS][4];
+
 	bool             show_cursor;
 	bool             use_xinerama;
 	bool             advanced;
@@ -129,6 +147,269 @@ static int_fast32_t xshm_update_geometry(struct xshm_data *data)
 	return 1;
 }
 
+/**
+ * Fetch the whole captured area into the shm segment
+ */
+static bool xshm_fetch_full(struct xshm_data *data)
+{
+	xcb_shm_get_image_cookie_t img_c;
+	xcb_shm_get_image_reply_t  *img_r;
+
+	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
+			data->x_org, data->y_org, data->width, data->height,
+			~0, XCB_IMAGE_FORMAT_Z_PIXMAP, data->xshm->seg, 0);
+	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
+	if (!img_r)
+		return false;
+
+	free(img_r);
+	return true;
+}
+
+#ifdef HAVE_XCB_DAMAGE
+/**
+ * Start tracking damage on the root window
+ *
+ * If the server does not support the damage extension every frame is captured
+ * in full.
+ */
+static void xshm_damage_start(struct xshm_data *data)
+{
+	xcb_damage_query_version_cookie_t dmg_c;
+	xcb_damage_query_version_reply_t  *dmg_r;
+
+	data->use_damage   = false;
+	data->full_refresh = true;
+
+	if (!xcb_get_extension_data(data->xcb, &xcb_damage_id)->present) {
+		blog(LOG_INFO, "Missing Damage extension, "
+				"capturing full frames");
+		return;
+	}
+
+	dmg_c = xcb_damage_query_version_unchecked(data->xcb,
+			XCB_DAMAGE_MAJOR_VERSION, XCB_DAMAGE_MINOR_VERSION);
+	dmg_r = xcb_damage_query_version_reply(data->xcb, dmg_c, NULL);
+	if (!dmg_r)
+		return;
+	free(dmg_r);
+
+	data->damage_region = xcb_generate_id(data->xcb);
+	xcb_xfixes_create_region(data->xcb, data->damage_region, 0, NULL);
+
+	data->damage = xcb_generate_id(data->xcb);
+	xcb_damage_create(data->xcb, data->damage, data->xcb_screen->root,
+			XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+
+	data->use_damage = true;
+}
+
+/**
+ * Stop tracking damage
+ */
+static void xshm_damage_stop(struct xshm_data *data)
+{
+	if (!data->use_damage)
+		return;
+
+	xcb_damage_destroy(data->xcb, data->damage);
+	xcb_xfixes_destroy_region(data->xcb, data->damage_region);
+	data->use_damage = false;
+}
+
+/**
+ * Drain pending events
+ *
+ * We only ever look at the accumulated damage region, but the server still
+ * sends a notify event whenever the region becomes non-empty.
+ */
+static void xshm_damage_drain_events(struct xshm_data *data)
+{
+	xcb_generic_event_t *ev;
+
+	while ((ev = xcb_poll_for_event(data->xcb)) != NULL)
+		free(ev);
+}
+
+/**
+ * Clip a damaged rectangle to the captured area
+ *
+ * @return false if the rectangle is outside of the captured area
+ */
+static bool xshm_damage_clip(struct xshm_data *data,
+		const xcb_rectangle_t *rect, int_fast32_t band[4])
+{
+	band[0] = rect->y - data->y_org;
+	band[1] = band[0] + rect->height;
+	band[2] = rect->x - data->x_org;
+	band[3] = band[2] + rect->width;
+
+	if (band[0] < 0)
+		band[0] = 0;
+	if (band[1] > data->height)
+		band[1] = data->height;
+	if (band[2] < 0)
+		band[2] = 0;
+	if (band[3] > data->width)
+		band[3] = data->width;
+
+	return band[0] < band[1] && band[2] < band[3];
+}
+
+/**
+ * Collect the rows that changed since the last frame
+ *
+ * The damaged rectangles are merged into bands of rows, which are fetched
+ * in full width straight into the right place of the shm segment, and of
+ * which only the damaged columns are uploaded.
+ *
+ * @return number of bands, or -1 if a full refresh is needed
+ */
+static int xshm_damage_bands(struct xshm_data *data,
+		int_fast32_t bands[][4])
+{
+	xcb_xfixes_fetch_region_cookie_t reg_c;
+	xcb_xfixes_fetch_region_reply_t  *reg_r;
+	xcb_rectangle_t                  *rects;
+	int                              count = 0;
+	int                              num_rects;
+	int_fast32_t                     area = 0;
+
+	xcb_damage_subtract(data->xcb, data->damage, XCB_NONE,
+			data->damage_region);
+	reg_c = xcb_xfixes_fetch_region_unchecked(data->xcb,
+			data->damage_region);
+	reg_r = xcb_xfixes_fetch_region_reply(data->xcb, reg_c, NULL);
+	if (!reg_r)
+		return -1;
+
+	rects     = xcb_xfixes_fetch_region_rectangles(reg_r);
+	num_rects = xcb_xfixes_fetch_region_rectangles_length(reg_r);
+
+	for (int i = 0; i < num_rects; i++) {
+		int_fast32_t rect[4];
+		int j;
+
+		if (!xshm_damage_clip(data, &rects[i], rect))
+			continue;
+
+		/* merge with any band it touches */
+		for (j = 0; j < count; j++) {
+			if (rect[0] <= bands[j][1] && rect[1] >= bands[j][0]) {
+				if (rect[0] < bands[j][0])
+					bands[j][0] = rect[0];
+				if (rect[1] > bands[j][1])
+					bands[j][1] = rect[1];
+				if (rect[2] < bands[j][2])
+					bands[j][2] = rect[2];
+				if (rect[3] > bands[j][3])
+					bands[j][3] = rect[3];
+				break;
+			}
+		}
+
+		if (j == count) {
+			if (count == XSHM_MAX_DAMAGE_BANDS) {
+				count = -1;
+				break;
+			}
+			memcpy(bands[count], rect, sizeof(rect));
+			count++;
+		}
+	}
+
+	free(reg_r);
+
+	for (int i = 0; i < count; i++)
+		area += bands[i][1] - bands[i][0];
+
+	/* fetching most of the screen in pieces is slower than all at once */
+	if (area > data->height / 2)
+		return -1;
+
+	return count;
+}
+
+/**
+ * Fetch the changed rows into the shm segment
+ *
+ * @return true if anything was fetched
+ */
+static bool xshm_fetch_damage(struct xshm_data *data)
+{
+	xcb_shm_get_image_cookie_t img_c[XSHM_MAX_DAMAGE_BANDS];
+	int_fast32_t               (*bands)[4] = data->bands;
+	bool                       success = true;
+	int                        count;
+
+	count = xshm_damage_bands(data, bands);
+	data->num_bands = count;
+	if (count < 0)
+		return xshm_fetch_full(data);
+	if (count == 0)
+		return false;
+
+	for (int i = 0; i < count; i++) {
+		img_c[i] = xcb_shm_get_image_unchecked(data->xcb,
+				data->xcb_screen->root,
+				data->x_org, data->y_org + bands[i][0],
+				data->width, bands[i][1] - bands[i][0],
+				~0, XCB_IMAGE_FORMAT_Z_PIXMAP, data->xshm->seg,
+				bands[i][0] * data->width * 4);
+	}
+
+	for (int i = 0; i < count; i++) {
+		xcb_shm_get_image_reply_t *img_r;
+
+		img_r = xcb_shm_get_image_reply(data->xcb, img_c[i], NULL);
+		if (!img_r)
+			success = false;
+		free(img_r);
+	}
+
+	/* retry everything next frame if a band went missing */
+	if (!success)
+		data->full_refresh = true;
+
+	return success;
+}
+#else
+static inline void xshm_damage_start(struct xshm_data *data)
+{
+	data->use_damage = false;
+}
+
+static inline void xshm_damage_stop(struct xshm_data *data)
+{
+	UNUSED_PARAMETER(data);
+}
+#endif
+
+/**
+ * Upload what was fetched into the shm segment to the texture
+ *
+ * @note requires to be called within the obs graphics context
+ */
+static void xshm_upload(struct xshm_data *data)
+{
+	uint32_t linesize = data->width * 4;
+
+	if (data->num_bands < 0) {
+		gs_texture_set_image(data->texture,
+				(void *) data->xshm->data, linesize, false);
+		return;
+	}
+
+	for (int i = 0; i < data->num_bands; i++) {
+		const int_fast32_t *band = data->bands[i];
+
+		gs_texture_set_image_rect(data->texture,
+				(void *) data->xshm->data, linesize,
+				band[2], band[0],
+				band[3] - band[2], band[1] - band[0]);
+	}
+}
+
 /**
  * Returns the name of the plugin
  */
@@ -156,6 +437,9 @@ static void xshm_capture_stop(struct xshm_data *data)
 
 	obs_leave_graphics();
 
+	if (data->xcb)
+		xshm_damage_stop(data);
+
 	if (data->xshm) {
 		xshm_xcb_detach(data->xshm);
 		data->xshm = NULL;
@@ -205,6 +489,8 @@ static void xshm_capture_start(struct xshm_data *data)
 	data->cursor = xcb_xcursor_init(data->xcb);
 	xcb_xcursor_offset(data->cursor, data->x_org, data->y_org);
 
+	xshm_damage_start(data);
+
 	obs_enter_graphics();
 
 	xshm_resize_texture(data);
@@ -396,32 +682,46 @@ static void xshm_video_tick(void *vptr, float seconds)
 	if (!obs_source_showing(data->source))
 		return;
 
-	xcb_shm_get_image_cookie_t           img_c;
-	xcb_shm_get_image_reply_t            *img_r;
 	xcb_xfixes_get_cursor_image_cookie_t cur_c;
 	xcb_xfixes_get_cursor_image_reply_t  *cur_r;
+	bool                                 changed;
 
-	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
-			data->x_org, data->y_org, data->width, data->height,
-			~0, XCB_IMAGE_FORMAT_Z_PIXMAP, data->xshm->seg, 0);
 	cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
 
-	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
-	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
+	/* the shm segment keeps the last frame, so with damage tracking only
+	 * the rows that changed need to be fetched, and nothing needs to be
+	 * uploaded at all if the screen is static */
+	data->num_bands = -1;
+
+#ifdef HAVE_XCB_DAMAGE
+	if (data->use_damage) {
+		xshm_damage_drain_events(data);
+
+		if (data->full_refresh) {
+			/* discard damage that the full fetch covers */
+			xcb_damage_subtract(data->xcb, data->damage, XCB_NONE,
+					XCB_NONE);
+			changed = xshm_fetch_full(data);
+			data->full_refresh = !changed;
+		} else {
+			changed = xshm_fetch_damage(data);
+		}
+	} else
+#endif
+	{
+		changed = xshm_fetch_full(data);
+	}
 
-	if (!img_r)
-		goto exit;
+	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
 
 	obs_enter_graphics();
 
-	gs_texture_set_image(data->texture, (void *) data->xshm->data,
-		data->width * 4, false);
+	if (changed)
+		xshm_upload(data);
 	xcb_xcursor_update(data->cursor, cur_r);
 
 	obs_leave_graphics();
 
-exit:
-	free(img_r);
 	free(cur_r);
 }
 
@@ -18,6 +18,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("linux-v4l2", "en-US")
+OBS_MODULE_LOAD_THREAD_SAFE()
 
 extern struct obs_source_info v4l2_input;
 
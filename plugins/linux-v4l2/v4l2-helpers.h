@@ -73,6 +73,21 @@ static inline enum video_format v4l2_to_obs_video_format(uint_fast32_t format)
 	}
 }
 
+/**
+ * Check if a v4l2 pixel format carries jpeg compressed frames
+ *
+ * These formats have no direct obs equivalent and need to be decoded before
+ * they can be passed to obs.
+ *
+ * @param format v4l2 format id
+ *
+ * @return true if the frames need to be decoded as mjpeg
+ */
+static inline bool v4l2_is_mjpeg(uint_fast32_t format)
+{
+	return format == V4L2_PIX_FMT_MJPEG || format == V4L2_PIX_FMT_JPEG;
+}
+
 /**
  * Fixed framesizes for devices that don't support enumerating discrete values.
  *
@@ -194,14 +209,17 @@ int_fast32_t v4l2_stop_capture(int_fast32_t dev);
 /**
  * Create memory mapping for buffers
  *
- * This tries to map at least 2, preferably 4, buffers to application memory.
+ * This tries to map the requested number of buffers to application memory.
+ * The driver may decide to map more or less, but at least 2 are required.
  *
  * @param dev handle for the v4l2 device
  * @param buf buffer data
+ * @param count number of buffers to request
  *
  * @return negative on failure
  */
-int_fast32_t v4l2_create_mmap(int_fast32_t dev, struct v4l2_buffer_data *buf);
+int_fast32_t v4l2_create_mmap(int_fast32_t dev, struct v4l2_buffer_data *buf,
+		uint32_t count);
 
 /**
  * Destroy the memory mapping for buffers
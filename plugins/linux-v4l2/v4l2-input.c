@@ -24,7 +24,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include <linux/videodev2.h>
 #include <libv4l2.h>
@@ -41,6 +42,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "v4l2-udev.h"
 #endif
 
+#if HAVE_MJPEG
+#include "v4l2-mjpeg.h"
+#endif
+
 /* The new dv timing api was introduced in Linux 3.4
  * Currently we simply disable dv timings when this is not defined */
 #if !defined(VIDIOC_ENUM_DV_TIMINGS) || !defined(V4L2_IN_CAP_DV_TIMINGS)
@@ -49,6 +54,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define V4L2_DATA(voidptr) struct v4l2_data *data = voidptr;
 
+#define V4L2_DEFAULT_BUFFER_COUNT 4
+#define V4L2_MAX_BUFFER_COUNT 32
+
 #define timeval2ns(tv) \
 	(((uint64_t) tv.tv_sec * 1000000000) + ((uint64_t) tv.tv_usec * 1000))
 
@@ -75,23 +83,155 @@ struct v4l2_data {
 	int dv_timing;
 	int resolution;
 	int framerate;
+	int buffer_count;
 
 	/* internal data */
 	obs_source_t *source;
 	pthread_t thread;
-	os_event_t *event;
+	int stop_fd;
 
 	int_fast32_t dev;
 	int width;
 	int height;
 	int linesize;
 	struct v4l2_buffer_data buffers;
+#if HAVE_MJPEG
+	struct v4l2_mjpeg *mjpeg;
+#endif
 };
 
 /* forward declarations */
 static void v4l2_init(struct v4l2_data *data);
 static void v4l2_terminate(struct v4l2_data *data);
 
+/**
+ * Capture statistics, reported when the capture is stopped
+ */
+struct v4l2_capture_stats {
+	/** number of buffers dequeued */
+	uint64_t buffers;
+	/** number of frames handed to obs, or to the mjpeg decoder */
+	uint64_t frames;
+	/** buffers the driver flagged as corrupted */
+	uint64_t error_buffers;
+	/** frames the driver dropped, detected by gaps in the sequence */
+	uint64_t dropped;
+	/** frames dropped because the mjpeg decoder queue was full */
+	uint64_t decoder_dropped;
+
+	/** sum and maximum of the dequeue jitter in nanoseconds */
+	uint64_t jitter_total;
+	uint64_t jitter_max;
+
+	uint64_t last_dequeue_ts;
+	uint64_t last_timestamp;
+	uint32_t last_sequence;
+};
+
+/**
+ * Update the capture statistics for a dequeued buffer
+ *
+ * The dequeue jitter is the difference between the interval in which we
+ * dequeue buffers and the interval of the timestamps the driver captured them
+ * with, so it measures how late the capture thread picks up frames.
+ */
+static void v4l2_update_stats(struct v4l2_capture_stats *stats,
+		const struct v4l2_buffer *buf, uint64_t dequeue_ts,
+		uint64_t timestamp)
+{
+	stats->buffers++;
+
+	if (stats->last_dequeue_ts) {
+		uint32_t gap = buf->sequence - stats->last_sequence;
+		int64_t jitter = (int64_t)(dequeue_ts - stats->last_dequeue_ts)
+			- (int64_t)(timestamp - stats->last_timestamp);
+
+		if (gap > 1)
+			stats->dropped += gap - 1;
+
+		if (jitter < 0)
+			jitter = -jitter;
+		stats->jitter_total += (uint64_t)jitter;
+		if ((uint64_t)jitter > stats->jitter_max)
+			stats->jitter_max = (uint64_t)jitter;
+	}
+
+	stats->last_dequeue_ts = dequeue_ts;
+	stats->last_timestamp  = timestamp;
+	stats->last_sequence   = buf->sequence;
+}
+
+static void v4l2_log_stats(struct v4l2_data *data,
+		const struct v4l2_capture_stats *stats)
+{
+	uint64_t frames = stats->frames;
+	uint64_t decoder_dropped = stats->decoder_dropped;
+	double jitter_avg = stats->buffers > 1
+		? (double)stats->jitter_total / (double)(stats->buffers - 1)
+		: 0.0;
+
+#if HAVE_MJPEG
+	/* frames that fail to decode never reach obs */
+	if (data->mjpeg) {
+		uint64_t failed = v4l2_mjpeg_dropped_frames(data->mjpeg);
+
+		decoder_dropped += failed;
+		frames -= failed < frames ? failed : frames;
+	}
+#endif
+
+	blog(LOG_INFO, "Stopped capture from %s after %"PRIu64" frames",
+			data->device_id, frames);
+	blog(LOG_INFO, "  dropped by device: %"PRIu64", "
+			"dropped by decoder: %"PRIu64", "
+			"corrupted buffers: %"PRIu64,
+			stats->dropped, decoder_dropped,
+			stats->error_buffers);
+	blog(LOG_INFO, "  dequeue jitter: avg %.3f ms, max %.3f ms",
+			jitter_avg / 1000000.0,
+			(double)stats->jitter_max / 1000000.0);
+}
+
+/**
+ * Get the timestamp for a buffer in the os_gettime_ns time base
+ *
+ * Most drivers stamp buffers with the monotonic clock, which is the clock
+ * os_gettime_ns uses, so those timestamps can be used directly. For anything
+ * else we fall back to the time the buffer was dequeued.
+ */
+static uint64_t v4l2_buffer_timestamp(const struct v4l2_buffer *buf,
+		uint64_t dequeue_ts)
+{
+#ifdef V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC
+	if ((buf->flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) ==
+			V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+		uint64_t ts = timeval2ns(buf->timestamp);
+		if (ts && ts <= dequeue_ts)
+			return ts;
+	}
+#else
+	UNUSED_PARAMETER(buf);
+#endif
+	return dequeue_ts;
+}
+
+/**
+ * Check if frames in the pixelformat can be passed to obs
+ *
+ * Apart from the formats obs understands natively this accepts mjpeg if the
+ * plugin was built with a decoder for it.
+ */
+static bool v4l2_format_supported(uint_fast32_t pixfmt)
+{
+	if (v4l2_to_obs_video_format(pixfmt) != VIDEO_FORMAT_NONE)
+		return true;
+#if HAVE_MJPEG
+	if (v4l2_is_mjpeg(pixfmt))
+		return true;
+#endif
+	return false;
+}
+
 /**
  * Prepare the output frame structure for obs and compute plane offsets
  *
@@ -144,44 +284,69 @@ static void v4l2_prep_obs_frame(struct v4l2_data *data,
 
 /*
  * Worker thread to get video data
+ *
+ * The thread waits on the device and the stop eventfd with epoll, so it
+ * wakes up as soon as a buffer is ready or the capture is stopped.
  */
 static void *v4l2_thread(void *vptr)
 {
 	V4L2_DATA(vptr);
 	int r;
-	fd_set fds;
+	int epfd;
 	uint8_t *start;
-	uint64_t frames;
-	uint64_t first_ts;
-	struct timeval tv;
+	uint64_t dequeue_ts;
+	struct epoll_event ev;
+	struct epoll_event events[2];
 	struct v4l2_buffer buf;
 	struct obs_source_frame out;
+	struct v4l2_capture_stats stats;
 	size_t plane_offsets[MAX_AV_PLANES];
+	bool stop = false;
+
+	os_set_thread_name("v4l2: capture");
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd == -1) {
+		blog(LOG_ERROR, "Unable to create epoll instance");
+		return NULL;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events  = EPOLLIN;
+	ev.data.fd = data->dev;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, data->dev, &ev) < 0) {
+		blog(LOG_ERROR, "Unable to watch device");
+		goto exit_epoll;
+	}
+	ev.data.fd = data->stop_fd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, data->stop_fd, &ev) < 0) {
+		blog(LOG_ERROR, "Unable to watch stop event");
+		goto exit_epoll;
+	}
 
 	if (v4l2_start_capture(data->dev, &data->buffers) < 0)
 		goto exit;
 
-	frames   = 0;
-	first_ts = 0;
+	memset(&stats, 0, sizeof(stats));
 	v4l2_prep_obs_frame(data, &out, plane_offsets);
 
-	while (os_event_try(data->event) == EAGAIN) {
-		FD_ZERO(&fds);
-		FD_SET(data->dev, &fds);
-		tv.tv_sec = 1;
-		tv.tv_usec = 0;
-
-		r = select(data->dev + 1, &fds, NULL, NULL, &tv);
+	while (!stop) {
+		r = epoll_wait(epfd, events, 2, -1);
 		if (r < 0) {
 			if (errno == EINTR)
 				continue;
-			blog(LOG_DEBUG, "select failed");
+			blog(LOG_DEBUG, "epoll_wait failed");
 			break;
-		} else if (r == 0) {
-			blog(LOG_DEBUG, "select timeout");
-			continue;
 		}
 
+		for (int i = 0; i < r; i++) {
+			if (events[i].data.fd == data->stop_fd)
+				stop = true;
+		}
+		if (stop)
+			break;
+
+		memset(&buf, 0, sizeof(buf));
 		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 		buf.memory = V4L2_MEMORY_MMAP;
 
@@ -192,28 +357,45 @@ static void *v4l2_thread(void *vptr)
 			break;
 		}
 
-		out.timestamp = timeval2ns(buf.timestamp);
-		if (!frames)
-			first_ts = out.timestamp;
-		out.timestamp -= first_ts;
+		dequeue_ts = os_gettime_ns();
+		out.timestamp = v4l2_buffer_timestamp(&buf, dequeue_ts);
+		v4l2_update_stats(&stats, &buf, dequeue_ts, out.timestamp);
 
-		start = (uint8_t *) data->buffers.info[buf.index].start;
-		for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
-			out.data[i] = start + plane_offsets[i];
-		obs_source_output_video(data->source, &out);
+		if (buf.flags & V4L2_BUF_FLAG_ERROR) {
+			stats.error_buffers++;
+		} else {
+			start = (uint8_t *) data->buffers.info[buf.index].start;
+#if HAVE_MJPEG
+			if (data->mjpeg) {
+				/* the decoder pool copies the data, so the
+				 * buffer can be requeued right away */
+				if (v4l2_mjpeg_submit(data->mjpeg, start,
+						buf.bytesused, out.timestamp))
+					stats.frames++;
+				else
+					stats.decoder_dropped++;
+			} else
+#endif
+			{
+				for (uint_fast32_t i = 0; i < MAX_AV_PLANES; ++i)
+					out.data[i] = start + plane_offsets[i];
+				obs_source_output_video(data->source, &out);
+				stats.frames++;
+			}
+		}
 
 		if (v4l2_ioctl(data->dev, VIDIOC_QBUF, &buf) < 0) {
 			blog(LOG_DEBUG, "failed to enqueue buffer");
 			break;
 		}
-
-		frames++;
 	}
 
-	blog(LOG_INFO, "Stopped capture after %"PRIu64" frames", frames);
+	v4l2_log_stats(data, &stats);
 
 exit:
 	v4l2_stop_capture(data->dev);
+exit_epoll:
+	close(epfd);
 	return NULL;
 }
 
@@ -232,6 +414,8 @@ static void v4l2_defaults(obs_data_t *settings)
 	obs_data_set_default_int(settings, "resolution", -1);
 	obs_data_set_default_int(settings, "framerate", -1);
 	obs_data_set_default_bool(settings, "buffering", true);
+	obs_data_set_default_int(settings, "buffer_count",
+			V4L2_DEFAULT_BUFFER_COUNT);
 }
 
 /**
@@ -388,8 +572,7 @@ static void v4l2_format_list(int dev, obs_property_t *prop)
 		if (fmt.flags & V4L2_FMT_FLAG_EMULATED)
 			dstr_cat(&buffer, " (Emulated)");
 
-		if (v4l2_to_obs_video_format(fmt.pixelformat)
-				!= VIDEO_FORMAT_NONE) {
+		if (v4l2_format_supported(fmt.pixelformat)) {
 			obs_property_list_add_int(prop, buffer.array,
 					fmt.pixelformat);
 			blog(LOG_INFO, "Pixelformat: %s (available)",
@@ -762,6 +945,10 @@ static obs_properties_t *v4l2_properties(void *vptr)
 	obs_properties_add_bool(props,
 			"buffering", obs_module_text("UseBuffering"));
 
+	obs_properties_add_int(props,
+			"buffer_count", obs_module_text("BufferCount"),
+			2, V4L2_MAX_BUFFER_COUNT, 1);
+
 	obs_data_t *settings = obs_source_get_settings(data->source);
 	v4l2_device_list(device_list, settings);
 	obs_data_release(settings);
@@ -778,12 +965,23 @@ static obs_properties_t *v4l2_properties(void *vptr)
 static void v4l2_terminate(struct v4l2_data *data)
 {
 	if (data->thread) {
-		os_event_signal(data->event);
+		uint64_t stop = 1;
+		if (write(data->stop_fd, &stop, sizeof(stop)) != sizeof(stop))
+			blog(LOG_ERROR, "Failed to signal capture thread");
 		pthread_join(data->thread, NULL);
-		os_event_destroy(data->event);
 		data->thread = 0;
 	}
 
+	if (data->stop_fd != -1) {
+		close(data->stop_fd);
+		data->stop_fd = -1;
+	}
+
+#if HAVE_MJPEG
+	v4l2_mjpeg_destroy(data->mjpeg);
+	data->mjpeg = NULL;
+#endif
+
 	v4l2_destroy_mmap(&data->buffers);
 
 	if (data->dev != -1) {
@@ -874,7 +1072,7 @@ static void v4l2_init(struct v4l2_data *data)
 		blog(LOG_ERROR, "Unable to set format");
 		goto fail;
 	}
-	if (v4l2_to_obs_video_format(data->pixfmt) == VIDEO_FORMAT_NONE) {
+	if (!v4l2_format_supported(data->pixfmt)) {
 		blog(LOG_ERROR, "Selected video format not supported");
 		goto fail;
 	}
@@ -892,13 +1090,26 @@ static void v4l2_init(struct v4l2_data *data)
 	blog(LOG_INFO, "Framerate: %.2f fps", (float) fps_denom / fps_num);
 
 	/* map buffers */
-	if (v4l2_create_mmap(data->dev, &data->buffers) < 0) {
+	if (v4l2_create_mmap(data->dev, &data->buffers,
+			data->buffer_count) < 0) {
 		blog(LOG_ERROR, "Failed to map buffers");
 		goto fail;
 	}
 
+#if HAVE_MJPEG
+	/* start the decoder threads for compressed formats */
+	if (v4l2_is_mjpeg(data->pixfmt)) {
+		data->mjpeg = v4l2_mjpeg_create(data->source, 0);
+		if (!data->mjpeg) {
+			blog(LOG_ERROR, "Failed to create mjpeg decoder");
+			goto fail;
+		}
+	}
+
+#endif
 	/* start the capture thread */
-	if (os_event_init(&data->event, OS_EVENT_TYPE_MANUAL) != 0)
+	data->stop_fd = eventfd(0, EFD_CLOEXEC);
+	if (data->stop_fd == -1)
 		goto fail;
 	if (pthread_create(&data->thread, NULL, v4l2_thread, data) != 0)
 		goto fail;
@@ -940,6 +1151,7 @@ static void v4l2_update(void *vptr, obs_data_t *settings)
 	data->dv_timing  = obs_data_get_int(settings, "dv_timing");
 	data->resolution = obs_data_get_int(settings, "resolution");
 	data->framerate  = obs_data_get_int(settings, "framerate");
+	data->buffer_count = obs_data_get_int(settings, "buffer_count");
 
 	v4l2_update_source_flags(data, settings);
 
@@ -950,6 +1162,7 @@ static void *v4l2_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct v4l2_data *data = bzalloc(sizeof(struct v4l2_data));
 	data->dev = -1;
+	data->stop_fd = -1;
 	data->source = source;
 
 	/* Bitch about build problems ... */
@@ -0,0 +1,416 @@
+/*
+Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include <inttypes.h>
+
+#include <util/threading.h>
+#include <util/circlebuf.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/bmem.h>
+
+#include <libavcodec/avcodec.h>
+#include <obs-ffmpeg-compat.h>
+
+#include "v4l2-mjpeg.h"
+
+#define blog(level, msg, ...) blog(level, "v4l2-mjpeg: " msg, ##__VA_ARGS__)
+
+#define MJPEG_MAX_THREADS 8
+
+/**
+ * A compressed frame waiting to be decoded
+ */
+struct mjpeg_job {
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+	uint64_t timestamp;
+	uint64_t seq;
+};
+
+/**
+ * Data structure for a single decoding thread
+ */
+struct mjpeg_worker {
+	struct v4l2_mjpeg *mj;
+	pthread_t thread;
+	bool thread_created;
+
+	AVCodecContext *decoder;
+	AVFrame *frame;
+};
+
+struct v4l2_mjpeg {
+	obs_source_t *source;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t job_cond;
+	pthread_cond_t output_cond;
+	bool stop;
+
+	/* queue of submitted jobs (struct mjpeg_job *) */
+	struct circlebuf pending;
+	DARRAY(struct mjpeg_job *) free_jobs;
+	struct mjpeg_job *jobs;
+	size_t num_jobs;
+
+	uint64_t next_seq;
+	uint64_t output_seq;
+	uint64_t dropped;
+
+	struct mjpeg_worker *workers;
+	int num_workers;
+};
+
+/**
+ * Fill in the obs frame for a decoded picture
+ *
+ * Planar 4:2:2 (which most webcams send) is handed out as I420 by doubling
+ * the chroma line sizes, which simply skips every other chroma row without
+ * having to copy or convert anything.
+ */
+static bool mjpeg_prep_obs_frame(AVFrame *pic, struct obs_source_frame *out)
+{
+	enum video_range_type range;
+	bool full_range = pic->color_range == AVCOL_RANGE_JPEG;
+
+	memset(out, 0, sizeof(*out));
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		out->data[i]     = pic->data[i];
+		out->linesize[i] = pic->linesize[i];
+	}
+
+	switch (pic->format) {
+	case AV_PIX_FMT_YUVJ420P:
+		full_range = true;
+		/* fall through */
+	case AV_PIX_FMT_YUV420P:
+		out->format = VIDEO_FORMAT_I420;
+		break;
+	case AV_PIX_FMT_YUVJ422P:
+		full_range = true;
+		/* fall through */
+	case AV_PIX_FMT_YUV422P:
+		out->format = VIDEO_FORMAT_I420;
+		out->linesize[1] *= 2;
+		out->linesize[2] *= 2;
+		break;
+	case AV_PIX_FMT_YUVJ444P:
+		full_range = true;
+		/* fall through */
+	case AV_PIX_FMT_YUV444P:
+		out->format = VIDEO_FORMAT_I444;
+		break;
+	case AV_PIX_FMT_NV12:
+		out->format = VIDEO_FORMAT_NV12;
+		break;
+	case AV_PIX_FMT_GRAY8:
+		out->format = VIDEO_FORMAT_Y800;
+		break;
+	default:
+		return false;
+	}
+
+	range = full_range ? VIDEO_RANGE_FULL : VIDEO_RANGE_PARTIAL;
+
+	out->width      = pic->width;
+	out->height     = pic->height;
+	out->full_range = full_range;
+	return video_format_get_parameters(VIDEO_CS_601, range,
+			out->color_matrix, out->color_range_min,
+			out->color_range_max);
+}
+
+static bool mjpeg_decode(struct mjpeg_worker *w, struct mjpeg_job *job)
+{
+	AVPacket packet;
+	int ret;
+
+	av_init_packet(&packet);
+	packet.data  = job->data;
+	packet.size  = (int)job->size;
+	packet.flags = AV_PKT_FLAG_KEY;
+
+	ret = avcodec_send_packet(w->decoder, &packet);
+	if (ret == 0)
+		ret = avcodec_receive_frame(w->decoder, w->frame);
+
+	return ret == 0;
+}
+
+/**
+ * Wait until it is this job's turn to be output
+ *
+ * Workers finish out of order, so each one waits here for all frames that
+ * were submitted earlier before handing its own frame to the source.
+ *
+ * @return false if the pool is being stopped
+ */
+static bool mjpeg_wait_turn(struct v4l2_mjpeg *mj, struct mjpeg_job *job)
+{
+	bool turn;
+
+	pthread_mutex_lock(&mj->mutex);
+	while (!mj->stop && mj->output_seq != job->seq)
+		pthread_cond_wait(&mj->output_cond, &mj->mutex);
+	turn = !mj->stop;
+	pthread_mutex_unlock(&mj->mutex);
+
+	return turn;
+}
+
+static void mjpeg_finish_job(struct v4l2_mjpeg *mj, struct mjpeg_job *job,
+		bool success)
+{
+	pthread_mutex_lock(&mj->mutex);
+	if (!success)
+		mj->dropped++;
+	mj->output_seq++;
+	da_push_back(mj->free_jobs, &job);
+	pthread_cond_broadcast(&mj->output_cond);
+	pthread_mutex_unlock(&mj->mutex);
+}
+
+static void *mjpeg_worker_thread(void *vptr)
+{
+	struct mjpeg_worker *w = vptr;
+	struct v4l2_mjpeg *mj = w->mj;
+	struct obs_source_frame out;
+
+	os_set_thread_name("v4l2: mjpeg decode");
+
+	for (;;) {
+		struct mjpeg_job *job = NULL;
+		bool success;
+
+		pthread_mutex_lock(&mj->mutex);
+		while (!mj->stop && !mj->pending.size)
+			pthread_cond_wait(&mj->job_cond, &mj->mutex);
+		if (!mj->stop)
+			circlebuf_pop_front(&mj->pending, &job, sizeof(job));
+		pthread_mutex_unlock(&mj->mutex);
+
+		if (!job)
+			break;
+
+		success = mjpeg_decode(w, job) &&
+			mjpeg_prep_obs_frame(w->frame, &out);
+
+		if (!mjpeg_wait_turn(mj, job))
+			break;
+
+		if (success) {
+			out.timestamp = job->timestamp;
+			obs_source_output_video(mj->source, &out);
+		}
+
+		av_frame_unref(w->frame);
+		mjpeg_finish_job(mj, job, success);
+	}
+
+	return NULL;
+}
+
+static bool mjpeg_worker_init(struct mjpeg_worker *w, struct v4l2_mjpeg *mj,
+		AVCodec *codec)
+{
+	w->mj = mj;
+
+	w->decoder = avcodec_alloc_context3(codec);
+	if (!w->decoder)
+		return false;
+
+	/* the pool does the threading, one frame per worker */
+	w->decoder->thread_count = 1;
+
+	if (avcodec_open2(w->decoder, codec, NULL) < 0)
+		return false;
+
+	w->frame = av_frame_alloc();
+	if (!w->frame)
+		return false;
+
+	if (pthread_create(&w->thread, NULL, mjpeg_worker_thread, w) != 0)
+		return false;
+
+	w->thread_created = true;
+	return true;
+}
+
+static void mjpeg_worker_free(struct mjpeg_worker *w)
+{
+	if (w->thread_created)
+		pthread_join(w->thread, NULL);
+	if (w->frame)
+		av_frame_free(&w->frame);
+	if (w->decoder) {
+		avcodec_close(w->decoder);
+		av_free(w->decoder);
+	}
+}
+
+static int mjpeg_default_threads(void)
+{
+	int threads = os_get_logical_cores() / 2;
+
+	if (threads < 2)
+		threads = 2;
+	if (threads > 4)
+		threads = 4;
+	return threads;
+}
+
+struct v4l2_mjpeg *v4l2_mjpeg_create(obs_source_t *source, int threads)
+{
+	struct v4l2_mjpeg *mj;
+	AVCodec *codec;
+
+	avcodec_register_all();
+
+	codec = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
+	if (!codec) {
+		blog(LOG_ERROR, "mjpeg decoder not available");
+		return NULL;
+	}
+
+	if (threads <= 0)
+		threads = mjpeg_default_threads();
+	if (threads > MJPEG_MAX_THREADS)
+		threads = MJPEG_MAX_THREADS;
+
+	mj = bzalloc(sizeof(struct v4l2_mjpeg));
+	mj->source = source;
+
+	if (pthread_mutex_init(&mj->mutex, NULL) != 0)
+		goto fail_mutex;
+	if (pthread_cond_init(&mj->job_cond, NULL) != 0)
+		goto fail_job_cond;
+	if (pthread_cond_init(&mj->output_cond, NULL) != 0)
+		goto fail_output_cond;
+
+	/* one frame in flight per worker plus one waiting for each */
+	mj->num_jobs = threads * 2;
+	mj->jobs = bzalloc(mj->num_jobs * sizeof(struct mjpeg_job));
+	for (size_t i = 0; i < mj->num_jobs; i++) {
+		struct mjpeg_job *job = &mj->jobs[i];
+		da_push_back(mj->free_jobs, &job);
+	}
+
+	mj->workers = bzalloc(threads * sizeof(struct mjpeg_worker));
+	mj->num_workers = threads;
+	for (int i = 0; i < threads; i++) {
+		if (!mjpeg_worker_init(&mj->workers[i], mj, codec)) {
+			blog(LOG_ERROR, "Failed to initialize decoder thread");
+			goto fail;
+		}
+	}
+
+	blog(LOG_INFO, "Decoding with %d threads", threads);
+	return mj;
+
+fail:
+	v4l2_mjpeg_destroy(mj);
+	return NULL;
+
+fail_output_cond:
+	pthread_cond_destroy(&mj->job_cond);
+fail_job_cond:
+	pthread_mutex_destroy(&mj->mutex);
+fail_mutex:
+	blog(LOG_ERROR, "Failed to initialize decoder synchronization");
+	bfree(mj);
+	return NULL;
+}
+
+void v4l2_mjpeg_destroy(struct v4l2_mjpeg *mj)
+{
+	if (!mj)
+		return;
+
+	pthread_mutex_lock(&mj->mutex);
+	mj->stop = true;
+	pthread_cond_broadcast(&mj->job_cond);
+	pthread_cond_broadcast(&mj->output_cond);
+	pthread_mutex_unlock(&mj->mutex);
+
+	for (int i = 0; i < mj->num_workers; i++)
+		mjpeg_worker_free(&mj->workers[i]);
+
+	if (mj->dropped)
+		blog(LOG_INFO, "Failed to decode %"PRIu64" frames",
+				mj->dropped);
+
+	for (size_t i = 0; i < mj->num_jobs; i++)
+		bfree(mj->jobs[i].data);
+
+	circlebuf_free(&mj->pending);
+	da_free(mj->free_jobs);
+	bfree(mj->workers);
+	bfree(mj->jobs);
+
+	pthread_cond_destroy(&mj->output_cond);
+	pthread_cond_destroy(&mj->job_cond);
+	pthread_mutex_destroy(&mj->mutex);
+	bfree(mj);
+}
+
+bool v4l2_mjpeg_submit(struct v4l2_mjpeg *mj, const uint8_t *data,
+		size_t size, uint64_t timestamp)
+{
+	struct mjpeg_job *job;
+	size_t new_size = size + INPUT_BUFFER_PADDING_SIZE;
+
+	pthread_mutex_lock(&mj->mutex);
+	if (!mj->free_jobs.num) {
+		pthread_mutex_unlock(&mj->mutex);
+		return false;
+	}
+	job = mj->free_jobs.array[mj->free_jobs.num - 1];
+	da_pop_back(mj->free_jobs);
+	pthread_mutex_unlock(&mj->mutex);
+
+	/* the job is owned by the capture thread until it is queued */
+	if (job->capacity < new_size) {
+		job->data     = brealloc(job->data, new_size);
+		job->capacity = new_size;
+	}
+	memcpy(job->data, data, size);
+	memset(job->data + size, 0, INPUT_BUFFER_PADDING_SIZE);
+	job->size      = size;
+	job->timestamp = timestamp;
+
+	pthread_mutex_lock(&mj->mutex);
+	job->seq = mj->next_seq++;
+	circlebuf_push_back(&mj->pending, &job, sizeof(job));
+	pthread_cond_signal(&mj->job_cond);
+	pthread_mutex_unlock(&mj->mutex);
+
+	return true;
+}
+
+uint64_t v4l2_mjpeg_dropped_frames(struct v4l2_mjpeg *mj)
+{
+	uint64_t dropped;
+
+	pthread_mutex_lock(&mj->mutex);
+	dropped = mj->dropped;
+	pthread_mutex_unlock(&mj->mutex);
+
+	return dropped;
+}
@@ -0,0 +1,84 @@
+/*
+Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <obs-module.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Opaque handle for a pool of mjpeg decoding threads
+ */
+struct v4l2_mjpeg;
+
+/**
+ * Create a mjpeg decoder pool
+ *
+ * Decoded frames are handed to the source in the order they were submitted,
+ * regardless of which worker decoded them.
+ *
+ * @param source the source decoded frames are output to
+ * @param threads number of worker threads, 0 to pick automatically
+ *
+ * @return decoder pool or NULL on failure
+ */
+struct v4l2_mjpeg *v4l2_mjpeg_create(obs_source_t *source, int threads);
+
+/**
+ * Destroy the mjpeg decoder pool
+ *
+ * This stops all workers, frames that have not been decoded yet are dropped.
+ *
+ * @param mj decoder pool
+ */
+void v4l2_mjpeg_destroy(struct v4l2_mjpeg *mj);
+
+/**
+ * Queue a compressed frame for decoding
+ *
+ * The data is copied, so the capture buffer can be requeued as soon as this
+ * returns. If all workers are busy and the queue is full the frame is dropped.
+ *
+ * @param mj decoder pool
+ * @param data compressed frame data
+ * @param size size of the compressed data
+ * @param timestamp timestamp of the frame
+ *
+ * @return false if the frame was dropped
+ */
+bool v4l2_mjpeg_submit(struct v4l2_mjpeg *mj, const uint8_t *data,
+		size_t size, uint64_t timestamp);
+
+/**
+ * Get the number of frames that were dropped because they could not be
+ * decoded
+ *
+ * Frames that are dropped because the queue is full are not included, those
+ * are reported by v4l2_mjpeg_submit returning false.
+ *
+ * @param mj decoder pool
+ *
+ * @return number of frames that failed to decode
+ */
+uint64_t v4l2_mjpeg_dropped_frames(struct v4l2_mjpeg *mj);
+
+#ifdef __cplusplus
+}
+#endif
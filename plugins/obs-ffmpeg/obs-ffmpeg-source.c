@@ -49,9 +49,11 @@ struct ffmpeg_source {
 	char *input;
 	char *input_format;
 	int buffering_mb;
+	int decode_ahead;
 	bool is_looping;
 	bool is_local_file;
 	bool is_hw_decoding;
+	bool is_shared_decoding;
 	bool is_clear_on_media_end;
 	bool restart_on_activate;
 	bool close_when_inactive;
@@ -72,6 +74,8 @@ static bool is_local_file_modified(obs_properties_t *props,
 	obs_property_t *buffering = obs_properties_get(props, "buffering_mb");
 	obs_property_t *close = obs_properties_get(props, "close_when_inactive");
 	obs_property_t *seekable = obs_properties_get(props, "seekable");
+	obs_property_t *shared = obs_properties_get(props,
+			"shared_decoding");
 	obs_property_set_visible(input, !enabled);
 	obs_property_set_visible(input_format, !enabled);
 	obs_property_set_visible(buffering, !enabled);
@@ -79,6 +83,7 @@ static bool is_local_file_modified(obs_properties_t *props,
 	obs_property_set_visible(local_file, enabled);
 	obs_property_set_visible(looping, enabled);
 	obs_property_set_visible(seekable, !enabled);
+	obs_property_set_visible(shared, enabled);
 
 	return true;
 }
@@ -93,6 +98,8 @@ static void ffmpeg_source_defaults(obs_data_t *settings)
 	obs_data_set_default_bool(settings, "hw_decode", true);
 #endif
 	obs_data_set_default_int(settings, "buffering_mb", 2);
+	obs_data_set_default_int(settings, "decode_ahead",
+			MP_DEFAULT_DECODE_AHEAD);
 }
 
 static const char *media_filter =
@@ -183,6 +190,12 @@ static obs_properties_t *ffmpeg_source_getproperties(void *data)
 
 	obs_properties_add_bool(props, "seekable", obs_module_text("Seekable"));
 
+	obs_properties_add_int(props, "decode_ahead",
+			obs_module_text("DecodeAhead"), 1, 60, 1);
+
+	obs_properties_add_bool(props, "shared_decoding",
+			obs_module_text("SharedDecoding"));
+
 	return props;
 }
 
@@ -195,6 +208,7 @@ static void dump_source_info(struct ffmpeg_source *s, const char *input,
 			"\tinput_format:            %s\n"
 			"\tis_looping:              %s\n"
 			"\tis_hw_decoding:          %s\n"
+			"\tis_shared_decoding:      %s\n"
 			"\tis_clear_on_media_end:   %s\n"
 			"\trestart_on_activate:     %s\n"
 			"\tclose_when_inactive:     %s",
@@ -202,6 +216,7 @@ static void dump_source_info(struct ffmpeg_source *s, const char *input,
 			input_format ? input_format : "(null)",
 			s->is_looping ? "yes" : "no",
 			s->is_hw_decoding ? "yes" : "no",
+			s->is_shared_decoding ? "yes" : "no",
 			s->is_clear_on_media_end ? "yes" : "no",
 			s->restart_on_activate ? "yes" : "no",
 			s->close_when_inactive ? "yes" : "no");
@@ -249,7 +264,9 @@ static void ffmpeg_source_open(struct ffmpeg_source *s)
 				preload_frame,
 				s->is_hw_decoding,
 				s->is_local_file || s->seekable,
-				s->range);
+				s->range,
+				s->decode_ahead,
+				s->is_local_file && s->is_shared_decoding);
 }
 
 static void ffmpeg_source_tick(void *data, float seconds)
@@ -320,6 +337,8 @@ static void ffmpeg_source_update(void *data, obs_data_t *settings)
 	s->range = (enum video_range_type)obs_data_get_int(settings,
 			"color_range");
 	s->buffering_mb = (int)obs_data_get_int(settings, "buffering_mb");
+	s->decode_ahead = (int)obs_data_get_int(settings, "decode_ahead");
+	s->is_shared_decoding = obs_data_get_bool(settings, "shared_decoding");
 	s->is_local_file = is_local_file;
 	s->seekable = obs_data_get_bool(settings, "seekable");
 
@@ -361,6 +380,20 @@ static void restart_proc(void *data, calldata_t *cd)
 	UNUSED_PARAMETER(cd);
 }
 
+static void seek_proc(void *data, calldata_t *cd)
+{
+	struct ffmpeg_source *s = data;
+	int64_t position = calldata_int(cd, "position");
+
+	if (!s->media_valid)
+		return;
+
+	/* an active source plays from the new position, an inactive one
+	 * starts from there when it is activated */
+	mp_media_seek(&s->media, position, obs_source_active(s->source),
+			s->is_looping);
+}
+
 static void get_duration(void *data, calldata_t *cd)
 {
 	struct ffmpeg_source *s = data;
@@ -422,6 +455,7 @@ static void *ffmpeg_source_create(obs_data_t *settings, obs_source_t *source)
 
 	proc_handler_t *ph = obs_source_get_proc_handler(source);
 	proc_handler_add(ph, "void restart()", restart_proc, s);
+	proc_handler_add(ph, "void seek(int position)", seek_proc, s);
 	proc_handler_add(ph, "void get_duration(out int duration)",
 			get_duration, s);
 	proc_handler_add(ph, "void get_nb_frames(out int num_frames)",
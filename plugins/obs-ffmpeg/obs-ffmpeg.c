@@ -3,6 +3,7 @@
 #include <util/platform.h>
 #include <libavutil/log.h>
 #include <libavcodec/avcodec.h>
+#include <media-playback/index.h>
 #include <pthread.h>
 
 OBS_DECLARE_MODULE()
@@ -173,6 +174,10 @@ bool obs_module_load(void)
 
 	//av_log_set_callback(ffmpeg_log_callback);
 
+	char *index_path = obs_module_config_path("keyframe-index");
+	mp_index_set_cache_path(index_path);
+	bfree(index_path);
+
 	obs_register_source(&ffmpeg_source);
 	obs_register_output(&ffmpeg_output);
 	obs_register_output(&ffmpeg_muxer);
@@ -189,6 +194,7 @@ bool obs_module_load(void)
 void obs_module_unload(void)
 {
 	av_log_set_callback(av_log_default_callback);
+	mp_index_set_cache_path(NULL);
 
 #ifdef _WIN32
 	pthread_mutex_destroy(&log_contexts_mutex);
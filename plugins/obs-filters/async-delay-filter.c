@@ -1,5 +1,8 @@
 #include <obs-module.h>
 #include <util/circlebuf.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include <media-io/video-frame.h>
 
 #ifndef SEC_TO_NSEC
 #define SEC_TO_NSEC 1000000000ULL
@@ -10,15 +13,35 @@
 #endif
 
 #define SETTING_DELAY_MS               "delay_ms"
+#define SETTING_COMPRESS               "compress_frames"
 
 #define TEXT_DELAY_MS                  obs_module_text("DelayMs")
+#define TEXT_COMPRESS                  obs_module_text("CompressFrames")
 
 struct async_delay_data {
 	obs_source_t                   *context;
 
-	/* contains struct obs_source_frame* */
+	/* contains struct obs_source_frame*, copies of the frames of the
+	 * parent that are owned by the filter, so that the frames of the
+	 * parent can be reused right away */
 	struct circlebuf               video_frames;
 
+	/* frames that are not in use, they are allocated once for the format
+	 * and size of the parent's frames and reused */
+	DARRAY(struct obs_source_frame*) unused_frames;
+	enum video_format              frame_format;
+	uint32_t                       frame_width;
+	uint32_t                       frame_height;
+
+	/* frame that was returned last, it is unused on the next frame */
+	struct obs_source_frame        *output;
+
+	/* packed 4:2:2 frames can be stored as NV12 to save memory, in
+	 * which case they are expanded to this frame when returned */
+	struct obs_source_frame        *expanded;
+	bool                           compress;
+	bool                           compressed;
+
 	/* stores the audio data */
 	struct circlebuf               audio_frames;
 	struct obs_audio_data          audio_output;
@@ -39,16 +62,49 @@ static const char *async_delay_filter_name(void *unused)
 	return obs_module_text("AsyncDelayFilter");
 }
 
-static void free_video_data(struct async_delay_data *filter,
-		obs_source_t *parent)
+/* frames of the filter are never released by libobs while they are owned
+ * by the filter, as a reference is added whenever one is returned */
+static inline struct obs_source_frame *create_frame(enum video_format format,
+		uint32_t width, uint32_t height)
+{
+	struct obs_source_frame *frame = obs_source_frame_create(format,
+			width, height);
+	frame->refs = 1;
+	return frame;
+}
+
+static inline void unuse_frame(struct async_delay_data *filter,
+		struct obs_source_frame *frame)
+{
+	if (frame && frame != filter->expanded)
+		da_push_back(filter->unused_frames, &frame);
+}
+
+static void free_video_data(struct async_delay_data *filter)
 {
 	while (filter->video_frames.size) {
 		struct obs_source_frame *frame;
 
 		circlebuf_pop_front(&filter->video_frames, &frame,
 				sizeof(struct obs_source_frame*));
-		obs_source_release_frame(parent, frame);
+		unuse_frame(filter, frame);
 	}
+
+	unuse_frame(filter, filter->output);
+	filter->output = NULL;
+}
+
+static void free_video_frames(struct async_delay_data *filter)
+{
+	free_video_data(filter);
+
+	for (size_t i = 0; i < filter->unused_frames.num; i++)
+		obs_source_frame_destroy(filter->unused_frames.array[i]);
+	da_resize(filter->unused_frames, 0);
+
+	obs_source_frame_destroy(filter->expanded);
+	filter->expanded = NULL;
+	filter->frame_format = VIDEO_FORMAT_NONE;
 }
 
 static inline void free_audio_packet(struct obs_audio_data *audio)
@@ -75,9 +131,7 @@ static void async_delay_filter_update(void *data, obs_data_t *settings)
 	uint64_t new_interval = (uint64_t)obs_data_get_int(settings,
 			SETTING_DELAY_MS) * MSEC_TO_NSEC;
 
-	if (new_interval < filter->interval)
-		free_video_data(filter, obs_filter_get_parent(filter->context));
-
+	filter->compress = obs_data_get_bool(settings, SETTING_COMPRESS);
 	filter->reset_audio = true;
 	filter->reset_video = true;
 	filter->interval = new_interval;
@@ -104,9 +158,11 @@ static void async_delay_filter_destroy(void *data)
 {
 	struct async_delay_data *filter = data;
 
+	free_video_frames(filter);
 	free_audio_packet(&filter->audio_output);
 	circlebuf_free(&filter->video_frames);
 	circlebuf_free(&filter->audio_frames);
+	da_free(filter->unused_frames);
 	bfree(data);
 }
 
@@ -116,6 +172,7 @@ static obs_properties_t *async_delay_filter_properties(void *data)
 
 	obs_properties_add_int(props, SETTING_DELAY_MS, TEXT_DELAY_MS,
 			0, 20000, 1);
+	obs_properties_add_bool(props, SETTING_COMPRESS, TEXT_COMPRESS);
 
 	UNUSED_PARAMETER(data);
 	return props;
@@ -125,8 +182,10 @@ static void async_delay_filter_remove(void *data, obs_source_t *parent)
 {
 	struct async_delay_data *filter = data;
 
-	free_video_data(filter, parent);
+	free_video_frames(filter);
 	free_audio_data(filter);
+
+	UNUSED_PARAMETER(parent);
 }
 
 /* due to the fact that we need timing information to be consistent in order to
@@ -138,29 +197,219 @@ static inline bool is_timestamp_jump(uint64_t ts, uint64_t prev_ts)
 	return ts < prev_ts || (ts - prev_ts) > SEC_TO_NSEC;
 }
 
+/* byte offsets of the samples of a macropixel of packed 4:2:2 formats */
+struct packed_layout {
+	size_t y0, y1, u, v;
+};
+
+static bool get_packed_layout(enum video_format format,
+		struct packed_layout *layout)
+{
+	switch (format) {
+	case VIDEO_FORMAT_YUY2:
+		*layout = (struct packed_layout){0, 2, 1, 3};
+		return true;
+	case VIDEO_FORMAT_YVYU:
+		*layout = (struct packed_layout){0, 2, 3, 1};
+		return true;
+	case VIDEO_FORMAT_UYVY:
+		*layout = (struct packed_layout){1, 3, 0, 2};
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* the chroma of each pair of lines is averaged */
+static void compress_to_nv12(struct obs_source_frame *dst,
+		const struct obs_source_frame *src,
+		const struct packed_layout *l)
+{
+	uint32_t pairs = src->width / 2;
+
+	for (uint32_t y = 0; y < src->height; y++) {
+		const uint8_t *in = src->data[0] + y * src->linesize[0];
+		uint8_t *lum = dst->data[0] + y * dst->linesize[0];
+
+		for (uint32_t x = 0; x < pairs; x++) {
+			lum[x * 2]     = in[x * 4 + l->y0];
+			lum[x * 2 + 1] = in[x * 4 + l->y1];
+		}
+	}
+
+	for (uint32_t y = 0; y < src->height / 2; y++) {
+		const uint8_t *in0 = src->data[0] + y * 2 * src->linesize[0];
+		const uint8_t *in1 = in0 + src->linesize[0];
+		uint8_t *chroma = dst->data[1] + y * dst->linesize[1];
+
+		for (uint32_t x = 0; x < pairs; x++) {
+			const uint8_t *p0 = in0 + x * 4;
+			const uint8_t *p1 = in1 + x * 4;
+
+			chroma[x * 2]     = (p0[l->u] + p1[l->u]) / 2;
+			chroma[x * 2 + 1] = (p0[l->v] + p1[l->v]) / 2;
+		}
+	}
+}
+
+static void expand_from_nv12(struct obs_source_frame *dst,
+		const struct obs_source_frame *src,
+		const struct packed_layout *l)
+{
+	uint32_t pairs = dst->width / 2;
+	uint32_t chroma_lines = dst->height / 2;
+
+	for (uint32_t y = 0; y < dst->height; y++) {
+		uint32_t chroma_y = y / 2 < chroma_lines ? y / 2 :
+			chroma_lines - 1;
+		const uint8_t *lum = src->data[0] + y * src->linesize[0];
+		const uint8_t *chroma = src->data[1] +
+			chroma_y * src->linesize[1];
+		uint8_t *out = dst->data[0] + y * dst->linesize[0];
+
+		for (uint32_t x = 0; x < pairs; x++) {
+			out[x * 4 + l->y0] = lum[x * 2];
+			out[x * 4 + l->y1] = lum[x * 2 + 1];
+			out[x * 4 + l->u]  = chroma[x * 2];
+			out[x * 4 + l->v]  = chroma[x * 2 + 1];
+		}
+	}
+}
+
+static inline void copy_frame_data(struct obs_source_frame *dst,
+		const struct obs_source_frame *src)
+{
+	struct video_frame dst_frame;
+	struct video_frame src_frame;
+
+	memcpy(dst_frame.data, dst->data, sizeof(dst_frame.data));
+	memcpy(dst_frame.linesize, dst->linesize, sizeof(dst_frame.linesize));
+	memcpy(src_frame.data, src->data, sizeof(src_frame.data));
+	memcpy(src_frame.linesize, src->linesize, sizeof(src_frame.linesize));
+
+	video_frame_copy(&dst_frame, &src_frame, src->format, src->height);
+}
+
+static inline void copy_frame_info(struct obs_source_frame *dst,
+		const struct obs_source_frame *src)
+{
+	dst->timestamp = src->timestamp;
+	dst->full_range = src->full_range;
+	dst->flip = src->flip;
+	memcpy(dst->color_matrix, src->color_matrix,
+			sizeof(dst->color_matrix));
+	memcpy(dst->color_range_min, src->color_range_min,
+			sizeof(dst->color_range_min));
+	memcpy(dst->color_range_max, src->color_range_max,
+			sizeof(dst->color_range_max));
+}
+
+static inline bool frame_format_changed(struct async_delay_data *filter,
+		const struct obs_source_frame *frame)
+{
+	struct packed_layout layout;
+	bool compress = filter->compress &&
+		get_packed_layout(frame->format, &layout);
+
+	return filter->frame_format != frame->format ||
+	       filter->frame_width  != frame->width  ||
+	       filter->frame_height != frame->height ||
+	       filter->compressed   != compress;
+}
+
+static struct obs_source_frame *store_frame(struct async_delay_data *filter,
+		const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *stored;
+	struct packed_layout layout;
+
+	if (frame_format_changed(filter, frame)) {
+		free_video_frames(filter);
+		filter->frame_format = frame->format;
+		filter->frame_width  = frame->width;
+		filter->frame_height = frame->height;
+		filter->compressed   = filter->compress &&
+			get_packed_layout(frame->format, &layout);
+	}
+
+	if (filter->unused_frames.num) {
+		stored = filter->unused_frames.array[
+			filter->unused_frames.num - 1];
+		da_pop_back(filter->unused_frames);
+	} else {
+		stored = create_frame(filter->compressed ?
+				VIDEO_FORMAT_NV12 : frame->format,
+				frame->width, frame->height);
+	}
+
+	if (filter->compressed) {
+		get_packed_layout(frame->format, &layout);
+		compress_to_nv12(stored, frame, &layout);
+	} else {
+		copy_frame_data(stored, frame);
+	}
+
+	copy_frame_info(stored, frame);
+	return stored;
+}
+
+static struct obs_source_frame *output_frame(struct async_delay_data *filter,
+		struct obs_source_frame *stored)
+{
+	struct packed_layout layout;
+
+	if (!filter->compressed) {
+		filter->output = stored;
+		return stored;
+	}
+
+	if (!filter->expanded)
+		filter->expanded = create_frame(filter->frame_format,
+				filter->frame_width, filter->frame_height);
+
+	get_packed_layout(filter->frame_format, &layout);
+	expand_from_nv12(filter->expanded, stored, &layout);
+	copy_frame_info(filter->expanded, stored);
+
+	unuse_frame(filter, stored);
+	return filter->expanded;
+}
+
 static struct obs_source_frame *async_delay_filter_video(void *data,
 		struct obs_source_frame *frame)
 {
 	struct async_delay_data *filter = data;
 	obs_source_t *parent = obs_filter_get_parent(filter->context);
+	struct obs_source_frame *stored;
 	struct obs_source_frame *output;
 	uint64_t cur_interval;
 
-	if (filter->reset_video ||
-	    is_timestamp_jump(frame->timestamp, filter->last_video_ts)) {
-		free_video_data(filter, parent);
+	/* the frame returned last has been released by now */
+	unuse_frame(filter, filter->output);
+	filter->output = NULL;
+
+	if (filter->reset_video) {
+		free_video_frames(filter);
 		filter->video_delay_reached = false;
 		filter->reset_video = false;
+
+	} else if (is_timestamp_jump(frame->timestamp,
+				filter->last_video_ts)) {
+		free_video_data(filter);
+		filter->video_delay_reached = false;
 	}
 
 	filter->last_video_ts = frame->timestamp;
 
-	circlebuf_push_back(&filter->video_frames, &frame,
+	stored = store_frame(filter, frame);
+	obs_source_release_frame(parent, frame);
+
+	circlebuf_push_back(&filter->video_frames, &stored,
 			sizeof(struct obs_source_frame*));
 	circlebuf_peek_front(&filter->video_frames, &output,
 			sizeof(struct obs_source_frame*));
 
-	cur_interval = frame->timestamp - output->timestamp;
+	cur_interval = stored->timestamp - output->timestamp;
 	if (!filter->video_delay_reached && cur_interval < filter->interval)
 		return NULL;
 
@@ -170,6 +419,8 @@ static struct obs_source_frame *async_delay_filter_video(void *data,
 	if (!filter->video_delay_reached)
 		filter->video_delay_reached = true;
 
+	output = output_frame(filter, output);
+	os_atomic_inc_long(&output->refs);
 	return output;
 }
 
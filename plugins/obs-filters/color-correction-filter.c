@@ -409,5 +409,6 @@ struct obs_source_info color_filter = {
 	.video_render = color_correction_filter_render,
 	.update = color_correction_filter_update,
 	.get_properties = color_correction_filter_properties,
-	.get_defaults = color_correction_filter_defaults
+	.get_defaults = color_correction_filter_defaults,
+	.fuse_function = "ColorFilterRGBA"
 };
@@ -252,5 +252,6 @@ struct obs_source_info color_key_filter = {
 	.video_render                  = color_key_render,
 	.update                        = color_key_update,
 	.get_properties                = color_key_properties,
-	.get_defaults                  = color_key_defaults
+	.get_defaults                  = color_key_defaults,
+	.fuse_function                 = "ColorKeyRGBA"
 };
@@ -178,6 +178,9 @@ static void gpu_delay_filter_tick(void *data, float t)
 
 	f->processed_frame = false;
 
+	/* the delayed frame that is drawn moves on every frame */
+	obs_source_content_changed(f->context);
+
 	if (check_size(f))
 		return;
 	check_interval(f);
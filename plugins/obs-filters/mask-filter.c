@@ -157,7 +157,9 @@ static void mask_filter_tick(void *data, float t)
 		if (!filter->last_time)
 			filter->last_time = cur_time;
 
-		gs_image_file_tick(&filter->image, cur_time - filter->last_time);
+		if (gs_image_file_tick(&filter->image,
+					cur_time - filter->last_time))
+			obs_source_content_changed(filter->context);
 		obs_enter_graphics();
 		gs_image_file_update_texture(&filter->image);
 		obs_leave_graphics();
@@ -4,6 +4,7 @@
 OBS_DECLARE_MODULE()
 
 OBS_MODULE_USE_DEFAULT_LOCALE("obs-filters", "en-US")
+OBS_MODULE_LOAD_THREAD_SAFE()
 
 extern struct obs_source_info mask_filter;
 extern struct obs_source_info crop_filter;
@@ -160,6 +160,9 @@ static void scroll_filter_tick(void *data, float seconds)
 		filter->offset.x -= 1.0f;
 	if (filter->offset.y > 1.0f)
 		filter->offset.y -= 1.0f;
+
+	if (filter->scroll_speed.x != 0.0f || filter->scroll_speed.y != 0.0f)
+		obs_source_content_changed(filter->context);
 }
 
 static void scroll_filter_render(void *data, gs_effect_t *effect)
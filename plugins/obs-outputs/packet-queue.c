@@ -0,0 +1,150 @@
+/******************************************************************************
+    Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "packet-queue.h"
+
+static inline bool is_droppable(const struct encoder_packet *packet)
+{
+	return packet->type == OBS_ENCODER_VIDEO && !packet->keyframe;
+}
+
+static inline int get_priority(const struct encoder_packet *packet)
+{
+	int priority = packet->drop_priority;
+
+	if (priority < 0)
+		return 0;
+	if (priority >= PACKET_QUEUE_PRIORITIES)
+		return PACKET_QUEUE_PRIORITIES - 1;
+	return priority;
+}
+
+static inline struct packet_queue_entry *get_entry(struct packet_queue *queue,
+		uint64_t id)
+{
+	return circlebuf_data(&queue->entries, (size_t)(id - queue->first_id) *
+			sizeof(struct packet_queue_entry));
+}
+
+static inline uint64_t index_front(struct circlebuf *index)
+{
+	return *(uint64_t*)circlebuf_data(index, 0);
+}
+
+void packet_queue_free(struct packet_queue *queue)
+{
+	packet_queue_clear(queue);
+
+	circlebuf_free(&queue->entries);
+	for (size_t i = 0; i < PACKET_QUEUE_PRIORITIES; i++)
+		circlebuf_free(&queue->priority_index[i]);
+}
+
+void packet_queue_clear(struct packet_queue *queue)
+{
+	struct encoder_packet packet;
+
+	while (packet_queue_pop(queue, &packet))
+		obs_encoder_packet_release(&packet);
+}
+
+void packet_queue_push(struct packet_queue *queue,
+		struct encoder_packet *packet)
+{
+	struct packet_queue_entry entry = {*packet, false};
+	uint64_t id = queue->first_id +
+		queue->entries.size / sizeof(struct packet_queue_entry);
+
+	circlebuf_push_back(&queue->entries, &entry, sizeof(entry));
+	queue->num_packets++;
+
+	if (is_droppable(packet))
+		circlebuf_push_back(&queue->priority_index[get_priority(packet)],
+				&id, sizeof(id));
+}
+
+bool packet_queue_pop(struct packet_queue *queue,
+		struct encoder_packet *packet)
+{
+	struct packet_queue_entry entry;
+
+	while (queue->entries.size) {
+		circlebuf_pop_front(&queue->entries, &entry, sizeof(entry));
+		queue->first_id++;
+
+		if (entry.dropped)
+			continue;
+
+		/* packets leave the queue in order, so a droppable packet
+		 * is always at the front of the index of its priority */
+		if (is_droppable(&entry.packet))
+			circlebuf_pop_front(&queue->priority_index[
+					get_priority(&entry.packet)],
+					NULL, sizeof(uint64_t));
+
+		queue->num_packets--;
+		*packet = entry.packet;
+		return true;
+	}
+
+	return false;
+}
+
+struct encoder_packet *packet_queue_first_droppable(
+		struct packet_queue *queue)
+{
+	uint64_t first_id = UINT64_MAX;
+
+	for (size_t i = 0; i < PACKET_QUEUE_PRIORITIES; i++) {
+		struct circlebuf *index = &queue->priority_index[i];
+
+		if (index->size && index_front(index) < first_id)
+			first_id = index_front(index);
+	}
+
+	if (first_id == UINT64_MAX)
+		return NULL;
+
+	return &get_entry(queue, first_id)->packet;
+}
+
+int packet_queue_drop(struct packet_queue *queue, int highest_priority)
+{
+	int num_dropped = 0;
+
+	if (highest_priority > PACKET_QUEUE_PRIORITIES)
+		highest_priority = PACKET_QUEUE_PRIORITIES;
+
+	for (int i = 0; i < highest_priority; i++) {
+		struct circlebuf *index = &queue->priority_index[i];
+
+		while (index->size) {
+			struct packet_queue_entry *entry;
+			uint64_t id;
+
+			circlebuf_pop_front(index, &id, sizeof(id));
+			entry = get_entry(queue, id);
+
+			obs_encoder_packet_release(&entry->packet);
+			entry->dropped = true;
+			queue->num_packets--;
+			num_dropped++;
+		}
+	}
+
+	return num_dropped;
+}
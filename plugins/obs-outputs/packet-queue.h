@@ -0,0 +1,68 @@
+/******************************************************************************
+    Copyright (C) 2018 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <obs.h>
+#include <obs-avc.h>
+#include <util/circlebuf.h>
+
+#define PACKET_QUEUE_PRIORITIES (OBS_NAL_PRIORITY_HIGHEST + 1)
+
+/*
+ * Queue of encoder packets waiting to be sent.  Besides the packets
+ * themselves, the queue keeps one index per drop priority of the video
+ * packets that can be dropped (everything but keyframes), so that finding
+ * the first droppable packet is O(1) and dropping packets only touches the
+ * packets that are actually dropped.  Dropped packets are only marked as
+ * such and are skipped when they reach the front of the queue.
+ */
+
+struct packet_queue_entry {
+	struct encoder_packet packet;
+	bool                  dropped;
+};
+
+struct packet_queue {
+	struct circlebuf entries;
+	struct circlebuf priority_index[PACKET_QUEUE_PRIORITIES];
+	uint64_t         first_id;
+	size_t           num_packets;
+};
+
+extern void packet_queue_free(struct packet_queue *queue);
+extern void packet_queue_clear(struct packet_queue *queue);
+
+extern void packet_queue_push(struct packet_queue *queue,
+		struct encoder_packet *packet);
+extern bool packet_queue_pop(struct packet_queue *queue,
+		struct encoder_packet *packet);
+
+/** Returns the first video packet that is not a keyframe, or NULL */
+extern struct encoder_packet *packet_queue_first_droppable(
+		struct packet_queue *queue);
+
+/**
+ * Drops all video packets that are not keyframes and have a drop priority
+ * lower than highest_priority, and returns the number of packets dropped.
+ */
+extern int packet_queue_drop(struct packet_queue *queue, int highest_priority);
+
+static inline size_t packet_queue_size(const struct packet_queue *queue)
+{
+	return queue->num_packets;
+}
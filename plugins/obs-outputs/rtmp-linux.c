@@ -0,0 +1,381 @@
+#ifdef __linux__
+#include "rtmp-stream.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/sockios.h>
+#include <unistd.h>
+
+#ifndef TCP_NOTSENT_LOWAT
+#define TCP_NOTSENT_LOWAT 25
+#endif
+
+/* the kernel holds at most this much unsent data at first; the limit
+ * follows the congestion window once the connection is running, up to an
+ * eighth of the write buffer (which holds about a second of the stream) */
+#define MIN_NOTSENT_LOWAT 16384
+#define MAX_NOTSENT_LOWAT_DIVISOR 8
+#define TUNE_INTERVAL_MS  1000
+#define LATENCY_FACTOR    20
+
+static inline size_t min_size(size_t a, size_t b)
+{
+	return a < b ? a : b;
+}
+
+bool socket_thread_linux_init(struct rtmp_stream *stream)
+{
+	stream->socket_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	return stream->socket_wake_fd != -1;
+}
+
+void socket_thread_linux_free(struct rtmp_stream *stream)
+{
+	if (stream->socket_wake_fd != -1) {
+		close(stream->socket_wake_fd);
+		stream->socket_wake_fd = -1;
+	}
+}
+
+void socket_thread_linux_signal(struct rtmp_stream *stream)
+{
+	if (stream->socket_wake_fd != -1)
+		eventfd_write(stream->socket_wake_fd, 1);
+}
+
+static void fatal_sock_shutdown(struct rtmp_stream *stream)
+{
+	close(stream->rtmp.m_sb.sb_socket);
+	stream->rtmp.m_sb.sb_socket = -1;
+	stream->write_buf_len = 0;
+	stream->socket_congestion = 0.0f;
+	os_event_signal(stream->buffer_space_available_event);
+}
+
+static bool set_epoll_events(int epoll_fd, int sock, uint32_t events)
+{
+	struct epoll_event ev = {0};
+	ev.events = events;
+	ev.data.fd = sock;
+	return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, sock, &ev) == 0;
+}
+
+static bool socket_event(struct rtmp_stream *stream, uint32_t events,
+		bool *can_write, uint64_t last_send_time)
+{
+	int sock = stream->rtmp.m_sb.sb_socket;
+
+	if (events & EPOLLOUT)
+		*can_write = true;
+
+	if (events & EPOLLIN) {
+		char discard[16384];
+
+		for (;;) {
+			ssize_t ret = recv(sock, discard, sizeof(discard), 0);
+			if (ret > 0)
+				continue;
+			if (ret == -1 && (errno == EAGAIN ||
+			                  errno == EWOULDBLOCK))
+				break;
+			if (ret == -1 && errno == EINTR)
+				continue;
+
+			blog(LOG_ERROR, "socket_thread_linux: Socket error, "
+					"recv() returned %d, errno %d",
+					(int)ret, ret == 0 ? 0 : errno);
+			stream->rtmp.last_error_code = ret == 0 ? 0 : errno;
+			fatal_sock_shutdown(stream);
+			return false;
+		}
+	}
+
+	if (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+		int err_code = 0;
+		socklen_t size = sizeof(err_code);
+
+		getsockopt(sock, SOL_SOCKET, SO_ERROR, &err_code, &size);
+
+		if (last_send_time) {
+			uint32_t diff = (uint32_t)(os_gettime_ns() / 1000000 -
+					last_send_time);
+
+			blog(LOG_ERROR, "socket_thread_linux: Socket closed, "
+					"%u ms since last send "
+					"(buffer: %d / %d)",
+					diff,
+					(int)stream->write_buf_len,
+					(int)stream->write_buf_size);
+		}
+
+		if (os_event_try(stream->stop_event) != EAGAIN)
+			blog(LOG_ERROR, "socket_thread_linux: Aborting due "
+					"to socket close during shutdown, "
+					"%d bytes lost, error %d",
+					(int)stream->write_buf_len, err_code);
+		else
+			blog(LOG_ERROR, "socket_thread_linux: Aborting due "
+					"to socket close, error %d",
+					err_code);
+
+		stream->rtmp.last_error_code = err_code;
+		fatal_sock_shutdown(stream);
+		return false;
+	}
+
+	return true;
+}
+
+/* SO_SNDBUF is never set, setting it would lock the buffer size and turn off
+ * the kernel's autotuning.  Only the not-sent limit is tuned: it follows the
+ * congestion window, which keeps about one round trip of data queued in the
+ * kernel and the rest in the write buffer where it counts towards
+ * congestion. */
+static void tune_notsent_lowat(struct rtmp_stream *stream, int *notsent_lowat)
+{
+	int sock = stream->rtmp.m_sb.sb_socket;
+	struct tcp_info tcpi;
+	socklen_t size = sizeof(tcpi);
+	int lowat;
+
+	if (getsockopt(sock, IPPROTO_TCP, TCP_INFO, &tcpi, &size) != 0)
+		return;
+
+	lowat = (int)(tcpi.tcpi_snd_cwnd * tcpi.tcpi_snd_mss);
+	if (lowat > (int)(stream->write_buf_size / MAX_NOTSENT_LOWAT_DIVISOR))
+		lowat = (int)(stream->write_buf_size / MAX_NOTSENT_LOWAT_DIVISOR);
+	if (lowat < MIN_NOTSENT_LOWAT)
+		lowat = MIN_NOTSENT_LOWAT;
+
+	if (lowat != *notsent_lowat) {
+		if (setsockopt(sock, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+				&lowat, sizeof(lowat)) == 0)
+			*notsent_lowat = lowat;
+	}
+}
+
+/* congestion is how full the data waiting to be sent is, both in the write
+ * buffer and in the socket */
+static void update_congestion(struct rtmp_stream *stream, int notsent_lowat)
+{
+	int unsent = 0;
+	float congestion;
+
+	if (ioctl(stream->rtmp.m_sb.sb_socket, SIOCOUTQNSD, &unsent) != 0)
+		unsent = 0;
+
+	pthread_mutex_lock(&stream->write_buf_mutex);
+	congestion = (float)(stream->write_buf_len + (size_t)unsent) /
+		(float)(stream->write_buf_size + (size_t)notsent_lowat);
+	pthread_mutex_unlock(&stream->write_buf_mutex);
+
+	stream->socket_congestion = congestion > 1.0f ? 1.0f : congestion;
+}
+
+enum data_ret {
+	RET_BREAK,
+	RET_FATAL,
+	RET_CONTINUE
+};
+
+static enum data_ret write_data(struct rtmp_stream *stream, bool *can_write,
+		uint64_t *last_send_time, size_t latency_packet_size,
+		int delay_time)
+{
+	bool exit_loop;
+	size_t send_len;
+	ssize_t ret;
+
+	pthread_mutex_lock(&stream->write_buf_mutex);
+
+	if (!stream->write_buf_len) {
+		pthread_mutex_unlock(&stream->write_buf_mutex);
+		return RET_BREAK;
+	}
+
+	send_len = stream->low_latency_mode ?
+		min_size(latency_packet_size, stream->write_buf_len) :
+		stream->write_buf_len;
+
+	ret = send(stream->rtmp.m_sb.sb_socket, stream->write_buf, send_len,
+			MSG_NOSIGNAL);
+
+	if (ret > 0) {
+		if (stream->write_buf_len - ret)
+			memmove(stream->write_buf,
+					stream->write_buf + ret,
+					stream->write_buf_len - ret);
+		stream->write_buf_len -= ret;
+
+		*last_send_time = os_gettime_ns() / 1000000;
+
+		os_event_signal(stream->buffer_space_available_event);
+
+	} else if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		*can_write = false;
+		pthread_mutex_unlock(&stream->write_buf_mutex);
+		return RET_BREAK;
+
+	} else if (ret == -1 && errno == EINTR) {
+		pthread_mutex_unlock(&stream->write_buf_mutex);
+		return RET_CONTINUE;
+
+	} else {
+		int err_code = ret == 0 ? 0 : errno;
+
+		/* connection closed, or connection was aborted /
+		 * socket closed / etc, that's a fatal error. */
+		blog(LOG_ERROR, "socket_thread_linux: Socket error, "
+				"send() returned %d, errno %d",
+				(int)ret, err_code);
+
+		pthread_mutex_unlock(&stream->write_buf_mutex);
+		stream->rtmp.last_error_code = err_code;
+		fatal_sock_shutdown(stream);
+		return RET_FATAL;
+	}
+
+	exit_loop = stream->write_buf_len == 0;
+
+	pthread_mutex_unlock(&stream->write_buf_mutex);
+
+	if (delay_time)
+		os_sleep_ms(delay_time);
+
+	return exit_loop ? RET_BREAK : RET_CONTINUE;
+}
+
+static inline void socket_thread_linux_internal(struct rtmp_stream *stream)
+{
+	int sock = stream->rtmp.m_sb.sb_socket;
+	struct epoll_event ev = {0};
+	struct epoll_event events[2];
+	uint32_t sock_events = EPOLLIN | EPOLLRDHUP;
+	bool can_write = true;
+	int notsent_lowat = 0;
+	int epoll_fd;
+
+	int delay_time;
+	size_t latency_packet_size;
+	uint64_t last_send_time = 0;
+	uint64_t last_tune_time = 0;
+
+	os_set_thread_name("rtmp-stream: socket_thread_linux");
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd == -1) {
+		blog(LOG_ERROR, "socket_thread_linux: Aborting due to "
+				"epoll_create1 failure, errno %d", errno);
+		fatal_sock_shutdown(stream);
+		return;
+	}
+
+	ev.events = sock_events;
+	ev.data.fd = sock;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &ev);
+
+	ev.events = EPOLLIN;
+	ev.data.fd = stream->socket_wake_fd;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stream->socket_wake_fd, &ev);
+
+	if (stream->low_latency_mode) {
+		delay_time = 1000 / LATENCY_FACTOR;
+		latency_packet_size = stream->write_buf_size /
+			(LATENCY_FACTOR - 2);
+	} else {
+		latency_packet_size = stream->write_buf_size;
+		delay_time = 0;
+	}
+
+	stream->socket_congestion = 0.0f;
+
+	if (stream->disable_send_window_optimization) {
+		blog(LOG_INFO, "socket_thread_linux: Send window "
+				"optimization disabled by user.");
+	} else {
+		notsent_lowat = MIN_NOTSENT_LOWAT;
+		setsockopt(sock, IPPROTO_TCP, TCP_NOTSENT_LOWAT,
+				&notsent_lowat, sizeof(notsent_lowat));
+	}
+
+	for (;;) {
+		if (os_event_try(stream->send_thread_signaled_exit) != EAGAIN) {
+			pthread_mutex_lock(&stream->write_buf_mutex);
+			if (stream->write_buf_len == 0) {
+				pthread_mutex_unlock(&stream->write_buf_mutex);
+				os_event_reset(stream->send_thread_signaled_exit);
+				break;
+			}
+
+			pthread_mutex_unlock(&stream->write_buf_mutex);
+		}
+
+		int count = epoll_wait(epoll_fd, events, 2, TUNE_INTERVAL_MS);
+		if (count == -1 && errno != EINTR) {
+			blog(LOG_ERROR, "socket_thread_linux: Aborting due "
+					"to epoll_wait failure, errno %d",
+					errno);
+			fatal_sock_shutdown(stream);
+			goto fatal_exit;
+		}
+
+		for (int i = 0; i < count; i++) {
+			if (events[i].data.fd == stream->socket_wake_fd) {
+				eventfd_t val;
+				eventfd_read(stream->socket_wake_fd, &val);
+
+			} else if (!socket_event(stream, events[i].events,
+						&can_write, last_send_time)) {
+				goto fatal_exit;
+			}
+		}
+
+		uint64_t ts = os_gettime_ns() / 1000000;
+		if (notsent_lowat && ts - last_tune_time >= TUNE_INTERVAL_MS) {
+			tune_notsent_lowat(stream, &notsent_lowat);
+			last_tune_time = ts;
+		}
+
+		while (can_write) {
+			enum data_ret ret = write_data(
+					stream,
+					&can_write,
+					&last_send_time,
+					latency_packet_size,
+					delay_time);
+
+			if (ret == RET_FATAL)
+				goto fatal_exit;
+			if (ret == RET_BREAK)
+				break;
+		}
+
+		/* only wait for the socket to become writable while there's
+		 * data it didn't take, otherwise it'd wake up constantly */
+		uint32_t new_events = EPOLLIN | EPOLLRDHUP;
+		if (!can_write)
+			new_events |= EPOLLOUT;
+
+		if (new_events != sock_events &&
+		    set_epoll_events(epoll_fd, sock, new_events))
+			sock_events = new_events;
+
+		update_congestion(stream, notsent_lowat);
+	}
+
+	close(epoll_fd);
+	blog(LOG_INFO, "socket_thread_linux: Normal exit");
+	return;
+
+fatal_exit:
+	close(epoll_fd);
+}
+
+void *socket_thread_linux(void *data)
+{
+	struct rtmp_stream *stream = data;
+	socket_thread_linux_internal(stream);
+	return NULL;
+}
+#endif
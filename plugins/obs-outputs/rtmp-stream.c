@@ -43,11 +43,7 @@ static inline void free_packets(struct rtmp_stream *stream)
 	if (num_packets)
 		info("Freeing %d remaining packets", (int)num_packets);
 
-	while (stream->packets.size) {
-		struct encoder_packet packet;
-		circlebuf_pop_front(&stream->packets, &packet, sizeof(packet));
-		obs_encoder_packet_release(&packet);
-	}
+	packet_queue_clear(&stream->packets);
 	pthread_mutex_unlock(&stream->packets_mutex);
 }
 
@@ -102,7 +98,7 @@ static void rtmp_stream_destroy(void *data)
 	os_event_destroy(stream->stop_event);
 	os_sem_destroy(stream->send_sem);
 	pthread_mutex_destroy(&stream->packets_mutex);
-	circlebuf_free(&stream->packets);
+	packet_queue_free(&stream->packets);
 #ifdef TEST_FRAMEDROPS
 	circlebuf_free(&stream->droptest_info);
 #endif
@@ -112,6 +108,9 @@ static void rtmp_stream_destroy(void *data)
 	os_event_destroy(stream->socket_available_event);
 	os_event_destroy(stream->send_thread_signaled_exit);
 	pthread_mutex_destroy(&stream->write_buf_mutex);
+#ifdef __linux__
+	socket_thread_linux_free(stream);
+#endif
 
 	if (stream->write_buf)
 		bfree(stream->write_buf);
@@ -123,6 +122,9 @@ static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 	struct rtmp_stream *stream = bzalloc(sizeof(struct rtmp_stream));
 	stream->output = output;
 	pthread_mutex_init_value(&stream->packets_mutex);
+#ifdef __linux__
+	stream->socket_wake_fd = -1;
+#endif
 
 	RTMP_Init(&stream->rtmp);
 	RTMP_LogSetCallback(log_rtmp);
@@ -158,6 +160,16 @@ static void *rtmp_stream_create(obs_data_t *settings, obs_output_t *output)
 		warn("Failed to initialize socket exit event");
 		goto fail;
 	}
+#ifdef __linux__
+	if (!socket_thread_linux_init(stream)) {
+		warn("Failed to initialize socket wake event");
+		goto fail;
+	}
+#endif
+
+	signal_handler_add(obs_output_get_signal_handler(output),
+			"void bitrate_changed(ptr output, int bitrate, "
+			"int prev_bitrate)");
 
 	UNUSED_PARAMETER(settings);
 	return stream;
@@ -212,11 +224,7 @@ static inline bool get_next_packet(struct rtmp_stream *stream,
 	bool new_packet = false;
 
 	pthread_mutex_lock(&stream->packets_mutex);
-	if (stream->packets.size) {
-		circlebuf_pop_front(&stream->packets, packet,
-				sizeof(struct encoder_packet));
-		new_packet = true;
-	}
+	new_packet = packet_queue_pop(&stream->packets, packet);
 	pthread_mutex_unlock(&stream->packets_mutex);
 
 	return new_packet;
@@ -323,6 +331,9 @@ retry_send:
 	pthread_mutex_unlock(&stream->write_buf_mutex);
 
 	os_event_signal (stream->buffer_has_data_event);
+#ifdef __linux__
+	socket_thread_linux_signal(stream);
+#endif
 
 	return len;
 }
@@ -441,6 +452,232 @@ static void set_output_error(struct rtmp_stream *stream)
 	obs_output_set_last_error(stream->output, msg);
 }
 
+#define DBR_RATE_INTERVAL_NS  1000000000ULL
+#define DBR_DEC_INTERVAL_NS   2000000000ULL
+#define DBR_INC_INTERVAL_NS   10000000000ULL
+#define DBR_DEC_THRESHOLD     40 /* percent of the drop threshold */
+#define DBR_INC_THRESHOLD     10 /* percent of the drop threshold */
+#define DBR_DEC_MAX_PERCENT   90
+#define DBR_INC_STEP_PERCENT  5
+#define DBR_MIN_PERCENT       25
+
+static long get_encoder_bitrate(obs_encoder_t *encoder)
+{
+	obs_data_t *settings = obs_encoder_get_settings(encoder);
+	long bitrate = (long)obs_data_get_int(settings, "bitrate");
+	obs_data_release(settings);
+	return bitrate;
+}
+
+static void dbr_init(struct rtmp_stream *stream, obs_data_t *settings)
+{
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
+	obs_encoder_t *aencoder;
+	uint32_t caps;
+
+	stream->dbr_enabled = false;
+
+	if (!obs_data_get_bool(settings, OPT_DYN_BITRATE) || !vencoder)
+		return;
+
+	caps = obs_get_encoder_caps(obs_encoder_get_id(vencoder));
+	if ((caps & OBS_ENCODER_CAP_DYN_BITRATE) == 0) {
+		info("Dynamic bitrate disabled, video encoder '%s' cannot "
+				"change its bitrate while encoding",
+				obs_encoder_get_id(vencoder));
+		return;
+	}
+
+	stream->dbr_orig_bitrate = get_encoder_bitrate(vencoder);
+	if (stream->dbr_orig_bitrate <= 0) {
+		warn("Dynamic bitrate disabled, video encoder didn't return "
+				"a valid bitrate");
+		return;
+	}
+
+	stream->dbr_audio_bitrate = 0;
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		aencoder = obs_output_get_audio_encoder(stream->output, i);
+		if (!aencoder)
+			break;
+		stream->dbr_audio_bitrate += get_encoder_bitrate(aencoder);
+	}
+
+	stream->dbr_cur_bitrate     = stream->dbr_orig_bitrate;
+	stream->dbr_rate_ts         = 0;
+	stream->dbr_rate_bytes      = 0;
+	stream->dbr_send_rate       = 0;
+	stream->dbr_last_change_ts  = 0;
+	stream->dbr_stable_since_ts = 0;
+	stream->dbr_new_bitrate     = 0;
+	stream->dbr_prev_bitrate    = 0;
+	stream->dbr_enabled         = true;
+
+	info("Dynamic bitrate enabled, video bitrate: %ld kbps",
+			stream->dbr_orig_bitrate);
+}
+
+/* called with packets_mutex held, so only records the new bitrate.  the
+ * encoder is updated and the signal sent by dbr_apply_bitrate once the
+ * mutex has been released, in case a signal handler touches the output */
+static void dbr_set_bitrate(struct rtmp_stream *stream, long bitrate,
+		uint64_t ts)
+{
+	if (!stream->dbr_new_bitrate)
+		stream->dbr_prev_bitrate = stream->dbr_cur_bitrate;
+
+	info("Video bitrate changed from %ld to %ld kbps "
+			"(send rate: %ld kbps)",
+			stream->dbr_cur_bitrate, bitrate,
+			stream->dbr_send_rate);
+
+	stream->dbr_new_bitrate    = bitrate;
+	stream->dbr_cur_bitrate    = bitrate;
+	stream->dbr_last_change_ts = ts;
+}
+
+/* takes the bitrate change recorded by dbr_set_bitrate, if any.  must be
+ * called with packets_mutex held */
+static inline long dbr_take_bitrate(struct rtmp_stream *stream,
+		long *prev_bitrate)
+{
+	long bitrate = stream->dbr_new_bitrate;
+
+	*prev_bitrate = stream->dbr_prev_bitrate;
+	stream->dbr_new_bitrate = 0;
+	return bitrate;
+}
+
+static void dbr_apply_bitrate(struct rtmp_stream *stream, long bitrate,
+		long prev_bitrate)
+{
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
+	signal_handler_t *sh = obs_output_get_signal_handler(stream->output);
+	obs_data_t *settings;
+	struct calldata params;
+
+	if (!vencoder)
+		return;
+
+	settings = obs_data_create();
+	obs_data_set_int(settings, "bitrate", bitrate);
+	obs_encoder_update(vencoder, settings);
+	obs_data_release(settings);
+
+	calldata_init(&params);
+	calldata_set_ptr(&params, "output", stream->output);
+	calldata_set_int(&params, "bitrate", bitrate);
+	calldata_set_int(&params, "prev_bitrate", prev_bitrate);
+	signal_handler_signal(sh, "bitrate_changed", &params);
+	calldata_free(&params);
+}
+
+static void dbr_update_send_rate(struct rtmp_stream *stream, uint64_t ts)
+{
+	uint64_t bytes;
+	long rate;
+
+	if (!stream->dbr_rate_ts) {
+		stream->dbr_rate_ts    = ts;
+		stream->dbr_rate_bytes = stream->total_bytes_sent;
+		return;
+	}
+
+	if (ts - stream->dbr_rate_ts < DBR_RATE_INTERVAL_NS)
+		return;
+
+	bytes = stream->total_bytes_sent - stream->dbr_rate_bytes;
+	rate  = (long)(bytes * 8000000ULL / (ts - stream->dbr_rate_ts));
+
+	stream->dbr_send_rate  = stream->dbr_send_rate ?
+		(stream->dbr_send_rate + rate) / 2 : rate;
+	stream->dbr_rate_ts    = ts;
+	stream->dbr_rate_bytes = stream->total_bytes_sent;
+}
+
+/* lowers the video bitrate to just under what the connection is currently
+ * sustaining as soon as data starts to back up (well before frames would
+ * have to be dropped), and only raises it back towards the original
+ * bitrate in small steps after the buffer has stayed nearly empty for a
+ * while, so that it doesn't oscillate */
+static void dbr_update(struct rtmp_stream *stream,
+		int64_t buffer_duration_usec)
+{
+	int64_t dec_threshold = stream->drop_threshold_usec *
+		DBR_DEC_THRESHOLD / 100;
+	int64_t inc_threshold = stream->drop_threshold_usec *
+		DBR_INC_THRESHOLD / 100;
+	uint64_t ts = os_gettime_ns();
+	long bitrate;
+
+	dbr_update_send_rate(stream, ts);
+
+	if (buffer_duration_usec > dec_threshold) {
+		long max_bitrate = stream->dbr_cur_bitrate *
+			DBR_DEC_MAX_PERCENT / 100;
+		long min_bitrate = stream->dbr_orig_bitrate *
+			DBR_MIN_PERCENT / 100;
+
+		stream->dbr_stable_since_ts = 0;
+
+		if (ts - stream->dbr_last_change_ts < DBR_DEC_INTERVAL_NS)
+			return;
+
+		bitrate = (stream->dbr_send_rate - stream->dbr_audio_bitrate) *
+			DBR_DEC_MAX_PERCENT / 100;
+		if (!stream->dbr_send_rate || bitrate > max_bitrate)
+			bitrate = max_bitrate;
+		if (bitrate < min_bitrate)
+			bitrate = min_bitrate;
+
+		if (bitrate < stream->dbr_cur_bitrate)
+			dbr_set_bitrate(stream, bitrate, ts);
+
+	} else if (buffer_duration_usec < inc_threshold) {
+		if (stream->dbr_cur_bitrate >= stream->dbr_orig_bitrate)
+			return;
+
+		if (!stream->dbr_stable_since_ts) {
+			stream->dbr_stable_since_ts = ts;
+			return;
+		}
+
+		if (ts - stream->dbr_stable_since_ts < DBR_INC_INTERVAL_NS ||
+		    ts - stream->dbr_last_change_ts < DBR_INC_INTERVAL_NS)
+			return;
+
+		bitrate = stream->dbr_cur_bitrate +
+			stream->dbr_orig_bitrate * DBR_INC_STEP_PERCENT / 100;
+		if (bitrate > stream->dbr_orig_bitrate)
+			bitrate = stream->dbr_orig_bitrate;
+
+		dbr_set_bitrate(stream, bitrate, ts);
+		stream->dbr_stable_since_ts = ts;
+
+	} else {
+		stream->dbr_stable_since_ts = 0;
+	}
+}
+
+static void dbr_restore(struct rtmp_stream *stream)
+{
+	long bitrate, prev_bitrate;
+
+	pthread_mutex_lock(&stream->packets_mutex);
+
+	if (stream->dbr_enabled &&
+	    stream->dbr_cur_bitrate != stream->dbr_orig_bitrate)
+		dbr_set_bitrate(stream, stream->dbr_orig_bitrate,
+				os_gettime_ns());
+	stream->dbr_enabled = false;
+	bitrate = dbr_take_bitrate(stream, &prev_bitrate);
+
+	pthread_mutex_unlock(&stream->packets_mutex);
+
+	if (bitrate)
+		dbr_apply_bitrate(stream, bitrate, prev_bitrate);
+}
+
 static void *send_thread(void *data)
 {
 	struct rtmp_stream *stream = data;
@@ -477,6 +714,8 @@ static void *send_thread(void *data)
 		}
 	}
 
+	dbr_restore(stream);
+
 	if (disconnected(stream)) {
 		info("Disconnected from %s", stream->path.array);
 	} else {
@@ -486,6 +725,9 @@ static void *send_thread(void *data)
 	if (stream->new_socket_loop) {
 		os_event_signal(stream->send_thread_signaled_exit);
 		os_event_signal(stream->buffer_has_data_event);
+#ifdef __linux__
+		socket_thread_linux_signal(stream);
+#endif
 		pthread_join(stream->socket_thread, NULL);
 		stream->socket_thread_active = false;
 		stream->rtmp.m_bCustomSend = false;
@@ -698,6 +940,9 @@ static int init_send(struct rtmp_stream *stream)
 #ifdef _WIN32
 		ret = pthread_create(&stream->socket_thread, NULL,
 				socket_thread_windows, stream);
+#elif defined(__linux__)
+		ret = pthread_create(&stream->socket_thread, NULL,
+				socket_thread_linux, stream);
 #else
 		warn("New socket loop not supported on this platform");
 		return OBS_OUTPUT_ERROR;
@@ -907,6 +1152,8 @@ static bool init_connect(struct rtmp_stream *stream)
 	stream->low_latency_mode = obs_data_get_bool(settings,
 			OPT_LOWLATENCY_ENABLED);
 
+	dbr_init(stream, settings);
+
 	obs_data_release(settings);
 	return true;
 }
@@ -954,14 +1201,13 @@ static bool rtmp_stream_start(void *data)
 static inline bool add_packet(struct rtmp_stream *stream,
 		struct encoder_packet *packet)
 {
-	circlebuf_push_back(&stream->packets, packet,
-			sizeof(struct encoder_packet));
+	packet_queue_push(&stream->packets, packet);
 	return true;
 }
 
 static inline size_t num_buffered_packets(struct rtmp_stream *stream)
 {
-	return stream->packets.size / sizeof(struct encoder_packet);
+	return packet_queue_size(&stream->packets);
 }
 
 static void drop_frames(struct rtmp_stream *stream, const char *name,
@@ -969,8 +1215,7 @@ static void drop_frames(struct rtmp_stream *stream, const char *name,
 {
 	UNUSED_PARAMETER(pframes);
 
-	struct circlebuf new_buf            = {0};
-	int              num_frames_dropped = 0;
+	int num_frames_dropped;
 
 #ifdef _DEBUG
 	int start_packets = (int)num_buffered_packets(stream);
@@ -978,25 +1223,9 @@ static void drop_frames(struct rtmp_stream *stream, const char *name,
 	UNUSED_PARAMETER(name);
 #endif
 
-	circlebuf_reserve(&new_buf, sizeof(struct encoder_packet) * 8);
-
-	while (stream->packets.size) {
-		struct encoder_packet packet;
-		circlebuf_pop_front(&stream->packets, &packet, sizeof(packet));
-
-		/* do not drop audio data or video keyframes */
-		if (packet.type          == OBS_ENCODER_AUDIO ||
-		    packet.drop_priority >= highest_priority) {
-			circlebuf_push_back(&new_buf, &packet, sizeof(packet));
-
-		} else {
-			num_frames_dropped++;
-			obs_encoder_packet_release(&packet);
-		}
-	}
-
-	circlebuf_free(&stream->packets);
-	stream->packets = new_buf;
+	/* audio data and video keyframes are never dropped */
+	num_frames_dropped = packet_queue_drop(&stream->packets,
+			highest_priority);
 
 	if (stream->min_priority < highest_priority)
 		stream->min_priority = highest_priority;
@@ -1012,26 +1241,9 @@ static void drop_frames(struct rtmp_stream *stream, const char *name,
 #endif
 }
 
-static bool find_first_video_packet(struct rtmp_stream *stream,
-		struct encoder_packet *first)
-{
-	size_t count = stream->packets.size / sizeof(*first);
-
-	for (size_t i = 0; i < count; i++) {
-		struct encoder_packet *cur = circlebuf_data(&stream->packets,
-				i * sizeof(*first));
-		if (cur->type == OBS_ENCODER_VIDEO && !cur->keyframe) {
-			*first = *cur;
-			return true;
-		}
-	}
-
-	return false;
-}
-
 static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 {
-	struct encoder_packet first;
+	struct encoder_packet *first;
 	int64_t buffer_duration_usec;
 	size_t num_packets = num_buffered_packets(stream);
 	const char *name = pframes ? "p-frames" : "b-frames";
@@ -1042,21 +1254,27 @@ static void check_to_drop_frames(struct rtmp_stream *stream, bool pframes)
 		stream->drop_threshold_usec;
 
 	if (num_packets < 5) {
-		if (!pframes)
+		if (!pframes) {
 			stream->congestion = 0.0f;
+			if (stream->dbr_enabled)
+				dbr_update(stream, 0);
+		}
 		return;
 	}
 
-	if (!find_first_video_packet(stream, &first))
+	first = packet_queue_first_droppable(&stream->packets);
+	if (!first)
 		return;
 
 	/* if the amount of time stored in the buffered packets waiting to be
 	 * sent is higher than threshold, drop frames */
-	buffer_duration_usec = stream->last_dts_usec - first.dts_usec;
+	buffer_duration_usec = stream->last_dts_usec - first->dts_usec;
 
 	if (!pframes) {
 		stream->congestion = (float)buffer_duration_usec /
 			(float)drop_threshold;
+		if (stream->dbr_enabled)
+			dbr_update(stream, buffer_duration_usec);
 	}
 
 	if (buffer_duration_usec > drop_threshold) {
@@ -1089,6 +1307,8 @@ static void rtmp_stream_data(void *data, struct encoder_packet *packet)
 	struct rtmp_stream    *stream = data;
 	struct encoder_packet new_packet;
 	bool                  added_packet = false;
+	long                  new_bitrate;
+	long                  prev_bitrate;
 
 	if (disconnected(stream) || !active(stream))
 		return;
@@ -1113,8 +1333,13 @@ static void rtmp_stream_data(void *data, struct encoder_packet *packet)
 			add_packet(stream, &new_packet);
 	}
 
+	new_bitrate = dbr_take_bitrate(stream, &prev_bitrate);
+
 	pthread_mutex_unlock(&stream->packets_mutex);
 
+	if (new_bitrate)
+		dbr_apply_bitrate(stream, new_bitrate, prev_bitrate);
+
 	if (added_packet)
 		os_sem_post(stream->send_sem);
 	else
@@ -1129,6 +1354,7 @@ static void rtmp_stream_defaults(obs_data_t *defaults)
 	obs_data_set_default_string(defaults, OPT_BIND_IP, "default");
 	obs_data_set_default_bool(defaults, OPT_NEWSOCKETLOOP_ENABLED, false);
 	obs_data_set_default_bool(defaults, OPT_LOWLATENCY_ENABLED, false);
+	obs_data_set_default_bool(defaults, OPT_DYN_BITRATE, false);
 }
 
 static obs_properties_t *rtmp_stream_properties(void *unused)
@@ -1160,6 +1386,8 @@ static obs_properties_t *rtmp_stream_properties(void *unused)
 			obs_module_text("RTMPStream.NewSocketLoop"));
 	obs_properties_add_bool(props, OPT_LOWLATENCY_ENABLED,
 			obs_module_text("RTMPStream.LowLatencyMode"));
+	obs_properties_add_bool(props, OPT_DYN_BITRATE,
+			obs_module_text("RTMPStream.DynamicBitrate"));
 
 	return props;
 }
@@ -1181,8 +1409,12 @@ static float rtmp_stream_congestion(void *data)
 	struct rtmp_stream *stream = data;
 
 	if (stream->new_socket_loop)
+#ifdef __linux__
+		return stream->socket_congestion;
+#else
 		return (float)stream->write_buf_len /
 			(float)stream->write_buf_size;
+#endif
 	else
 		return stream->min_priority > 0 ? 1.0f : stream->congestion;
 }
@@ -8,6 +8,7 @@
 #include "librtmp/rtmp.h"
 #include "librtmp/log.h"
 #include "flv-mux.h"
+#include "packet-queue.h"
 #include "net-if.h"
 
 #ifdef _WIN32
@@ -30,6 +31,7 @@
 #define OPT_BIND_IP "bind_ip"
 #define OPT_NEWSOCKETLOOP_ENABLED "new_socket_loop_enabled"
 #define OPT_LOWLATENCY_ENABLED "low_latency_mode_enabled"
+#define OPT_DYN_BITRATE "dyn_bitrate"
 
 //#define TEST_FRAMEDROPS
 
@@ -48,7 +50,7 @@ struct rtmp_stream {
 	obs_output_t     *output;
 
 	pthread_mutex_t  packets_mutex;
-	struct circlebuf packets;
+	struct packet_queue packets;
 	bool             sent_headers;
 
 	bool             got_first_video;
@@ -84,6 +86,19 @@ struct rtmp_stream {
 	uint64_t         total_bytes_sent;
 	int              dropped_frames;
 
+	/* dynamic bitrate variables */
+	bool             dbr_enabled;
+	long             dbr_orig_bitrate;
+	long             dbr_cur_bitrate;
+	long             dbr_audio_bitrate;
+	uint64_t         dbr_rate_ts;
+	uint64_t         dbr_rate_bytes;
+	long             dbr_send_rate;
+	uint64_t         dbr_last_change_ts;
+	uint64_t         dbr_stable_since_ts;
+	long             dbr_new_bitrate;
+	long             dbr_prev_bitrate;
+
 #ifdef TEST_FRAMEDROPS
 	struct circlebuf droptest_info;
 	size_t           droptest_size;
@@ -104,8 +119,18 @@ struct rtmp_stream {
 	os_event_t       *buffer_has_data_event;
 	os_event_t       *socket_available_event;
 	os_event_t       *send_thread_signaled_exit;
+
+#ifdef __linux__
+	int              socket_wake_fd;
+	float            socket_congestion;
+#endif
 };
 
 #ifdef _WIN32
 void *socket_thread_windows(void *data);
+#elif defined(__linux__)
+bool socket_thread_linux_init(struct rtmp_stream *stream);
+void socket_thread_linux_free(struct rtmp_stream *stream);
+void socket_thread_linux_signal(struct rtmp_stream *stream);
+void *socket_thread_linux(void *data);
 #endif
@@ -3,6 +3,7 @@
 OBS_DECLARE_MODULE()
 
 OBS_MODULE_USE_DEFAULT_LOCALE("obs-transitions", "en-US")
+OBS_MODULE_LOAD_THREAD_SAFE()
 
 extern struct obs_source_info cut_transition;
 extern struct obs_source_info fade_transition;
@@ -47,6 +47,7 @@ static void stinger_update(void *data, obs_data_t *settings)
 
 	obs_data_t *media_settings = obs_data_create();
 	obs_data_set_string(media_settings, "local_file", path);
+	obs_data_set_bool(media_settings, "shared_decoding", true);
 
 	obs_source_release(s->media_source);
 	s->media_source = obs_source_create_private("ffmpeg_source", NULL,
@@ -2,6 +2,7 @@
 
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("obs-x264", "en-US")
+OBS_MODULE_LOAD_THREAD_SAFE()
 
 extern struct obs_encoder_info obs_x264_encoder;
 
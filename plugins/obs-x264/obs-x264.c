@@ -769,6 +769,7 @@ struct obs_encoder_info obs_x264_encoder = {
 	.id             = "obs_x264",
 	.type           = OBS_ENCODER_VIDEO,
 	.codec          = "h264",
+	.caps           = OBS_ENCODER_CAP_DYN_BITRATE,
 	.get_name       = obs_x264_getname,
 	.create         = obs_x264_create,
 	.destroy        = obs_x264_destroy,
@@ -28,6 +28,7 @@ FT_Library ft2_lib;
 
 OBS_DECLARE_MODULE()
 OBS_MODULE_USE_DEFAULT_LOCALE("text-freetype2", "en-US")
+OBS_MODULE_LOAD_THREAD_SAFE()
 
 uint32_t texbuf_w = 2048, texbuf_h = 2048;
 
@@ -0,0 +1,226 @@
+/*
+ * Benchmark for the libobs format conversion functions.
+ *
+ * Times each conversion at 1080p and 4K, once for the whole frame on the
+ * calling thread and once split across a format_conversion_pool, and checks
+ * that both produce the same output.  The AVX2 paths are picked at runtime,
+ * so the single threaded numbers are the AVX2 ones on CPUs that support it.
+ *
+ * usage: format-conversion-bench [iterations] [threads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <media-io/format-conversion.h>
+
+enum conversion {
+	CONV_UYVX_TO_I420,
+	CONV_UYVX_TO_NV12,
+	CONV_UYVX_TO_I444,
+	CONV_420_TO_UYVX,
+	CONV_NV12_TO_UYVX,
+	CONV_422_TO_UYVX,
+	CONV_COUNT
+};
+
+static const char *conversion_names[CONV_COUNT] = {
+	"uyvx -> i420",
+	"uyvx -> nv12",
+	"uyvx -> i444",
+	"i420 -> uyvx",
+	"nv12 -> uyvx",
+	"yuy2 -> uyvx",
+};
+
+struct frame {
+	uint8_t  *data[3];
+	uint32_t linesize[3];
+	uint32_t plane_size[3];
+	size_t   planes;
+};
+
+struct conversion_data {
+	enum conversion conv;
+	struct frame    *in;
+	struct frame    *out;
+};
+
+static void frame_init(struct frame *frame, enum conversion conv, bool input,
+		uint32_t cx, uint32_t cy)
+{
+	bool packed = (conv <= CONV_UYVX_TO_I444) == input;
+
+	memset(frame, 0, sizeof(*frame));
+
+	if (packed) {
+		uint32_t bpp = (input && conv == CONV_422_TO_UYVX) ? 2 : 4;
+
+		frame->planes = 1;
+		frame->linesize[0] = cx * bpp;
+		frame->plane_size[0] = cx * bpp * cy;
+
+	} else if (conv == CONV_UYVX_TO_I444) {
+		frame->planes = 3;
+		for (size_t i = 0; i < 3; i++) {
+			frame->linesize[i] = cx;
+			frame->plane_size[i] = cx * cy;
+		}
+
+	} else if (conv == CONV_UYVX_TO_NV12 || conv == CONV_NV12_TO_UYVX) {
+		frame->planes = 2;
+		frame->linesize[0] = cx;
+		frame->linesize[1] = cx;
+		frame->plane_size[0] = cx * cy;
+		frame->plane_size[1] = cx * cy / 2;
+
+	} else {
+		frame->planes = 3;
+		frame->linesize[0] = cx;
+		frame->linesize[1] = cx / 2;
+		frame->linesize[2] = cx / 2;
+		frame->plane_size[0] = cx * cy;
+		frame->plane_size[1] = cx * cy / 4;
+		frame->plane_size[2] = cx * cy / 4;
+	}
+
+	for (size_t i = 0; i < frame->planes; i++) {
+		frame->data[i] = bmalloc(frame->plane_size[i]);
+		for (uint32_t j = 0; j < frame->plane_size[i]; j++)
+			frame->data[i][j] = (uint8_t)rand();
+	}
+}
+
+static void frame_free(struct frame *frame)
+{
+	for (size_t i = 0; i < frame->planes; i++)
+		bfree(frame->data[i]);
+}
+
+static bool frame_equal(const struct frame *a, const struct frame *b)
+{
+	for (size_t i = 0; i < a->planes; i++) {
+		if (memcmp(a->data[i], b->data[i], a->plane_size[i]) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+static void convert_slice(void *param, uint32_t start_y, uint32_t end_y)
+{
+	struct conversion_data *data = param;
+	struct frame *in = data->in;
+	struct frame *out = data->out;
+
+	switch (data->conv) {
+	case CONV_UYVX_TO_I420:
+		compress_uyvx_to_i420(in->data[0], in->linesize[0],
+				start_y, end_y, out->data, out->linesize);
+		break;
+	case CONV_UYVX_TO_NV12:
+		compress_uyvx_to_nv12(in->data[0], in->linesize[0],
+				start_y, end_y, out->data, out->linesize);
+		break;
+	case CONV_UYVX_TO_I444:
+		convert_uyvx_to_i444(in->data[0], in->linesize[0],
+				start_y, end_y, out->data, out->linesize);
+		break;
+	case CONV_420_TO_UYVX:
+		decompress_420((const uint8_t *const *)in->data, in->linesize,
+				start_y, end_y, out->data[0], out->linesize[0]);
+		break;
+	case CONV_NV12_TO_UYVX:
+		decompress_nv12((const uint8_t *const *)in->data, in->linesize,
+				start_y, end_y, out->data[0], out->linesize[0]);
+		break;
+	case CONV_422_TO_UYVX:
+		decompress_422(in->data[0], in->linesize[0],
+				start_y, end_y, out->data[0], out->linesize[0],
+				true);
+		break;
+	case CONV_COUNT:
+		break;
+	}
+}
+
+static double time_conversion(format_conversion_pool_t *pool,
+		struct conversion_data *data, uint32_t cy, int iterations)
+{
+	uint64_t start_time = os_gettime_ns();
+
+	for (int i = 0; i < iterations; i++)
+		format_conversion_pool_run(pool, cy, convert_slice, data);
+
+	return (double)(os_gettime_ns() - start_time) / 1000000.0 /
+		(double)iterations;
+}
+
+static bool bench(format_conversion_pool_t *pool, enum conversion conv,
+		uint32_t cx, uint32_t cy, int iterations)
+{
+	struct frame in, out, sliced_out;
+	struct conversion_data data = {conv, &in, &out};
+	double single_ms, sliced_ms;
+	bool equal;
+
+	frame_init(&in, conv, true, cx, cy);
+	frame_init(&out, conv, false, cx, cy);
+	frame_init(&sliced_out, conv, false, cx, cy);
+
+	single_ms = time_conversion(NULL, &data, cy, iterations);
+
+	data.out = &sliced_out;
+	sliced_ms = time_conversion(pool, &data, cy, iterations);
+
+	equal = frame_equal(&out, &sliced_out);
+
+	printf("%4ux%-4u  %s  %8.3f ms  %8.3f ms  %5.2fx%s\n",
+			cx, cy, conversion_names[conv],
+			single_ms, sliced_ms, single_ms / sliced_ms,
+			equal ? "" : "  OUTPUT MISMATCH");
+
+	frame_free(&in);
+	frame_free(&out);
+	frame_free(&sliced_out);
+	return equal;
+}
+
+int main(int argc, char *argv[])
+{
+	static const uint32_t sizes[][2] = {
+		{1920, 1080},
+		{3840, 2160},
+	};
+
+	int iterations = argc > 1 ? atoi(argv[1]) : 100;
+	int threads = argc > 2 ? atoi(argv[2]) : 0;
+	format_conversion_pool_t *pool;
+	bool success = true;
+
+	if (iterations <= 0)
+		iterations = 100;
+
+	/* with no pool, the sliced runs just convert the whole frame again */
+	pool = format_conversion_pool_create(threads);
+	if (!pool)
+		printf("no conversion pool, only one core available\n");
+
+	printf("%d iterations, %d physical cores\n\n", iterations,
+			os_get_physical_cores());
+	printf("size       conversion    single       sliced       speedup\n");
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		for (int conv = 0; conv < CONV_COUNT; conv++) {
+			if (!bench(pool, conv, sizes[i][0], sizes[i][1],
+						iterations))
+				success = false;
+		}
+	}
+
+	format_conversion_pool_destroy(pool);
+	return success ? 0 : 1;
+}
@@ -0,0 +1,232 @@
+/*
+ * Loopback test for the Linux RTMP socket thread.
+ *
+ * Runs socket_thread_linux against a sink on 127.0.0.1 that reads at a
+ * limited rate using a token bucket (the same shaping tc's tbf qdisc does),
+ * so no root access or qdisc setup is needed.  The stream is fed at
+ * STREAM_KBPS.  While the sink is slower than the stream, congestion must
+ * climb close to 1.0; once the sink is faster it must drain again, and every
+ * byte queued must arrive.
+ */
+
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#include "rtmp-stream.h"
+
+#define STREAM_KBPS       3000
+#define THROTTLED_KBPS    2000
+#define UNTHROTTLED_KBPS  8000
+#define PHASE_MS          4000
+#define TICK_MS           10
+#define BUCKET_SIZE       16384
+
+#define CHUNK_SIZE (STREAM_KBPS * 125 * TICK_MS / 1000)
+
+static int listen_fd = -1;
+static volatile long sink_kbps = THROTTLED_KBPS;
+static volatile long received = 0;
+
+static void *sink_thread(void *data)
+{
+	uint64_t last_time = os_gettime_ns();
+	double tokens = 0.0;
+	char buf[1024];
+	int fd;
+
+	UNUSED_PARAMETER(data);
+
+	fd = accept(listen_fd, NULL, NULL);
+	if (fd == -1)
+		return NULL;
+
+	for (;;) {
+		uint64_t cur_time = os_gettime_ns();
+
+		tokens += (double)(cur_time - last_time) / 1000000000.0 *
+			(double)sink_kbps * 125.0;
+		if (tokens > BUCKET_SIZE)
+			tokens = BUCKET_SIZE;
+		last_time = cur_time;
+
+		while (tokens >= sizeof(buf)) {
+			ssize_t ret = recv(fd, buf, sizeof(buf), 0);
+			if (ret <= 0) {
+				close(fd);
+				return NULL;
+			}
+
+			tokens -= (double)ret;
+			received += (long)ret;
+		}
+
+		os_sleep_ms(2);
+	}
+}
+
+static bool queue_data(struct rtmp_stream *stream, const char *data,
+		size_t size)
+{
+	for (;;) {
+		if (stream->rtmp.m_sb.sb_socket == -1)
+			return false;
+
+		pthread_mutex_lock(&stream->write_buf_mutex);
+		if (stream->write_buf_len + size <= stream->write_buf_size)
+			break;
+		pthread_mutex_unlock(&stream->write_buf_mutex);
+
+		if (os_event_timedwait(stream->buffer_space_available_event,
+					1000) == ETIMEDOUT)
+			return false;
+	}
+
+	memcpy(stream->write_buf + stream->write_buf_len, data, size);
+	stream->write_buf_len += size;
+	pthread_mutex_unlock(&stream->write_buf_mutex);
+
+	socket_thread_linux_signal(stream);
+	return true;
+}
+
+static int open_loopback(void)
+{
+	struct sockaddr_in addr = {0};
+	socklen_t addr_len = sizeof(addr);
+	int nonblock = 1;
+	int sock;
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (listen_fd == -1 ||
+	    bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+	    listen(listen_fd, 1) != 0 ||
+	    getsockname(listen_fd, (struct sockaddr*)&addr, &addr_len) != 0)
+		return -1;
+
+	sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (sock == -1)
+		return -1;
+	if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		close(sock);
+		return -1;
+	}
+
+	ioctl(sock, FIONBIO, &nonblock);
+	return sock;
+}
+
+/* feeds the stream for one phase, returning the highest and the final
+ * congestion seen */
+static bool run_phase(struct rtmp_stream *stream, long *sent,
+		float *max_congestion, float *end_congestion)
+{
+	char chunk[CHUNK_SIZE];
+
+	memset(chunk, 0xAA, sizeof(chunk));
+	*max_congestion = 0.0f;
+
+	for (int i = 0; i < PHASE_MS / TICK_MS; i++) {
+		if (!queue_data(stream, chunk, sizeof(chunk)))
+			return false;
+		*sent += (long)sizeof(chunk);
+
+		os_sleep_ms(TICK_MS);
+
+		if (stream->socket_congestion > *max_congestion)
+			*max_congestion = stream->socket_congestion;
+	}
+
+	*end_congestion = stream->socket_congestion;
+	return true;
+}
+
+int main(void)
+{
+	struct rtmp_stream stream = {0};
+	pthread_t sink, socket_thread;
+	float throttled_max, throttled_end;
+	float unthrottled_max, unthrottled_end;
+	long sent = 0;
+	bool success = false;
+
+	stream.socket_wake_fd = -1;
+	stream.rtmp.m_sb.sb_socket = open_loopback();
+	if (stream.rtmp.m_sb.sb_socket == -1) {
+		printf("failed to open loopback connection\n");
+		return 1;
+	}
+
+	if (pthread_create(&sink, NULL, sink_thread, NULL) != 0)
+		return 1;
+
+	if (!socket_thread_linux_init(&stream))
+		return 1;
+
+	pthread_mutex_init(&stream.write_buf_mutex, NULL);
+	os_event_init(&stream.buffer_space_available_event,
+			OS_EVENT_TYPE_AUTO);
+	os_event_init(&stream.send_thread_signaled_exit, OS_EVENT_TYPE_MANUAL);
+	os_event_init(&stream.stop_event, OS_EVENT_TYPE_MANUAL);
+
+	/* about a second of the stream, as rtmp-stream.c sizes it */
+	stream.write_buf_size = STREAM_KBPS * 128;
+	stream.write_buf = bmalloc(stream.write_buf_size);
+
+	if (pthread_create(&socket_thread, NULL, socket_thread_linux,
+				&stream) != 0)
+		return 1;
+
+	if (!run_phase(&stream, &sent, &throttled_max, &throttled_end)) {
+		printf("socket closed while throttled\n");
+		goto exit;
+	}
+
+	sink_kbps = UNTHROTTLED_KBPS;
+
+	if (!run_phase(&stream, &sent, &unthrottled_max, &unthrottled_end)) {
+		printf("socket closed while unthrottled\n");
+		goto exit;
+	}
+
+	printf("throttled (%d kbps):   max congestion %.2f, end %.2f\n",
+			THROTTLED_KBPS, throttled_max, throttled_end);
+	printf("unthrottled (%d kbps): max congestion %.2f, end %.2f\n",
+			UNTHROTTLED_KBPS, unthrottled_max, unthrottled_end);
+
+	success = throttled_max >= 0.9f && unthrottled_end <= 0.25f;
+
+exit:
+	os_event_signal(stream.send_thread_signaled_exit);
+	socket_thread_linux_signal(&stream);
+	pthread_join(socket_thread, NULL);
+
+	/* let the sink read whatever is still in flight */
+	for (int i = 0; i < 100 && received < sent; i++)
+		os_sleep_ms(10);
+
+	printf("sent %ld bytes, received %ld bytes\n", sent, received);
+	if (received != sent)
+		success = false;
+
+	if (stream.rtmp.m_sb.sb_socket != -1)
+		close(stream.rtmp.m_sb.sb_socket);
+	pthread_join(sink, NULL);
+	close(listen_fd);
+
+	socket_thread_linux_free(&stream);
+	os_event_destroy(stream.buffer_space_available_event);
+	os_event_destroy(stream.send_thread_signaled_exit);
+	os_event_destroy(stream.stop_event);
+	pthread_mutex_destroy(&stream.write_buf_mutex);
+	bfree(stream.write_buf);
+
+	printf("%s\n", success ? "PASS" : "FAIL");
+	return success ? 0 : 1;
+}